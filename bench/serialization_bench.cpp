@@ -0,0 +1,420 @@
+#include <benchmark/benchmark.h>
+
+#include <bit>
+#include <cstdint>
+#include <evm/columns.h>
+#include <evm/convert.h>
+#include <evm/cursor.h>
+#include <evm/instruction.h>
+#include <evm/loading.h>
+#include <evm/lz.h>
+#include <evm/primitive.h>
+#include <string>
+#include <vector>
+
+/// the number of values each benchmark iteration processes.
+static constexpr uint64_t batch = 4096;
+
+/**
+ * Reports the throughput of a benchmark, as items and bytes per second and
+ * the time per item (time/op).
+ */
+static void
+report (benchmark::State &state, uint64_t items, uint64_t bytes)
+{
+  state.SetItemsProcessed (state.iterations () * items);
+  state.SetBytesProcessed (state.iterations () * bytes);
+  state.counters["time/op"] = benchmark::Counter (
+      items, benchmark::Counter::kIsIterationInvariantRate
+                 | benchmark::Counter::kInvert);
+}
+
+template <typename T>
+static std::vector<uint8_t>
+saved_values ()
+{
+  std::vector<T> values (batch);
+  for (uint64_t i = 0; i < batch; i++)
+    values[i] = static_cast<T> (i * 7);
+
+  std::vector<uint8_t> buffer (batch * sizeof (T));
+  evm::save_span<T> (values, buffer.data ());
+
+  return buffer;
+}
+
+template <typename T>
+static void
+BM_value_ls_info_load (benchmark::State &state)
+{
+  auto buffer = saved_values<T> ();
+  std::vector<T> values (batch);
+  auto info = evm::value_ls_info<T> ();
+
+  for (auto _ : state)
+    {
+      for (uint64_t i = 0; i < batch; i++)
+        values[i] = info.load (buffer.data () + i * info.load_size (nullptr));
+      benchmark::DoNotOptimize (values.data ());
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+template <typename T>
+static void
+BM_value_ls_info_save (benchmark::State &state)
+{
+  std::vector<T> values (batch);
+  std::vector<uint8_t> buffer (batch * sizeof (T));
+  auto info = evm::value_ls_info<T> ();
+
+  for (auto _ : state)
+    {
+      for (uint64_t i = 0; i < batch; i++)
+        info.save (values[i], buffer.data () + i * info.save_size (values[i]));
+      benchmark::DoNotOptimize (buffer.data ());
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+/**
+ * The bulk counterpart of BM_value_ls_info_load.
+ */
+template <typename T>
+static void
+BM_load_span (benchmark::State &state)
+{
+  auto buffer = saved_values<T> ();
+  std::vector<T> values (batch);
+
+  for (auto _ : state)
+    {
+      evm::load_span<T> (values, buffer.data ());
+      benchmark::DoNotOptimize (values.data ());
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+template <typename T>
+static void
+BM_load_span_swapped (benchmark::State &state)
+{
+  constexpr auto foreign = std::endian::native == std::endian::little
+                               ? std::endian::big
+                               : std::endian::little;
+
+  auto buffer = saved_values<T> ();
+  std::vector<T> values (batch);
+
+  for (auto _ : state)
+    {
+      evm::load_span<T> (values, buffer.data (), foreign);
+      benchmark::DoNotOptimize (values.data ());
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+template <typename T>
+static void
+BM_save_span (benchmark::State &state)
+{
+  std::vector<T> values (batch);
+  std::vector<uint8_t> buffer (batch * sizeof (T));
+
+  for (auto _ : state)
+    {
+      evm::save_span<T> (values, buffer.data ());
+      benchmark::DoNotOptimize (buffer.data ());
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+#define BENCH_NUMERIC(BM)                                                     \
+  BENCHMARK_TEMPLATE (BM, int8_t);                                            \
+  BENCHMARK_TEMPLATE (BM, int16_t);                                           \
+  BENCHMARK_TEMPLATE (BM, int32_t);                                           \
+  BENCHMARK_TEMPLATE (BM, int64_t);                                           \
+  BENCHMARK_TEMPLATE (BM, uint8_t);                                           \
+  BENCHMARK_TEMPLATE (BM, uint16_t);                                          \
+  BENCHMARK_TEMPLATE (BM, uint32_t);                                          \
+  BENCHMARK_TEMPLATE (BM, uint64_t);                                          \
+  BENCHMARK_TEMPLATE (BM, float);                                             \
+  BENCHMARK_TEMPLATE (BM, double)
+
+BENCH_NUMERIC (BM_value_ls_info_load);
+BENCH_NUMERIC (BM_value_ls_info_save);
+BENCH_NUMERIC (BM_load_span);
+BENCH_NUMERIC (BM_load_span_swapped);
+BENCH_NUMERIC (BM_save_span);
+
+template <typename S>
+static void
+BM_string_load (benchmark::State &state)
+{
+  auto length = static_cast<uint64_t> (state.range (0));
+  auto info = evm::value_ls_info<S> ();
+
+  std::string str (length, 'x');
+  std::vector<uint8_t> buffer (length + 8);
+  evm::value_ls_info<std::string> ().save (str, buffer.data ());
+
+  for (auto _ : state)
+    {
+      auto loaded = info.load (buffer.data ());
+      benchmark::DoNotOptimize (loaded);
+    }
+
+  report (state, 1, buffer.size ());
+}
+
+static void
+BM_string_save (benchmark::State &state)
+{
+  auto length = static_cast<uint64_t> (state.range (0));
+  auto info = evm::value_ls_info<std::string> ();
+
+  std::string str (length, 'x');
+  std::vector<uint8_t> buffer (length + 8);
+
+  for (auto _ : state)
+    {
+      info.save (str, buffer.data ());
+      benchmark::DoNotOptimize (buffer.data ());
+    }
+
+  report (state, 1, buffer.size ());
+}
+
+BENCHMARK_TEMPLATE (BM_string_load, std::string)->Range (8, 1 << 16);
+BENCHMARK_TEMPLATE (BM_string_load, std::string_view)->Range (8, 1 << 16);
+BENCHMARK (BM_string_save)->Range (8, 1 << 16);
+
+/**
+ * A buffer of fat primitives of mixed types.
+ */
+static std::vector<uint8_t>
+saved_primitives (bool fat)
+{
+  evm::byte_writer writer;
+
+  for (uint64_t i = 0; i < batch; i++)
+    {
+      if (i % 3 == 0)
+        writer.write_primitive (evm::make_primitive<evm::I64_TYPE> (i), fat);
+      else if (i % 3 == 1)
+        writer.write_primitive (evm::make_primitive<evm::F64_TYPE> (i), fat);
+      else
+        writer.write_primitive (evm::make_primitive<evm::U8_TYPE> (i), fat);
+    }
+
+  return writer.take ();
+}
+
+static void
+BM_load_primitive_thin (benchmark::State &state)
+{
+  auto buffer = saved_primitives (false);
+  evm::primitive_type types[] = { evm::I64_TYPE, evm::F64_TYPE, evm::U8_TYPE };
+
+  for (auto _ : state)
+    {
+      const auto *data = buffer.data ();
+      for (uint64_t i = 0; i < batch; i++)
+        {
+          auto type = types[i % 3];
+          benchmark::DoNotOptimize (evm::load_primitive (type, data));
+          data += evm::primitive_load_size (type, data);
+        }
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+static void
+BM_load_primitive_fat (benchmark::State &state)
+{
+  auto buffer = saved_primitives (true);
+
+  for (auto _ : state)
+    {
+      const auto *data = buffer.data ();
+      for (uint64_t i = 0; i < batch; i++)
+        {
+          benchmark::DoNotOptimize (evm::load_primitive (data));
+          data += evm::primitive_load_size (data);
+        }
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+static void
+BM_read_primitive_fat (benchmark::State &state)
+{
+  auto buffer = saved_primitives (true);
+
+  for (auto _ : state)
+    {
+      evm::byte_reader reader (buffer);
+      while (!reader.at_end ())
+        benchmark::DoNotOptimize (reader.read_primitive ());
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+/**
+ * Decodes the mixed buffer when the argument is 0,
+ * and a buffer holding one long run of i64 otherwise.
+ */
+static void
+BM_decode_columns (benchmark::State &state)
+{
+  auto buffer = saved_primitives (true);
+
+  if (state.range (0) != 0)
+    {
+      evm::byte_writer writer;
+      for (uint64_t i = 0; i < batch; i++)
+        writer.write_primitive (evm::make_primitive<evm::I64_TYPE> (i), true);
+      buffer = writer.take ();
+    }
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize (evm::decode_columns (buffer));
+
+  report (state, batch, buffer.size ());
+}
+
+static void
+BM_save_primitive (benchmark::State &state)
+{
+  auto fat = state.range (0) != 0;
+  auto value = evm::make_primitive<evm::F64_TYPE> (1.5);
+  std::vector<uint8_t> buffer (batch * 9);
+
+  for (auto _ : state)
+    {
+      auto *data = buffer.data ();
+      for (uint64_t i = 0; i < batch; i++)
+        {
+          evm::save_primitive (value, data, fat);
+          data += evm::primitive_save_size (value, fat);
+        }
+      benchmark::DoNotOptimize (buffer.data ());
+    }
+
+  report (state, batch, batch * evm::primitive_save_size (value, fat));
+}
+
+BENCHMARK (BM_load_primitive_thin);
+BENCHMARK (BM_load_primitive_fat);
+BENCHMARK (BM_read_primitive_fat);
+BENCHMARK (BM_decode_columns)->Arg (0)->Arg (1);
+BENCHMARK (BM_save_primitive)->Arg (0)->Arg (1);
+
+static void
+BM_instruction_load (benchmark::State &state)
+{
+  evm::byte_writer writer;
+
+  for (uint64_t i = 0; i < batch; i++)
+    {
+      if (i % 2 == 0)
+        writer.write_instruction ({ .code = evm::opcode::load_local,
+                                    .args = { .local = { 1 } } });
+      else
+        writer.write_instruction (
+            { .code = evm::opcode::add, .args = { .lonely = {} } });
+    }
+
+  auto buffer = writer.take ();
+  auto info = evm::instruction::get_ls_info ();
+
+  for (auto _ : state)
+    {
+      const auto *data = buffer.data ();
+      for (uint64_t i = 0; i < batch; i++)
+        {
+          benchmark::DoNotOptimize (info.load (data));
+          data += info.load_size (data);
+        }
+    }
+
+  report (state, batch, buffer.size ());
+}
+
+BENCHMARK (BM_instruction_load);
+
+/**
+ * Decompresses a code section, as a compressed module section would be,
+ * reporting the throughput of the decompressed bytes.
+ */
+static void
+BM_lz_decompress (benchmark::State &state)
+{
+  evm::byte_writer writer;
+
+  for (uint64_t i = 0; i < batch * 4; i++)
+    writer.write_instruction ({ .code = evm::opcode::load_local,
+                                .args = { .local = { uint16_t (i % 5) } } });
+
+  auto raw = writer.take ();
+  auto block = evm::lz_compress (raw);
+  std::vector<uint8_t> output (raw.size ());
+
+  for (auto _ : state)
+    {
+      evm::lz_decompress (block, output);
+      benchmark::DoNotOptimize (output.data ());
+    }
+
+  report (state, batch * 4, raw.size ());
+}
+
+BENCHMARK (BM_lz_decompress);
+
+/**
+ * Converts an array of values to another type with each instruction set
+ * the CPU supports, given as the argument.
+ */
+template <evm::primitive_type FROM, evm::primitive_type TO>
+static void
+BM_convert_array (benchmark::State &state)
+{
+  auto level = static_cast<evm::simd_level> (state.range (0));
+  if (level > evm::simd_support ())
+    {
+      state.SkipWithError ("Instruction set is not supported.");
+      return;
+    }
+
+  std::vector<evm::primitive_value_t<FROM>> in (batch);
+  for (uint64_t i = 0; i < batch; i++)
+    in[i] = static_cast<evm::primitive_value_t<FROM>> (i * 7);
+  std::vector<evm::primitive_value_t<TO>> out (batch);
+
+  auto kernel = evm::find_array_convert (FROM, TO, level);
+  for (auto _ : state)
+    {
+      kernel (in.data (), out.data (), batch);
+      benchmark::DoNotOptimize (out.data ());
+    }
+
+  state.SetLabel (std::string (evm::simd_level_name (level)));
+  report (state, batch, batch * sizeof (in[0]));
+}
+
+BENCHMARK_TEMPLATE (BM_convert_array, evm::I32_TYPE, evm::F64_TYPE)
+    ->DenseRange (0, evm::simd_level_count - 1);
+BENCHMARK_TEMPLATE (BM_convert_array, evm::U8_TYPE, evm::I64_TYPE)
+    ->DenseRange (0, evm::simd_level_count - 1);
+BENCHMARK_TEMPLATE (BM_convert_array, evm::F64_TYPE, evm::F32_TYPE)
+    ->DenseRange (0, evm::simd_level_count - 1);
+BENCHMARK_TEMPLATE (BM_convert_array, evm::F64_TYPE, evm::I32_TYPE)
+    ->DenseRange (0, evm::simd_level_count - 1);
@@ -0,0 +1,456 @@
+/** @file
+ *
+ * @brief This header contains the arithmetic, comparison and conversion
+ * kernels on values of every @c evm::primitive_type, along with the
+ * promotion rules for operands of different types (@c evm::promote).
+ *
+ * Each operation has typed kernels on @c value_slot, such as
+ * @c evm::add<I64_TYPE>, for when the types are known, and a constexpr
+ * table of kernels indexed by the types of both operands
+ * (@c evm::find_arith) for when they are not.
+ * Neither visits a @c primitive_value.
+ */
+
+#ifndef EVM_COMMON_ARITH_H_
+#define EVM_COMMON_ARITH_H_
+
+#include "primitive.h"
+#include "tagged.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace evm
+{
+
+/**
+ * @brief The number of primitive types.
+ */
+constexpr uint8_t primitive_type_count = F64_TYPE + 1;
+
+/**
+ * @brief An arithmetic operation.
+ */
+enum class arith_op : uint8_t
+{
+  add,
+  sub,
+  mul,
+  div,
+  rem,
+};
+
+/**
+ * @brief A comparison.
+ */
+enum class compare_op : uint8_t
+{
+  eq,
+  ne,
+  lt,
+  le,
+  gt,
+  ge,
+};
+
+/**
+ * @brief The size of a value of the given type, in bytes.
+ */
+constexpr uint8_t
+type_size (primitive_type type)
+{
+  constexpr uint8_t sizes[] = { 1, 2, 4, 8, 1, 2, 4, 8, 4, 8 };
+  return sizes[type];
+}
+
+/**
+ * @brief The type two operands are converted to before an operation.
+ *
+ * - Operands of the same type are not converted.
+ * - If either operand is a float, both become the wider float type.
+ * - Integers of the same signedness become the wider type.
+ * - A signed and an unsigned integer become the smallest signed type wider
+ *   than the unsigned one and at least as wide as the signed one, which is
+ *   @c I64_TYPE at most, so @c U64_TYPE values above @c INT64_MAX wrap.
+ */
+constexpr primitive_type
+promote (primitive_type lhs, primitive_type rhs)
+{
+  if (lhs == rhs)
+    return lhs;
+
+  if (is_float_type (lhs) || is_float_type (rhs))
+    return lhs == F64_TYPE || rhs == F64_TYPE ? F64_TYPE : F32_TYPE;
+
+  if (is_signed_type (lhs) == is_signed_type (rhs))
+    return type_size (lhs) >= type_size (rhs) ? lhs : rhs;
+
+  auto signed_size = type_size (is_signed_type (lhs) ? lhs : rhs);
+  auto unsigned_size = type_size (is_signed_type (lhs) ? rhs : lhs);
+  auto size = std::min<uint8_t> (
+      std::max<uint8_t> (signed_size, 2 * unsigned_size), 8);
+
+  return static_cast<primitive_type> (I8_TYPE + std::countr_zero (size));
+}
+
+/**
+ * @brief Applies an arithmetic operation to two values of the same type.
+ *
+ * Integers wrap around, including @c INT64_MIN / @c -1,
+ * and the remainder of floats is @c std::fmod.
+ *
+ * @throws std::runtime_error on integer division by zero.
+ */
+template <arith_op OP, primitive_type TYPE>
+constexpr value_slot
+arith (value_slot lhs, value_slot rhs)
+{
+  using T = primitive_value_t<TYPE>;
+
+  auto a = from_slot<TYPE> (lhs);
+  auto b = from_slot<TYPE> (rhs);
+
+  if constexpr (std::is_integral_v<T>)
+    {
+      // unsigned 64 bits wraps around, and never promotes to int.
+      auto x = static_cast<uint64_t> (a);
+      auto y = static_cast<uint64_t> (b);
+
+      if constexpr (OP == arith_op::add)
+        return to_slot<TYPE> (static_cast<T> (x + y));
+      else if constexpr (OP == arith_op::sub)
+        return to_slot<TYPE> (static_cast<T> (x - y));
+      else if constexpr (OP == arith_op::mul)
+        return to_slot<TYPE> (static_cast<T> (x * y));
+      else
+        {
+          if (b == 0)
+            throw std::runtime_error ("Division by zero.");
+
+          // the one quotient that overflows, wrap it around.
+          if constexpr (std::is_signed_v<T>)
+            if (b == -1 && a == std::numeric_limits<T>::min ())
+              return to_slot<TYPE> (OP == arith_op::rem ? T (0) : a);
+
+          return to_slot<TYPE> (
+              static_cast<T> (OP == arith_op::rem ? a % b : a / b));
+        }
+    }
+  else
+    {
+      if constexpr (OP == arith_op::add)
+        return to_slot<TYPE> (a + b);
+      else if constexpr (OP == arith_op::sub)
+        return to_slot<TYPE> (a - b);
+      else if constexpr (OP == arith_op::mul)
+        return to_slot<TYPE> (a * b);
+      else if constexpr (OP == arith_op::div)
+        return to_slot<TYPE> (a / b);
+      else
+        return to_slot<TYPE> (std::fmod (a, b));
+    }
+}
+
+template <primitive_type TYPE>
+constexpr value_slot
+add (value_slot lhs, value_slot rhs)
+{
+  return arith<arith_op::add, TYPE> (lhs, rhs);
+}
+
+template <primitive_type TYPE>
+constexpr value_slot
+sub (value_slot lhs, value_slot rhs)
+{
+  return arith<arith_op::sub, TYPE> (lhs, rhs);
+}
+
+template <primitive_type TYPE>
+constexpr value_slot
+mul (value_slot lhs, value_slot rhs)
+{
+  return arith<arith_op::mul, TYPE> (lhs, rhs);
+}
+
+template <primitive_type TYPE>
+constexpr value_slot
+div (value_slot lhs, value_slot rhs)
+{
+  return arith<arith_op::div, TYPE> (lhs, rhs);
+}
+
+template <primitive_type TYPE>
+constexpr value_slot
+rem (value_slot lhs, value_slot rhs)
+{
+  return arith<arith_op::rem, TYPE> (lhs, rhs);
+}
+
+/**
+ * @brief Negates a value, integers wrap around.
+ * @throws std::runtime_error if it is not a number.
+ */
+template <primitive_type TYPE>
+constexpr value_slot
+neg (value_slot value)
+{
+  using T = primitive_value_t<TYPE>;
+  auto a = from_slot<TYPE> (value);
+
+  if constexpr (std::is_integral_v<T>)
+    return to_slot<TYPE> (static_cast<T> (0 - static_cast<uint64_t> (a)));
+  else
+    return to_slot<TYPE> (-a);
+}
+
+/**
+ * @brief Compares two values of the same type.
+ */
+template <compare_op OP, primitive_type TYPE>
+constexpr bool
+compare (value_slot lhs, value_slot rhs)
+{
+  auto a = from_slot<TYPE> (lhs);
+  auto b = from_slot<TYPE> (rhs);
+
+  if constexpr (OP == compare_op::eq)
+    return a == b;
+  else if constexpr (OP == compare_op::ne)
+    return a != b;
+  else if constexpr (OP == compare_op::lt)
+    return a < b;
+  else if constexpr (OP == compare_op::le)
+    return a <= b;
+  else if constexpr (OP == compare_op::gt)
+    return a > b;
+  else
+    return a >= b;
+}
+
+/**
+ * @brief Converts a value to another type.
+ *
+ * Integers are truncated or extended as in C++.
+ * Floats converted to integers round towards zero and saturate at the
+ * limits of the integer type, and NaN becomes zero.
+ * Floats converted to floats round to nearest, and overflow to infinity.
+ */
+template <primitive_type FROM, primitive_type TO>
+constexpr primitive_value_t<TO>
+convert_value (primitive_value_t<FROM> value)
+{
+  using F = primitive_value_t<FROM>;
+  using T = primitive_value_t<TO>;
+
+  if constexpr (std::is_floating_point_v<F> && std::is_integral_v<T>)
+    {
+      constexpr auto min = std::numeric_limits<T>::min ();
+      constexpr auto max = std::numeric_limits<T>::max ();
+
+      if (value != value)
+        return T (0);
+      // the limits may round up as floats, but then nothing lies between.
+      if (value <= static_cast<F> (min))
+        return min;
+      if (value >= static_cast<F> (max))
+        return max;
+
+      return static_cast<T> (value);
+    }
+  else
+    return static_cast<T> (value);
+}
+
+/**
+ * @brief Converts a slot to another type, see @c convert_value.
+ */
+template <primitive_type FROM, primitive_type TO>
+constexpr value_slot
+convert (value_slot slot)
+{
+  return to_slot<TO> (convert_value<FROM, TO> (from_slot<FROM> (slot)));
+}
+
+/**
+ * @brief A kernel for an arithmetic operation, with the types of its
+ * operands fixed. It returns a value of the promoted type.
+ */
+using arith_kernel = value_slot (*) (value_slot lhs, value_slot rhs);
+/**
+ * @brief A kernel for a comparison, with the types of its operands fixed.
+ */
+using compare_kernel = bool (*) (value_slot lhs, value_slot rhs);
+/**
+ * @brief A kernel for a conversion, with both types fixed.
+ */
+using convert_kernel = value_slot (*) (value_slot value);
+/**
+ * @brief A kernel for negation, with the type fixed.
+ */
+using neg_kernel = value_slot (*) (value_slot value);
+
+/// @cond IGNORE
+template <arith_op OP, primitive_type LHS, primitive_type RHS>
+value_slot
+promoted_arith (value_slot lhs, value_slot rhs)
+{
+  constexpr auto TYPE = promote (LHS, RHS);
+  return arith<OP, TYPE> (convert<LHS, TYPE> (lhs), convert<RHS, TYPE> (rhs));
+}
+
+template <compare_op OP, primitive_type LHS, primitive_type RHS>
+bool
+promoted_compare (value_slot lhs, value_slot rhs)
+{
+  constexpr auto TYPE = promote (LHS, RHS);
+
+  // integers compare exactly, whatever their signedness.
+  if constexpr (LHS != RHS && is_integer_type (LHS) && is_integer_type (RHS))
+    {
+      auto a = from_slot<LHS> (lhs);
+      auto b = from_slot<RHS> (rhs);
+
+      if constexpr (OP == compare_op::eq)
+        return std::cmp_equal (a, b);
+      else if constexpr (OP == compare_op::ne)
+        return std::cmp_not_equal (a, b);
+      else if constexpr (OP == compare_op::lt)
+        return std::cmp_less (a, b);
+      else if constexpr (OP == compare_op::le)
+        return std::cmp_less_equal (a, b);
+      else if constexpr (OP == compare_op::gt)
+        return std::cmp_greater (a, b);
+      else
+        return std::cmp_greater_equal (a, b);
+    }
+  else
+    return compare<OP, TYPE> (convert<LHS, TYPE> (lhs),
+                              convert<RHS, TYPE> (rhs));
+}
+
+/// the kernel for every pair of types, the left one major.
+template <typename K, template <primitive_type, primitive_type> class M>
+constexpr std::array<K, primitive_type_count * primitive_type_count>
+make_pair_table ()
+{
+  return []<uint64_t... I> (std::index_sequence<I...>) {
+    return std::array<K, sizeof...(I)>{ M<
+        static_cast<primitive_type> (I / primitive_type_count),
+        static_cast<primitive_type> (I % primitive_type_count)>::kernel... };
+  }(std::make_index_sequence<primitive_type_count * primitive_type_count> ());
+}
+
+template <arith_op OP> struct arith_entry
+{
+  template <primitive_type LHS, primitive_type RHS> struct of
+  {
+    static constexpr arith_kernel kernel = promoted_arith<OP, LHS, RHS>;
+  };
+};
+
+template <compare_op OP> struct compare_entry
+{
+  template <primitive_type LHS, primitive_type RHS> struct of
+  {
+    static constexpr compare_kernel kernel = promoted_compare<OP, LHS, RHS>;
+  };
+};
+
+template <primitive_type FROM, primitive_type TO> struct convert_entry
+{
+  static constexpr convert_kernel kernel = convert<FROM, TO>;
+};
+/// @endcond
+
+/**
+ * @brief The kernels of an arithmetic operation,
+ * indexed by @c lhs @c * @c primitive_type_count @c + @c rhs.
+ */
+template <arith_op OP>
+inline constexpr auto arith_table
+    = make_pair_table<arith_kernel, arith_entry<OP>::template of> ();
+
+/**
+ * @brief The kernels of a comparison, indexed as @c arith_table.
+ */
+template <compare_op OP>
+inline constexpr auto compare_table
+    = make_pair_table<compare_kernel, compare_entry<OP>::template of> ();
+
+/**
+ * @brief The conversion kernels, indexed by
+ * @c from @c * @c primitive_type_count @c + @c to.
+ */
+inline constexpr auto convert_table
+    = make_pair_table<convert_kernel, convert_entry> ();
+
+/**
+ * @brief The negation kernels, indexed by type.
+ */
+inline constexpr std::array<neg_kernel, primitive_type_count> neg_table = {
+  neg<I8_TYPE>,  neg<I16_TYPE>, neg<I32_TYPE>, neg<I64_TYPE>, neg<U8_TYPE>,
+  neg<U16_TYPE>, neg<U32_TYPE>, neg<U64_TYPE>, neg<F32_TYPE>, neg<F64_TYPE>,
+};
+
+/**
+ * @brief The index of a pair of types in a kernel table.
+ * Both types must be valid.
+ */
+constexpr uint64_t
+kernel_index (primitive_type lhs, primitive_type rhs)
+{
+  return uint64_t (lhs) * primitive_type_count + rhs;
+}
+
+/**
+ * @brief The kernel of an arithmetic operation on operands of the given
+ * types, which returns a value of type @c promote (lhs, rhs).
+ * @throws std::runtime_error if a type is invalid.
+ */
+arith_kernel find_arith (arith_op op, primitive_type lhs, primitive_type rhs);
+/**
+ * @brief The kernel of a comparison on operands of the given types.
+ * Integers are compared exactly, anything else in the promoted type.
+ * @throws std::runtime_error if a type is invalid.
+ */
+compare_kernel find_compare (compare_op op, primitive_type lhs,
+                             primitive_type rhs);
+/**
+ * @brief The kernel converting from one type to another, see @c convert.
+ * @throws std::runtime_error if a type is invalid.
+ */
+convert_kernel find_convert (primitive_type from, primitive_type to);
+
+/**
+ * @brief Applies an arithmetic operation to two values,
+ * promoting them first (see @c promote).
+ * @throws std::runtime_error on integer division by zero.
+ */
+primitive_value arith (arith_op op, const primitive_value &lhs,
+                       const primitive_value &rhs);
+/**
+ * @brief Compares two values, see @c find_compare.
+ */
+bool compare (compare_op op, const primitive_value &lhs,
+              const primitive_value &rhs);
+/**
+ * @brief Negates a value, integers wrap around.
+ * @throws std::runtime_error if it is not a number.
+ */
+primitive_value neg (const primitive_value &value);
+/**
+ * @brief Converts a value to another type, see @c convert.
+ * @throws std::runtime_error if @c to is invalid.
+ */
+primitive_value convert (const primitive_value &value, primitive_type to);
+
+} // evm
+
+#endif // EVM_COMMON_ARITH_H_
@@ -0,0 +1,147 @@
+/** @file
+ *
+ * @brief This header contains the on-disk cache of decoded and verified
+ * programs (@c evm::program_cache), so that a module seen before is loaded
+ * without decoding or verifying it again.
+ *
+ * Each entry is a file named after a hash of the module, the host
+ * signatures it was verified against and the cache version
+ * (@c evm::cache_key). It holds the program, its verification and its
+ * register code (see @c evm::lower_program) as arrays
+ * back to back, each aligned to 8 bytes, which are mapped and copied in
+ * bulk when the entry is found.
+ *
+ * Entries are saved in the byte order of the host. Entries of another
+ * version or byte order, or that are damaged, are never found and can be
+ * removed with @c evm::program_cache::prune.
+ */
+
+#ifndef EVM_COMMON_CACHE_H_
+#define EVM_COMMON_CACHE_H_
+
+#include "lowering.h"
+#include "program.h"
+#include "verifier.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace evm
+{
+
+/**
+ * @brief The version of the cache entry layout. It is bumped whenever
+ * the entries, or what decoding or verification produce, change.
+ * Together with @c module_version, it is part of every @c cache_key.
+ */
+constexpr uint32_t cache_version = 3;
+
+/**
+ * @brief What a cache entry is looked up by.
+ *
+ * This is a 128-bit hash, which is fast rather than cryptographic:
+ * the cache directory should only be writable by those trusted to
+ * provide programs.
+ */
+struct cache_key
+{
+  uint64_t high;
+  uint64_t low;
+
+  /**
+   * @brief Hashes a module with everything its cached form depends on.
+   * @param module The bytes of the module, as saved.
+   * @param hosts The host functions it is verified against.
+   * @param optimize Whether it is optimized before it is verified.
+   */
+  static cache_key of (std::span<const uint8_t> module,
+                       std::span<const host_signature> hosts, bool optimize);
+
+  /**
+   * @brief The key as 32 hexadecimal digits.
+   */
+  std::string to_string () const;
+
+  bool operator== (const cache_key &) const = default;
+};
+
+/**
+ * @brief A program along with its verification and register code,
+ * as the cache holds them.
+ */
+struct verified_program
+{
+  program prog;
+  verification verified;
+  reg_program lowered;
+};
+
+/**
+ * @brief A directory of decoded and verified programs.
+ *
+ * Entries are written to a temporary file and renamed into place,
+ * so many processes can share a directory, and a reader never sees
+ * a partly written entry.
+ */
+class program_cache
+{
+public:
+  /**
+   * @brief Uses @c directory, creating it if it does not exist.
+   * @throws std::runtime_error if it can not be created.
+   */
+  explicit program_cache (std::string directory);
+
+  /**
+   * @brief Loads a program from the cache,
+   * or decodes, optimizes if asked, verifies and lowers it then saves it
+   * if it is not there.
+   *
+   * A cache that can not be written is only slower,
+   * the program is still loaded.
+   *
+   * @throws std::runtime_error if the module is malformed,
+   * or its program does not verify.
+   */
+  verified_program load (std::span<const uint8_t> module,
+                         std::span<const host_signature> hosts = {},
+                         bool optimize = true) const;
+
+  /**
+   * @brief The entry for @c key, or @c std::nullopt if there is none,
+   * or it is damaged or of another version.
+   * @param hosts The host functions of the key, which are not saved in
+   * the entry.
+   */
+  std::optional<verified_program>
+  find (const cache_key &key, std::span<const host_signature> hosts) const;
+  /**
+   * @brief Saves an entry for @c key, replacing any there was.
+   * @throws std::runtime_error if the entry can not be written.
+   */
+  void store (const cache_key &key, const verified_program &entry) const;
+
+  /**
+   * @brief Removes the entries that can never be found, because they are
+   * of another version or byte order or are damaged,
+   * along with temporary files left behind. It should not run while
+   * another process stores entries, whose temporary files it would remove.
+   * @return The number of files removed.
+   */
+  uint64_t prune () const;
+
+  /**
+   * @brief The path of the entry for @c key.
+   */
+  std::string path_of (const cache_key &key) const;
+  const std::string &directory () const;
+
+private:
+  std::string m_directory;
+};
+
+} // evm
+
+#endif // EVM_COMMON_CACHE_H_
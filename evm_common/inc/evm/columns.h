@@ -0,0 +1,92 @@
+/** @file
+ *
+ * @brief This header contains columnar decoding of fat primitives
+ * (@c evm::decode_columns), which decodes a whole buffer in one pass into
+ * one array per @c evm::primitive_type.
+ */
+
+#ifndef EVM_COMMON_COLUMNS_H_
+#define EVM_COMMON_COLUMNS_H_
+
+#include "primitive.h"
+
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+namespace evm
+{
+
+/// @cond IGNORE
+template <typename V> struct columns_of;
+
+template <typename... T> struct columns_of<std::variant<T...>>
+{
+  using type = std::tuple<std::vector<T>...>;
+};
+/// @endcond
+
+/**
+ * @brief Primitives decoded into typed columns.
+ *
+ * The value at position @c i in the decoded buffer has the type
+ * @c types[i], and is at @c indices[i] in the column of that type.
+ */
+struct primitive_columns
+{
+  /**
+   * @brief A column for each @c primitive_type, in the same order.
+   */
+  typename columns_of<primitive_value>::type columns;
+  /**
+   * @brief The type of each value.
+   */
+  std::vector<primitive_type> types;
+  /**
+   * @brief The index of each value in its column.
+   */
+  std::vector<uint32_t> indices;
+
+  /**
+   * @brief The column of the given type.
+   */
+  template <primitive_type TYPE>
+  std::vector<primitive_value_t<TYPE>> &
+  column ()
+  {
+    return std::get<TYPE> (columns);
+  }
+
+  template <primitive_type TYPE>
+  const std::vector<primitive_value_t<TYPE>> &
+  column () const
+  {
+    return std::get<TYPE> (columns);
+  }
+
+  /**
+   * @brief The number of values decoded.
+   */
+  uint64_t size () const;
+  /**
+   * @brief The value at position @c index in the decoded buffer.
+   */
+  primitive_value get (uint64_t index) const;
+};
+
+/**
+ * @brief Decodes a buffer of fat primitives, as written by
+ * `save_primitive (..., true)`, into columns.
+ *
+ * Runs of values of the same type are decoded together,
+ * without looking at the type of each value again.
+ *
+ * @throws std::runtime_error if a type is invalid or a value is truncated.
+ */
+primitive_columns decode_columns (std::span<const uint8_t> buffer);
+
+} // evm
+
+#endif // EVM_COMMON_COLUMNS_H_
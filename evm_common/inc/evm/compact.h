@@ -0,0 +1,212 @@
+/** @file
+ *
+ * @brief This header contains the compact encoding of modules:
+ * LEB128 integers (@c evm::load_uleb128 and friends), and the conversion of
+ * a module to it (@c evm::compact_module).
+ *
+ * A module with @c module_flag_compact set saves integer constants,
+ * string lengths and instruction operands as LEB128,
+ * unsigned values as ULEB128 and signed values as SLEB128,
+ * so that the small values most code uses take a byte or two.
+ * Floats, opcodes, types and functions are saved as usual.
+ */
+
+#ifndef EVM_COMMON_COMPACT_H_
+#define EVM_COMMON_COMPACT_H_
+
+#include "module.h"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief The most bytes a 64-bit LEB128 value takes.
+ */
+constexpr uint64_t max_leb128_size = 10;
+
+/**
+ * @brief The size of @c value as ULEB128.
+ */
+constexpr uint64_t
+uleb128_size (uint64_t value)
+{
+  auto bits = 64 - std::countl_zero (value | 1);
+  return (bits + 6) / 7;
+}
+
+/**
+ * @brief The size of @c value as SLEB128.
+ */
+constexpr uint64_t
+sleb128_size (int64_t value)
+{
+  // the bits that differ from the sign, and the sign.
+  auto bits
+      = 65 - std::countl_zero (static_cast<uint64_t> (value ^ (value >> 63)));
+  return (bits + 6) / 7;
+}
+
+/**
+ * @brief Saves @c value as ULEB128.
+ * @return The number of bytes written, see @c uleb128_size.
+ */
+inline uint64_t
+save_uleb128 (uint64_t value, uint8_t *buffer)
+{
+  uint64_t size = 0;
+
+  for (; value >= 0x80; value >>= 7)
+    buffer[size++] = static_cast<uint8_t> (value) | 0x80;
+  buffer[size++] = static_cast<uint8_t> (value);
+
+  return size;
+}
+
+/**
+ * @brief Saves @c value as SLEB128.
+ * @return The number of bytes written, see @c sleb128_size.
+ */
+inline uint64_t
+save_sleb128 (int64_t value, uint8_t *buffer)
+{
+  auto size = sleb128_size (value);
+
+  for (uint64_t i = 0; i + 1 < size; i++, value >>= 7)
+    buffer[i] = static_cast<uint8_t> (value & 0x7f) | 0x80;
+  buffer[size - 1] = static_cast<uint8_t> (value & 0x7f);
+
+  return size;
+}
+
+/// @cond IGNORE
+/**
+ * Decodes up to 8 bytes of LEB128 at once, without a branch per byte:
+ * the first clear continuation bit gives the size,
+ * and the 7-bit groups are packed together in three steps.
+ */
+inline uint64_t
+load_leb128_word (const uint8_t *buffer, uint64_t &value)
+{
+  uint64_t word;
+  std::memcpy (&word, buffer, sizeof (word));
+
+  if constexpr (std::endian::native == std::endian::big)
+    {
+#if defined(__GNUC__)
+      word = __builtin_bswap64 (word);
+#else
+      return 0;
+#endif
+    }
+
+  auto stops = ~word & 0x8080808080808080;
+  if (stops == 0)
+    return 0;
+
+  auto bits = std::countr_zero (stops) + 1;
+  auto groups = bits == 64 ? word : word & ((uint64_t (1) << bits) - 1);
+
+  groups &= 0x7f7f7f7f7f7f7f7f;
+  groups = (groups & 0x007f007f007f007f)
+           | ((groups & 0x7f007f007f007f00) >> 1);
+  groups = (groups & 0x00003fff00003fff)
+           | ((groups & 0x3fff00003fff0000) >> 2);
+  groups = (groups & 0x000000000fffffff)
+           | ((groups & 0x0fffffff00000000) >> 4);
+
+  value = groups;
+  return bits / 8;
+}
+
+/**
+ * Decodes LEB128 a byte at a time, for the end of a buffer and for values
+ * over 56 bits.
+ */
+template <bool is_signed>
+inline uint64_t
+load_leb128_bytes (const uint8_t *buffer, uint64_t available, uint64_t &value)
+{
+  uint64_t result = 0;
+
+  for (uint64_t i = 0; i < available && i < max_leb128_size; i++)
+    {
+      auto byte = buffer[i];
+      result |= uint64_t (byte & 0x7f) << (7 * i);
+
+      if (byte & 0x80)
+        continue;
+
+      // the last byte only has room for the top bit,
+      // and the rest of a signed one is its sign.
+      if (i == max_leb128_size - 1
+          && (is_signed ? byte != 0 && byte != 0x7f : byte > 1))
+        return 0;
+
+      value = result;
+      return i + 1;
+    }
+
+  return 0;
+}
+/// @endcond
+
+/**
+ * @brief Loads a ULEB128 value.
+ * @param available The number of bytes that can be read from @c buffer.
+ * @return The number of bytes read,
+ * or @c 0 if the value is truncated or too large.
+ */
+inline uint64_t
+load_uleb128 (const uint8_t *buffer, uint64_t available, uint64_t &value)
+{
+  if (available >= sizeof (uint64_t))
+    if (auto size = load_leb128_word (buffer, value))
+      return size;
+
+  return load_leb128_bytes<false> (buffer, available, value);
+}
+
+/**
+ * @brief Loads a SLEB128 value, see @c load_uleb128.
+ */
+inline uint64_t
+load_sleb128 (const uint8_t *buffer, uint64_t available, int64_t &value)
+{
+  uint64_t bits = 0;
+  uint64_t size = 0;
+
+  if (available >= sizeof (uint64_t))
+    size = load_leb128_word (buffer, bits);
+  if (size == 0)
+    size = load_leb128_bytes<true> (buffer, available, bits);
+  if (size == 0)
+    return 0;
+
+  // extend the sign bit of the last group.
+  auto shift = 7 * size;
+  if (shift < 64 && (bits >> (shift - 1)) & 1)
+    bits |= ~uint64_t (0) << shift;
+
+  value = static_cast<int64_t> (bits);
+  return size;
+}
+
+/**
+ * @brief Re-encodes a module with @c module_flag_compact.
+ *
+ * Instructions are laid out again, and jump targets and function entries
+ * moved to match. Sections of other kinds are copied as they are.
+ * A module that is already compact is copied.
+ *
+ * @throws std::runtime_error if a section is malformed.
+ */
+std::vector<uint8_t> compact_module (const module_view &module);
+
+} // evm
+
+#endif // EVM_COMMON_COMPACT_H_
@@ -0,0 +1,100 @@
+/** @file
+ *
+ * @brief This header contains the conversion of whole arrays of values
+ * between any two number types (@c evm::convert_array), with kernels for
+ * several instruction sets of which the best the CPU supports is picked
+ * at runtime (@c evm::simd_support).
+ *
+ * The kernels of every pair of types and instruction set come from one
+ * template, and convert exactly as @c evm::convert_value does.
+ */
+
+#ifndef EVM_COMMON_CONVERT_H_
+#define EVM_COMMON_CONVERT_H_
+
+#include "arith.h"
+#include "primitive.h"
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+namespace evm
+{
+
+/**
+ * @brief An instruction set the conversion kernels are built for,
+ * each a superset of the one before.
+ */
+enum class simd_level : uint8_t
+{
+  scalar, /**< one value at a time, on any CPU */
+  sse4_2, /**< 16-byte vectors, on x86 with SSE4.2 */
+  avx2,   /**< 32-byte vectors, on x86 with AVX2 */
+};
+
+/**
+ * @brief The number of instruction sets.
+ */
+constexpr uint8_t simd_level_count = uint8_t (simd_level::avx2) + 1;
+
+/**
+ * @brief The best instruction set the CPU supports, read from CPUID once.
+ * Always @c simd_level::scalar on other CPUs.
+ */
+simd_level simd_support ();
+
+/**
+ * @brief The name of an instruction set, such as @c "avx2".
+ */
+std::string_view simd_level_name (simd_level level);
+
+/**
+ * @brief A kernel converting @c count values from one type to another,
+ * between arrays of @c primitive_value_t of those types that do not overlap.
+ */
+using array_convert_kernel = void (*) (const void *in, void *out,
+                                       uint64_t count);
+
+/**
+ * @brief The kernel converting arrays from one type to another,
+ * with the given instruction set.
+ * @throws std::runtime_error if a type is not a number,
+ * or the CPU does not support the instruction set.
+ */
+array_convert_kernel find_array_convert (primitive_type from,
+                                         primitive_type to, simd_level level);
+/**
+ * @brief The kernel converting arrays from one type to another,
+ * with the best instruction set the CPU supports.
+ * @throws std::runtime_error if a type is not a number.
+ */
+array_convert_kernel find_array_convert (primitive_type from,
+                                         primitive_type to);
+
+/**
+ * @brief Converts @c count values from an array of @c from values to an
+ * array of @c to values, see @c find_array_convert.
+ */
+void convert_array (primitive_type from, primitive_type to, const void *in,
+                    void *out, uint64_t count);
+
+/**
+ * @brief Converts an array of values to another type, see @c convert_value.
+ * @throws std::runtime_error if the arrays are not the same size.
+ */
+template <primitive_type FROM, primitive_type TO>
+void
+convert_array (std::span<const primitive_value_t<FROM>> in,
+               std::span<primitive_value_t<TO>> out)
+{
+  if (in.size () != out.size ())
+    throw std::runtime_error ("Arrays are not the same size.");
+
+  find_array_convert (FROM, TO) (in.data (), out.data (), in.size ());
+}
+
+} // evm
+
+#endif // EVM_COMMON_CONVERT_H_
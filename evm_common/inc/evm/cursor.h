@@ -0,0 +1,308 @@
+/** @file
+ *
+ * @brief This header contains cursors, which load (@c evm::byte_reader) and
+ * save (@c evm::byte_writer) values one after another,
+ * keeping track of the position themselves.
+ */
+
+#ifndef EVM_COMMON_CURSOR_H_
+#define EVM_COMMON_CURSOR_H_
+
+#include "compact.h"
+#include "instruction.h"
+#include "primitive.h"
+#include "serializer.h"
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief Reads values from a buffer, advancing past each one as it is read.
+ *
+ * Every value is decoded exactly once,
+ * there is no need to get its size before loading it.
+ */
+class byte_reader
+{
+public:
+  /**
+   * @param bytes Bytes to read.
+   * @param checked Whether reads are bounds checked. An unchecked reader
+   * trusts its input, and reading past the end is undefined.
+   */
+  explicit byte_reader (std::span<const uint8_t> bytes, bool checked = true)
+      : m_begin (bytes.data ()), m_position (bytes.data ()),
+        m_end (bytes.data () + bytes.size ()), m_checked (checked)
+  {
+  }
+
+  /**
+   * @brief Reads a value with a @c serializer.
+   * @throws std::out_of_range if checked and the value is truncated.
+   */
+  template <serializable T>
+  T
+  read ()
+  {
+    if constexpr (fixed_serializable<T>)
+      require (serializer<T>::size);
+    else if (m_checked)
+      {
+        // the values that are not fixed start with their length, which is
+        // checked against what is left after it, since adding the two
+        // could wrap around.
+        require (sizeof (uint64_t));
+        auto length = serializer<uint64_t>::load (m_position);
+        if (length > remaining () - sizeof (uint64_t))
+          throw std::out_of_range ("Read past the end of the buffer.");
+      }
+
+    auto value = serializer<T>::load (m_position);
+    m_position += serializer<T>::load_size (m_position);
+
+    return value;
+  }
+
+  /**
+   * @brief Reads a fat primitive, see @c load_primitive.
+   * @throws std::runtime_error if the type is invalid.
+   */
+  primitive_value read_primitive ();
+  /**
+   * @brief Reads a thin primitive of the given type.
+   */
+  primitive_value read_primitive (primitive_type type);
+  /**
+   * @brief Reads an instruction, see @c instruction::load.
+   * @throws std::runtime_error if the opcode is invalid.
+   */
+  instruction read_instruction ();
+
+  /**
+   * @brief Reads a ULEB128 value, see compact.h.
+   * @throws std::runtime_error if it is truncated or too large.
+   */
+  uint64_t
+  read_uleb128 ()
+  {
+    uint64_t value;
+    auto size = load_uleb128 (m_position, remaining (), value);
+
+    if (size == 0)
+      throw std::runtime_error ("Malformed LEB128 value.");
+
+    m_position += size;
+    return value;
+  }
+
+  /**
+   * @brief Reads a SLEB128 value, see compact.h.
+   * @throws std::runtime_error if it is truncated or too large.
+   */
+  int64_t
+  read_sleb128 ()
+  {
+    int64_t value;
+    auto size = load_sleb128 (m_position, remaining (), value);
+
+    if (size == 0)
+      throw std::runtime_error ("Malformed LEB128 value.");
+
+    m_position += size;
+    return value;
+  }
+
+  /**
+   * @brief Reads a fat primitive in the compact encoding.
+   * @throws std::runtime_error if the type is invalid,
+   * or the value does not fit it.
+   */
+  primitive_value read_compact_primitive ();
+  /**
+   * @brief Reads an instruction in the compact encoding.
+   * @throws std::runtime_error if the opcode is invalid,
+   * or an operand does not fit it.
+   */
+  instruction read_compact_instruction ();
+  /**
+   * @brief Reads a string in the compact encoding, without copying it.
+   */
+  std::string_view read_compact_string ();
+
+  /**
+   * @brief Reads @c count raw bytes, without copying them.
+   */
+  std::span<const uint8_t>
+  read_bytes (uint64_t count)
+  {
+    require (count);
+
+    auto bytes = std::span<const uint8_t> (m_position, count);
+    m_position += count;
+
+    return bytes;
+  }
+
+  void
+  skip (uint64_t count)
+  {
+    require (count);
+    m_position += count;
+  }
+
+  /**
+   * @brief The number of bytes read so far.
+   */
+  uint64_t
+  offset () const
+  {
+    return m_position - m_begin;
+  }
+
+  uint64_t
+  remaining () const
+  {
+    return m_end - m_position;
+  }
+
+  bool
+  at_end () const
+  {
+    return m_position >= m_end;
+  }
+
+  /**
+   * @brief The next byte to be read.
+   */
+  const uint8_t *
+  position () const
+  {
+    return m_position;
+  }
+
+private:
+  void
+  require (uint64_t count) const
+  {
+    if (m_checked && count > remaining ())
+      throw std::out_of_range ("Read past the end of the buffer.");
+  }
+
+  const uint8_t *m_begin;
+  const uint8_t *m_position;
+  const uint8_t *m_end;
+  bool m_checked;
+};
+
+/**
+ * @brief Writes values into a growing buffer, one after another.
+ *
+ * The buffer grows geometrically, and at least by a batch each time,
+ * so that writing many small values rarely reallocates.
+ */
+class byte_writer
+{
+public:
+  /**
+   * @param batch The least number of bytes the buffer grows by.
+   */
+  explicit byte_writer (uint64_t batch = 4096) : m_batch (batch) {}
+
+  /**
+   * @brief Writes a value with a @c serializer.
+   */
+  template <serializable T>
+  void
+  write (const T &value)
+  {
+    serializer<T>::save (value, reserve (serializer<T>::save_size (value)));
+  }
+
+  /**
+   * @brief Writes a primitive, see @c save_primitive.
+   */
+  void write_primitive (const primitive_value &value, bool fat = false);
+  /**
+   * @brief Writes an instruction, see @c instruction::save.
+   */
+  void write_instruction (const instruction &instr);
+
+  void
+  write_uleb128 (uint64_t value)
+  {
+    auto *bytes = reserve (max_leb128_size);
+    m_size -= max_leb128_size - save_uleb128 (value, bytes);
+  }
+
+  void
+  write_sleb128 (int64_t value)
+  {
+    auto *bytes = reserve (max_leb128_size);
+    m_size -= max_leb128_size - save_sleb128 (value, bytes);
+  }
+
+  /**
+   * @brief Writes a fat primitive in the compact encoding.
+   */
+  void write_compact_primitive (const primitive_value &value);
+  /**
+   * @brief Writes an instruction in the compact encoding.
+   */
+  void write_compact_instruction (const instruction &instr);
+  void write_compact_string (std::string_view value);
+
+  void write_bytes (std::span<const uint8_t> bytes);
+
+  /**
+   * @brief Appends @c count bytes to the buffer, to be written by the caller.
+   * @return The first appended byte, valid until the next write.
+   */
+  uint8_t *
+  reserve (uint64_t count)
+  {
+    if (m_size + count > m_buffer.size ())
+      grow (count);
+
+    auto *bytes = m_buffer.data () + m_size;
+    m_size += count;
+
+    return bytes;
+  }
+
+  uint64_t
+  size () const
+  {
+    return m_size;
+  }
+
+  /**
+   * @brief The bytes written so far.
+   */
+  std::span<const uint8_t>
+  bytes () const
+  {
+    return std::span<const uint8_t> (m_buffer.data (), m_size);
+  }
+
+  /**
+   * @brief Takes the bytes written, leaving the writer empty.
+   */
+  std::vector<uint8_t> take ();
+
+private:
+  void grow (uint64_t count);
+
+  std::vector<uint8_t> m_buffer;
+  uint64_t m_size = 0;
+  uint64_t m_batch;
+};
+
+} // evm
+
+#endif // EVM_COMMON_CURSOR_H_
@@ -0,0 +1,149 @@
+/** @file
+ *
+ * @brief This header contains the pre-decoded form of code
+ * (@c evm::decoded_code), which is what gets executed.
+ */
+
+#ifndef EVM_COMMON_DECODE_H_
+#define EVM_COMMON_DECODE_H_
+
+#include "instruction.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief Code decoded in one pass, as a struct of arrays.
+ *
+ * Instructions are addressed by their index,
+ * and each one has an entry in every array.
+ * The operands are pre-resolved into 64-bit slots:
+ * jump targets are instruction indices,
+ * fused branches are packed into a @c branch_operand,
+ * and every other argument is zero extended.
+ */
+struct decoded_code
+{
+  /**
+   * @brief The opcode of each instruction.
+   */
+  std::vector<opcode> opcodes;
+  /**
+   * @brief The operand of each instruction, @c 0 for lonely instructions.
+   */
+  std::vector<uint64_t> operands;
+  /**
+   * @brief The offset of each instruction in the encoded code.
+   */
+  std::vector<uint32_t> offsets;
+
+  /**
+   * @brief The number of instructions.
+   */
+  uint64_t size () const;
+  /**
+   * @brief The index of the instruction at @c offset in the encoded code,
+   * or @c std::nullopt if no instruction starts there.
+   *
+   * This function runs in *O(log n)* time.
+   */
+  std::optional<uint32_t> index_of (uint32_t offset) const;
+};
+
+/**
+ * @brief The pre-resolved operand of an @c instruction_kind::branch
+ * instruction.
+ *
+ * It is packed into a slot as the target in the low 32 bits,
+ * then the value, the comparison and the jump.
+ */
+struct branch_operand
+{
+  /**
+   * @brief The instruction index to jump to.
+   */
+  uint32_t target;
+  /**
+   * @brief The local variable or constant to compare with.
+   */
+  uint16_t value;
+  /**
+   * @brief The comparison, one of @c opcode::eq to @c opcode::ge.
+   */
+  opcode compare;
+  /**
+   * @brief @c opcode::jump_if or @c opcode::jump_unless.
+   */
+  opcode jump;
+
+  static constexpr branch_operand
+  unpack (uint64_t slot)
+  {
+    return branch_operand{
+      .target = static_cast<uint32_t> (slot),
+      .value = static_cast<uint16_t> (slot >> 32),
+      .compare = static_cast<opcode> (slot >> 48),
+      .jump = static_cast<opcode> (slot >> 56),
+    };
+  }
+
+  constexpr uint64_t
+  pack () const
+  {
+    return uint64_t (target) | uint64_t (value) << 32
+           | uint64_t (compare) << 48 | uint64_t (jump) << 56;
+  }
+};
+
+/**
+ * @brief Whether the opcode is a comparison, @c opcode::eq to @c opcode::ge.
+ */
+constexpr bool
+is_comparison (opcode code)
+{
+  return code >= opcode::eq && code <= opcode::ge;
+}
+
+/**
+ * @brief Whether the opcode is a conditional jump.
+ */
+constexpr bool
+is_conditional_jump (opcode code)
+{
+  return code == opcode::jump_if || code == opcode::jump_unless;
+}
+
+/**
+ * @brief Decodes the encoded instructions in @c code.
+ * @param compact Whether the code is in the compact encoding,
+ * see @c module_flag_compact.
+ * @throws std::runtime_error if there is an invalid opcode,
+ * a truncated instruction, a jump to a non instruction offset,
+ * or a fused branch without a comparison and a conditional jump.
+ */
+decoded_code decode_code (std::span<const uint8_t> code,
+                          bool compact = false);
+
+/**
+ * @brief Turns the jump targets of code decoded one instruction at a time
+ * from offsets into instruction indices, as @c decode_code does.
+ * @throws std::runtime_error if a jump is to a non instruction offset,
+ * or a fused branch is without a comparison and a conditional jump.
+ */
+void resolve_jumps (decoded_code &code);
+
+/**
+ * @brief The pre-resolved operand slot for the given instruction arguments.
+ * Jump targets are left as offsets.
+ */
+uint64_t instruction_operand (instruction_kind kind,
+                              const instruction_args &args);
+
+} // evm
+
+#endif // EVM_COMMON_DECODE_H_
@@ -7,14 +7,19 @@
 #define EVM_COMMON_INSTRUCTION_H_
 
 #include "loading.h"
+#include "primitive.h"
 #include <cstdint>
+#include <string_view>
 
 namespace evm
 {
 
 /**
  * @brief An Operation Code (opcode).
- * This is currently a stub.
+ *
+ * Values are pushed to and popped from the operand stack.
+ * Comparisons push a @c U8_TYPE that is @c 1 if the comparison holds and @c 0
+ * otherwise, and conditional jumps treat any non zero value as true.
  */
 enum class opcode : uint8_t
 {
@@ -22,8 +27,217 @@ enum class opcode : uint8_t
    * @brief @c nop No operation.
    */
   nop,
+  /**
+   * @brief @c load_const Pushes the constant at the given index.
+   */
+  load_const,
+  /**
+   * @brief @c pop Pops a value.
+   */
+  pop,
+  /**
+   * @brief @c dup Pushes a copy of the top value.
+   */
+  dup,
+  /**
+   * @brief @c swap Swaps the two top values.
+   */
+  swap,
+  /**
+   * @brief @c load_local Pushes the local variable at the given index.
+   */
+  load_local,
+  /**
+   * @brief @c store_local Pops a value into the local variable at the given
+   * index.
+   */
+  store_local,
+  /**
+   * @brief @c add Pops two values, and pushes their sum.
+   */
+  add,
+  /**
+   * @brief @c sub Pops two values, and pushes their difference.
+   */
+  sub,
+  /**
+   * @brief @c mul Pops two values, and pushes their product.
+   */
+  mul,
+  /**
+   * @brief @c div Pops two values, and pushes their quotient.
+   */
+  div,
+  /**
+   * @brief @c rem Pops two values, and pushes the remainder of their
+   * division.
+   */
+  rem,
+  /**
+   * @brief @c neg Pops a value and pushes its negation.
+   */
+  neg,
+  /**
+   * @brief @c eq Pops two values, and pushes whether they are equal.
+   */
+  eq,
+  /**
+   * @brief @c ne Pops two values, and pushes whether they are not equal.
+   */
+  ne,
+  /**
+   * @brief @c lt Pops two values, and pushes whether the first is less than
+   * the second.
+   */
+  lt,
+  /**
+   * @brief @c le Pops two values, and pushes whether the first is less than
+   * or equal to the second.
+   */
+  le,
+  /**
+   * @brief @c gt Pops two values, and pushes whether the first is greater
+   * than the second.
+   */
+  gt,
+  /**
+   * @brief @c ge Pops two values, and pushes whether the first is greater
+   * than or equal to the second.
+   */
+  ge,
+  /**
+   * @brief @c conv Pops a value, and pushes it converted to the given type.
+   */
+  conv,
+  /**
+   * @brief @c jump Continues at the given offset.
+   */
+  jump,
+  /**
+   * @brief @c jump_if Pops a value, and continues at the given offset if it
+   * is true.
+   */
+  jump_if,
+  /**
+   * @brief @c jump_unless Pops a value, and continues at the given offset if
+   * it is false.
+   */
+  jump_unless,
+  /**
+   * @brief @c call Calls the function at the given index.
+   */
+  call,
+  /**
+   * @brief @c ret Returns from the current function.
+   */
+  ret,
+  /**
+   * @brief @c host_call Calls the host function at the given index.
+   */
+  host_call,
+
+  // superinstructions, made by the optimizer (see optimizer.h).
+
+  /**
+   * @brief @c add_const Adds the constant at the given index to the top
+   * value, fusing @c load_const and @c add.
+   */
+  add_const,
+  /**
+   * @brief @c sub_const Subtracts the constant at the given index from the
+   * top value, fusing @c load_const and @c sub.
+   */
+  sub_const,
+  /**
+   * @brief @c branch_local Pops a value, compares it to the given local
+   * variable and jumps on the result,
+   * fusing @c load_local, a comparison and a conditional jump.
+   */
+  branch_local,
+  /**
+   * @brief @c branch_const Pops a value, compares it to the given constant
+   * and jumps on the result,
+   * fusing @c load_const, a comparison and a conditional jump.
+   */
+  branch_const,
+
+  // instructions on the heap of the interpreter, whose objects are
+  // referred to by values of REF_TYPE.
+
+  /**
+   * @brief @c load_string Pushes a new string on the heap, copied from the
+   * string at the given index of the strings section.
+   */
+  load_string,
+  /**
+   * @brief @c concat Pops two strings, and pushes a new string that joins
+   * them.
+   */
+  concat,
+
+  // quickened instructions, which an interpreter rewrites its own copy of
+  // the code into once it knows the type of their operands
+  // (see quickened_opcode). They are never encoded.
+
+  /** @brief @c add of two @c I64_TYPE values. */
+  add_i64,
+  /** @brief @c sub of two @c I64_TYPE values. */
+  sub_i64,
+  /** @brief @c mul of two @c I64_TYPE values. */
+  mul_i64,
+  /** @brief @c eq of two @c I64_TYPE values. */
+  eq_i64,
+  /** @brief @c ne of two @c I64_TYPE values. */
+  ne_i64,
+  /** @brief @c lt of two @c I64_TYPE values. */
+  lt_i64,
+  /** @brief @c le of two @c I64_TYPE values. */
+  le_i64,
+  /** @brief @c gt of two @c I64_TYPE values. */
+  gt_i64,
+  /** @brief @c ge of two @c I64_TYPE values. */
+  ge_i64,
+  /** @brief @c add_const of an @c I64_TYPE value. */
+  add_const_i64,
+  /** @brief @c sub_const of an @c I64_TYPE value. */
+  sub_const_i64,
+  /** @brief @c add of two @c F64_TYPE values. */
+  add_f64,
+  /** @brief @c sub of two @c F64_TYPE values. */
+  sub_f64,
+  /** @brief @c mul of two @c F64_TYPE values. */
+  mul_f64,
+  /** @brief @c eq of two @c F64_TYPE values. */
+  eq_f64,
+  /** @brief @c ne of two @c F64_TYPE values. */
+  ne_f64,
+  /** @brief @c lt of two @c F64_TYPE values. */
+  lt_f64,
+  /** @brief @c le of two @c F64_TYPE values. */
+  le_f64,
+  /** @brief @c gt of two @c F64_TYPE values. */
+  gt_f64,
+  /** @brief @c ge of two @c F64_TYPE values. */
+  ge_f64,
+  /** @brief @c add_const of an @c F64_TYPE value. */
+  add_const_f64,
+  /** @brief @c sub_const of an @c F64_TYPE value. */
+  sub_const_f64,
 };
 
+/**
+ * @brief The number of opcodes that can be encoded,
+ * any byte at or above this is not an opcode of a module.
+ */
+constexpr uint8_t opcode_count
+    = static_cast<uint8_t> (opcode::concat) + 1;
+
+/**
+ * @brief The number of opcodes, including the quickened ones.
+ */
+constexpr uint8_t quickened_opcode_count
+    = static_cast<uint8_t> (opcode::sub_const_f64) + 1;
+
 /**
  * @brief The different 'kinds' of instructions, organised by the arguments
  * they take.
@@ -33,7 +247,29 @@ enum class instruction_kind : uint8_t
   /**
    * @brief A lonely argument, that takes no arguments.
    */
-  lonely // TODO: add more
+  lonely,
+  /**
+   * @brief Takes a 32-bit index, of a constant, string or function.
+   */
+  index,
+  /**
+   * @brief Takes a 16-bit local variable index.
+   */
+  local,
+  /**
+   * @brief Takes a 32-bit offset to jump to,
+   * from the start of the code section.
+   */
+  jump,
+  /**
+   * @brief Takes a @c primitive_type.
+   */
+  type,
+  /**
+   * @brief Takes a 16-bit local variable or constant index,
+   * a comparison and conditional jump opcode, and a 32-bit offset to jump to.
+   */
+  branch,
 };
 
 /**
@@ -48,6 +284,46 @@ union instruction_args
   struct
   {
   } lonely;
+  /**
+   * @brief Index arguments.
+   */
+  struct
+  {
+    uint32_t value;
+  } index;
+  /**
+   * @brief Local arguments.
+   */
+  struct
+  {
+    uint16_t value;
+  } local;
+  /**
+   * @brief Jump arguments.
+   */
+  struct
+  {
+    uint32_t target;
+  } jump;
+  /**
+   * @brief Type arguments.
+   */
+  struct
+  {
+    primitive_type value;
+  } type;
+  /**
+   * @brief Fused branch arguments.
+   */
+  struct
+  {
+    uint16_t value;
+    /// one of @c opcode::eq to @c opcode::ge.
+    opcode compare;
+    /// @c opcode::jump_if or @c opcode::jump_unless.
+    opcode jump;
+    uint32_t target;
+  } branch;
 
   static instruction_args load (instruction_kind kind, const uint8_t *buff);
   static instruction_args load (opcode opcode, const uint8_t *buff);
@@ -55,6 +331,10 @@ union instruction_args
                     uint8_t *buff);
   static void save (const instruction_args &args, opcode opcode,
                     uint8_t *buff);
+  /**
+   * @brief The size of the arguments of the given kind, when saved.
+   */
+  static uint64_t size (instruction_kind kind);
 };
 
 /**
@@ -72,13 +352,7 @@ struct instruction
   instruction_args args;
 
   static instruction load (const uint8_t *buffer);
-  /**
-   * @brief Unimplemented
-   */
   static void save (const instruction &instr, uint8_t *buff);
-  /**
-   * @brief Unimplemented
-   */
   static ls_info<instruction> get_ls_info ();
 };
 
@@ -95,8 +369,29 @@ opcode load_opcode (const uint8_t *buffer);
 void save_opcode (const opcode &opcode, uint8_t *buffer);
 /**
  * @brief Gets the 'kind' (@c instruction_kind) of the given opcode.
+ * @throws std::runtime_error if it is not an opcode.
  */
 instruction_kind opcode_kind (opcode opcode);
+/**
+ * @brief Whether the byte is a valid opcode, which quickened opcodes are
+ * not.
+ */
+bool opcode_valid (uint8_t byte);
+/**
+ * @brief The quickened variant of a generic opcode for operands of the
+ * given type, or @c generic itself if there is none.
+ */
+opcode quickened_opcode (opcode generic, primitive_type type);
+/**
+ * @brief The generic opcode a quickened opcode is a variant of,
+ * or @c quick itself if it is not quickened.
+ */
+opcode generic_opcode (opcode quick);
+/**
+ * @brief The name of the opcode, as in its documentation,
+ * or @c "invalid" if it is not one. Quickened opcodes have names too.
+ */
+std::string_view opcode_name (opcode opcode);
 /**
  * @brief The load save info (@c ls_info) for opcode.
  */
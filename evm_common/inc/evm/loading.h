@@ -6,7 +6,10 @@
 #ifndef EVM_COMMON_LOADING_H_
 #define EVM_COMMON_LOADING_H_
 
+#include <bit>
 #include <cstdint>
+#include <span>
+#include <type_traits>
 
 namespace evm
 {
@@ -43,11 +46,56 @@ template <typename T> struct ls_info
 
 /**
  * @brief The @c ls_info for some primitive types,
- * This includes numeric types (such as int64_t) for now.
+ * This includes numeric types (such as int64_t),
+ * @c std::string and @c std::string_view.
+ *
+ * Strings are saved as a 64-bit length followed by the characters.
+ * Loading a @c std::string copies the characters in one go,
+ * while loading a @c std::string_view does not copy at all:
+ * the view points into the buffer that was loaded from,
+ * so it is only valid for as long as that buffer is.
+ *
+ * This is the type erased form of @c serializer<T> (see serializer.h),
+ * which should be preferred in tight loops as it can be inlined.
+ *
  * @return @c ls_info for the primitive.
  */
 template <typename T> ls_info<T> value_ls_info ();
 
+/**
+ * @brief Loads a whole array of primitives in one call.
+ *
+ * The values are expected back to back in @c buffer, as written by
+ * @c save_span or by repeated calls to @c value_ls_info<T> ().save.
+ * The bytes are copied in bulk, and then swapped in bulk if @c order differs
+ * from the host byte order.
+ *
+ * This function is instanciated for the numeric types supported by
+ * @c value_ls_info.
+ *
+ * @param values Array to load into, its size is the number of values loaded.
+ * @param buffer Buffer to load from.
+ * @param order Byte order the values were saved with.
+ */
+template <typename T>
+void load_span (std::span<T> values, const uint8_t *buffer,
+                std::endian order = std::endian::native);
+
+/**
+ * @brief Saves a whole array of primitives in one call.
+ *
+ * This is the bulk counterpart of @c value_ls_info<T> ().save,
+ * the values are written back to back into @c buffer,
+ * which must hold at least @c values.size_bytes () bytes.
+ *
+ * @param values Array to save.
+ * @param buffer Buffer to save into.
+ * @param order Byte order to save the values with.
+ */
+template <typename T>
+void save_span (std::span<const std::type_identity_t<T>> values,
+                uint8_t *buffer, std::endian order = std::endian::native);
+
 
 } // evm
 
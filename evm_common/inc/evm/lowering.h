@@ -0,0 +1,190 @@
+/** @file
+ *
+ * @brief This header contains the register code (@c evm::reg_program),
+ * and the lowering of verified stack code into it (@c evm::lower_program).
+ *
+ * The registers of a function are the slots of its frame: its local
+ * variables, then one for each depth of its operand stack, so operand
+ * stack slot @c d is register @c locals+d. The verifier gives every
+ * instruction one stack depth, so each value has a register of its own.
+ *
+ * Lowering follows the stack as it goes, without emitting the instructions
+ * that only move values: loading a local variable or constant only
+ * remembers where the value is, until an instruction uses it straight from
+ * there. Results are written to the local variable they are stored to,
+ * and comparisons are fused with the conditional jumps that use them.
+ * So a loop like `i = i + 1` is one instruction instead of four.
+ */
+
+#ifndef EVM_COMMON_LOWERING_H_
+#define EVM_COMMON_LOWERING_H_
+
+#include "instruction.h"
+#include "primitive.h"
+#include "program.h"
+#include "verifier.h"
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief An operation of the register code.
+ *
+ * Registers are @c dst, @c a and @c b, a @c _k suffix means @c b is the
+ * index of a constant instead.
+ */
+enum class reg_op : uint8_t
+{
+  /**
+   * @brief @c dst = @c a.
+   */
+  mov,
+  /**
+   * @brief @c dst = the constant @c a.
+   */
+  load_const,
+  add,
+  sub,
+  mul,
+  div,
+  rem,
+  add_k,
+  sub_k,
+  mul_k,
+  div_k,
+  rem_k,
+  /**
+   * @brief @c dst = -@c a.
+   */
+  neg,
+  /**
+   * @brief @c dst = @c a converted from @c type to @c result.
+   */
+  conv,
+  /**
+   * @brief @c dst = whether @c a and @c b hold for @c compare.
+   */
+  compare,
+  compare_k,
+  /**
+   * @brief Continues at the instruction @c dst.
+   */
+  jump,
+  /**
+   * @brief Continues at @c dst if @c a is true.
+   */
+  jump_if,
+  /**
+   * @brief Continues at @c dst if @c a is false.
+   */
+  jump_unless,
+  /**
+   * @brief Continues at @c dst if @c a and @c b hold for @c compare.
+   */
+  branch_if,
+  branch_if_k,
+  /**
+   * @brief Continues at @c dst unless @c a and @c b hold for @c compare.
+   */
+  branch_unless,
+  branch_unless_k,
+  /**
+   * @brief Calls the function @c b, whose frame starts at @c a with its
+   * arguments, and writes what it returns, if anything, to @c dst.
+   */
+  call,
+  /**
+   * @brief Calls the host function @c b with the arguments from @c a on,
+   * and writes what it returns, if anything, to @c dst.
+   */
+  host_call,
+  /**
+   * @brief Returns @c a, of type @c result.
+   */
+  ret,
+  /**
+   * @brief Returns nothing.
+   */
+  ret_void,
+  /**
+   * @brief Swaps @c a and @c b.
+   */
+  swap,
+  /**
+   * @brief @c dst = a new string copied from the string @c a.
+   */
+  load_string,
+  /**
+   * @brief @c dst = a new string joining @c a and @c b.
+   */
+  concat,
+};
+
+/**
+ * @brief The number of register operations.
+ */
+constexpr uint8_t reg_op_count = static_cast<uint8_t> (reg_op::concat) + 1;
+
+/**
+ * @brief An instruction of the register code, 16 bytes.
+ */
+struct reg_instr
+{
+  reg_op op;
+  /**
+   * @brief The type of the operands.
+   */
+  primitive_type type;
+  /**
+   * @brief The type written to @c dst.
+   */
+  primitive_type result;
+  /**
+   * @brief The comparison opcode, of comparisons and branches.
+   */
+  opcode compare;
+  uint32_t dst;
+  uint32_t a;
+  uint32_t b;
+
+  bool operator== (const reg_instr &) const = default;
+};
+
+static_assert (sizeof (reg_instr) == 16
+               && std::is_trivially_copyable_v<reg_instr>);
+
+/**
+ * @brief The register code of a program.
+ *
+ * Frames are laid out as for the stack code, and are as large as
+ * @c verification::frame_sizes.
+ */
+struct reg_program
+{
+  std::vector<reg_instr> code;
+  /**
+   * @brief Where each function starts in @c code.
+   */
+  std::vector<uint32_t> entries;
+};
+
+/**
+ * @brief Lowers a verified program into register code.
+ * @param verified The verification of @c prog, which must be of it.
+ */
+reg_program lower_program (const program &prog,
+                           const verification &verified);
+
+/**
+ * @brief The name of the operation, for debugging.
+ */
+std::string_view reg_op_name (reg_op op);
+
+} // evm
+
+#endif // EVM_COMMON_LOWERING_H_
@@ -0,0 +1,66 @@
+/** @file
+ *
+ * @brief This header contains the block codec used for compressed module
+ * sections (@c evm::lz_compress and @c evm::lz_decompress).
+ *
+ * A block is a series of sequences, each a run of literal bytes followed by
+ * a match, which copies bytes already decoded. A sequence starts with a
+ * token, whose high nibble is the number of literals and whose low nibble
+ * is the match length less @c lz_min_match. A nibble of 15 is extended by
+ * the bytes after it, each added to it until one is under 255.
+ * The literals follow, then the offset of the match as a 16 bit integer,
+ * then the extension of the match length. The last sequence of a block only
+ * has literals.
+ *
+ * Decoding is a few copies per sequence, with no entropy coding,
+ * so it runs at close to the speed of memory.
+ */
+
+#ifndef EVM_COMMON_LZ_H_
+#define EVM_COMMON_LZ_H_
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief The shortest match a block has.
+ */
+constexpr uint64_t lz_min_match = 4;
+/**
+ * @brief The furthest back a match can reach.
+ */
+constexpr uint64_t lz_max_offset = 65535;
+/**
+ * @brief The most a block can expand to, relative to its size.
+ */
+constexpr uint64_t lz_max_ratio = 255;
+
+/**
+ * @brief The largest a block compressed from @c size bytes can be.
+ */
+constexpr uint64_t
+lz_bound (uint64_t size)
+{
+  return size + size / 255 + 16;
+}
+
+/**
+ * @brief Compresses @c input into a new block.
+ */
+std::vector<uint8_t> lz_compress (std::span<const uint8_t> input);
+
+/**
+ * @brief Decompresses the block @c input into @c output,
+ * which must be exactly its decompressed size.
+ * @throws std::runtime_error if the block is malformed,
+ * or does not fill @c output exactly.
+ */
+void lz_decompress (std::span<const uint8_t> input, std::span<uint8_t> output);
+
+} // evm
+
+#endif // EVM_COMMON_LZ_H_
@@ -0,0 +1,315 @@
+/** @file
+ *
+ * @brief This header contains the module container format,
+ * along with a writer (@c evm::module_writer) and readers
+ * (@c evm::module_view and @c evm::mapped_module) for it.
+ *
+ * A module starts with a @c module_header, followed by a directory of
+ * @c section_entry, one per section. The sections follow the directory,
+ * each one starting at an offset aligned to @c module_section_alignment,
+ * so that they can be read in place once the module is in memory.
+ *
+ * A section can be compressed (@c section_flag_compressed), in which case
+ * it is decompressed the first time it is read, see lz.h.
+ * Other sections are still read in place.
+ */
+
+#ifndef EVM_COMMON_MODULE_H_
+#define EVM_COMMON_MODULE_H_
+
+#include "loading.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief The contents of a module section.
+ */
+enum class section_kind : uint32_t
+{
+  /**
+   * @brief Encoded instructions, see @c instruction::load.
+   */
+  code,
+  /**
+   * @brief Fat primitives saved back to back, see @c load_primitive,
+   * or @c byte_reader::read_compact_primitive in a compact module.
+   */
+  constants,
+  /**
+   * @brief Strings saved back to back,
+   * see @c value_ls_info<std::string_view>,
+   * or @c byte_reader::read_compact_string in a compact module.
+   */
+  strings,
+  /**
+   * @brief Functions saved back to back, see @c function_info.
+   */
+  functions,
+};
+
+/**
+ * @brief The magic number at the start of every module ("EVMM").
+ */
+constexpr uint32_t module_magic = 0x4d4d5645;
+/**
+ * @brief The version of the module format written by @c module_writer.
+ * Modules with another version are rejected.
+ */
+constexpr uint16_t module_version = 2;
+/**
+ * @brief Module flag: values are saved in the compact encoding,
+ * see compact.h.
+ */
+constexpr uint16_t module_flag_compact = 1 << 0;
+/**
+ * @brief Every module flag, modules with any other flag are rejected.
+ */
+constexpr uint16_t module_known_flags = module_flag_compact;
+/**
+ * @brief Section flag: the section is compressed with @c lz_compress.
+ */
+constexpr uint32_t section_flag_compressed = 1 << 0;
+/**
+ * @brief Every section flag, modules with any other flag are rejected.
+ */
+constexpr uint32_t section_known_flags = section_flag_compressed;
+/**
+ * @brief The alignment of every section, relative to the start of the module.
+ */
+constexpr uint64_t module_section_alignment = 16;
+
+/**
+ * @brief The header at the start of every module.
+ */
+struct module_header
+{
+  /**
+   * @brief Should always be @c module_magic.
+   */
+  uint32_t magic;
+  /**
+   * @brief The format version, see @c module_version.
+   */
+  uint16_t version;
+  /**
+   * @brief Flags for the whole module, such as @c module_flag_compact.
+   */
+  uint16_t flags;
+  /**
+   * @brief The number of entries in the section directory.
+   */
+  uint32_t section_count;
+
+  /**
+   * @brief The size of the header when saved.
+   */
+  static constexpr uint64_t saved_size = 16;
+
+  static module_header load (const uint8_t *buffer);
+  static void save (const module_header &header, uint8_t *buffer);
+  static ls_info<module_header> get_ls_info ();
+};
+
+/**
+ * @brief An entry of the section directory.
+ */
+struct section_entry
+{
+  /**
+   * @brief What the section contains.
+   */
+  section_kind kind;
+  /**
+   * @brief Flags for this section, such as @c section_flag_compressed.
+   */
+  uint32_t flags;
+  /**
+   * @brief Offset of the section from the start of the module.
+   */
+  uint64_t offset;
+  /**
+   * @brief Size of the section in bytes, as saved in the module.
+   */
+  uint64_t size;
+  /**
+   * @brief Size of the section in bytes once decompressed,
+   * the same as @c size if it is not compressed.
+   */
+  uint64_t raw_size;
+
+  /**
+   * @brief The size of an entry when saved.
+   */
+  static constexpr uint64_t saved_size = 32;
+
+  static section_entry load (const uint8_t *buffer);
+  static void save (const section_entry &entry, uint8_t *buffer);
+  static ls_info<section_entry> get_ls_info ();
+};
+
+/**
+ * @brief Checks the flags of a section, and that its sizes agree.
+ * @throws std::runtime_error if they do not.
+ */
+void check_section_size (const section_entry &entry);
+
+/**
+ * @brief Builds a module out of sections.
+ *
+ * The section data is copied when added,
+ * and laid out when the module is written.
+ */
+class module_writer
+{
+public:
+  /**
+   * @brief Adds a section to the module.
+   * @param kind What the section contains.
+   * @param data The contents of the section.
+   * @param compress Whether to compress the section. It is saved as it is
+   * if that would not make it smaller.
+   */
+  void add_section (section_kind kind, std::span<const uint8_t> data,
+                    bool compress = false);
+  /**
+   * @brief Sets the flags of the module, which must match how the sections
+   * are encoded.
+   */
+  void set_flags (uint16_t flags);
+
+  /**
+   * @brief The size of the module once written.
+   */
+  uint64_t size () const;
+
+  /**
+   * @brief Writes the module into @c buffer,
+   * which must hold at least @c size () bytes.
+   */
+  void write (uint8_t *buffer) const;
+  /**
+   * @brief Writes the module into a new buffer.
+   */
+  std::vector<uint8_t> write () const;
+  /**
+   * @brief Writes the module into the file at @c path,
+   * replacing it if it exists.
+   * @throws std::runtime_error if the file can not be written.
+   */
+  void write_file (const std::string &path) const;
+
+private:
+  struct pending_section
+  {
+    section_kind kind;
+    uint32_t flags;
+    uint64_t raw_size;
+    std::vector<uint8_t> data;
+  };
+
+  std::vector<pending_section> m_sections;
+  uint16_t m_flags = 0;
+};
+
+/**
+ * @brief A read only view of a module in memory.
+ *
+ * This does not copy or own the module, and the spans it gives out point
+ * into the viewed bytes, except for those of compressed sections.
+ * Those are decompressed the first time they are read, into buffers
+ * shared by every copy of the view. Reading sections is thread safe.
+ */
+class module_view
+{
+public:
+  module_view () = default;
+  /**
+   * @brief Checks the header and section directory of the module.
+   * @throws std::runtime_error if the module is malformed.
+   */
+  explicit module_view (std::span<const uint8_t> bytes);
+
+  const module_header &header () const;
+  /**
+   * @brief The section directory.
+   */
+  const std::vector<section_entry> &sections () const;
+  /**
+   * @brief The contents of the first section of the given kind,
+   * or @c std::nullopt if there is no such section.
+   * @throws std::runtime_error if the section can not be decompressed.
+   */
+  std::optional<std::span<const uint8_t>> section (section_kind kind) const;
+  /**
+   * @brief The contents of the section at @c index in the directory.
+   * @throws std::runtime_error if the section can not be decompressed.
+   */
+  std::span<const uint8_t> section_data (uint64_t index) const;
+  /**
+   * @brief Decompresses every compressed section ahead of time,
+   * on up to @c threads threads at once.
+   * @throws std::runtime_error if a section can not be decompressed.
+   */
+  void prefetch (uint32_t threads = 0) const;
+  /**
+   * @brief The whole module.
+   */
+  std::span<const uint8_t> bytes () const;
+
+private:
+  struct inflated_sections;
+
+  std::span<const uint8_t> m_bytes;
+  module_header m_header = {};
+  std::vector<section_entry> m_sections;
+  /// the decompressed sections, if there are any compressed ones.
+  std::shared_ptr<inflated_sections> m_inflated;
+};
+
+/**
+ * @brief A module mapped read only into memory from a file.
+ *
+ * The file is mapped shared,
+ * so processes mapping the same module share its pages,
+ * and nothing is read until it is accessed.
+ */
+class mapped_module
+{
+public:
+  /**
+   * @brief Maps the module at @c path.
+   * @throws std::runtime_error if the file can not be mapped or the module is
+   * malformed.
+   */
+  explicit mapped_module (const std::string &path);
+  ~mapped_module ();
+
+  mapped_module (mapped_module &&other) noexcept;
+  mapped_module &operator= (mapped_module &&other) noexcept;
+  mapped_module (const mapped_module &) = delete;
+  mapped_module &operator= (const mapped_module &) = delete;
+
+  /**
+   * @brief A view of the mapped module, valid while this is alive.
+   */
+  const module_view &view () const;
+
+private:
+  void unmap ();
+
+  void *m_address = nullptr;
+  uint64_t m_size = 0;
+  module_view m_view;
+};
+
+} // evm
+
+#endif // EVM_COMMON_MODULE_H_
@@ -0,0 +1,113 @@
+/** @file
+ *
+ * @brief This header contains the peephole optimizer
+ * (@c evm::optimize_program), which runs between loading and execution.
+ * It drops @c opcode::nop and fuses common sequences of instructions into
+ * superinstructions, picked by a @c evm::fusion_table.
+ */
+
+#ifndef EVM_COMMON_OPTIMIZER_H_
+#define EVM_COMMON_OPTIMIZER_H_
+
+#include "instruction.h"
+#include "program.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief How often each opcode ran straight after each other opcode,
+ * as collected by a profiler.
+ */
+struct opcode_pair_counts
+{
+  std::array<uint64_t, opcode_count * opcode_count> counts{};
+
+  uint64_t &
+  operator() (opcode first, opcode second)
+  {
+    return counts[static_cast<uint8_t> (first) * opcode_count
+                  + static_cast<uint8_t> (second)];
+  }
+
+  uint64_t
+  operator() (opcode first, opcode second) const
+  {
+    return counts[static_cast<uint8_t> (first) * opcode_count
+                  + static_cast<uint8_t> (second)];
+  }
+
+  /**
+   * @brief The number of pairs counted.
+   */
+  uint64_t total () const;
+};
+
+/**
+ * @brief A superinstruction: a sequence of opcodes,
+ * and the opcode they are fused into.
+ */
+struct fusion_rule
+{
+  std::vector<opcode> pattern;
+  opcode fused;
+};
+
+/**
+ * @brief The superinstructions the optimizer may use.
+ */
+class fusion_table
+{
+public:
+  /**
+   * @brief A table with every superinstruction.
+   */
+  static fusion_table all ();
+  /**
+   * @brief A table without superinstructions,
+   * the optimizer then only drops @c opcode::nop.
+   */
+  static fusion_table none ();
+  /**
+   * @brief A table with the superinstructions that pay off for a profile.
+   *
+   * A superinstruction is used if every pair of opcodes in its pattern makes
+   * up at least @c min_share of the pairs that ran.
+   */
+  static fusion_table from_profile (const opcode_pair_counts &pairs,
+                                    double min_share = 0.01);
+
+  /**
+   * @brief The superinstructions, longest pattern first.
+   */
+  const std::vector<fusion_rule> &rules () const;
+  /**
+   * @brief Whether the table fuses into the given opcode.
+   */
+  bool uses (opcode fused) const;
+
+private:
+  std::vector<fusion_rule> m_rules;
+};
+
+/**
+ * @brief Drops @c opcode::nop and fuses instructions, in place.
+ *
+ * Jump targets and function entries are remapped,
+ * and a sequence is never fused across a jump target or function entry,
+ * so the program behaves as before.
+ * Fused instructions keep the offset of their first instruction.
+ *
+ * Verification (@c verify_program) should be done after optimizing,
+ * as it depends on the instruction indices.
+ */
+void optimize_program (program &prog,
+                       const fusion_table &table = fusion_table::all ());
+
+} // evm
+
+#endif // EVM_COMMON_OPTIMIZER_H_
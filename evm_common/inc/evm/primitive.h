@@ -25,7 +25,8 @@ namespace evm
  * <prefix><size>_TYPE. A prefix of @c I means a signed integer, @c U an unsigned
  * integer, and @c F a floating point.
  *
- * Currently only numbers are implemented.
+ * @c REF_TYPE is not a number but a reference to an object on the heap of
+ * an interpreter, it is never saved in a module.
  */
 enum primitive_type : uint8_t
 {
@@ -39,6 +40,18 @@ enum primitive_type : uint8_t
   U64_TYPE, /**< 64-bit unsigned integer */
   F32_TYPE, /**< 32-bit floating point number */
   F64_TYPE, /**< 64-bit floating point number */
+  REF_TYPE, /**< reference to a heap object, or null */
+};
+
+/**
+ * @brief A reference to an object on the heap of an interpreter,
+ * see @c evm::heap. The address is zero for a null reference.
+ */
+struct heap_ref
+{
+  uint64_t address;
+
+  bool operator== (const heap_ref &) const = default;
 };
 
 /**
@@ -52,7 +65,7 @@ enum primitive_type : uint8_t
  */
 using primitive_value
     = std::variant<int8_t, int16_t, int32_t, int64_t, uint8_t, uint16_t,
-                   uint32_t, uint64_t, float, double>;
+                   uint32_t, uint64_t, float, double, heap_ref>;
 
 /**
  * @brief The associated type for the given @c primitive_type.
@@ -87,6 +100,11 @@ std::optional<primitive_value_t<TYPE>> get_primitive (primitive_value value);
 template <primitive_type TYPE>
 primitive_value make_primitive (primitive_value_t<TYPE> value);
 
+/**
+ * @brief Makes the zero value of the given type.
+ */
+primitive_value default_primitive (primitive_type type);
+
 /**
  * @brief Returns the type of value stored within the primitive_value.
  *
@@ -126,6 +144,7 @@ primitive_value load_primitive (const uint8_t *buffer);
  * @param buffer Buffer to save into.
  * @param fat Whether or not the primitive should be a fat primitive,
  * ie one that saves a type specifying byte along with the value.
+ * @throws std::runtime_error if the value is a @c heap_ref.
  */
 void save_primitive (const primitive_value &value, uint8_t *buffer,
                      bool fat = false);
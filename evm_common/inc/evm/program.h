@@ -0,0 +1,124 @@
+/** @file
+ *
+ * @brief This header contains functions (@c evm::function_info) and
+ * programs (@c evm::program), the decoded form of a module that is ready to
+ * run.
+ */
+
+#ifndef EVM_COMMON_PROGRAM_H_
+#define EVM_COMMON_PROGRAM_H_
+
+#include "decode.h"
+#include "loading.h"
+#include "module.h"
+#include "primitive.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief A function, with its entry point and signature.
+ *
+ * Arguments are the first local variables of a function,
+ * the other local variables start out as zero.
+ */
+struct function_info
+{
+  /**
+   * @brief Where the function starts.
+   * When saved this is an offset in the code section,
+   * and in a @c program it is an instruction index.
+   */
+  uint32_t entry;
+  /**
+   * @brief The number of arguments the function takes.
+   */
+  uint16_t arg_count;
+  /**
+   * @brief The types of the local variables, starting with the arguments.
+   */
+  std::vector<primitive_type> locals;
+  /**
+   * @brief The type the function returns, if any.
+   */
+  std::optional<primitive_type> result;
+
+  static function_info load (const uint8_t *buffer);
+  static void save (const function_info &info, uint8_t *buffer);
+  static ls_info<function_info> get_ls_info ();
+};
+
+/**
+ * @brief The strings of a program, back to back in one buffer,
+ * so that loading them allocates once rather than once per string.
+ */
+struct string_table
+{
+  /**
+   * @brief The characters of every string.
+   */
+  std::string chars;
+  /**
+   * @brief Where each string ends in @c chars, the next one starts there.
+   */
+  std::vector<uint64_t> ends;
+
+  uint64_t size () const;
+  /**
+   * @brief The string at @c index, which must be less than @c size.
+   */
+  std::string_view operator[] (uint64_t index) const;
+  void push_back (std::string_view value);
+
+  bool operator== (const string_table &) const = default;
+};
+
+/**
+ * @brief A decoded module, ready to be run.
+ */
+struct program
+{
+  /**
+   * @brief The code of every function.
+   */
+  decoded_code code;
+  /**
+   * @brief The constant pool, indexed by @c opcode::load_const.
+   */
+  std::vector<primitive_value> constants;
+  /**
+   * @brief The functions, indexed by @c opcode::call.
+   */
+  std::vector<function_info> functions;
+  /**
+   * @brief The strings section, indexed by @c opcode::load_string.
+   */
+  string_table strings;
+};
+
+/**
+ * @brief Decodes the code, constants, functions and strings of a module,
+ * in either encoding (see @c module_flag_compact).
+ * Only the code section is required.
+ * @throws std::runtime_error if a section is malformed,
+ * or a function does not start at an instruction.
+ */
+program load_program (const module_view &module);
+
+/**
+ * @brief Checks a function loaded from a module, and turns its entry from
+ * an offset in the code section into an instruction index.
+ * @throws std::runtime_error if it has more arguments than locals,
+ * or does not start at an instruction.
+ */
+void resolve_function (function_info &function, const decoded_code &code);
+
+} // evm
+
+#endif // EVM_COMMON_PROGRAM_H_
@@ -0,0 +1,223 @@
+/** @file
+ *
+ * @brief This header contains compile time loading and saving
+ * (@c evm::serializer), which the type erased @c evm::ls_info is built on.
+ *
+ * Unlike @c ls_info, a serializer is visible to the compiler,
+ * so loading and saving fixed width types compiles down to plain loads and
+ * stores.
+ */
+
+#ifndef EVM_COMMON_SERIALIZER_H_
+#define EVM_COMMON_SERIALIZER_H_
+
+#include "loading.h"
+
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace evm
+{
+
+/**
+ * @brief Loading and saving for @c T.
+ *
+ * Specialisations have the same static functions as the members of
+ * @c ls_info, and a @c constexpr @c size if every value of @c T has the
+ * same size.
+ */
+template <typename T> struct serializer;
+
+/**
+ * @brief A type with a @c serializer.
+ */
+template <typename T>
+concept serializable
+    = requires (const uint8_t *in, uint8_t *out, const T &value) {
+        {
+          serializer<T>::load (in)
+        } -> std::same_as<T>;
+        serializer<T>::save (value, out);
+        {
+          serializer<T>::load_size (in)
+        } -> std::convertible_to<uint64_t>;
+        {
+          serializer<T>::save_size (value)
+        } -> std::convertible_to<uint64_t>;
+      };
+
+/**
+ * @brief A type with a @c serializer, whose values always have the same
+ * size.
+ */
+template <typename T>
+concept fixed_serializable = serializable<T> && requires {
+  {
+    serializer<T>::size
+  } -> std::convertible_to<uint64_t>;
+};
+
+/**
+ * @brief Numbers are saved as their bytes.
+ */
+template <typename T>
+  requires std::is_arithmetic_v<T>
+struct serializer<T>
+{
+  static constexpr uint64_t size = sizeof (T);
+
+  static T
+  load (const uint8_t *buffer)
+  {
+    T value;
+    std::memcpy (&value, buffer, size);
+    return value;
+  }
+
+  static void
+  save (const T &value, uint8_t *buffer)
+  {
+    std::memcpy (buffer, &value, size);
+  }
+
+  static constexpr uint64_t
+  load_size (const uint8_t *)
+  {
+    return size;
+  }
+
+  static constexpr uint64_t
+  save_size (const T &)
+  {
+    return size;
+  }
+};
+
+/**
+ * @brief Enums are saved as their underlying type.
+ */
+template <typename T>
+  requires std::is_enum_v<T>
+struct serializer<T>
+{
+  using underlying = serializer<std::underlying_type_t<T>>;
+
+  static constexpr uint64_t size = underlying::size;
+
+  static T
+  load (const uint8_t *buffer)
+  {
+    return static_cast<T> (underlying::load (buffer));
+  }
+
+  static void
+  save (const T &value, uint8_t *buffer)
+  {
+    underlying::save (static_cast<std::underlying_type_t<T>> (value), buffer);
+  }
+
+  static constexpr uint64_t
+  load_size (const uint8_t *)
+  {
+    return size;
+  }
+
+  static constexpr uint64_t
+  save_size (const T &)
+  {
+    return size;
+  }
+};
+
+/**
+ * @brief Strings are saved as a 64-bit length followed by the characters.
+ *
+ * Loaded views point into the buffer they were loaded from,
+ * see @c value_ls_info.
+ */
+template <> struct serializer<std::string_view>
+{
+  static std::string_view
+  load (const uint8_t *buffer)
+  {
+    auto size = serializer<uint64_t>::load (buffer);
+    buffer += serializer<uint64_t>::size;
+
+    return std::string_view (reinterpret_cast<const char *> (buffer), size);
+  }
+
+  static void
+  save (const std::string_view &value, uint8_t *buffer)
+  {
+    serializer<uint64_t>::save (value.size (), buffer);
+    buffer += serializer<uint64_t>::size;
+
+    std::memcpy (buffer, value.data (), value.size ());
+  }
+
+  static uint64_t
+  load_size (const uint8_t *buffer)
+  {
+    return serializer<uint64_t>::load (buffer) + serializer<uint64_t>::size;
+  }
+
+  static uint64_t
+  save_size (const std::string_view &value)
+  {
+    return value.size () + serializer<uint64_t>::size;
+  }
+};
+
+/**
+ * @brief Strings are saved like @c std::string_view,
+ * and loaded with one copy.
+ */
+template <> struct serializer<std::string>
+{
+  static std::string
+  load (const uint8_t *buffer)
+  {
+    return std::string (serializer<std::string_view>::load (buffer));
+  }
+
+  static void
+  save (const std::string &value, uint8_t *buffer)
+  {
+    serializer<std::string_view>::save (value, buffer);
+  }
+
+  static uint64_t
+  load_size (const uint8_t *buffer)
+  {
+    return serializer<std::string_view>::load_size (buffer);
+  }
+
+  static uint64_t
+  save_size (const std::string &value)
+  {
+    return serializer<std::string_view>::save_size (value);
+  }
+};
+
+/**
+ * @brief Makes the type erased @c ls_info out of a @c serializer.
+ */
+template <serializable T>
+constexpr ls_info<T>
+make_ls_info ()
+{
+  return ls_info<T>{
+    .load_size = serializer<T>::load_size,
+    .save_size = serializer<T>::save_size,
+    .load = serializer<T>::load,
+    .save = serializer<T>::save,
+  };
+}
+
+} // evm
+
+#endif // EVM_COMMON_SERIALIZER_H_
@@ -0,0 +1,220 @@
+/** @file
+ *
+ * @brief This header contains the streaming module decoder
+ * (@c evm::module_stream), which decodes a module chunk by chunk as its
+ * bytes arrive, and pumps that feed it from @c std::istream and file
+ * descriptors.
+ */
+
+#ifndef EVM_COMMON_STREAM_H_
+#define EVM_COMMON_STREAM_H_
+
+#include "instruction.h"
+#include "module.h"
+#include "primitive.h"
+#include "program.h"
+
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief The size of the chunks the pumps read, by default.
+ */
+constexpr uint64_t stream_chunk_size = 64 * 1024;
+
+/**
+ * @brief Receives what a @c module_stream decodes, as soon as it is decoded.
+ *
+ * Each callback does nothing by default.
+ * Values are passed in the order they are in their section,
+ * and sections in the order they are in the module.
+ */
+class stream_sink
+{
+public:
+  virtual ~stream_sink () = default;
+
+  /**
+   * @brief Called once the header and section directory are read.
+   */
+  virtual void
+  on_header (const module_header &, std::span<const section_entry>)
+  {
+  }
+  /**
+   * @brief Called when a section of a known kind starts.
+   * @return Whether to decode the section, it is skipped otherwise.
+   */
+  virtual bool
+  on_section (const section_entry &)
+  {
+    return true;
+  }
+  /**
+   * @brief Called for each instruction, with its offset in the code section.
+   */
+  virtual void
+  on_instruction (uint32_t, const instruction &)
+  {
+  }
+  virtual void
+  on_constant (const primitive_value &)
+  {
+  }
+  /**
+   * @brief Called for each string, which is only valid during the call.
+   */
+  virtual void
+  on_string (std::string_view)
+  {
+  }
+  /**
+   * @brief Called for each function, whose entry is still an offset in the
+   * code section.
+   */
+  virtual void
+  on_function (const function_info &)
+  {
+  }
+  /**
+   * @brief Called when a decoded section ends.
+   */
+  virtual void
+  on_section_end (const section_entry &)
+  {
+  }
+};
+
+/**
+ * @brief Decodes a module as it arrives, in chunks of any size.
+ *
+ * Only the value split between two chunks is buffered, never the module,
+ * so decoding can start long before the module is all there.
+ * Compressed sections are the exception: they are buffered whole,
+ * then decompressed and decoded at once.
+ * Sections are decoded in the order of their offsets,
+ * and the padding between them is skipped.
+ * Both encodings are supported, see @c module_flag_compact.
+ */
+class module_stream
+{
+public:
+  /**
+   * @param sink Receives what is decoded, it must outlive the stream.
+   */
+  explicit module_stream (stream_sink &sink);
+
+  /**
+   * @brief Decodes as much as possible with the next bytes of the module.
+   * @throws std::runtime_error if the module is malformed,
+   * after which the stream should not be used.
+   */
+  void feed (std::span<const uint8_t> bytes);
+  /**
+   * @brief Ends the module, there are no more bytes.
+   * @throws std::runtime_error if the module is truncated.
+   */
+  void finish ();
+
+  /**
+   * @brief Whether every section has been read.
+   */
+  bool done () const;
+  /**
+   * @brief The number of bytes fed so far.
+   */
+  uint64_t offset () const;
+
+private:
+  enum class state
+  {
+    header,
+    directory,
+    gap,
+    section,
+    end,
+  };
+
+  const uint8_t *peek (std::span<const uint8_t> &bytes, uint64_t count);
+  void consume (std::span<const uint8_t> &bytes, uint64_t count);
+  void next_section ();
+  bool decode_item (std::span<const uint8_t> &bytes);
+  bool decode_compact_item (std::span<const uint8_t> &bytes);
+
+  stream_sink &m_sink;
+  state m_state = state::header;
+  module_header m_header = {};
+  /// the sections, by offset.
+  std::vector<section_entry> m_sections;
+  uint64_t m_next = 0;
+  /// whether the current section is decoded or skipped.
+  bool m_decoding = false;
+  uint64_t m_offset = 0;
+  /// the offset in the current section, once decompressed.
+  uint64_t m_position = 0;
+  /// whether the current section is decoded from a decompressed buffer.
+  bool m_inflating = false;
+  /// the start of a value split between chunks.
+  std::vector<uint8_t> m_pending;
+};
+
+/**
+ * @brief Builds a @c program out of a @c module_stream,
+ * as @c load_program does from a whole module.
+ */
+class program_builder : public stream_sink
+{
+public:
+  bool on_section (const section_entry &entry) override;
+  void on_instruction (uint32_t offset, const instruction &instr) override;
+  void on_constant (const primitive_value &value) override;
+  void on_string (std::string_view value) override;
+  void on_function (const function_info &info) override;
+
+  /**
+   * @brief Resolves the jumps and function entries,
+   * once the stream has finished.
+   * @throws std::runtime_error if there is no code section,
+   * or the code or functions are invalid, see @c load_program.
+   */
+  program take ();
+
+private:
+  program m_program;
+  /// the kinds of section done, only the first of each kind is read.
+  std::vector<section_kind> m_seen;
+};
+
+/**
+ * @brief Feeds all of @c in to @c stream, then finishes it.
+ * @throws std::runtime_error if reading fails or the module is malformed.
+ */
+void pump_stream (std::istream &in, module_stream &stream,
+                  uint64_t chunk_size = stream_chunk_size);
+/**
+ * @brief Feeds a file descriptor to @c stream until end of file,
+ * then finishes it. The descriptor is left open.
+ * @throws std::runtime_error if reading fails or the module is malformed.
+ */
+void pump_stream (int fd, module_stream &stream,
+                  uint64_t chunk_size = stream_chunk_size);
+
+/**
+ * @brief Loads a program from a stream of a module, see @c program_builder.
+ */
+program stream_program (std::istream &in);
+/**
+ * @brief Loads a program from a file descriptor, such as a pipe or socket,
+ * see @c program_builder.
+ */
+program stream_program (int fd);
+
+} // evm
+
+#endif // EVM_COMMON_STREAM_H_
@@ -0,0 +1,289 @@
+/** @file
+ *
+ * @brief This header contains the compact value representation used by the
+ * operand stack: the raw 8-byte value (@c evm::value_slot), with its
+ * @c evm::primitive_type kept on the side (@c evm::tagged_stack).
+ */
+
+#ifndef EVM_COMMON_TAGGED_H_
+#define EVM_COMMON_TAGGED_H_
+
+#include "primitive.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief The raw bits of a primitive value, without its type.
+ *
+ * Signed integers are sign extended, unsigned integers zero extended,
+ * and floating point numbers are stored as their bits
+ * (in the low 32 bits for @c F32_TYPE).
+ */
+using value_slot = uint64_t;
+
+/**
+ * @brief Stores a value into a slot.
+ */
+template <primitive_type TYPE>
+constexpr value_slot
+to_slot (primitive_value_t<TYPE> value)
+{
+  using T = primitive_value_t<TYPE>;
+
+  if constexpr (std::is_same_v<T, float>)
+    return std::bit_cast<uint32_t> (value);
+  else if constexpr (std::is_same_v<T, double>)
+    return std::bit_cast<uint64_t> (value);
+  else
+    return static_cast<value_slot> (static_cast<int64_t> (value));
+}
+
+/**
+ * @brief Loads a value from a slot.
+ */
+template <primitive_type TYPE>
+constexpr primitive_value_t<TYPE>
+from_slot (value_slot slot)
+{
+  using T = primitive_value_t<TYPE>;
+
+  if constexpr (std::is_same_v<T, float>)
+    return std::bit_cast<float> (static_cast<uint32_t> (slot));
+  else if constexpr (std::is_same_v<T, double>)
+    return std::bit_cast<double> (slot);
+  else
+    return static_cast<T> (slot);
+}
+
+/**
+ * @brief Calls @c fn with the given type as a
+ * @c std::integral_constant<primitive_type, TYPE>,
+ * so that it can be used as a template argument.
+ * @throws std::runtime_error if @c type is not a number type,
+ * including @c REF_TYPE.
+ */
+template <typename F>
+constexpr decltype (auto)
+visit_type (primitive_type type, F &&fn)
+{
+#define CASE_OF(T)                                                            \
+  case T:                                                                     \
+    return fn (std::integral_constant<primitive_type, T> ())
+
+  switch (type)
+    {
+      CASE_OF (I8_TYPE);
+      CASE_OF (I16_TYPE);
+      CASE_OF (I32_TYPE);
+      CASE_OF (I64_TYPE);
+      CASE_OF (U8_TYPE);
+      CASE_OF (U16_TYPE);
+      CASE_OF (U32_TYPE);
+      CASE_OF (U64_TYPE);
+      CASE_OF (F32_TYPE);
+      CASE_OF (F64_TYPE);
+    case REF_TYPE:
+      break;
+    }
+
+#undef CASE_OF
+
+  throw std::runtime_error ("Invalid Type Specifier.");
+}
+
+/**
+ * @brief Stores a value into a slot, the type is returned by
+ * @c primitive_get_type.
+ */
+value_slot to_slot (const primitive_value &value);
+/**
+ * @brief Loads a value of the given type from a slot.
+ */
+primitive_value from_slot (value_slot slot, primitive_type type);
+
+/// @cond IGNORE
+constexpr uint16_t signed_types_mask = (1 << I8_TYPE) | (1 << I16_TYPE)
+                                       | (1 << I32_TYPE) | (1 << I64_TYPE);
+constexpr uint16_t unsigned_types_mask = (1 << U8_TYPE) | (1 << U16_TYPE)
+                                         | (1 << U32_TYPE) | (1 << U64_TYPE);
+constexpr uint16_t float_types_mask = (1 << F32_TYPE) | (1 << F64_TYPE);
+/// @endcond
+
+/**
+ * @brief Whether the type is a number, that is any type but @c REF_TYPE.
+ */
+constexpr bool
+is_number_type (primitive_type type)
+{
+  return type <= F64_TYPE;
+}
+
+/**
+ * @brief Whether the type is a signed or unsigned integer.
+ * This, and the other type checks, do not branch.
+ */
+constexpr bool
+is_integer_type (primitive_type type)
+{
+  return ((signed_types_mask | unsigned_types_mask) >> type) & 1;
+}
+
+/**
+ * @brief Whether the type is a signed integer.
+ */
+constexpr bool
+is_signed_type (primitive_type type)
+{
+  return (signed_types_mask >> type) & 1;
+}
+
+/**
+ * @brief Whether the type is a floating point number.
+ */
+constexpr bool
+is_float_type (primitive_type type)
+{
+  return (float_types_mask >> type) & 1;
+}
+
+/**
+ * @brief A stack of values, as an array of slots and an array of types.
+ *
+ * Each value takes 8 bytes plus a 1 byte type,
+ * against the 16 bytes of a @c primitive_value.
+ */
+class tagged_stack
+{
+public:
+  void
+  push (value_slot slot, primitive_type type)
+  {
+    if (m_size == capacity ())
+      grow (m_size + 1);
+
+    push_unchecked (slot, type);
+  }
+
+  void
+  push (const primitive_value &value)
+  {
+    push (to_slot (value), primitive_get_type (value));
+  }
+
+  /**
+   * @brief Pushes a value without checking for room,
+   * which must have been made with @c reserve.
+   */
+  void
+  push_unchecked (value_slot slot, primitive_type type)
+  {
+    m_slots[m_size] = slot;
+    m_types[m_size] = type;
+    m_size++;
+  }
+
+  /**
+   * @brief Removes the top @c count values.
+   */
+  void
+  pop (uint64_t count = 1)
+  {
+    m_size -= count;
+  }
+
+  /**
+   * @brief The value at @c index, from the bottom of the stack.
+   */
+  primitive_value
+  get (uint64_t index) const
+  {
+    return from_slot (m_slots[index], m_types[index]);
+  }
+
+  value_slot &
+  slot (uint64_t index)
+  {
+    return m_slots[index];
+  }
+
+  primitive_type &
+  type (uint64_t index)
+  {
+    return m_types[index];
+  }
+
+  uint64_t
+  size () const
+  {
+    return m_size;
+  }
+
+  /**
+   * @brief The number of values the stack holds before it grows.
+   */
+  uint64_t
+  capacity () const
+  {
+    return m_slots.size ();
+  }
+
+  /**
+   * @brief Resizes the stack, new values are zero.
+   */
+  void
+  resize (uint64_t size)
+  {
+    if (size > capacity ())
+      grow (size);
+
+    for (auto i = m_size; i < size; i++)
+      {
+        m_slots[i] = 0;
+        m_types[i] = primitive_type{};
+      }
+
+    m_size = size;
+  }
+
+  /**
+   * @brief Makes room for at least @c size values.
+   */
+  void
+  reserve (uint64_t size)
+  {
+    if (size > capacity ())
+      grow (size);
+  }
+
+  void
+  clear ()
+  {
+    m_size = 0;
+  }
+
+private:
+  /// grows geometrically, so that reserving a little more each call is cheap.
+  void
+  grow (uint64_t size)
+  {
+    auto capacity = std::max (size, 2 * this->capacity ());
+    m_slots.resize (capacity);
+    m_types.resize (capacity);
+  }
+
+  std::vector<value_slot> m_slots;
+  std::vector<primitive_type> m_types;
+  uint64_t m_size = 0;
+};
+
+} // evm
+
+#endif // EVM_COMMON_TAGGED_H_
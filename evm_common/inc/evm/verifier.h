@@ -0,0 +1,114 @@
+/** @file
+ *
+ * @brief This header contains the bytecode verifier (@c evm::verify_program),
+ * which checks a program before it runs and records the shape of its operand
+ * stack (@c evm::verification).
+ */
+
+#ifndef EVM_COMMON_VERIFIER_H_
+#define EVM_COMMON_VERIFIER_H_
+
+#include "primitive.h"
+#include "program.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief The signature of a host function, called by @c opcode::host_call.
+ */
+struct host_signature
+{
+  /**
+   * @brief The types of the arguments, popped with the last on top.
+   */
+  std::vector<primitive_type> args;
+  /**
+   * @brief The type the host function returns, if any.
+   */
+  std::optional<primitive_type> result;
+};
+
+/**
+ * @brief What the verifier knows about a program.
+ *
+ * The operand stack is the part of a frame above its local variables.
+ * Every path to an instruction reaches it with the same operand stack,
+ * so each instruction has one depth and one list of types.
+ */
+struct verification
+{
+  /// the depth of unreachable instructions.
+  static constexpr uint32_t unreachable = UINT32_MAX;
+
+  /**
+   * @brief The operand stack depth before each instruction runs,
+   * or @c unreachable.
+   */
+  std::vector<uint32_t> depths;
+  /**
+   * @brief Where the stack types of each instruction start in @c types.
+   */
+  std::vector<uint32_t> type_offsets;
+  /**
+   * @brief The stack types of every instruction, bottom first.
+   */
+  std::vector<primitive_type> types;
+  /**
+   * @brief The function each instruction belongs to,
+   * or @c unreachable.
+   */
+  std::vector<uint32_t> owners;
+  /**
+   * @brief The deepest the operand stack of each function gets.
+   */
+  std::vector<uint32_t> max_depths;
+  /**
+   * @brief The number of slots a frame of each function needs,
+   * its local variables plus its deepest operand stack.
+   */
+  std::vector<uint32_t> frame_sizes;
+  /**
+   * @brief The host functions the program was verified against.
+   */
+  std::vector<host_signature> hosts;
+
+  /**
+   * @brief Whether the instruction can be run.
+   */
+  bool reachable (uint64_t ip) const;
+  /**
+   * @brief The types on the operand stack before the instruction runs,
+   * bottom first.
+   */
+  std::span<const primitive_type> stack_types (uint64_t ip) const;
+};
+
+/**
+ * @brief Verifies every function of a program.
+ *
+ * Verified code cannot underflow the operand stack,
+ * use a value of the wrong type, or use a constant, local variable,
+ * function or host function that does not exist.
+ * It also cannot run off the end of a function,
+ * or into the code of another function.
+ *
+ * This function runs in *O(n d)* time,
+ * where *d* is the deepest operand stack.
+ *
+ * @param prog The program to verify.
+ * @param hosts The host functions, indexed by @c opcode::host_call.
+ * @throws std::runtime_error naming the first bad instruction,
+ * if the program is malformed.
+ */
+verification verify_program (const program &prog,
+                             std::span<const host_signature> hosts = {});
+
+} // evm
+
+#endif // EVM_COMMON_VERIFIER_H_
@@ -0,0 +1,108 @@
+#include <evm/arith.h>
+
+namespace evm
+{
+
+static void
+check_type (primitive_type type)
+{
+  if (type >= primitive_type_count)
+    throw std::runtime_error ("Invalid Type Specifier.");
+}
+
+arith_kernel
+find_arith (arith_op op, primitive_type lhs, primitive_type rhs)
+{
+  check_type (lhs);
+  check_type (rhs);
+  auto index = kernel_index (lhs, rhs);
+
+  switch (op)
+    {
+    case arith_op::add:
+      return arith_table<arith_op::add>[index];
+    case arith_op::sub:
+      return arith_table<arith_op::sub>[index];
+    case arith_op::mul:
+      return arith_table<arith_op::mul>[index];
+    case arith_op::div:
+      return arith_table<arith_op::div>[index];
+    case arith_op::rem:
+      return arith_table<arith_op::rem>[index];
+    }
+
+  throw std::runtime_error ("Invalid arithmetic operation.");
+}
+
+compare_kernel
+find_compare (compare_op op, primitive_type lhs, primitive_type rhs)
+{
+  check_type (lhs);
+  check_type (rhs);
+  auto index = kernel_index (lhs, rhs);
+
+  switch (op)
+    {
+    case compare_op::eq:
+      return compare_table<compare_op::eq>[index];
+    case compare_op::ne:
+      return compare_table<compare_op::ne>[index];
+    case compare_op::lt:
+      return compare_table<compare_op::lt>[index];
+    case compare_op::le:
+      return compare_table<compare_op::le>[index];
+    case compare_op::gt:
+      return compare_table<compare_op::gt>[index];
+    case compare_op::ge:
+      return compare_table<compare_op::ge>[index];
+    }
+
+  throw std::runtime_error ("Invalid comparison.");
+}
+
+convert_kernel
+find_convert (primitive_type from, primitive_type to)
+{
+  check_type (from);
+  check_type (to);
+
+  return convert_table[kernel_index (from, to)];
+}
+
+primitive_value
+arith (arith_op op, const primitive_value &lhs, const primitive_value &rhs)
+{
+  auto lhs_type = primitive_get_type (lhs);
+  auto rhs_type = primitive_get_type (rhs);
+  auto kernel = find_arith (op, lhs_type, rhs_type);
+
+  return from_slot (kernel (to_slot (lhs), to_slot (rhs)),
+                    promote (lhs_type, rhs_type));
+}
+
+bool
+compare (compare_op op, const primitive_value &lhs, const primitive_value &rhs)
+{
+  auto kernel
+      = find_compare (op, primitive_get_type (lhs), primitive_get_type (rhs));
+
+  return kernel (to_slot (lhs), to_slot (rhs));
+}
+
+primitive_value
+neg (const primitive_value &value)
+{
+  auto type = primitive_get_type (value);
+  check_type (type);
+
+  return from_slot (neg_table[type](to_slot (value)), type);
+}
+
+primitive_value
+convert (const primitive_value &value, primitive_type to)
+{
+  auto kernel = find_convert (primitive_get_type (value), to);
+  return from_slot (kernel (to_slot (value)), to);
+}
+
+} // evm
@@ -0,0 +1,622 @@
+#include <evm/cache.h>
+#include <evm/cursor.h>
+#include <evm/loading.h>
+#include <evm/module.h>
+#include <evm/optimizer.h>
+#include <evm/serializer.h>
+#include <evm/tagged.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace evm
+{
+
+/// the magic number at the start of every entry ("EVMC").
+static constexpr uint32_t entry_magic = 0x434d5645;
+/// saved in the byte order of the host, to tell it apart from others.
+static constexpr uint16_t entry_order = 0x0102;
+static constexpr uint64_t header_size = 104;
+/// no result, in the results of the functions.
+static constexpr uint8_t no_result = 0xff;
+
+static const char entry_extension[] = ".evmc";
+static const char temporary_extension[] = ".tmp";
+
+static constexpr uint64_t hash_prime_a = 0x9e3779b185ebca87;
+static constexpr uint64_t hash_prime_b = 0xc2b2ae3d27d4eb4f;
+
+/**
+ * Mixes the bits of @c value, so each one affects every other.
+ */
+static uint64_t
+avalanche (uint64_t value)
+{
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccd;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53;
+  value ^= value >> 33;
+
+  return value;
+}
+
+/**
+ * Hashes 8 bytes at a time into two lanes, which are mixed together
+ * at the end.
+ */
+static cache_key
+hash_bytes (std::span<const uint8_t> bytes, uint64_t seed)
+{
+  uint64_t a = seed ^ hash_prime_a;
+  uint64_t b = ~seed ^ hash_prime_b;
+
+  auto mix = [&] (uint64_t word) {
+    a = std::rotl ((a ^ word) * hash_prime_a, 31);
+    b = std::rotl ((b ^ std::rotl (word, 32)) * hash_prime_b, 29) + a;
+  };
+
+  uint64_t i = 0;
+  for (; i + sizeof (uint64_t) <= bytes.size (); i += sizeof (uint64_t))
+    {
+      uint64_t word;
+      std::memcpy (&word, bytes.data () + i, sizeof (word));
+      mix (word);
+    }
+
+  uint64_t tail = 0;
+  std::memcpy (&tail, bytes.data () + i, bytes.size () - i);
+  mix (tail);
+
+  a ^= bytes.size ();
+  b ^= bytes.size ();
+  a = avalanche (a + b);
+  b = avalanche (b ^ a);
+
+  return cache_key{ .high = a, .low = b };
+}
+
+cache_key
+cache_key::of (std::span<const uint8_t> module,
+               std::span<const host_signature> hosts, bool optimize)
+{
+  // everything but the module, which is hashed in place.
+  byte_writer context;
+  context.write (cache_version);
+  context.write (module_version);
+  context.write (static_cast<uint8_t> (optimize));
+  context.write (static_cast<uint64_t> (hosts.size ()));
+
+  for (const auto &host : hosts)
+    {
+      context.write (static_cast<uint64_t> (host.args.size ()));
+      for (auto type : host.args)
+        context.write (static_cast<uint8_t> (type));
+      context.write (static_cast<uint8_t> (host.result.value_or (
+          static_cast<primitive_type> (no_result))));
+    }
+
+  auto module_hash = hash_bytes (module, 0);
+  auto context_hash = hash_bytes (context.bytes (), module_hash.low);
+
+  return cache_key{ .high = module_hash.high ^ context_hash.high,
+                    .low = context_hash.low };
+}
+
+std::string
+cache_key::to_string () const
+{
+  char digits[33];
+  std::snprintf (digits, sizeof (digits), "%016llx%016llx",
+                 static_cast<unsigned long long> (high),
+                 static_cast<unsigned long long> (low));
+
+  return digits;
+}
+
+/**
+ * The number of values in each array of an entry.
+ */
+struct entry_counts
+{
+  uint64_t instructions;
+  uint64_t constants;
+  uint64_t functions;
+  uint64_t locals;
+  uint64_t types;
+  uint64_t strings;
+  uint64_t chars;
+  uint64_t reg_instructions;
+};
+
+/**
+ * Where each array of an entry starts, with the size of the entry.
+ */
+struct entry_layout
+{
+  uint64_t opcodes, operands, offsets;
+  uint64_t constant_types, constant_slots;
+  uint64_t entries, arg_counts, results, local_offsets, locals;
+  uint64_t depths, type_offsets, owners, types, max_depths, frame_sizes;
+  uint64_t string_ends, string_chars;
+  uint64_t reg_code, reg_entries;
+  uint64_t size;
+
+  explicit entry_layout (const entry_counts &counts)
+  {
+    uint64_t at = header_size;
+    auto place = [&] (uint64_t count, uint64_t width) {
+      at = (at + 7) & ~uint64_t (7);
+      auto start = at;
+      at += count * width;
+      return start;
+    };
+
+    opcodes = place (counts.instructions, sizeof (opcode));
+    operands = place (counts.instructions, sizeof (uint64_t));
+    offsets = place (counts.instructions, sizeof (uint32_t));
+    constant_types = place (counts.constants, sizeof (primitive_type));
+    constant_slots = place (counts.constants, sizeof (value_slot));
+    entries = place (counts.functions, sizeof (uint32_t));
+    arg_counts = place (counts.functions, sizeof (uint16_t));
+    results = place (counts.functions, sizeof (uint8_t));
+    local_offsets = place (counts.functions + 1, sizeof (uint32_t));
+    locals = place (counts.locals, sizeof (primitive_type));
+    depths = place (counts.instructions, sizeof (uint32_t));
+    type_offsets = place (counts.instructions, sizeof (uint32_t));
+    owners = place (counts.instructions, sizeof (uint32_t));
+    types = place (counts.types, sizeof (primitive_type));
+    max_depths = place (counts.functions, sizeof (uint32_t));
+    frame_sizes = place (counts.functions, sizeof (uint32_t));
+    string_ends = place (counts.strings, sizeof (uint64_t));
+    string_chars = place (counts.chars, sizeof (char));
+    reg_code = place (counts.reg_instructions, sizeof (reg_instr));
+    reg_entries = place (counts.functions, sizeof (uint32_t));
+    size = at;
+  }
+};
+
+template <typename T>
+static void
+save_array (const std::vector<T> &values, uint8_t *buffer)
+{
+  // bytes, and register instructions, whose fields are in host order too.
+  if constexpr (sizeof (T) == 1 || std::is_same_v<T, reg_instr>)
+    std::memcpy (buffer, values.data (), values.size () * sizeof (T));
+  else
+    save_span<T> (values, buffer);
+}
+
+template <typename T>
+static void
+load_array (std::vector<T> &values, uint64_t count, const uint8_t *buffer)
+{
+  values.resize (count);
+
+  if constexpr (sizeof (T) == 1 || std::is_same_v<T, reg_instr>)
+    std::memcpy (values.data (), buffer, count * sizeof (T));
+  else
+    load_span<T> (values, buffer);
+}
+
+/**
+ * Saves an entry into a new buffer.
+ */
+static std::vector<uint8_t>
+save_entry (const cache_key &key, const verified_program &entry)
+{
+  const auto &prog = entry.prog;
+  const auto &verified = entry.verified;
+
+  entry_counts counts{ .instructions = prog.code.size (),
+                       .constants = prog.constants.size (),
+                       .functions = prog.functions.size (),
+                       .locals = 0,
+                       .types = verified.types.size (),
+                       .strings = prog.strings.size (),
+                       .chars = prog.strings.chars.size (),
+                       .reg_instructions = entry.lowered.code.size () };
+
+  std::vector<uint8_t> results;
+  std::vector<uint32_t> local_offsets = { 0 };
+  std::vector<primitive_type> locals;
+  std::vector<uint32_t> entries;
+  std::vector<uint16_t> arg_counts;
+
+  for (const auto &function : prog.functions)
+    {
+      entries.push_back (function.entry);
+      arg_counts.push_back (function.arg_count);
+      results.push_back (function.result.value_or (
+          static_cast<primitive_type> (no_result)));
+      locals.insert (locals.end (), function.locals.begin (),
+                     function.locals.end ());
+      local_offsets.push_back (static_cast<uint32_t> (locals.size ()));
+    }
+  counts.locals = locals.size ();
+
+  // the constants are saved as columns, ready to be put in slots.
+  std::vector<primitive_type> constant_types;
+  std::vector<value_slot> constant_slots;
+  for (const auto &constant : prog.constants)
+    {
+      constant_types.push_back (primitive_get_type (constant));
+      constant_slots.push_back (to_slot (constant));
+    }
+
+  entry_layout layout (counts);
+  std::vector<uint8_t> buffer (layout.size);
+  auto *data = buffer.data ();
+
+  save_array (prog.code.opcodes, data + layout.opcodes);
+  save_array (prog.code.operands, data + layout.operands);
+  save_array (prog.code.offsets, data + layout.offsets);
+  save_array (constant_types, data + layout.constant_types);
+  save_array (constant_slots, data + layout.constant_slots);
+  save_array (entries, data + layout.entries);
+  save_array (arg_counts, data + layout.arg_counts);
+  save_array (results, data + layout.results);
+  save_array (local_offsets, data + layout.local_offsets);
+  save_array (locals, data + layout.locals);
+  save_array (verified.depths, data + layout.depths);
+  save_array (verified.type_offsets, data + layout.type_offsets);
+  save_array (verified.owners, data + layout.owners);
+  save_array (verified.types, data + layout.types);
+  save_array (verified.max_depths, data + layout.max_depths);
+  save_array (verified.frame_sizes, data + layout.frame_sizes);
+  save_array (prog.strings.ends, data + layout.string_ends);
+  std::memcpy (data + layout.string_chars, prog.strings.chars.data (),
+               counts.chars);
+  save_array (entry.lowered.code, data + layout.reg_code);
+  save_array (entry.lowered.entries, data + layout.reg_entries);
+
+  auto payload = std::span<const uint8_t> (buffer).subspan (header_size);
+
+  byte_writer header;
+  header.write (entry_magic);
+  header.write (cache_version);
+  header.write (module_version);
+  header.write (entry_order);
+  header.write<uint32_t> (0);
+  header.write (key.high);
+  header.write (key.low);
+  header.write (hash_bytes (payload, 0).low);
+  header.write (counts.instructions);
+  header.write (counts.constants);
+  header.write (counts.functions);
+  header.write (counts.locals);
+  header.write (counts.types);
+  header.write (counts.strings);
+  header.write (counts.chars);
+  header.write (counts.reg_instructions);
+  std::memcpy (data, header.bytes ().data (), header_size);
+
+  return buffer;
+}
+
+/**
+ * Loads an entry, if it is of this version and byte order, for @c key,
+ * and undamaged.
+ */
+static std::optional<verified_program>
+load_entry (std::span<const uint8_t> bytes, const cache_key &key)
+{
+  if (bytes.size () < header_size)
+    return std::nullopt;
+
+  byte_reader header (bytes.first (header_size));
+  if (header.read<uint32_t> () != entry_magic
+      || header.read<uint32_t> () != cache_version
+      || header.read<uint16_t> () != module_version
+      || header.read<uint16_t> () != entry_order)
+    return std::nullopt;
+
+  header.skip (sizeof (uint32_t));
+  if (header.read<uint64_t> () != key.high
+      || header.read<uint64_t> () != key.low)
+    return std::nullopt;
+
+  auto payload_hash = header.read<uint64_t> ();
+  entry_counts counts;
+  counts.instructions = header.read<uint64_t> ();
+  counts.constants = header.read<uint64_t> ();
+  counts.functions = header.read<uint64_t> ();
+  counts.locals = header.read<uint64_t> ();
+  counts.types = header.read<uint64_t> ();
+  counts.strings = header.read<uint64_t> ();
+  counts.chars = header.read<uint64_t> ();
+  counts.reg_instructions = header.read<uint64_t> ();
+
+  // every value takes a byte at least, so this bounds the layout.
+  for (auto count : { counts.instructions, counts.constants, counts.functions,
+                      counts.locals, counts.types, counts.strings,
+                      counts.chars, counts.reg_instructions })
+    if (count > bytes.size ())
+      return std::nullopt;
+
+  entry_layout layout (counts);
+  if (layout.size != bytes.size ()
+      || hash_bytes (bytes.subspan (header_size), 0).low != payload_hash)
+    return std::nullopt;
+
+  const auto *data = bytes.data ();
+  verified_program entry;
+  auto &prog = entry.prog;
+  auto &verified = entry.verified;
+
+  load_array (prog.code.opcodes, counts.instructions, data + layout.opcodes);
+  load_array (prog.code.operands, counts.instructions, data + layout.operands);
+  load_array (prog.code.offsets, counts.instructions, data + layout.offsets);
+
+  std::vector<primitive_type> constant_types;
+  std::vector<value_slot> constant_slots;
+  load_array (constant_types, counts.constants, data + layout.constant_types);
+  load_array (constant_slots, counts.constants, data + layout.constant_slots);
+
+  prog.constants.reserve (counts.constants);
+  for (uint64_t i = 0; i < counts.constants; i++)
+    prog.constants.push_back (from_slot (constant_slots[i],
+                                         constant_types[i]));
+
+  std::vector<uint32_t> entries;
+  std::vector<uint16_t> arg_counts;
+  std::vector<uint8_t> results;
+  std::vector<uint32_t> local_offsets;
+  std::vector<primitive_type> locals;
+  load_array (entries, counts.functions, data + layout.entries);
+  load_array (arg_counts, counts.functions, data + layout.arg_counts);
+  load_array (results, counts.functions, data + layout.results);
+  load_array (local_offsets, counts.functions + 1,
+              data + layout.local_offsets);
+  load_array (locals, counts.locals, data + layout.locals);
+
+  prog.functions.reserve (counts.functions);
+  for (uint64_t i = 0; i < counts.functions; i++)
+    {
+      auto begin = local_offsets[i];
+      auto end = local_offsets[i + 1];
+      if (begin > end || end > counts.locals)
+        return std::nullopt;
+
+      function_info function;
+      function.entry = entries[i];
+      function.arg_count = arg_counts[i];
+      function.locals.assign (locals.begin () + begin, locals.begin () + end);
+      if (results[i] != no_result)
+        function.result = static_cast<primitive_type> (results[i]);
+
+      prog.functions.push_back (std::move (function));
+    }
+
+  load_array (verified.depths, counts.instructions, data + layout.depths);
+  load_array (verified.type_offsets, counts.instructions,
+              data + layout.type_offsets);
+  load_array (verified.owners, counts.instructions, data + layout.owners);
+  load_array (verified.types, counts.types, data + layout.types);
+  load_array (verified.max_depths, counts.functions, data + layout.max_depths);
+  load_array (verified.frame_sizes, counts.functions,
+              data + layout.frame_sizes);
+
+  auto &strings = prog.strings;
+  load_array (strings.ends, counts.strings, data + layout.string_ends);
+  if (!std::is_sorted (strings.ends.begin (), strings.ends.end ())
+      || (counts.strings > 0 ? strings.ends.back () : 0) != counts.chars)
+    return std::nullopt;
+
+  strings.chars.assign (
+      reinterpret_cast<const char *> (data + layout.string_chars),
+      counts.chars);
+
+  auto &lowered = entry.lowered;
+  load_array (lowered.code, counts.reg_instructions, data + layout.reg_code);
+  load_array (lowered.entries, counts.functions, data + layout.reg_entries);
+  if (!std::all_of (lowered.entries.begin (), lowered.entries.end (),
+                    [&] (uint32_t at) { return at < counts.reg_instructions; }))
+    return std::nullopt;
+
+  return entry;
+}
+
+/**
+ * Maps the entry at @c path and loads it, see @c load_entry.
+ */
+static std::optional<verified_program>
+read_entry (const std::string &path, const cache_key &key)
+{
+  int fd = ::open (path.c_str (), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return std::nullopt;
+
+  struct stat info;
+  if (::fstat (fd, &info) != 0 || info.st_size == 0)
+    {
+      ::close (fd);
+      return std::nullopt;
+    }
+
+  auto size = static_cast<uint64_t> (info.st_size);
+  auto *address = ::mmap (nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close (fd);
+
+  if (address == MAP_FAILED)
+    return std::nullopt;
+
+  std::optional<verified_program> entry;
+  try
+    {
+      entry = load_entry (std::span<const uint8_t> (
+                              static_cast<const uint8_t *> (address), size),
+                          key);
+    }
+  catch (...)
+    {
+      ::munmap (address, size);
+      throw;
+    }
+
+  ::munmap (address, size);
+  return entry;
+}
+
+/**
+ * The key an entry is named after, if @c name is the name of an entry.
+ */
+static std::optional<cache_key>
+parse_entry_name (const std::string &name)
+{
+  auto extension = sizeof (entry_extension) - 1;
+  if (name.size () != 32 + extension
+      || name.compare (32, extension, entry_extension) != 0)
+    return std::nullopt;
+
+  try
+    {
+      std::size_t used;
+      auto high = std::stoull (name.substr (0, 16), &used, 16);
+      if (used != 16)
+        return std::nullopt;
+      auto low = std::stoull (name.substr (16, 16), &used, 16);
+      if (used != 16)
+        return std::nullopt;
+
+      return cache_key{ .high = high, .low = low };
+    }
+  catch (const std::logic_error &)
+    {
+      return std::nullopt;
+    }
+}
+
+program_cache::program_cache (std::string directory)
+    : m_directory (std::move (directory))
+{
+  std::error_code error;
+  std::filesystem::create_directories (m_directory, error);
+
+  if (error || !std::filesystem::is_directory (m_directory))
+    throw std::runtime_error ("Could not create cache directory "
+                              + m_directory + ".");
+}
+
+verified_program
+program_cache::load (std::span<const uint8_t> module,
+                     std::span<const host_signature> hosts,
+                     bool optimize) const
+{
+  auto key = cache_key::of (module, hosts, optimize);
+  if (auto entry = find (key, hosts))
+    return std::move (*entry);
+
+  verified_program entry;
+  entry.prog = load_program (module_view (module));
+  if (optimize)
+    optimize_program (entry.prog);
+  entry.verified = verify_program (entry.prog, hosts);
+  entry.lowered = lower_program (entry.prog, entry.verified);
+
+  try
+    {
+      store (key, entry);
+    }
+  catch (const std::runtime_error &)
+    {
+      // it is loaded again next time.
+    }
+
+  return entry;
+}
+
+std::optional<verified_program>
+program_cache::find (const cache_key &key,
+                     std::span<const host_signature> hosts) const
+{
+  auto entry = read_entry (path_of (key), key);
+
+  if (entry)
+    entry->verified.hosts.assign (hosts.begin (), hosts.end ());
+
+  return entry;
+}
+
+void
+program_cache::store (const cache_key &key, const verified_program &entry) const
+{
+  static std::atomic<uint64_t> counter = 0;
+
+  auto buffer = save_entry (key, entry);
+  auto path = path_of (key);
+  // unique to this writer, so writers never share a temporary file.
+  auto temporary = path + "." + std::to_string (::getpid ()) + "."
+                   + std::to_string (counter++) + temporary_extension;
+
+  {
+    std::ofstream file (temporary, std::ios::binary | std::ios::trunc);
+    file.write (reinterpret_cast<const char *> (buffer.data ()),
+                static_cast<std::streamsize> (buffer.size ()));
+    file.close ();
+
+    if (!file)
+      {
+        std::remove (temporary.c_str ());
+        throw std::runtime_error ("Could not write cache entry " + path
+                                  + ".");
+      }
+  }
+
+  if (std::rename (temporary.c_str (), path.c_str ()) != 0)
+    {
+      std::remove (temporary.c_str ());
+      throw std::runtime_error ("Could not write cache entry " + path + ".");
+    }
+}
+
+uint64_t
+program_cache::prune () const
+{
+  uint64_t removed = 0;
+  std::error_code error;
+
+  for (const auto &file :
+       std::filesystem::directory_iterator (m_directory, error))
+    {
+      auto name = file.path ().filename ().string ();
+      auto key = parse_entry_name (name);
+      bool temporary = name.ends_with (temporary_extension);
+
+      if (!temporary && (!key || read_entry (file.path ().string (), *key)))
+        continue;
+
+      if (std::filesystem::remove (file.path (), error))
+        removed++;
+    }
+
+  return removed;
+}
+
+std::string
+program_cache::path_of (const cache_key &key) const
+{
+  return (std::filesystem::path (m_directory)
+          / (key.to_string () + entry_extension))
+      .string ();
+}
+
+const std::string &
+program_cache::directory () const
+{
+  return m_directory;
+}
+
+} // evm
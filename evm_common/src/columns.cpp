@@ -0,0 +1,100 @@
+#include <evm/columns.h>
+#include <evm/serializer.h>
+#include <evm/tagged.h>
+
+#include <numeric>
+#include <stdexcept>
+
+namespace evm
+{
+
+uint64_t
+primitive_columns::size () const
+{
+  return types.size ();
+}
+
+primitive_value
+primitive_columns::get (uint64_t index) const
+{
+  return visit_type (types[index], [this, index] (auto type) {
+    return make_primitive<type ()> (column<type ()> ()[indices[index]]);
+  });
+}
+
+/**
+ * Decodes the run of values of type @c TYPE starting at @c offset,
+ * and returns the offset after it.
+ */
+template <primitive_type TYPE>
+static uint64_t
+decode_run (primitive_columns &columns, std::span<const uint8_t> buffer,
+            uint64_t offset)
+{
+  using T = primitive_value_t<TYPE>;
+  constexpr uint64_t stride = 1 + serializer<T>::size;
+
+  // find the end of the run, by only looking at the type bytes.
+  uint64_t count = 1;
+  while (offset + count * stride < buffer.size ()
+         && buffer[offset + count * stride] == TYPE)
+    count++;
+
+  if (offset + count * stride > buffer.size ())
+    throw std::runtime_error ("Truncated primitive.");
+
+  auto &column = columns.column<TYPE> ();
+  auto first = column.size ();
+  const auto *values = buffer.data () + offset + 1;
+
+  // mixed types are common too, where resizing for each value is slow.
+  if (count == 1)
+    {
+      column.push_back (serializer<T>::load (values));
+      columns.types.push_back (TYPE);
+      columns.indices.push_back (static_cast<uint32_t> (first));
+
+      return offset + stride;
+    }
+
+  column.resize (first + count);
+
+  for (uint64_t i = 0; i < count; i++)
+    column[first + i] = serializer<T>::load (values + i * stride);
+
+  columns.types.insert (columns.types.end (), count, TYPE);
+
+  auto indices = columns.indices.size ();
+  columns.indices.resize (indices + count);
+  std::iota (columns.indices.begin () + indices, columns.indices.end (),
+             static_cast<uint32_t> (first));
+
+  return offset + count * stride;
+}
+
+primitive_columns
+decode_columns (std::span<const uint8_t> buffer)
+{
+  primitive_columns columns;
+
+  // the smallest fat primitive is two bytes.
+  columns.types.reserve (buffer.size () / 2);
+  columns.indices.reserve (buffer.size () / 2);
+
+  uint64_t offset = 0;
+
+  while (offset < buffer.size ())
+    {
+      if (buffer[offset] > F64_TYPE)
+        throw std::runtime_error ("Invalid Type Specifier.");
+
+      auto type = static_cast<primitive_type> (buffer[offset]);
+      offset = visit_type (type, [&] (auto type) {
+        return decode_run<type ()> (columns, buffer, offset);
+      });
+    }
+
+  return columns;
+}
+
+} // evm
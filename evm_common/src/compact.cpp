@@ -0,0 +1,251 @@
+#include <evm/compact.h>
+#include <evm/cursor.h>
+#include <evm/decode.h>
+#include <evm/program.h>
+
+#include <optional>
+#include <stdexcept>
+
+namespace evm
+{
+
+/// the size of a function before its local types.
+static constexpr uint64_t function_fixed_size = 10;
+
+/**
+ * The size of an instruction in the compact encoding.
+ * @c target is its jump target once moved, if it has one.
+ */
+static uint64_t
+compact_size (const instruction &instr, uint32_t target)
+{
+  const auto &args = instr.args;
+
+  switch (opcode_kind (instr.code))
+    {
+    case instruction_kind::lonely:
+      return sizeof (opcode);
+    case instruction_kind::index:
+      return sizeof (opcode) + uleb128_size (args.index.value);
+    case instruction_kind::local:
+      return sizeof (opcode) + uleb128_size (args.local.value);
+    case instruction_kind::jump:
+      return sizeof (opcode) + uleb128_size (target);
+    case instruction_kind::type:
+      return sizeof (opcode) + sizeof (primitive_type);
+    case instruction_kind::branch:
+      return sizeof (opcode) + uleb128_size (args.branch.value)
+             + 2 * sizeof (opcode) + uleb128_size (target);
+    }
+  return sizeof (opcode);
+}
+
+/**
+ * A code section laid out again in the compact encoding.
+ */
+struct compact_code
+{
+  std::vector<uint8_t> bytes;
+  /// the old offset of every instruction, and its new one.
+  decoded_code old_layout;
+  std::vector<uint32_t> offsets;
+};
+
+static compact_code
+compact_code_section (std::span<const uint8_t> section)
+{
+  compact_code result;
+  // validates the section, and maps offsets to instructions.
+  result.old_layout = decode_code (section);
+
+  std::vector<instruction> code;
+  std::vector<uint32_t> targets;
+  byte_reader reader (section);
+
+  code.reserve (result.old_layout.size ());
+  targets.reserve (result.old_layout.size ());
+
+  while (!reader.at_end ())
+    {
+      auto instr = reader.read_instruction ();
+      uint32_t target = 0;
+
+      if (opcode_kind (instr.code) == instruction_kind::jump)
+        target = *result.old_layout.index_of (instr.args.jump.target);
+      else if (opcode_kind (instr.code) == instruction_kind::branch)
+        target = *result.old_layout.index_of (instr.args.branch.target);
+
+      code.push_back (instr);
+      targets.push_back (target);
+    }
+
+  // a target takes more bytes the further it is, and moving it can move
+  // others, so the layout is repeated until it settles. Sizes only grow,
+  // so this ends.
+  auto &offsets = result.offsets;
+  offsets.assign (code.size () + 1, 0);
+
+  for (bool changed = true; changed;)
+    {
+      changed = false;
+      uint64_t offset = 0;
+
+      for (uint64_t i = 0; i < code.size (); i++)
+        {
+          auto size = compact_size (code[i], offsets[targets[i]]);
+
+          if (offsets[i] != offset)
+            changed = true;
+          offsets[i] = static_cast<uint32_t> (offset);
+          offset += size;
+        }
+
+      if (offset > UINT32_MAX)
+        throw std::runtime_error ("Code section is too large.");
+      offsets[code.size ()] = static_cast<uint32_t> (offset);
+    }
+
+  byte_writer writer;
+
+  for (uint64_t i = 0; i < code.size (); i++)
+    {
+      auto instr = code[i];
+
+      if (opcode_kind (instr.code) == instruction_kind::jump)
+        instr.args.jump.target = offsets[targets[i]];
+      else if (opcode_kind (instr.code) == instruction_kind::branch)
+        instr.args.branch.target = offsets[targets[i]];
+
+      writer.write_compact_instruction (instr);
+    }
+
+  offsets.pop_back ();
+  result.bytes = writer.take ();
+  return result;
+}
+
+static std::vector<uint8_t>
+compact_constants (std::span<const uint8_t> section)
+{
+  byte_reader reader (section);
+  byte_writer writer;
+
+  try
+    {
+      while (!reader.at_end ())
+        writer.write_compact_primitive (reader.read_primitive ());
+    }
+  catch (const std::out_of_range &)
+    {
+      throw std::runtime_error ("Truncated constant.");
+    }
+
+  return writer.take ();
+}
+
+static std::vector<uint8_t>
+compact_strings (std::span<const uint8_t> section)
+{
+  byte_reader reader (section);
+  byte_writer writer;
+
+  try
+    {
+      while (!reader.at_end ())
+        writer.write_compact_string (reader.read<std::string_view> ());
+    }
+  catch (const std::out_of_range &)
+    {
+      throw std::runtime_error ("Truncated string.");
+    }
+
+  return writer.take ();
+}
+
+static std::vector<uint8_t>
+compact_functions (std::span<const uint8_t> section, const compact_code *code)
+{
+  auto info = function_info::get_ls_info ();
+  std::vector<uint8_t> bytes (section.begin (), section.end ());
+  uint64_t offset = 0;
+
+  // functions keep their layout, only their entries move.
+  while (offset < bytes.size ())
+    {
+      auto *data = bytes.data () + offset;
+
+      if (bytes.size () - offset < function_fixed_size
+          || info.load_size (data) > bytes.size () - offset)
+        throw std::runtime_error ("Truncated function.");
+
+      if (code)
+        {
+          auto entry = serializer<uint32_t>::load (data);
+          auto index = code->old_layout.index_of (entry);
+          if (!index)
+            throw std::runtime_error ("Function entry is not an instruction.");
+
+          serializer<uint32_t>::save (code->offsets[*index], data);
+        }
+
+      offset += info.load_size (data);
+    }
+
+  return bytes;
+}
+
+std::vector<uint8_t>
+compact_module (const module_view &module)
+{
+  auto bytes = module.bytes ();
+  if (module.header ().flags & module_flag_compact)
+    return std::vector<uint8_t> (bytes.begin (), bytes.end ());
+
+  // function entries are offsets into the first code section,
+  // as with load_program.
+  std::optional<compact_code> code;
+  if (auto section = module.section (section_kind::code))
+    code = compact_code_section (*section);
+
+  module_writer writer;
+  writer.set_flags (module.header ().flags | module_flag_compact);
+  bool first_code = true;
+
+  for (uint64_t i = 0; i < module.sections ().size (); i++)
+    {
+      const auto &entry = module.sections ()[i];
+      auto section = module.section_data (i);
+      // sections stay compressed if they were.
+      bool compress = entry.flags & section_flag_compressed;
+
+      switch (entry.kind)
+        {
+        case section_kind::code:
+          writer.add_section (entry.kind,
+                              first_code ? code->bytes
+                                         : compact_code_section (section).bytes,
+                              compress);
+          first_code = false;
+          break;
+        case section_kind::constants:
+          writer.add_section (entry.kind, compact_constants (section),
+                              compress);
+          break;
+        case section_kind::strings:
+          writer.add_section (entry.kind, compact_strings (section), compress);
+          break;
+        case section_kind::functions:
+          writer.add_section (
+              entry.kind,
+              compact_functions (section, code ? &*code : nullptr), compress);
+          break;
+        default:
+          writer.add_section (entry.kind, section, compress);
+          break;
+        }
+    }
+
+  return writer.write ();
+}
+
+} // evm
@@ -0,0 +1,195 @@
+#include <evm/convert.h>
+
+#include <array>
+#include <limits>
+#include <type_traits>
+
+// The kernels of each instruction set are the same loop, compiled for it
+// with a target attribute and vectorized by the compiler.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EVM_CONVERT_X86
+#endif
+
+namespace evm
+{
+
+/// converts the values one at a time.
+template <primitive_type FROM, primitive_type TO>
+static void
+convert_scalar (const void *in, void *out, uint64_t count)
+{
+  const auto *from = static_cast<const primitive_value_t<FROM> *> (in);
+  auto *to = static_cast<primitive_value_t<TO> *> (out);
+
+  for (uint64_t i = 0; i < count; i++)
+    to[i] = convert_value<FROM, TO> (from[i]);
+}
+
+#ifdef EVM_CONVERT_X86
+/// convert_value without branches, which the loops below vectorize.
+template <primitive_type FROM, primitive_type TO>
+[[gnu::always_inline]] inline primitive_value_t<TO>
+convert_lane (primitive_value_t<FROM> value)
+{
+  using F = primitive_value_t<FROM>;
+  using T = primitive_value_t<TO>;
+
+  if constexpr (std::is_floating_point_v<F> && std::is_integral_v<T>)
+    {
+      constexpr auto min = static_cast<F> (std::numeric_limits<T>::min ());
+      constexpr auto max = static_cast<F> (std::numeric_limits<T>::max ());
+
+      // only values in range are converted, NaN is not.
+      auto in_range = value > min && value < max;
+      auto result = static_cast<T> (in_range ? value : F (0));
+      result = value <= min ? std::numeric_limits<T>::min () : result;
+      return value >= max ? std::numeric_limits<T>::max () : result;
+    }
+  else
+    return static_cast<T> (value);
+}
+
+/// converts the values a block at a time, then the rest one at a time.
+/// Blocks have a fixed size, so that they vectorize without a scalar
+/// remainder. It is inlined into a kernel for an instruction set,
+/// which the blocks are compiled for.
+template <primitive_type FROM, primitive_type TO>
+[[gnu::always_inline]] inline void
+convert_blocks (const void *in, void *out, uint64_t count)
+{
+  constexpr uint64_t block = 64;
+
+  const auto *__restrict from
+      = static_cast<const primitive_value_t<FROM> *> (in);
+  auto *__restrict to = static_cast<primitive_value_t<TO> *> (out);
+  uint64_t i = 0;
+
+  for (; i + block <= count; i += block)
+    for (uint64_t j = 0; j < block; j++)
+      to[i + j] = convert_lane<FROM, TO> (from[i + j]);
+
+  for (; i < count; i++)
+    to[i] = convert_lane<FROM, TO> (from[i]);
+}
+
+template <primitive_type FROM, primitive_type TO>
+[[gnu::target ("sse4.2")]] static void
+convert_sse4_2 (const void *in, void *out, uint64_t count)
+{
+  convert_blocks<FROM, TO> (in, out, count);
+}
+
+template <primitive_type FROM, primitive_type TO>
+[[gnu::target ("avx2")]] static void
+convert_avx2 (const void *in, void *out, uint64_t count)
+{
+  convert_blocks<FROM, TO> (in, out, count);
+}
+#endif
+
+/// @cond IGNORE
+template <primitive_type FROM, primitive_type TO> struct scalar_entry
+{
+  static constexpr array_convert_kernel kernel = convert_scalar<FROM, TO>;
+};
+
+#ifdef EVM_CONVERT_X86
+template <primitive_type FROM, primitive_type TO> struct sse4_2_entry
+{
+  static constexpr array_convert_kernel kernel = convert_sse4_2<FROM, TO>;
+};
+
+template <primitive_type FROM, primitive_type TO> struct avx2_entry
+{
+  static constexpr array_convert_kernel kernel = convert_avx2<FROM, TO>;
+};
+#else
+template <primitive_type FROM, primitive_type TO>
+using sse4_2_entry = scalar_entry<FROM, TO>;
+template <primitive_type FROM, primitive_type TO>
+using avx2_entry = scalar_entry<FROM, TO>;
+#endif
+/// @endcond
+
+/// the kernels of each instruction set, indexed as convert_table.
+static constexpr std::array<
+    std::array<array_convert_kernel,
+               primitive_type_count * primitive_type_count>,
+    simd_level_count>
+    kernel_tables = {
+      make_pair_table<array_convert_kernel, scalar_entry> (),
+      make_pair_table<array_convert_kernel, sse4_2_entry> (),
+      make_pair_table<array_convert_kernel, avx2_entry> (),
+    };
+
+static void
+check_type (primitive_type type)
+{
+  if (type >= primitive_type_count)
+    throw std::runtime_error ("Invalid Type Specifier.");
+}
+
+simd_level
+simd_support ()
+{
+#ifdef EVM_CONVERT_X86
+  // the compiler's runtime reads CPUID, and whether the OS saves the
+  // AVX registers.
+  static const auto level = [] {
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx2"))
+      return simd_level::avx2;
+    if (__builtin_cpu_supports ("sse4.2"))
+      return simd_level::sse4_2;
+    return simd_level::scalar;
+  }();
+
+  return level;
+#else
+  return simd_level::scalar;
+#endif
+}
+
+std::string_view
+simd_level_name (simd_level level)
+{
+  switch (level)
+    {
+    case simd_level::scalar:
+      return "scalar";
+    case simd_level::sse4_2:
+      return "sse4.2";
+    case simd_level::avx2:
+      return "avx2";
+    }
+
+  return "invalid";
+}
+
+array_convert_kernel
+find_array_convert (primitive_type from, primitive_type to, simd_level level)
+{
+  check_type (from);
+  check_type (to);
+
+  if (level > simd_support ())
+    throw std::runtime_error ("Instruction set is not supported.");
+
+  return kernel_tables[uint8_t (level)][kernel_index (from, to)];
+}
+
+array_convert_kernel
+find_array_convert (primitive_type from, primitive_type to)
+{
+  return find_array_convert (from, to, simd_support ());
+}
+
+void
+convert_array (primitive_type from, primitive_type to, const void *in,
+               void *out, uint64_t count)
+{
+  find_array_convert (from, to) (in, out, count);
+}
+
+} // evm
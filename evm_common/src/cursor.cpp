@@ -0,0 +1,236 @@
+#include <evm/cursor.h>
+#include <evm/tagged.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace evm
+{
+
+primitive_value
+byte_reader::read_primitive ()
+{
+  return read_primitive (read<primitive_type> ());
+}
+
+primitive_value
+byte_reader::read_primitive (primitive_type type)
+{
+  return visit_type (type, [this] (auto type) {
+    return make_primitive<type ()> (read<primitive_value_t<type ()>> ());
+  });
+}
+
+instruction
+byte_reader::read_instruction ()
+{
+  require (sizeof (opcode));
+  if (!opcode_valid (*m_position))
+    throw std::runtime_error ("Invalid opcode.");
+
+  auto code = read<opcode> ();
+  auto kind = opcode_kind (code);
+
+  require (instruction_args::size (kind));
+  auto args = instruction_args::load (kind, m_position);
+  m_position += instruction_args::size (kind);
+
+  return instruction{ .code = code, .args = args };
+}
+
+/**
+ * Narrows an operand read in the compact encoding.
+ */
+template <typename T>
+static T
+narrow_operand (uint64_t value)
+{
+  if (value > std::numeric_limits<T>::max ())
+    throw std::runtime_error ("Operand out of range.");
+
+  return static_cast<T> (value);
+}
+
+primitive_value
+byte_reader::read_compact_primitive ()
+{
+  return visit_type (read<primitive_type> (), [this] (auto type) {
+    using T = primitive_value_t<type ()>;
+
+    if constexpr (std::is_floating_point_v<T>)
+      return make_primitive<type ()> (read<T> ());
+    else
+      {
+        T value;
+        bool fits;
+
+        if constexpr (std::is_signed_v<T>)
+          {
+            auto wide = read_sleb128 ();
+            value = static_cast<T> (wide);
+            fits = value == wide;
+          }
+        else
+          {
+            auto wide = read_uleb128 ();
+            value = static_cast<T> (wide);
+            fits = value == wide;
+          }
+
+        if (!fits)
+          throw std::runtime_error ("Constant out of range.");
+
+        return make_primitive<type ()> (value);
+      }
+  });
+}
+
+instruction
+byte_reader::read_compact_instruction ()
+{
+  require (sizeof (opcode));
+  if (!opcode_valid (*m_position))
+    throw std::runtime_error ("Invalid opcode.");
+
+  auto code = read<opcode> ();
+  instruction_args args;
+
+  switch (opcode_kind (code))
+    {
+    case instruction_kind::lonely:
+      args.lonely = {};
+      break;
+    case instruction_kind::index:
+      args.index.value = narrow_operand<uint32_t> (read_uleb128 ());
+      break;
+    case instruction_kind::local:
+      args.local.value = narrow_operand<uint16_t> (read_uleb128 ());
+      break;
+    case instruction_kind::jump:
+      args.jump.target = narrow_operand<uint32_t> (read_uleb128 ());
+      break;
+    case instruction_kind::type:
+      args.type.value = read<primitive_type> ();
+      break;
+    case instruction_kind::branch:
+      args.branch.value = narrow_operand<uint16_t> (read_uleb128 ());
+      args.branch.compare = read<opcode> ();
+      args.branch.jump = read<opcode> ();
+      args.branch.target = narrow_operand<uint32_t> (read_uleb128 ());
+      break;
+    }
+
+  return instruction{ .code = code, .args = args };
+}
+
+std::string_view
+byte_reader::read_compact_string ()
+{
+  auto size = read_uleb128 ();
+  auto bytes = read_bytes (size);
+
+  return std::string_view (reinterpret_cast<const char *> (bytes.data ()),
+                           bytes.size ());
+}
+
+void
+byte_writer::write_compact_primitive (const primitive_value &value)
+{
+  auto type = primitive_get_type (value);
+  write (type);
+
+  visit_type (type, [&] (auto type) {
+    using T = primitive_value_t<type ()>;
+    auto raw = std::get<type ()> (value);
+
+    if constexpr (std::is_floating_point_v<T>)
+      write (raw);
+    else if constexpr (std::is_signed_v<T>)
+      write_sleb128 (raw);
+    else
+      write_uleb128 (raw);
+  });
+}
+
+void
+byte_writer::write_compact_instruction (const instruction &instr)
+{
+  write (instr.code);
+  const auto &args = instr.args;
+
+  switch (opcode_kind (instr.code))
+    {
+    case instruction_kind::lonely:
+      return;
+    case instruction_kind::index:
+      write_uleb128 (args.index.value);
+      return;
+    case instruction_kind::local:
+      write_uleb128 (args.local.value);
+      return;
+    case instruction_kind::jump:
+      write_uleb128 (args.jump.target);
+      return;
+    case instruction_kind::type:
+      write (args.type.value);
+      return;
+    case instruction_kind::branch:
+      write_uleb128 (args.branch.value);
+      write (args.branch.compare);
+      write (args.branch.jump);
+      write_uleb128 (args.branch.target);
+      return;
+    }
+}
+
+void
+byte_writer::write_compact_string (std::string_view value)
+{
+  write_uleb128 (value.size ());
+  write_bytes (std::span<const uint8_t> (
+      reinterpret_cast<const uint8_t *> (value.data ()), value.size ()));
+}
+
+void
+byte_writer::write_primitive (const primitive_value &value, bool fat)
+{
+  save_primitive (value, reserve (primitive_save_size (value, fat)), fat);
+}
+
+void
+byte_writer::write_instruction (const instruction &instr)
+{
+  auto info = instruction::get_ls_info ();
+  info.save (instr, reserve (info.save_size (instr)));
+}
+
+void
+byte_writer::write_bytes (std::span<const uint8_t> bytes)
+{
+  std::memcpy (reserve (bytes.size ()), bytes.data (), bytes.size ());
+}
+
+std::vector<uint8_t>
+byte_writer::take ()
+{
+  std::vector<uint8_t> bytes;
+  bytes.swap (m_buffer);
+  bytes.resize (m_size);
+  m_size = 0;
+
+  return bytes;
+}
+
+void
+byte_writer::grow (uint64_t count)
+{
+  auto needed = m_size + count;
+  auto size = std::max<uint64_t> (m_buffer.size () * 2,
+                                  m_buffer.size () + m_batch);
+
+  m_buffer.resize (std::max (size, needed));
+}
+
+} // evm
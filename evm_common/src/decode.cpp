@@ -0,0 +1,187 @@
+#include <evm/cursor.h>
+#include <evm/decode.h>
+#include <evm/serializer.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace evm
+{
+
+uint64_t
+decoded_code::size () const
+{
+  return opcodes.size ();
+}
+
+std::optional<uint32_t>
+decoded_code::index_of (uint32_t offset) const
+{
+  auto found = std::lower_bound (offsets.begin (), offsets.end (), offset);
+
+  if (found == offsets.end () || *found != offset)
+    return std::nullopt;
+
+  return static_cast<uint32_t> (found - offsets.begin ());
+}
+
+uint64_t
+instruction_operand (instruction_kind kind, const instruction_args &args)
+{
+  switch (kind)
+    {
+    case instruction_kind::lonely:
+      return 0;
+    case instruction_kind::index:
+      return args.index.value;
+    case instruction_kind::local:
+      return args.local.value;
+    case instruction_kind::jump:
+      return args.jump.target;
+    case instruction_kind::type:
+      return args.type.value;
+    case instruction_kind::branch:
+      return branch_operand{ .target = args.branch.target,
+                             .value = args.branch.value,
+                             .compare = args.branch.compare,
+                             .jump = args.branch.jump }
+          .pack ();
+    }
+  return 0;
+}
+
+/**
+ * Loads the operand slot of an instruction straight from its arguments.
+ */
+static uint64_t
+load_operand (instruction_kind kind, const uint8_t *buffer)
+{
+  switch (kind)
+    {
+    case instruction_kind::lonely:
+      return 0;
+    case instruction_kind::index:
+    case instruction_kind::jump:
+      return serializer<uint32_t>::load (buffer);
+    case instruction_kind::local:
+      return serializer<uint16_t>::load (buffer);
+    case instruction_kind::type:
+      return serializer<primitive_type>::load (buffer);
+    case instruction_kind::branch:
+      return instruction_operand (
+          instruction_kind::branch,
+          instruction_args::load (instruction_kind::branch, buffer));
+    }
+  return 0;
+}
+
+/**
+ * Decodes instructions in the compact encoding, which are only as long as
+ * their operands.
+ */
+static void
+decode_compact (std::span<const uint8_t> code, decoded_code &decoded)
+{
+  byte_reader reader (code);
+
+  while (!reader.at_end ())
+    {
+      auto offset = reader.offset ();
+      instruction instr;
+
+      try
+        {
+          instr = reader.read_compact_instruction ();
+        }
+      catch (const std::out_of_range &)
+        {
+          throw std::runtime_error ("Truncated instruction.");
+        }
+
+      decoded.opcodes.push_back (instr.code);
+      decoded.operands.push_back (
+          instruction_operand (opcode_kind (instr.code), instr.args));
+      decoded.offsets.push_back (static_cast<uint32_t> (offset));
+    }
+}
+
+decoded_code
+decode_code (std::span<const uint8_t> code, bool compact)
+{
+  decoded_code decoded;
+
+  // most instructions are a few bytes, so this avoids most reallocations.
+  auto estimate = code.size () / 2;
+  decoded.opcodes.reserve (estimate);
+  decoded.operands.reserve (estimate);
+  decoded.offsets.reserve (estimate);
+
+  if (compact)
+    {
+      decode_compact (code, decoded);
+      resolve_jumps (decoded);
+      return decoded;
+    }
+
+  uint64_t offset = 0;
+
+  while (offset < code.size ())
+    {
+      if (!opcode_valid (code[offset]))
+        throw std::runtime_error ("Invalid opcode.");
+
+      auto op = load_opcode (code.data () + offset);
+      auto kind = opcode_kind (op);
+      auto size = sizeof (opcode) + instruction_args::size (kind);
+
+      if (size > code.size () - offset)
+        throw std::runtime_error ("Truncated instruction.");
+
+      decoded.opcodes.push_back (op);
+      decoded.operands.push_back (
+          load_operand (kind, code.data () + offset + sizeof (opcode)));
+      decoded.offsets.push_back (static_cast<uint32_t> (offset));
+
+      offset += size;
+    }
+
+  resolve_jumps (decoded);
+  return decoded;
+}
+
+void
+resolve_jumps (decoded_code &decoded)
+{
+  for (uint64_t i = 0; i < decoded.size (); i++)
+    {
+      auto kind = opcode_kind (decoded.opcodes[i]);
+
+      if (kind == instruction_kind::branch)
+        {
+          auto branch = branch_operand::unpack (decoded.operands[i]);
+
+          if (!is_comparison (branch.compare)
+              || !is_conditional_jump (branch.jump))
+            throw std::runtime_error ("Invalid fused branch.");
+
+          auto index = decoded.index_of (branch.target);
+          if (!index)
+            throw std::runtime_error ("Jump to an invalid offset.");
+
+          branch.target = *index;
+          decoded.operands[i] = branch.pack ();
+        }
+      else if (kind == instruction_kind::jump)
+        {
+          auto target = static_cast<uint32_t> (decoded.operands[i]);
+          auto index = decoded.index_of (target);
+
+          if (!index)
+            throw std::runtime_error ("Jump to an invalid offset.");
+
+          decoded.operands[i] = *index;
+        }
+    }
+}
+
+} // evm
@@ -1,4 +1,7 @@
 #include <evm/instruction.h>
+#include <evm/serializer.h>
+
+#include <stdexcept>
 
 namespace evm
 {
@@ -12,6 +15,25 @@ instruction_args::load (instruction_kind kind, const uint8_t *buffer)
     {
     case instruction_kind::lonely:
       args.lonely = {};
+      break;
+    case instruction_kind::index:
+      args.index.value = serializer<uint32_t>::load (buffer);
+      break;
+    case instruction_kind::local:
+      args.local.value = serializer<uint16_t>::load (buffer);
+      break;
+    case instruction_kind::jump:
+      args.jump.target = serializer<uint32_t>::load (buffer);
+      break;
+    case instruction_kind::type:
+      args.type.value = serializer<primitive_type>::load (buffer);
+      break;
+    case instruction_kind::branch:
+      args.branch.value = serializer<uint16_t>::load (buffer);
+      args.branch.compare = serializer<opcode>::load (buffer + 2);
+      args.branch.jump = serializer<opcode>::load (buffer + 3);
+      args.branch.target = serializer<uint32_t>::load (buffer + 4);
+      break;
     }
 
   return args;
@@ -31,6 +53,24 @@ instruction_args::save (const instruction_args &args, instruction_kind kind,
     {
     case instruction_kind::lonely:
       return;
+    case instruction_kind::index:
+      serializer<uint32_t>::save (args.index.value, buffer);
+      return;
+    case instruction_kind::local:
+      serializer<uint16_t>::save (args.local.value, buffer);
+      return;
+    case instruction_kind::jump:
+      serializer<uint32_t>::save (args.jump.target, buffer);
+      return;
+    case instruction_kind::type:
+      serializer<primitive_type>::save (args.type.value, buffer);
+      return;
+    case instruction_kind::branch:
+      serializer<uint16_t>::save (args.branch.value, buffer);
+      serializer<opcode>::save (args.branch.compare, buffer + 2);
+      serializer<opcode>::save (args.branch.jump, buffer + 3);
+      serializer<uint32_t>::save (args.branch.target, buffer + 4);
+      return;
     }
 }
 
@@ -41,6 +81,26 @@ instruction_args::save (const instruction_args &args, opcode code,
   save (args, opcode_kind (code), buffer);
 }
 
+uint64_t
+instruction_args::size (instruction_kind kind)
+{
+  switch (kind)
+    {
+    case instruction_kind::lonely:
+      return 0;
+    case instruction_kind::index:
+    case instruction_kind::jump:
+      return sizeof (uint32_t);
+    case instruction_kind::local:
+      return sizeof (uint16_t);
+    case instruction_kind::type:
+      return sizeof (primitive_type);
+    case instruction_kind::branch:
+      return sizeof (uint16_t) + 2 * sizeof (opcode) + sizeof (uint32_t);
+    }
+  return 0;
+}
+
 instruction
 instruction::load (const uint8_t *buffer)
 {
@@ -54,6 +114,36 @@ instruction::load (const uint8_t *buffer)
   };
 }
 
+void
+instruction::save (const instruction &instr, uint8_t *buffer)
+{
+  save_opcode (instr.code, buffer);
+  buffer++;
+  instruction_args::save (instr.args, instr.code, buffer);
+}
+
+static uint64_t
+instruction_ld_size (const uint8_t *buffer)
+{
+  auto kind = opcode_kind (load_opcode (buffer));
+  return sizeof (opcode) + instruction_args::size (kind);
+}
+
+static uint64_t
+instruction_st_size (const instruction &instr)
+{
+  return sizeof (opcode) + instruction_args::size (opcode_kind (instr.code));
+}
+
+ls_info<instruction>
+instruction::get_ls_info ()
+{
+  return ls_info<instruction>{ .load_size = instruction_ld_size,
+                               .save_size = instruction_st_size,
+                               .load = load,
+                               .save = save };
+}
+
 static uint64_t
 opcode_ld_size (const uint8_t *)
 {
@@ -83,12 +173,166 @@ save_opcode (const opcode &self, uint8_t *buffer)
 instruction_kind
 opcode_kind (opcode opcode)
 {
-  switch (opcode)
+  switch (generic_opcode (opcode))
     {
+    case opcode::load_const:
+    case opcode::call:
+    case opcode::host_call:
+    case opcode::add_const:
+    case opcode::sub_const:
+    case opcode::load_string:
+      return instruction_kind::index;
+    case opcode::load_local:
+    case opcode::store_local:
+      return instruction_kind::local;
+    case opcode::jump:
+    case opcode::jump_if:
+    case opcode::jump_unless:
+      return instruction_kind::jump;
+    case opcode::conv:
+      return instruction_kind::type;
+    case opcode::branch_local:
+    case opcode::branch_const:
+      return instruction_kind::branch;
     case opcode::nop:
+    case opcode::pop:
+    case opcode::dup:
+    case opcode::swap:
+    case opcode::add:
+    case opcode::sub:
+    case opcode::mul:
+    case opcode::div:
+    case opcode::rem:
+    case opcode::neg:
+    case opcode::eq:
+    case opcode::ne:
+    case opcode::lt:
+    case opcode::le:
+    case opcode::gt:
+    case opcode::ge:
+    case opcode::ret:
+    case opcode::concat:
       return instruction_kind::lonely;
+    // generic_opcode never gives these.
+    case opcode::add_i64:
+    case opcode::sub_i64:
+    case opcode::mul_i64:
+    case opcode::eq_i64:
+    case opcode::ne_i64:
+    case opcode::lt_i64:
+    case opcode::le_i64:
+    case opcode::gt_i64:
+    case opcode::ge_i64:
+    case opcode::add_const_i64:
+    case opcode::sub_const_i64:
+    case opcode::add_f64:
+    case opcode::sub_f64:
+    case opcode::mul_f64:
+    case opcode::eq_f64:
+    case opcode::ne_f64:
+    case opcode::lt_f64:
+    case opcode::le_f64:
+    case opcode::gt_f64:
+    case opcode::ge_f64:
+    case opcode::add_const_f64:
+    case opcode::sub_const_f64:
+      break;
     };
-  return instruction_kind::lonely;
+
+  throw std::runtime_error ("Invalid opcode.");
+}
+
+bool
+opcode_valid (uint8_t byte)
+{
+  return byte < opcode_count;
+}
+
+/// the quickened opcodes, with the generic opcode and type they are for.
+static constexpr struct
+{
+  opcode generic;
+  primitive_type type;
+  opcode quick;
+} quickenings[] = {
+  { opcode::add, I64_TYPE, opcode::add_i64 },
+  { opcode::sub, I64_TYPE, opcode::sub_i64 },
+  { opcode::mul, I64_TYPE, opcode::mul_i64 },
+  { opcode::eq, I64_TYPE, opcode::eq_i64 },
+  { opcode::ne, I64_TYPE, opcode::ne_i64 },
+  { opcode::lt, I64_TYPE, opcode::lt_i64 },
+  { opcode::le, I64_TYPE, opcode::le_i64 },
+  { opcode::gt, I64_TYPE, opcode::gt_i64 },
+  { opcode::ge, I64_TYPE, opcode::ge_i64 },
+  { opcode::add_const, I64_TYPE, opcode::add_const_i64 },
+  { opcode::sub_const, I64_TYPE, opcode::sub_const_i64 },
+  { opcode::add, F64_TYPE, opcode::add_f64 },
+  { opcode::sub, F64_TYPE, opcode::sub_f64 },
+  { opcode::mul, F64_TYPE, opcode::mul_f64 },
+  { opcode::eq, F64_TYPE, opcode::eq_f64 },
+  { opcode::ne, F64_TYPE, opcode::ne_f64 },
+  { opcode::lt, F64_TYPE, opcode::lt_f64 },
+  { opcode::le, F64_TYPE, opcode::le_f64 },
+  { opcode::gt, F64_TYPE, opcode::gt_f64 },
+  { opcode::ge, F64_TYPE, opcode::ge_f64 },
+  { opcode::add_const, F64_TYPE, opcode::add_const_f64 },
+  { opcode::sub_const, F64_TYPE, opcode::sub_const_f64 },
+};
+static_assert (sizeof (quickenings) / sizeof (quickenings[0])
+               == quickened_opcode_count - opcode_count);
+// in the same order as opcode, so generic_opcode can index it.
+static_assert ([] {
+  for (uint8_t i = 0; i < quickened_opcode_count - opcode_count; i++)
+    if (static_cast<uint8_t> (quickenings[i].quick) != opcode_count + i)
+      return false;
+  return true;
+}());
+
+opcode
+quickened_opcode (opcode generic, primitive_type type)
+{
+  for (const auto &entry : quickenings)
+    if (entry.generic == generic && entry.type == type)
+      return entry.quick;
+
+  return generic;
+}
+
+opcode
+generic_opcode (opcode quick)
+{
+  auto byte = static_cast<uint8_t> (quick);
+  if (byte < opcode_count || byte >= quickened_opcode_count)
+    return quick;
+
+  return quickenings[byte - opcode_count].generic;
+}
+
+std::string_view
+opcode_name (opcode opcode)
+{
+  // in the same order as opcode.
+  static constexpr std::string_view names[] = {
+    "nop",       "load_const",   "pop",          "dup",
+    "swap",      "load_local",   "store_local",  "add",
+    "sub",       "mul",          "div",          "rem",
+    "neg",       "eq",           "ne",           "lt",
+    "le",        "gt",           "ge",           "conv",
+    "jump",      "jump_if",      "jump_unless",  "call",
+    "ret",       "host_call",    "add_const",    "sub_const",
+    "branch_local", "branch_const", "load_string", "concat",
+    "add_i64",   "sub_i64",      "mul_i64",      "eq_i64",
+    "ne_i64",    "lt_i64",       "le_i64",       "gt_i64",
+    "ge_i64",    "add_const_i64", "sub_const_i64", "add_f64",
+    "sub_f64",   "mul_f64",      "eq_f64",       "ne_f64",
+    "lt_f64",    "le_f64",       "gt_f64",       "ge_f64",
+    "add_const_f64", "sub_const_f64",
+  };
+  static_assert (sizeof (names) / sizeof (names[0])
+                 == quickened_opcode_count);
+
+  auto byte = static_cast<uint8_t> (opcode);
+  return byte < quickened_opcode_count ? names[byte] : "invalid";
 }
 
 ls_info<opcode>
@@ -1,7 +1,8 @@
 #define EVM_INTERNAL
 #include <evm/loading.h>
+#include <evm/serializer.h>
 
-#include <stdexcept>
+#include <cstring>
 #include <string>
 #include <string_view>
 #include <type_traits>
@@ -9,144 +10,87 @@
 namespace evm
 {
 
-template <typename T, typename A> static uint64_t basic_size (const A);
-template <typename T> static T basic_load (const uint8_t *);
-template <typename T> static uint64_t basic_save (const T &, const uint8_t *);
-
 template <typename T>
-static uint64_t
-basic_size ()
-{
-  return sizeof (T);
-}
-
-template <typename T, typename A>
-static uint64_t
-basic_size (A)
-{
-  return basic_size<T> ();
-}
-
-template <>
-uint64_t
-basic_size<std::string> (const uint8_t *buffer)
-{
-  return basic_load<uint64_t> (buffer) + basic_size<uint64_t> ();
-}
-
-template <>
-uint64_t
-basic_size<std::string_view> (const uint8_t *buffer)
-{
-  return basic_load<uint64_t> (buffer) + basic_size<uint64_t> ();
-}
-
-template <>
-uint64_t
-basic_size<std::string> (const std::string &str)
-{
-  auto len = str.length ();
-  return len + basic_size<uint64_t> ();
-}
-
-template <>
-uint64_t
-basic_size<std::string_view> (const std::string_view &str)
+ls_info<T>
+value_ls_info ()
 {
-  auto len = str.length ();
-  return len + basic_size<uint64_t> ();
+  return make_ls_info<T> ();
 }
 
+/**
+ * Reverses the bytes of @c value.
+ * This uses the compiler's byte swap builtins where there are any,
+ * which loops over arrays are vectorised with.
+ */
 template <typename T>
 static T
-basic_load (const uint8_t *buff)
-{
-  T output;
-  // interpret T as bytes.
-  auto *bytes = reinterpret_cast<uint8_t *> (&output);
-
-  for (uint64_t i = 0; i < sizeof (T); i++)
-    bytes[i] = buff[i];
-
-  return output;
-}
-
-template <>
-std::string
-basic_load<std::string> (const uint8_t *buff)
+byte_swap (T value)
 {
-  auto size = basic_size<std::string> (buff) - 8;
-  buff += basic_size<uint64_t> ();
-
-  std::string str;
-  str.reserve (size);
-
-  for (uint64_t i = 0; i < size; i++)
+  using U = std::conditional_t<
+      sizeof (T) == 8, uint64_t,
+      std::conditional_t<sizeof (T) == 4, uint32_t,
+                         std::conditional_t<sizeof (T) == 2, uint16_t,
+                                            uint8_t>>>;
+
+  auto in = std::bit_cast<U> (value);
+  U out = 0;
+
+#if defined(__GNUC__)
+  if constexpr (sizeof (U) == 8)
+    out = __builtin_bswap64 (in);
+  else if constexpr (sizeof (U) == 4)
+    out = __builtin_bswap32 (in);
+  else if constexpr (sizeof (U) == 2)
+    out = __builtin_bswap16 (in);
+  else
+    out = in;
+#else
+  for (uint64_t i = 0; i < sizeof (U); i++)
     {
-      auto *character = reinterpret_cast<const char *> (&buff[i]);
-      str.append (character, 1);
+      out = static_cast<U> (out << 8) | static_cast<U> (in & 0xff);
+      in = static_cast<U> (in >> 8);
     }
+#endif
 
-  return str;
-}
-
-template <>
-std::string_view
-basic_load<std::string_view> (const uint8_t *buff)
-{
-  throw std::runtime_error (
-      "Tried to load std::string_view from memory (which is not supported).");
+  return std::bit_cast<T> (out);
 }
 
 template <typename T>
-static void
-basic_save (const T &value, uint8_t *buff)
+void
+load_span (std::span<T> values, const uint8_t *buffer, std::endian order)
 {
-  auto *bytes = reinterpret_cast<const uint8_t *> (&value);
+  // an empty span may have no data at all.
+  if (values.empty ())
+    return;
 
-  for (uint64_t i = 0; i < sizeof (T); i++)
-    buff[i] = bytes[i];
-}
-
-template <typename S>
-static void
-str_save (const S &value, uint8_t *buff)
-{
-  auto size = basic_size<std::string> (value) - 8;
+  std::memcpy (values.data (), buffer, values.size_bytes ());
 
-  // write size
-  basic_save<uint64_t> (size, buff);
-  buff += 8;
+  if (sizeof (T) == 1 || order == std::endian::native)
+    return;
 
-  // write bytes
-  for (uint64_t i = 0; i < size; i++)
-    buff[i] = static_cast<uint8_t> (value[i]);
+  for (auto &value : values)
+    value = byte_swap (value);
 }
 
-template <>
+template <typename T>
 void
-basic_save<std::string> (const std::string &value, uint8_t *buff)
+save_span (std::span<const std::type_identity_t<T>> values, uint8_t *buffer,
+           std::endian order)
 {
-  str_save<std::string> (value, buff);
-}
+  if (values.empty ())
+    return;
 
-template <>
-void
-basic_save<std::string_view> (const std::string_view &value, uint8_t *buff)
-{
-  str_save<std::string_view> (value, buff);
-}
+  if (sizeof (T) == 1 || order == std::endian::native)
+    {
+      std::memcpy (buffer, values.data (), values.size_bytes ());
+      return;
+    }
 
-template <typename T>
-ls_info<T>
-value_ls_info ()
-{
-  return ls_info<T>{
-    .load_size = basic_size<T>,
-    .save_size = basic_size<T>,
-    .load = basic_load<T>,
-    .save = basic_save<T>,
-  };
+  for (uint64_t i = 0; i < values.size (); i++)
+    {
+      auto swapped = byte_swap (values[i]);
+      std::memcpy (buffer + i * sizeof (T), &swapped, sizeof (T));
+    }
 }
 
 #define PRIMITIVE_LS_INFO(T) template ls_info<T> value_ls_info<T> ()
@@ -165,4 +109,19 @@ PRIMITIVE_LS_INFO (double);
 PRIMITIVE_LS_INFO (std::string);
 PRIMITIVE_LS_INFO (std::string_view);
 
+#define PRIMITIVE_SPAN(T)                                                     \
+  template void load_span<T> (std::span<T>, const uint8_t *, std::endian);    \
+  template void save_span<T> (std::span<const T>, uint8_t *, std::endian)
+
+PRIMITIVE_SPAN (uint8_t);
+PRIMITIVE_SPAN (uint16_t);
+PRIMITIVE_SPAN (uint32_t);
+PRIMITIVE_SPAN (uint64_t);
+PRIMITIVE_SPAN (int8_t);
+PRIMITIVE_SPAN (int16_t);
+PRIMITIVE_SPAN (int32_t);
+PRIMITIVE_SPAN (int64_t);
+PRIMITIVE_SPAN (float);
+PRIMITIVE_SPAN (double);
+
 } // evm
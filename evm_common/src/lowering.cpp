@@ -0,0 +1,652 @@
+#include <evm/decode.h>
+#include <evm/lowering.h>
+
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace evm
+{
+
+/**
+ * Where a value on the operand stack is while lowering,
+ * until an instruction needs it in a register of its own.
+ */
+struct pending_value
+{
+  enum class place : uint8_t
+  {
+    /// in the register of its depth.
+    own,
+    /// in another register, a local variable or an own register below it.
+    alias,
+    /// a constant, not loaded yet.
+    constant,
+  };
+
+  place where;
+  /// the register or constant, for aliases and constants.
+  uint32_t index;
+  primitive_type type;
+};
+
+/**
+ * Lowers the code of a program in order, keeping track of where the
+ * values of the operand stack are.
+ *
+ * Own registers only change when their value is popped,
+ * so aliases of them stay valid, and materializing a value only ever writes
+ * a register nothing else refers to.
+ */
+struct register_lowering
+{
+  const program &prog;
+  const verification &verified;
+  reg_program out;
+
+  /// the operand stack, bottom first.
+  std::vector<pending_value> stack;
+  /// the number of local variables, where the operand stack starts.
+  uint32_t locals = 0;
+  /// the depth whose value the last instruction emitted wrote, if any.
+  std::optional<uint32_t> fresh;
+
+  /// where each instruction starts in the register code.
+  std::vector<uint32_t> labels;
+  /// the jumps and branches, whose targets are instruction indices until
+  /// every label is known.
+  std::vector<uint32_t> fixups;
+
+  register_lowering (const program &prog, const verification &verified)
+      : prog (prog), verified (verified)
+  {
+  }
+
+  uint32_t
+  top () const
+  {
+    return static_cast<uint32_t> (stack.size () - 1);
+  }
+
+  uint32_t
+  own (uint32_t depth) const
+  {
+    return locals + depth;
+  }
+
+  void
+  emit (reg_instr instr)
+  {
+    out.code.push_back (instr);
+    fresh.reset ();
+  }
+
+  void
+  emit_jump (reg_instr instr, uint32_t target)
+  {
+    instr.dst = target;
+    fixups.push_back (static_cast<uint32_t> (out.code.size ()));
+    emit (instr);
+  }
+
+  void
+  push (pending_value value)
+  {
+    stack.push_back (value);
+    fresh.reset ();
+  }
+
+  /// pushes the value the last instruction emitted wrote to its own register.
+  void
+  push_result (primitive_type type)
+  {
+    stack.push_back (pending_value{ .where = pending_value::place::own,
+                                    .index = 0,
+                                    .type = type });
+    fresh = top ();
+  }
+
+  pending_value
+  pop ()
+  {
+    auto value = stack.back ();
+    stack.pop_back ();
+    fresh.reset ();
+
+    return value;
+  }
+
+  /**
+   * Moves the value at @c depth into its own register.
+   */
+  void
+  materialize (uint32_t depth)
+  {
+    auto &value = stack[depth];
+    if (value.where == pending_value::place::own)
+      return;
+
+    emit (reg_instr{ .op = value.where == pending_value::place::constant
+                               ? reg_op::load_const
+                               : reg_op::mov,
+                     .type = value.type,
+                     .result = value.type,
+                     .compare = opcode::nop,
+                     .dst = own (depth),
+                     .a = value.index,
+                     .b = 0 });
+    value.where = pending_value::place::own;
+  }
+
+  /**
+   * The register the value at @c depth is in, loading it if it is a
+   * constant.
+   */
+  uint32_t
+  use (uint32_t depth)
+  {
+    auto &value = stack[depth];
+
+    if (value.where == pending_value::place::constant)
+      materialize (depth);
+    if (value.where == pending_value::place::own)
+      return own (depth);
+
+    return value.index;
+  }
+
+  /**
+   * Materializes every value, as the start of a block expects them.
+   */
+  void
+  flush ()
+  {
+    for (uint32_t depth = 0; depth < stack.size (); depth++)
+      materialize (depth);
+  }
+
+  /**
+   * Materializes the values that alias a local variable about to change.
+   */
+  void
+  write_local (uint32_t local)
+  {
+    for (uint32_t depth = 0; depth < stack.size (); depth++)
+      if (stack[depth].where == pending_value::place::alias
+          && stack[depth].index == local)
+        materialize (depth);
+  }
+
+  /**
+   * Starts a block at @c ip, with every value in its own register.
+   */
+  void
+  start_block (uint64_t ip)
+  {
+    locals = static_cast<uint32_t> (
+        prog.functions[verified.owners[ip]].locals.size ());
+
+    stack.clear ();
+    for (auto type : verified.stack_types (ip))
+      stack.push_back (pending_value{ .where = pending_value::place::own,
+                                      .index = 0,
+                                      .type = type });
+    fresh.reset ();
+  }
+
+  /**
+   * Lowers an arithmetic operation or comparison of the two top values,
+   * with a constant right operand folded into the instruction.
+   */
+  void
+  binary (reg_op op, reg_op op_k, opcode compare, bool is_compare)
+  {
+    auto rhs = stack[top ()];
+    auto lhs = top () - 1;
+    auto type = rhs.type;
+    auto a = use (lhs);
+
+    uint32_t b = rhs.index;
+    if (rhs.where == pending_value::place::constant)
+      op = op_k;
+    else
+      b = use (top ());
+
+    pop ();
+    pop ();
+    emit (reg_instr{ .op = op,
+                     .type = type,
+                     .result = is_compare ? U8_TYPE : type,
+                     .compare = compare,
+                     .dst = own (lhs),
+                     .a = a,
+                     .b = b });
+    push_result (is_compare ? U8_TYPE : type);
+  }
+
+  /**
+   * Lowers an operation of the top value, into its own register.
+   */
+  void
+  unary (reg_op op, uint32_t b, primitive_type result)
+  {
+    auto depth = top ();
+    auto type = stack[depth].type;
+    auto a = use (depth);
+
+    pop ();
+    emit (reg_instr{ .op = op,
+                     .type = type,
+                     .result = result,
+                     .compare = opcode::nop,
+                     .dst = own (depth),
+                     .a = a,
+                     .b = b });
+    push_result (result);
+  }
+
+  /**
+   * Lowers a call, whose arguments are materialized in order so the frame
+   * of the callee starts at the first of them.
+   */
+  void
+  call (reg_op op, uint32_t index, uint64_t arg_count,
+        std::optional<primitive_type> result)
+  {
+    auto first = static_cast<uint32_t> (stack.size () - arg_count);
+    for (auto depth = first; depth < stack.size (); depth++)
+      materialize (depth);
+
+    stack.resize (first);
+    emit (reg_instr{ .op = op,
+                     .type = result.value_or (primitive_type{}),
+                     .result = result.value_or (primitive_type{}),
+                     .compare = opcode::nop,
+                     .dst = own (first),
+                     .a = own (first),
+                     .b = index });
+
+    if (result)
+      push_result (*result);
+  }
+
+  /**
+   * Lowers a conditional jump, fused with the comparison just before it
+   * when there is one.
+   */
+  void
+  conditional (opcode jump, uint32_t target)
+  {
+    bool when = jump == opcode::jump_if;
+
+    if (fresh == top ()
+        && (out.code.back ().op == reg_op::compare
+            || out.code.back ().op == reg_op::compare_k))
+      {
+        // what the comparison reads is never written by flushing.
+        auto compared = out.code.back ();
+        out.code.pop_back ();
+        pop ();
+        flush ();
+
+        bool constant = compared.op == reg_op::compare_k;
+        compared.op = when ? (constant ? reg_op::branch_if_k
+                                       : reg_op::branch_if)
+                           : (constant ? reg_op::branch_unless_k
+                                       : reg_op::branch_unless);
+        compared.result = compared.type;
+        emit_jump (compared, target);
+        return;
+      }
+
+    auto type = stack[top ()].type;
+    auto a = use (top ());
+    pop ();
+    flush ();
+
+    emit_jump (reg_instr{ .op = when ? reg_op::jump_if : reg_op::jump_unless,
+                          .type = type,
+                          .result = type,
+                          .compare = opcode::nop,
+                          .dst = 0,
+                          .a = a,
+                          .b = 0 },
+               target);
+  }
+
+  /**
+   * Lowers one instruction, and returns whether it falls through.
+   */
+  bool
+  lower (uint64_t ip)
+  {
+    const auto &info = prog.functions[verified.owners[ip]];
+    auto op = prog.code.opcodes[ip];
+    auto operand = prog.code.operands[ip];
+    auto index = static_cast<uint32_t> (operand);
+
+    switch (op)
+      {
+      case opcode::nop:
+        break;
+
+      case opcode::load_const:
+        push (pending_value{
+            .where = pending_value::place::constant,
+            .index = index,
+            .type = primitive_get_type (prog.constants[index]) });
+        break;
+
+      case opcode::pop:
+        pop ();
+        break;
+
+      case opcode::dup:
+        {
+          auto value = stack[top ()];
+          if (value.where == pending_value::place::own)
+            value = pending_value{ .where = pending_value::place::alias,
+                                   .index = own (top ()),
+                                   .type = value.type };
+          push (value);
+          break;
+        }
+
+      case opcode::swap:
+        {
+          auto &lhs = stack[top () - 1];
+          auto &rhs = stack[top ()];
+
+          // neither is in a register of its own, so they just trade places.
+          if (lhs.where != pending_value::place::own
+              && rhs.where != pending_value::place::own)
+            {
+              std::swap (lhs, rhs);
+              fresh.reset ();
+              break;
+            }
+
+          materialize (top () - 1);
+          materialize (top ());
+          std::swap (lhs.type, rhs.type);
+          emit (reg_instr{ .op = reg_op::swap,
+                           .type = lhs.type,
+                           .result = lhs.type,
+                           .compare = opcode::nop,
+                           .dst = 0,
+                           .a = own (top () - 1),
+                           .b = own (top ()) });
+          break;
+        }
+
+      case opcode::load_local:
+        push (pending_value{ .where = pending_value::place::alias,
+                             .index = index,
+                             .type = info.locals[index] });
+        break;
+
+      case opcode::store_local:
+        {
+          auto value = stack[top ()];
+          if (value.where == pending_value::place::alias
+              && value.index == index)
+            {
+              pop ();
+              break;
+            }
+
+          write_local (index);
+
+          // the value was just computed, so it is computed into the local.
+          if (fresh == top ())
+            out.code.back ().dst = index;
+          else if (value.where == pending_value::place::constant)
+            emit (reg_instr{ .op = reg_op::load_const,
+                             .type = value.type,
+                             .result = value.type,
+                             .compare = opcode::nop,
+                             .dst = index,
+                             .a = value.index,
+                             .b = 0 });
+          else
+            emit (reg_instr{ .op = reg_op::mov,
+                             .type = value.type,
+                             .result = value.type,
+                             .compare = opcode::nop,
+                             .dst = index,
+                             .a = use (top ()),
+                             .b = 0 });
+          pop ();
+          break;
+        }
+
+      case opcode::add:
+        binary (reg_op::add, reg_op::add_k, opcode::nop, false);
+        break;
+      case opcode::sub:
+        binary (reg_op::sub, reg_op::sub_k, opcode::nop, false);
+        break;
+      case opcode::mul:
+        binary (reg_op::mul, reg_op::mul_k, opcode::nop, false);
+        break;
+      case opcode::div:
+        binary (reg_op::div, reg_op::div_k, opcode::nop, false);
+        break;
+      case opcode::rem:
+        binary (reg_op::rem, reg_op::rem_k, opcode::nop, false);
+        break;
+
+      case opcode::add_const:
+        unary (reg_op::add_k, index, stack[top ()].type);
+        break;
+      case opcode::sub_const:
+        unary (reg_op::sub_k, index, stack[top ()].type);
+        break;
+
+      case opcode::neg:
+        unary (reg_op::neg, 0, stack[top ()].type);
+        break;
+
+      case opcode::conv:
+        unary (reg_op::conv, 0, static_cast<primitive_type> (operand));
+        break;
+
+      case opcode::eq:
+      case opcode::ne:
+      case opcode::lt:
+      case opcode::le:
+      case opcode::gt:
+      case opcode::ge:
+        binary (reg_op::compare, reg_op::compare_k, op, true);
+        break;
+
+      case opcode::jump:
+        flush ();
+        emit_jump (reg_instr{ .op = reg_op::jump,
+                              .type = primitive_type{},
+                              .result = primitive_type{},
+                              .compare = opcode::nop,
+                              .dst = 0,
+                              .a = 0,
+                              .b = 0 },
+                   index);
+        return false;
+
+      case opcode::jump_if:
+      case opcode::jump_unless:
+        conditional (op, index);
+        break;
+
+      case opcode::branch_local:
+      case opcode::branch_const:
+        {
+          auto fused = branch_operand::unpack (operand);
+          bool when = fused.jump == opcode::jump_if;
+          bool constant = op == opcode::branch_const;
+
+          auto type = stack[top ()].type;
+          auto a = use (top ());
+          pop ();
+          flush ();
+
+          auto branch = when ? (constant ? reg_op::branch_if_k
+                                         : reg_op::branch_if)
+                             : (constant ? reg_op::branch_unless_k
+                                         : reg_op::branch_unless);
+          emit_jump (reg_instr{ .op = branch,
+                                .type = type,
+                                .result = type,
+                                .compare = fused.compare,
+                                .dst = 0,
+                                .a = a,
+                                .b = fused.value },
+                     fused.target);
+          break;
+        }
+
+      case opcode::call:
+        {
+          const auto &callee = prog.functions[index];
+          call (reg_op::call, index, callee.arg_count, callee.result);
+          break;
+        }
+
+      case opcode::host_call:
+        {
+          const auto &host = verified.hosts[index];
+          call (reg_op::host_call, index, host.args.size (), host.result);
+          break;
+        }
+
+      case opcode::ret:
+        if (info.result)
+          {
+            auto a = use (top ());
+            emit (reg_instr{ .op = reg_op::ret,
+                             .type = *info.result,
+                             .result = *info.result,
+                             .compare = opcode::nop,
+                             .dst = 0,
+                             .a = a,
+                             .b = 0 });
+          }
+        else
+          emit (reg_instr{ .op = reg_op::ret_void,
+                           .type = primitive_type{},
+                           .result = primitive_type{},
+                           .compare = opcode::nop,
+                           .dst = 0,
+                           .a = 0,
+                           .b = 0 });
+        return false;
+
+      case opcode::load_string:
+        emit (reg_instr{ .op = reg_op::load_string,
+                         .type = REF_TYPE,
+                         .result = REF_TYPE,
+                         .compare = opcode::nop,
+                         .dst = own (static_cast<uint32_t> (stack.size ())),
+                         .a = index,
+                         .b = 0 });
+        push_result (REF_TYPE);
+        break;
+
+      case opcode::concat:
+        binary (reg_op::concat, reg_op::concat, opcode::nop, false);
+        break;
+
+      // quickened opcodes are never decoded, so never verified.
+      default:
+        throw std::runtime_error ("Invalid opcode.");
+      }
+
+    return true;
+  }
+
+  reg_program
+  lower_all ()
+  {
+    const auto &code = prog.code;
+    std::vector<bool> starts (code.size ());
+
+    for (const auto &function : prog.functions)
+      starts[function.entry] = true;
+
+    for (uint64_t ip = 0; ip < code.size (); ip++)
+      {
+        if (!verified.reachable (ip))
+          continue;
+
+        auto kind = opcode_kind (code.opcodes[ip]);
+        if (kind == instruction_kind::jump)
+          starts[code.operands[ip]] = true;
+        else if (kind == instruction_kind::branch)
+          starts[branch_operand::unpack (code.operands[ip]).target] = true;
+      }
+
+    labels.assign (code.size (), 0);
+    // whether the instruction before runs into this one.
+    bool falls = false;
+
+    for (uint64_t ip = 0; ip < code.size (); ip++)
+      {
+        if (!verified.reachable (ip))
+          {
+            falls = false;
+            continue;
+          }
+
+        if (starts[ip])
+          {
+            if (falls)
+              flush ();
+            start_block (ip);
+          }
+
+        labels[ip] = static_cast<uint32_t> (out.code.size ());
+        falls = lower (ip);
+      }
+
+    for (auto at : fixups)
+      out.code[at].dst = labels[out.code[at].dst];
+
+    for (const auto &function : prog.functions)
+      out.entries.push_back (labels[function.entry]);
+
+    return std::move (out);
+  }
+};
+
+reg_program
+lower_program (const program &prog, const verification &verified)
+{
+  if (verified.depths.size () != prog.code.size ()
+      || verified.frame_sizes.size () != prog.functions.size ())
+    throw std::runtime_error ("Verification is not of this program.");
+
+  return register_lowering (prog, verified).lower_all ();
+}
+
+std::string_view
+reg_op_name (reg_op op)
+{
+  // in the same order as reg_op.
+  static constexpr std::string_view names[] = {
+    "mov",         "load_const",    "add",
+    "sub",         "mul",           "div",
+    "rem",         "add_k",         "sub_k",
+    "mul_k",       "div_k",         "rem_k",
+    "neg",         "conv",          "compare",
+    "compare_k",   "jump",          "jump_if",
+    "jump_unless", "branch_if",     "branch_if_k",
+    "branch_unless", "branch_unless_k", "call",
+    "host_call",   "ret",           "ret_void",
+    "swap",        "load_string",   "concat",
+  };
+  static_assert (sizeof (names) / sizeof (names[0]) == reg_op_count);
+
+  auto byte = static_cast<uint8_t> (op);
+  return byte < reg_op_count ? names[byte] : "invalid";
+}
+
+} // evm
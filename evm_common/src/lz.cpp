@@ -0,0 +1,207 @@
+#include <evm/lz.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace evm
+{
+
+/// the number of bits hashed into the match table.
+static constexpr int hash_bits = 14;
+/// matches do not start in the last bytes, so that a block ends in literals.
+static constexpr uint64_t end_literals = 5;
+
+static uint32_t
+load_u32 (const uint8_t *buffer)
+{
+  uint32_t value;
+  std::memcpy (&value, buffer, sizeof (value));
+  return value;
+}
+
+static uint32_t
+hash_u32 (uint32_t value)
+{
+  return (value * 2654435761u) >> (32 - hash_bits);
+}
+
+/**
+ * Saves the extension of a length whose nibble is full.
+ */
+static void
+save_length (std::vector<uint8_t> &output, uint64_t length)
+{
+  for (; length >= 255; length -= 255)
+    output.push_back (255);
+  output.push_back (static_cast<uint8_t> (length));
+}
+
+static void
+save_sequence (std::vector<uint8_t> &output, const uint8_t *literals,
+               uint64_t literal_count, uint64_t offset, uint64_t match)
+{
+  auto literal_nibble = std::min<uint64_t> (literal_count, 15);
+  auto match_nibble
+      = match > 0 ? std::min<uint64_t> (match - lz_min_match, 15) : 0;
+  output.push_back (static_cast<uint8_t> (literal_nibble << 4 | match_nibble));
+
+  if (literal_nibble == 15)
+    save_length (output, literal_count - 15);
+  output.insert (output.end (), literals, literals + literal_count);
+
+  if (match == 0)
+    return;
+
+  output.push_back (static_cast<uint8_t> (offset));
+  output.push_back (static_cast<uint8_t> (offset >> 8));
+  if (match_nibble == 15)
+    save_length (output, match - lz_min_match - 15);
+}
+
+std::vector<uint8_t>
+lz_compress (std::span<const uint8_t> input)
+{
+  std::vector<uint8_t> output;
+  output.reserve (lz_bound (input.size ()));
+
+  // the last position each hash was seen at, plus one.
+  std::vector<uint32_t> table (uint64_t (1) << hash_bits);
+  const auto *data = input.data ();
+  auto size = input.size ();
+
+  uint64_t anchor = 0;
+  uint64_t position = 0;
+
+  // positions are stored in 32 bits, so larger inputs are literals past that.
+  auto limit = std::min<uint64_t> (size, UINT32_MAX);
+
+  while (limit >= lz_min_match + end_literals
+         && position + lz_min_match + end_literals <= limit)
+    {
+      auto value = load_u32 (data + position);
+      auto &slot = table[hash_u32 (value)];
+      uint64_t candidate = slot;
+      slot = static_cast<uint32_t> (position + 1);
+
+      if (candidate == 0 || position - (candidate - 1) > lz_max_offset
+          || load_u32 (data + candidate - 1) != value)
+        {
+          position++;
+          continue;
+        }
+
+      candidate--;
+      auto match = lz_min_match;
+      while (position + match + end_literals < size
+             && data[candidate + match] == data[position + match])
+        match++;
+
+      save_sequence (output, data + anchor, position - anchor,
+                     position - candidate, match);
+
+      position += match;
+      anchor = position;
+    }
+
+  save_sequence (output, data + anchor, size - anchor, 0, 0);
+  return output;
+}
+
+[[noreturn]] static void
+malformed ()
+{
+  throw std::runtime_error ("Malformed compressed section.");
+}
+
+/**
+ * Loads the extension of a length whose nibble is full.
+ */
+static uint64_t
+load_length (const uint8_t *&input, const uint8_t *end)
+{
+  uint64_t length = 0;
+
+  for (;;)
+    {
+      if (input == end)
+        malformed ();
+
+      auto byte = *input++;
+      length += byte;
+      if (byte != 255)
+        return length;
+    }
+}
+
+void
+lz_decompress (std::span<const uint8_t> input, std::span<uint8_t> output)
+{
+  const auto *in = input.data ();
+  const auto *in_end = in + input.size ();
+  auto *out = output.data ();
+  auto *out_end = out + output.size ();
+
+  for (;;)
+    {
+      if (in == in_end)
+        malformed ();
+
+      auto token = *in++;
+
+      uint64_t literals = token >> 4;
+      if (literals == 15)
+        literals += load_length (in, in_end);
+
+      if (literals > uint64_t (in_end - in)
+          || literals > uint64_t (out_end - out))
+        malformed ();
+
+      // an empty output may have no buffer at all.
+      if (literals > 0)
+        std::memcpy (out, in, literals);
+      in += literals;
+      out += literals;
+
+      // the last sequence has no match.
+      if (in == in_end)
+        break;
+
+      if (in_end - in < 2)
+        malformed ();
+
+      uint64_t offset = in[0] | uint64_t (in[1]) << 8;
+      in += 2;
+
+      uint64_t match = (token & 15) + lz_min_match;
+      if ((token & 15) == 15)
+        match += load_length (in, in_end);
+
+      if (offset == 0 || offset > uint64_t (out - output.data ())
+          || match > uint64_t (out_end - out))
+        malformed ();
+
+      const auto *from = out - offset;
+
+      if (offset >= 8 && uint64_t (out_end - out) >= match + 8)
+        {
+          // 8 bytes at a time, which may write past the match into room
+          // that is written again later.
+          for (uint64_t i = 0; i < match; i += 8)
+            std::memcpy (out + i, from + i, 8);
+          out += match;
+        }
+      else
+        {
+          // an overlapping match repeats the bytes before it.
+          for (uint64_t i = 0; i < match; i++)
+            out[i] = from[i];
+          out += match;
+        }
+    }
+
+  if (out != out_end)
+    malformed ();
+}
+
+} // evm
@@ -0,0 +1,487 @@
+#include <evm/lz.h>
+#include <evm/module.h>
+#include <evm/serializer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace evm
+{
+
+/**
+ * Rounds @c offset up to the next section boundary.
+ */
+static uint64_t
+align_section (uint64_t offset)
+{
+  auto mask = module_section_alignment - 1;
+  return (offset + mask) & ~mask;
+}
+
+template <fixed_serializable T>
+static T
+load_field (const uint8_t *&buffer)
+{
+  auto value = serializer<T>::load (buffer);
+  buffer += serializer<T>::size;
+
+  return value;
+}
+
+template <fixed_serializable T>
+static void
+save_field (const T &value, uint8_t *&buffer)
+{
+  serializer<T>::save (value, buffer);
+  buffer += serializer<T>::size;
+}
+
+module_header
+module_header::load (const uint8_t *buffer)
+{
+  module_header header;
+  header.magic = load_field<uint32_t> (buffer);
+  header.version = load_field<uint16_t> (buffer);
+  header.flags = load_field<uint16_t> (buffer);
+  header.section_count = load_field<uint32_t> (buffer);
+
+  return header;
+}
+
+void
+module_header::save (const module_header &header, uint8_t *buffer)
+{
+  save_field (header.magic, buffer);
+  save_field (header.version, buffer);
+  save_field (header.flags, buffer);
+  save_field (header.section_count, buffer);
+  // reserved.
+  save_field<uint32_t> (0, buffer);
+}
+
+static uint64_t
+header_ld_size (const uint8_t *)
+{
+  return module_header::saved_size;
+}
+
+static uint64_t
+header_st_size (const module_header &)
+{
+  return module_header::saved_size;
+}
+
+ls_info<module_header>
+module_header::get_ls_info ()
+{
+  return ls_info<module_header>{ .load_size = header_ld_size,
+                                 .save_size = header_st_size,
+                                 .load = load,
+                                 .save = save };
+}
+
+section_entry
+section_entry::load (const uint8_t *buffer)
+{
+  section_entry entry;
+  entry.kind = load_field<section_kind> (buffer);
+  entry.flags = load_field<uint32_t> (buffer);
+  entry.offset = load_field<uint64_t> (buffer);
+  entry.size = load_field<uint64_t> (buffer);
+  entry.raw_size = load_field<uint64_t> (buffer);
+
+  return entry;
+}
+
+void
+section_entry::save (const section_entry &entry, uint8_t *buffer)
+{
+  save_field (entry.kind, buffer);
+  save_field (entry.flags, buffer);
+  save_field (entry.offset, buffer);
+  save_field (entry.size, buffer);
+  save_field (entry.raw_size, buffer);
+}
+
+static uint64_t
+entry_ld_size (const uint8_t *)
+{
+  return section_entry::saved_size;
+}
+
+static uint64_t
+entry_st_size (const section_entry &)
+{
+  return section_entry::saved_size;
+}
+
+ls_info<section_entry>
+section_entry::get_ls_info ()
+{
+  return ls_info<section_entry>{ .load_size = entry_ld_size,
+                                 .save_size = entry_st_size,
+                                 .load = load,
+                                 .save = save };
+}
+
+void
+module_writer::add_section (section_kind kind, std::span<const uint8_t> data,
+                            bool compress)
+{
+  if (compress)
+    {
+      auto compressed = lz_compress (data);
+
+      if (compressed.size () < data.size ())
+        {
+          m_sections.push_back (pending_section{
+              .kind = kind,
+              .flags = section_flag_compressed,
+              .raw_size = data.size (),
+              .data = std::move (compressed),
+          });
+          return;
+        }
+    }
+
+  m_sections.push_back (pending_section{
+      .kind = kind,
+      .flags = 0,
+      .raw_size = data.size (),
+      .data = std::vector<uint8_t> (data.begin (), data.end ()),
+  });
+}
+
+void
+module_writer::set_flags (uint16_t flags)
+{
+  m_flags = flags;
+}
+
+uint64_t
+module_writer::size () const
+{
+  uint64_t size = module_header::saved_size
+                  + m_sections.size () * section_entry::saved_size;
+
+  for (const auto &section : m_sections)
+    size = align_section (size) + section.data.size ();
+
+  return size;
+}
+
+void
+module_writer::write (uint8_t *buffer) const
+{
+  auto header = module_header{
+    .magic = module_magic,
+    .version = module_version,
+    .flags = m_flags,
+    .section_count = static_cast<uint32_t> (m_sections.size ()),
+  };
+  module_header::save (header, buffer);
+
+  uint64_t offset = module_header::saved_size
+                    + m_sections.size () * section_entry::saved_size;
+  auto *directory = buffer + module_header::saved_size;
+
+  for (const auto &section : m_sections)
+    {
+      auto aligned = align_section (offset);
+      // zero the padding, so that written modules are reproducible.
+      std::memset (buffer + offset, 0, aligned - offset);
+
+      auto entry = section_entry{
+        .kind = section.kind,
+        .flags = section.flags,
+        .offset = aligned,
+        .size = section.data.size (),
+        .raw_size = section.raw_size,
+      };
+      section_entry::save (entry, directory);
+      directory += section_entry::saved_size;
+
+      if (!section.data.empty ())
+        std::memcpy (buffer + aligned, section.data.data (),
+                     section.data.size ());
+      offset = aligned + section.data.size ();
+    }
+}
+
+std::vector<uint8_t>
+module_writer::write () const
+{
+  std::vector<uint8_t> buffer (size ());
+  write (buffer.data ());
+
+  return buffer;
+}
+
+void
+module_writer::write_file (const std::string &path) const
+{
+  auto buffer = write ();
+
+  std::ofstream file (path, std::ios::binary | std::ios::trunc);
+  file.write (reinterpret_cast<const char *> (buffer.data ()),
+              static_cast<std::streamsize> (buffer.size ()));
+
+  if (!file)
+    throw std::runtime_error ("Could not write module to " + path + ".");
+}
+
+void
+check_section_size (const section_entry &entry)
+{
+  if (entry.flags & ~section_known_flags)
+    throw std::runtime_error ("Module section has unsupported flags.");
+
+  bool compressed = entry.flags & section_flag_compressed;
+  // a block only expands so far, which bounds what a bad size can allocate.
+  if (compressed ? entry.raw_size / lz_max_ratio > entry.size
+                 : entry.raw_size != entry.size)
+    throw std::runtime_error ("Module section has an invalid size.");
+}
+
+/**
+ * The decompressed sections of a module, each decompressed once
+ * by whichever thread reads it first.
+ */
+struct module_view::inflated_sections
+{
+  explicit inflated_sections (uint64_t count)
+      : once (new std::once_flag[count]), data (count)
+  {
+  }
+
+  std::unique_ptr<std::once_flag[]> once;
+  std::vector<std::vector<uint8_t>> data;
+};
+
+module_view::module_view (std::span<const uint8_t> bytes) : m_bytes (bytes)
+{
+  if (bytes.size () < module_header::saved_size)
+    throw std::runtime_error ("Module is smaller than its header.");
+
+  m_header = module_header::load (bytes.data ());
+
+  if (m_header.magic != module_magic)
+    throw std::runtime_error ("Module has an invalid magic number.");
+  if (m_header.version != module_version)
+    throw std::runtime_error ("Module has an unsupported version.");
+  if (m_header.flags & ~module_known_flags)
+    throw std::runtime_error ("Module has unsupported flags.");
+
+  auto directory_end = module_header::saved_size
+                       + uint64_t (m_header.section_count)
+                             * section_entry::saved_size;
+  if (directory_end > bytes.size ())
+    throw std::runtime_error ("Module section directory is truncated.");
+
+  m_sections.reserve (m_header.section_count);
+  const auto *directory = bytes.data () + module_header::saved_size;
+
+  for (uint32_t i = 0; i < m_header.section_count; i++)
+    {
+      auto entry = section_entry::load (directory);
+      directory += section_entry::saved_size;
+
+      if (entry.offset % module_section_alignment != 0)
+        throw std::runtime_error ("Module section is not aligned.");
+      if (entry.offset < directory_end || entry.offset > bytes.size ()
+          || entry.size > bytes.size () - entry.offset)
+        throw std::runtime_error ("Module section is out of bounds.");
+      check_section_size (entry);
+
+      m_sections.push_back (entry);
+    }
+
+  auto compressed = [] (const section_entry &entry) {
+    return (entry.flags & section_flag_compressed) != 0;
+  };
+  if (std::any_of (m_sections.begin (), m_sections.end (), compressed))
+    m_inflated = std::make_shared<inflated_sections> (m_sections.size ());
+}
+
+const module_header &
+module_view::header () const
+{
+  return m_header;
+}
+
+const std::vector<section_entry> &
+module_view::sections () const
+{
+  return m_sections;
+}
+
+std::optional<std::span<const uint8_t>>
+module_view::section (section_kind kind) const
+{
+  for (uint64_t i = 0; i < m_sections.size (); i++)
+    if (m_sections[i].kind == kind)
+      return section_data (i);
+
+  return std::nullopt;
+}
+
+std::span<const uint8_t>
+module_view::section_data (uint64_t index) const
+{
+  const auto &entry = m_sections.at (index);
+  auto saved = m_bytes.subspan (entry.offset, entry.size);
+
+  if (!(entry.flags & section_flag_compressed))
+    return saved;
+
+  auto &data = m_inflated->data[index];
+  std::call_once (m_inflated->once[index], [&] {
+    std::vector<uint8_t> raw (entry.raw_size);
+    lz_decompress (saved, raw);
+    data = std::move (raw);
+  });
+
+  return data;
+}
+
+void
+module_view::prefetch (uint32_t threads) const
+{
+  if (!m_inflated)
+    return;
+
+  std::vector<uint64_t> pending;
+  for (uint64_t i = 0; i < m_sections.size (); i++)
+    if (m_sections[i].flags & section_flag_compressed)
+      pending.push_back (i);
+
+  if (threads == 0)
+    threads = std::max (std::thread::hardware_concurrency (), 1u);
+  threads = static_cast<uint32_t> (
+      std::min<uint64_t> (threads, pending.size ()));
+
+  std::atomic<uint64_t> next = 0;
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto work = [&] {
+    for (auto i = next++; i < pending.size (); i = next++)
+      try
+        {
+          section_data (pending[i]);
+        }
+      catch (...)
+        {
+          std::lock_guard lock (error_mutex);
+          if (!error)
+            error = std::current_exception ();
+        }
+  };
+
+  // this thread is one of the workers.
+  std::vector<std::thread> workers;
+  for (uint32_t i = 1; i < threads; i++)
+    workers.emplace_back (work);
+  work ();
+
+  for (auto &worker : workers)
+    worker.join ();
+
+  if (error)
+    std::rethrow_exception (error);
+}
+
+std::span<const uint8_t>
+module_view::bytes () const
+{
+  return m_bytes;
+}
+
+mapped_module::mapped_module (const std::string &path)
+{
+  int fd = ::open (path.c_str (), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error ("Could not open module " + path + ".");
+
+  struct stat info;
+  if (::fstat (fd, &info) != 0 || info.st_size == 0)
+    {
+      ::close (fd);
+      throw std::runtime_error ("Could not map module " + path + ".");
+    }
+
+  m_size = static_cast<uint64_t> (info.st_size);
+  m_address = ::mmap (nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps the file alive.
+  ::close (fd);
+
+  if (m_address == MAP_FAILED)
+    {
+      m_address = nullptr;
+      throw std::runtime_error ("Could not map module " + path + ".");
+    }
+
+  try
+    {
+      m_view = module_view (std::span<const uint8_t> (
+          static_cast<const uint8_t *> (m_address), m_size));
+    }
+  catch (...)
+    {
+      unmap ();
+      throw;
+    }
+}
+
+mapped_module::~mapped_module () { unmap (); }
+
+mapped_module::mapped_module (mapped_module &&other) noexcept
+    : m_address (std::exchange (other.m_address, nullptr)),
+      m_size (std::exchange (other.m_size, 0)),
+      m_view (std::move (other.m_view))
+{
+}
+
+mapped_module &
+mapped_module::operator= (mapped_module &&other) noexcept
+{
+  if (this != &other)
+    {
+      unmap ();
+      m_address = std::exchange (other.m_address, nullptr);
+      m_size = std::exchange (other.m_size, 0);
+      m_view = std::move (other.m_view);
+    }
+
+  return *this;
+}
+
+const module_view &
+mapped_module::view () const
+{
+  return m_view;
+}
+
+void
+mapped_module::unmap ()
+{
+  if (m_address != nullptr)
+    ::munmap (m_address, m_size);
+
+  m_address = nullptr;
+  m_size = 0;
+}
+
+} // evm
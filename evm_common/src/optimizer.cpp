@@ -0,0 +1,292 @@
+#include <evm/decode.h>
+#include <evm/optimizer.h>
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+
+namespace evm
+{
+
+uint64_t
+opcode_pair_counts::total () const
+{
+  return std::accumulate (counts.begin (), counts.end (), uint64_t (0));
+}
+
+static std::vector<fusion_rule>
+all_rules ()
+{
+  std::vector<fusion_rule> rules;
+
+  // longest first, so that they win over shorter rules.
+  for (auto compare : { opcode::eq, opcode::ne, opcode::lt, opcode::le,
+                        opcode::gt, opcode::ge })
+    for (auto jump : { opcode::jump_if, opcode::jump_unless })
+      {
+        rules.push_back (fusion_rule{
+            .pattern = { opcode::load_local, compare, jump },
+            .fused = opcode::branch_local,
+        });
+        rules.push_back (fusion_rule{
+            .pattern = { opcode::load_const, compare, jump },
+            .fused = opcode::branch_const,
+        });
+      }
+
+  rules.push_back (fusion_rule{ .pattern = { opcode::load_const, opcode::add },
+                                .fused = opcode::add_const });
+  rules.push_back (fusion_rule{ .pattern = { opcode::load_const, opcode::sub },
+                                .fused = opcode::sub_const });
+
+  return rules;
+}
+
+fusion_table
+fusion_table::all ()
+{
+  fusion_table table;
+  table.m_rules = all_rules ();
+
+  return table;
+}
+
+fusion_table
+fusion_table::none ()
+{
+  return fusion_table ();
+}
+
+fusion_table
+fusion_table::from_profile (const opcode_pair_counts &pairs, double min_share)
+{
+  fusion_table table;
+  auto threshold = min_share * static_cast<double> (pairs.total ());
+
+  for (auto &rule : all_rules ())
+    {
+      bool hot = true;
+
+      for (uint64_t i = 0; i + 1 < rule.pattern.size (); i++)
+        {
+          auto count = pairs (rule.pattern[i], rule.pattern[i + 1]);
+          if (count == 0 || static_cast<double> (count) < threshold)
+            hot = false;
+        }
+
+      if (hot)
+        table.m_rules.push_back (std::move (rule));
+    }
+
+  return table;
+}
+
+const std::vector<fusion_rule> &
+fusion_table::rules () const
+{
+  return m_rules;
+}
+
+bool
+fusion_table::uses (opcode fused) const
+{
+  return std::any_of (m_rules.begin (), m_rules.end (),
+                      [fused] (const auto &rule) {
+                        return rule.fused == fused;
+                      });
+}
+
+/**
+ * Moves jump targets and function entries to where their instructions went.
+ * @c remap has an entry for every old instruction, and one past the end.
+ */
+static void
+retarget (program &prog, const std::vector<uint32_t> &remap)
+{
+  auto &code = prog.code;
+
+  for (uint64_t i = 0; i < code.size (); i++)
+    {
+      auto kind = opcode_kind (code.opcodes[i]);
+
+      if (kind == instruction_kind::jump)
+        code.operands[i] = remap[code.operands[i]];
+      else if (kind == instruction_kind::branch)
+        {
+          auto branch = branch_operand::unpack (code.operands[i]);
+          branch.target = remap[branch.target];
+          code.operands[i] = branch.pack ();
+        }
+    }
+
+  for (auto &function : prog.functions)
+    function.entry = remap[function.entry];
+}
+
+static void
+resize_code (decoded_code &code, uint64_t size)
+{
+  code.opcodes.resize (size);
+  code.operands.resize (size);
+  code.offsets.resize (size);
+}
+
+/**
+ * Removes every @c opcode::nop, jumps to one go to the instruction after it.
+ */
+static void
+drop_nops (program &prog)
+{
+  auto &code = prog.code;
+  std::vector<uint32_t> remap (code.size () + 1);
+  uint32_t out = 0;
+
+  for (uint64_t ip = 0; ip < code.size (); ip++)
+    {
+      remap[ip] = out;
+      if (code.opcodes[ip] == opcode::nop)
+        continue;
+
+      code.opcodes[out] = code.opcodes[ip];
+      code.operands[out] = code.operands[ip];
+      code.offsets[out] = code.offsets[ip];
+      out++;
+    }
+
+  remap[code.size ()] = out;
+  resize_code (code, out);
+  retarget (prog, remap);
+}
+
+/**
+ * Whether each instruction is a jump target or function entry.
+ */
+static std::vector<bool>
+find_targets (const program &prog)
+{
+  const auto &code = prog.code;
+  std::vector<bool> targets (code.size () + 1);
+
+  for (uint64_t i = 0; i < code.size (); i++)
+    {
+      auto kind = opcode_kind (code.opcodes[i]);
+
+      if (kind == instruction_kind::jump)
+        targets[code.operands[i]] = true;
+      else if (kind == instruction_kind::branch)
+        targets[branch_operand::unpack (code.operands[i]).target] = true;
+    }
+
+  for (const auto &function : prog.functions)
+    targets[function.entry] = true;
+
+  return targets;
+}
+
+static bool
+matches (const decoded_code &code, uint64_t ip, const fusion_rule &rule,
+         const std::vector<bool> &targets)
+{
+  if (rule.pattern.size () > code.size () - ip)
+    return false;
+
+  for (uint64_t i = 0; i < rule.pattern.size (); i++)
+    {
+      if (code.opcodes[ip + i] != rule.pattern[i])
+        return false;
+      // nothing may jump into the middle of a superinstruction.
+      if (i > 0 && targets[ip + i])
+        return false;
+    }
+
+  return true;
+}
+
+/**
+ * The operand of the superinstruction that fuses the instructions at @c ip,
+ * if they can be fused.
+ */
+static std::optional<uint64_t>
+fused_operand (const decoded_code &code, uint64_t ip, opcode fused)
+{
+  switch (fused)
+    {
+    case opcode::add_const:
+    case opcode::sub_const:
+      return code.operands[ip];
+
+    case opcode::branch_local:
+    case opcode::branch_const:
+      if (code.operands[ip] > UINT16_MAX)
+        return std::nullopt;
+
+      return branch_operand{
+        .target = static_cast<uint32_t> (code.operands[ip + 2]),
+        .value = static_cast<uint16_t> (code.operands[ip]),
+        .compare = code.opcodes[ip + 1],
+        .jump = code.opcodes[ip + 2],
+      }
+          .pack ();
+
+    default:
+      return std::nullopt;
+    }
+}
+
+static void
+fuse (program &prog, const fusion_table &table)
+{
+  auto &code = prog.code;
+  auto targets = find_targets (prog);
+
+  std::vector<uint32_t> remap (code.size () + 1);
+  uint32_t out = 0;
+  uint64_t ip = 0;
+
+  while (ip < code.size ())
+    {
+      auto op = code.opcodes[ip];
+      auto operand = code.operands[ip];
+      uint64_t length = 1;
+
+      for (const auto &rule : table.rules ())
+        {
+          if (!matches (code, ip, rule, targets))
+            continue;
+
+          auto fused = fused_operand (code, ip, rule.fused);
+          if (!fused)
+            continue;
+
+          op = rule.fused;
+          operand = *fused;
+          length = rule.pattern.size ();
+          break;
+        }
+
+      for (uint64_t i = 0; i < length; i++)
+        remap[ip + i] = out;
+
+      // out never passes ip, so this does not clobber unread instructions.
+      code.opcodes[out] = op;
+      code.operands[out] = operand;
+      code.offsets[out] = code.offsets[ip];
+      out++;
+      ip += length;
+    }
+
+  remap[code.size ()] = out;
+  resize_code (code, out);
+  retarget (prog, remap);
+}
+
+void
+optimize_program (program &prog, const fusion_table &table)
+{
+  drop_nops (prog);
+
+  if (!table.rules ().empty ())
+    fuse (prog, table);
+}
+
+} // evm
@@ -1,7 +1,8 @@
 #include <evm/primitive.h>
 
-#include <evm/loading.h>
+#include <evm/serializer.h>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 
 namespace evm
@@ -40,6 +41,25 @@ make_primitive (primitive_value_t<TYPE> value)
   return primitive_value (idx, value);
 }
 
+primitive_value
+default_primitive (primitive_type type)
+{
+#define CASE_OF(T)                                                            \
+  case T:                                                                     \
+    return make_primitive<T> (0)
+
+  switch (type)
+    {
+      INSTANCE_MACRO (CASE_OF);
+    case REF_TYPE:
+      return make_primitive<REF_TYPE> (heap_ref{ 0 });
+    default:
+      throw std::runtime_error ("Invalid Type Specifier.");
+    }
+
+#undef CASE_OF
+}
+
 primitive_type
 primitive_get_type (primitive_value value)
 {
@@ -50,12 +70,9 @@ template <primitive_type TYPE>
 static primitive_value
 load_primitive_raw (const uint8_t *buffer)
 {
-  // load info.
-  auto val_ls_info = value_ls_info<primitive_value_t<TYPE>> ();
-  // load value.
-  auto val = val_ls_info.load (buffer);
+  auto val = serializer<primitive_value_t<TYPE>>::load (buffer);
 
-  return primitive_value (val);
+  return make_primitive<TYPE> (val);
 }
 
 static primitive_type
@@ -101,6 +118,8 @@ void
 save_primitive (const primitive_value &value, uint8_t *buffer, bool fat)
 {
   auto type = primitive_get_type (value);
+  if (type == REF_TYPE)
+    throw std::runtime_error ("References can not be saved.");
 
   // save type info if fat.
   if (fat)
@@ -111,8 +130,8 @@ save_primitive (const primitive_value &value, uint8_t *buffer, bool fat)
 
   // Function to save value.
   auto save_value = [buffer] (auto v) {
-    auto info = value_ls_info<typeof (v)> ();
-    info.save (v, buffer);
+    if constexpr (!std::is_same_v<decltype (v), heap_ref>)
+      serializer<decltype (v)>::save (v, buffer);
   };
 
   std::visit (save_value, value);
@@ -168,6 +187,7 @@ primitive_type_name (primitive_type t)
   switch (t)
     {
       INSTANCE_MACRO (CASE_OF);
+      CASE_OF (REF_TYPE);
     default:
       return "";
     }
@@ -186,4 +206,5 @@ primitive_type_name (primitive_type t)
 
 // Instance generic functions for all values of primitive_type
 INSTANCE_MACRO (PRIM_INST);
+PRIM_INST (REF_TYPE);
 }
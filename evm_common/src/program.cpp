@@ -0,0 +1,190 @@
+#include <evm/cursor.h>
+#include <evm/program.h>
+#include <evm/serializer.h>
+
+#include <stdexcept>
+
+namespace evm
+{
+
+/// the size of a function before its local types.
+static constexpr uint64_t function_fixed_size = 10;
+
+function_info
+function_info::load (const uint8_t *buffer)
+{
+  function_info info;
+  info.entry = serializer<uint32_t>::load (buffer);
+  info.arg_count = serializer<uint16_t>::load (buffer + 4);
+  auto local_count = serializer<uint16_t>::load (buffer + 6);
+
+  if (buffer[8] != 0)
+    info.result = static_cast<primitive_type> (buffer[9]);
+
+  buffer += function_fixed_size;
+  info.locals.reserve (local_count);
+
+  for (uint16_t i = 0; i < local_count; i++)
+    info.locals.push_back (static_cast<primitive_type> (buffer[i]));
+
+  return info;
+}
+
+void
+function_info::save (const function_info &info, uint8_t *buffer)
+{
+  serializer<uint32_t>::save (info.entry, buffer);
+  serializer<uint16_t>::save (info.arg_count, buffer + 4);
+  serializer<uint16_t>::save (
+      static_cast<uint16_t> (info.locals.size ()), buffer + 6);
+  buffer[8] = info.result.has_value ();
+  buffer[9] = info.result.value_or (I8_TYPE);
+
+  buffer += function_fixed_size;
+
+  for (auto type : info.locals)
+    *buffer++ = static_cast<uint8_t> (type);
+}
+
+static uint64_t
+function_ld_size (const uint8_t *buffer)
+{
+  return function_fixed_size + serializer<uint16_t>::load (buffer + 6);
+}
+
+static uint64_t
+function_st_size (const function_info &info)
+{
+  return function_fixed_size + info.locals.size ();
+}
+
+ls_info<function_info>
+function_info::get_ls_info ()
+{
+  return ls_info<function_info>{ .load_size = function_ld_size,
+                                 .save_size = function_st_size,
+                                 .load = load,
+                                 .save = save };
+}
+
+uint64_t
+string_table::size () const
+{
+  return ends.size ();
+}
+
+std::string_view
+string_table::operator[] (uint64_t index) const
+{
+  auto begin = index == 0 ? 0 : ends[index - 1];
+  return std::string_view (chars).substr (begin, ends[index] - begin);
+}
+
+void
+string_table::push_back (std::string_view value)
+{
+  chars.append (value);
+  ends.push_back (chars.size ());
+}
+
+static std::vector<primitive_value>
+load_constants (std::span<const uint8_t> section, bool compact)
+{
+  std::vector<primitive_value> constants;
+  byte_reader reader (section);
+
+  try
+    {
+      while (!reader.at_end ())
+        constants.push_back (compact ? reader.read_compact_primitive ()
+                                     : reader.read_primitive ());
+    }
+  catch (const std::out_of_range &)
+    {
+      throw std::runtime_error ("Truncated constant.");
+    }
+
+  return constants;
+}
+
+static string_table
+load_strings (std::span<const uint8_t> section, bool compact)
+{
+  string_table strings;
+  byte_reader reader (section);
+
+  try
+    {
+      while (!reader.at_end ())
+        strings.push_back (compact ? reader.read_compact_string ()
+                                   : reader.read<std::string_view> ());
+    }
+  catch (const std::out_of_range &)
+    {
+      throw std::runtime_error ("Truncated string.");
+    }
+
+  return strings;
+}
+
+void
+resolve_function (function_info &function, const decoded_code &code)
+{
+  if (function.arg_count > function.locals.size ())
+    throw std::runtime_error ("Function has more arguments than locals.");
+
+  auto entry = code.index_of (function.entry);
+  if (!entry)
+    throw std::runtime_error ("Function entry is not an instruction.");
+
+  function.entry = *entry;
+}
+
+static std::vector<function_info>
+load_functions (std::span<const uint8_t> section, const decoded_code &code)
+{
+  auto info = function_info::get_ls_info ();
+  std::vector<function_info> functions;
+  uint64_t offset = 0;
+
+  while (offset < section.size ())
+    {
+      const auto *data = section.data () + offset;
+
+      if (section.size () - offset < function_fixed_size
+          || info.load_size (data) > section.size () - offset)
+        throw std::runtime_error ("Truncated function.");
+
+      auto function = info.load (data);
+      offset += info.load_size (data);
+
+      resolve_function (function, code);
+      functions.push_back (std::move (function));
+    }
+
+  return functions;
+}
+
+program
+load_program (const module_view &module)
+{
+  auto code = module.section (section_kind::code);
+  if (!code)
+    throw std::runtime_error ("Module has no code section.");
+
+  bool compact = module.header ().flags & module_flag_compact;
+
+  program prog;
+  prog.code = decode_code (*code, compact);
+
+  if (auto constants = module.section (section_kind::constants))
+    prog.constants = load_constants (*constants, compact);
+  if (auto functions = module.section (section_kind::functions))
+    prog.functions = load_functions (*functions, prog.code);
+  if (auto strings = module.section (section_kind::strings))
+    prog.strings = load_strings (*strings, compact);
+
+  return prog;
+}
+
+} // evm
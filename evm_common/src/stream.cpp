@@ -0,0 +1,571 @@
+#include <evm/cursor.h>
+#include <evm/decode.h>
+#include <evm/lz.h>
+#include <evm/serializer.h>
+#include <evm/stream.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <utility>
+
+#include <unistd.h>
+
+namespace evm
+{
+
+/// the size of a function before its local types.
+static constexpr uint64_t function_fixed_size = 10;
+
+/**
+ * The bytes needed to know the size of a value in a section.
+ */
+static uint64_t
+item_prefix (section_kind kind)
+{
+  switch (kind)
+    {
+    case section_kind::code:
+      return sizeof (opcode);
+    case section_kind::constants:
+      return sizeof (primitive_type);
+    case section_kind::strings:
+      return sizeof (uint64_t);
+    case section_kind::functions:
+      return function_fixed_size;
+    }
+  return 0;
+}
+
+static const char *
+truncated_message (section_kind kind)
+{
+  switch (kind)
+    {
+    case section_kind::code:
+      return "Truncated instruction.";
+    case section_kind::constants:
+      return "Truncated constant.";
+    case section_kind::strings:
+      return "Truncated string.";
+    case section_kind::functions:
+      return "Truncated function.";
+    }
+  return "Truncated section.";
+}
+
+static bool
+known_kind (section_kind kind)
+{
+  return kind <= section_kind::functions;
+}
+
+/**
+ * The size of the value starting with @c prefix, which holds
+ * @c item_prefix bytes, or more than @c left if it does not fit.
+ */
+static uint64_t
+item_size (section_kind kind, const uint8_t *prefix, uint64_t left)
+{
+  switch (kind)
+    {
+    case section_kind::code:
+      if (!opcode_valid (*prefix))
+        throw std::runtime_error ("Invalid opcode.");
+      return sizeof (opcode)
+             + instruction_args::size (opcode_kind (load_opcode (prefix)));
+
+    case section_kind::constants:
+      return primitive_load_size (prefix);
+
+    case section_kind::strings:
+      {
+        auto length = serializer<uint64_t>::load (prefix);
+        // without overflowing.
+        if (length > left - sizeof (uint64_t))
+          return left + 1;
+        return sizeof (uint64_t) + length;
+      }
+
+    case section_kind::functions:
+      return function_info::get_ls_info ().load_size (prefix);
+    }
+  return 0;
+}
+
+module_stream::module_stream (stream_sink &sink) : m_sink (sink) {}
+
+void
+module_stream::feed (std::span<const uint8_t> bytes)
+{
+  for (;;)
+    switch (m_state)
+      {
+      case state::header:
+        {
+          const auto *data = peek (bytes, module_header::saved_size);
+          if (!data)
+            return;
+
+          m_header = module_header::load (data);
+          if (m_header.magic != module_magic)
+            throw std::runtime_error ("Module has an invalid magic number.");
+          if (m_header.version != module_version)
+            throw std::runtime_error ("Module has an unsupported version.");
+          if (m_header.flags & ~module_known_flags)
+            throw std::runtime_error ("Module has unsupported flags.");
+
+          consume (bytes, module_header::saved_size);
+          m_state = state::directory;
+          break;
+        }
+
+      case state::directory:
+        {
+          auto size
+              = uint64_t (m_header.section_count) * section_entry::saved_size;
+          const auto *data = size > 0 ? peek (bytes, size) : nullptr;
+          if (size > 0 && !data)
+            return;
+
+          auto directory_end = module_header::saved_size + size;
+          std::vector<section_entry> directory;
+          directory.reserve (m_header.section_count);
+
+          for (uint32_t i = 0; i < m_header.section_count; i++)
+            {
+              auto entry = section_entry::load (
+                  data + uint64_t (i) * section_entry::saved_size);
+
+              if (entry.offset % module_section_alignment != 0)
+                throw std::runtime_error ("Module section is not aligned.");
+              if (entry.offset < directory_end
+                  || entry.size > UINT64_MAX - entry.offset)
+                throw std::runtime_error ("Module section is out of bounds.");
+              check_section_size (entry);
+
+              directory.push_back (entry);
+            }
+
+          if (size > 0)
+            consume (bytes, size);
+
+          m_sections = directory;
+          std::stable_sort (m_sections.begin (), m_sections.end (),
+                            [] (const auto &a, const auto &b) {
+                              return a.offset < b.offset;
+                            });
+
+          // every byte is read once, so sections cannot share any.
+          for (uint64_t i = 1; i < m_sections.size (); i++)
+            if (m_sections[i].offset
+                < m_sections[i - 1].offset + m_sections[i - 1].size)
+              throw std::runtime_error ("Module sections overlap.");
+
+          m_sink.on_header (m_header, directory);
+          next_section ();
+          break;
+        }
+
+      case state::gap:
+        {
+          const auto &entry = m_sections[m_next];
+          auto skip = std::min<uint64_t> (entry.offset - m_offset,
+                                          bytes.size ());
+
+          bytes = bytes.subspan (skip);
+          m_offset += skip;
+          if (m_offset < entry.offset)
+            return;
+
+          m_decoding = known_kind (entry.kind) && m_sink.on_section (entry);
+          m_position = 0;
+          m_state = state::section;
+          break;
+        }
+
+      case state::section:
+        {
+          const auto &entry = m_sections[m_next];
+          auto end = entry.offset + entry.size;
+
+          if (m_offset == end)
+            {
+              if (m_decoding)
+                m_sink.on_section_end (entry);
+
+              m_next++;
+              next_section ();
+              break;
+            }
+
+          if (!m_decoding)
+            {
+              auto skip = std::min<uint64_t> (end - m_offset, bytes.size ());
+
+              bytes = bytes.subspan (skip);
+              m_offset += skip;
+              if (m_offset < end)
+                return;
+              break;
+            }
+
+          bool compact = m_header.flags & module_flag_compact;
+
+          if (entry.flags & section_flag_compressed)
+            {
+              const auto *data = peek (bytes, entry.size);
+              if (!data)
+                return;
+
+              std::vector<uint8_t> raw (entry.raw_size);
+              lz_decompress (std::span (data, entry.size), raw);
+              consume (bytes, entry.size);
+
+              // every value is there, so each one is decoded in one go.
+              std::span<const uint8_t> rest = raw;
+              m_position = 0;
+              m_inflating = true;
+
+              while (m_position < entry.raw_size)
+                if (!(compact ? decode_compact_item (rest)
+                              : decode_item (rest)))
+                  throw std::runtime_error (truncated_message (entry.kind));
+
+              m_inflating = false;
+              break;
+            }
+
+          if (!(compact ? decode_compact_item (bytes) : decode_item (bytes)))
+            return;
+          break;
+        }
+
+      case state::end:
+        // anything after the last section is not part of any.
+        m_offset += bytes.size ();
+        return;
+      }
+}
+
+void
+module_stream::finish ()
+{
+  if (m_state != state::end)
+    throw std::runtime_error ("Module is truncated.");
+}
+
+bool
+module_stream::done () const
+{
+  return m_state == state::end;
+}
+
+uint64_t
+module_stream::offset () const
+{
+  return m_offset + m_pending.size ();
+}
+
+/**
+ * The next @c count bytes in one piece, from @c bytes if they are all there,
+ * or gathered into the pending buffer otherwise.
+ * Returns @c nullptr, having gathered what there is, if they are not there.
+ */
+const uint8_t *
+module_stream::peek (std::span<const uint8_t> &bytes, uint64_t count)
+{
+  if (m_pending.empty () && bytes.size () >= count)
+    return bytes.data ();
+  if (m_pending.size () >= count)
+    return m_pending.data ();
+
+  auto take = std::min<uint64_t> (count - m_pending.size (), bytes.size ());
+  m_pending.insert (m_pending.end (), bytes.begin (), bytes.begin () + take);
+  bytes = bytes.subspan (take);
+
+  return m_pending.size () == count ? m_pending.data () : nullptr;
+}
+
+/**
+ * Moves past @c count bytes that were peeked.
+ */
+void
+module_stream::consume (std::span<const uint8_t> &bytes, uint64_t count)
+{
+  if (m_pending.empty ())
+    bytes = bytes.subspan (count);
+  else
+    // more may have been peeked than the value took.
+    m_pending.erase (m_pending.begin (), m_pending.begin () + count);
+
+  m_position += count;
+  if (!m_inflating)
+    m_offset += count;
+}
+
+void
+module_stream::next_section ()
+{
+  m_state = m_next < m_sections.size () ? state::gap : state::end;
+}
+
+/**
+ * Decodes the next value of the current section.
+ * Returns @c false if it is not all there yet.
+ */
+bool
+module_stream::decode_item (std::span<const uint8_t> &bytes)
+{
+  const auto &entry = m_sections[m_next];
+  auto left = entry.raw_size - m_position;
+  auto prefix = item_prefix (entry.kind);
+
+  if (prefix > left)
+    throw std::runtime_error (truncated_message (entry.kind));
+
+  const auto *data = peek (bytes, prefix);
+  if (!data)
+    return false;
+
+  auto size = item_size (entry.kind, data, left);
+  if (size > left)
+    throw std::runtime_error (truncated_message (entry.kind));
+
+  data = peek (bytes, size);
+  if (!data)
+    return false;
+
+  switch (entry.kind)
+    {
+    case section_kind::code:
+      m_sink.on_instruction (
+          static_cast<uint32_t> (m_position),
+          instruction::load (data));
+      break;
+    case section_kind::constants:
+      m_sink.on_constant (load_primitive (data));
+      break;
+    case section_kind::strings:
+      m_sink.on_string (value_ls_info<std::string_view> ().load (data));
+      break;
+    case section_kind::functions:
+      m_sink.on_function (function_info::load (data));
+      break;
+    }
+
+  consume (bytes, size);
+  return true;
+}
+
+/**
+ * The most bytes a value in the compact encoding takes,
+ * or needs to know its size.
+ */
+static uint64_t
+compact_prefix (section_kind kind)
+{
+  switch (kind)
+    {
+    case section_kind::code:
+      // the opcode, two operands, and the comparison and jump of a branch.
+      return sizeof (opcode) + 2 * max_leb128_size + 2 * sizeof (opcode);
+    case section_kind::constants:
+      return sizeof (primitive_type) + max_leb128_size;
+    case section_kind::strings:
+      return max_leb128_size;
+    case section_kind::functions:
+      return function_fixed_size;
+    }
+  return 0;
+}
+
+/**
+ * Decodes the next value of the current section in the compact encoding.
+ * Values are not all the same size, so enough is peeked for the largest,
+ * or up to the end of the section.
+ */
+bool
+module_stream::decode_compact_item (std::span<const uint8_t> &bytes)
+{
+  const auto &entry = m_sections[m_next];
+  if (entry.kind == section_kind::functions)
+    return decode_item (bytes);
+
+  auto left = entry.raw_size - m_position;
+  auto prefix = std::min (compact_prefix (entry.kind), left);
+
+  const auto *data = peek (bytes, prefix);
+  if (!data)
+    return false;
+
+  byte_reader reader (std::span<const uint8_t> (data, prefix));
+  uint64_t size;
+
+  try
+    {
+      switch (entry.kind)
+        {
+        case section_kind::code:
+          m_sink.on_instruction (
+              static_cast<uint32_t> (m_position),
+              reader.read_compact_instruction ());
+          size = reader.offset ();
+          break;
+
+        case section_kind::constants:
+          m_sink.on_constant (reader.read_compact_primitive ());
+          size = reader.offset ();
+          break;
+
+        case section_kind::strings:
+          {
+            auto length = reader.read_uleb128 ();
+            if (length > left - reader.offset ())
+              throw std::out_of_range ("Read past the end of the section.");
+
+            size = reader.offset () + length;
+            data = peek (bytes, size);
+            if (!data)
+              return false;
+
+            m_sink.on_string (std::string_view (
+                reinterpret_cast<const char *> (data + reader.offset ()),
+                length));
+            break;
+          }
+
+        default:
+          size = 0;
+          break;
+        }
+    }
+  catch (const std::out_of_range &)
+    {
+      throw std::runtime_error (truncated_message (entry.kind));
+    }
+
+  consume (bytes, size);
+  return true;
+}
+
+bool
+program_builder::on_section (const section_entry &entry)
+{
+  if (std::find (m_seen.begin (), m_seen.end (), entry.kind)
+      != m_seen.end ())
+    return false;
+
+  m_seen.push_back (entry.kind);
+  return true;
+}
+
+void
+program_builder::on_instruction (uint32_t offset, const instruction &instr)
+{
+  auto &code = m_program.code;
+
+  code.opcodes.push_back (instr.code);
+  code.operands.push_back (
+      instruction_operand (opcode_kind (instr.code), instr.args));
+  code.offsets.push_back (offset);
+}
+
+void
+program_builder::on_constant (const primitive_value &value)
+{
+  m_program.constants.push_back (value);
+}
+
+void
+program_builder::on_string (std::string_view value)
+{
+  m_program.strings.push_back (value);
+}
+
+void
+program_builder::on_function (const function_info &info)
+{
+  m_program.functions.push_back (info);
+}
+
+program
+program_builder::take ()
+{
+  if (std::find (m_seen.begin (), m_seen.end (), section_kind::code)
+      == m_seen.end ())
+    throw std::runtime_error ("Module has no code section.");
+
+  resolve_jumps (m_program.code);
+  for (auto &function : m_program.functions)
+    resolve_function (function, m_program.code);
+
+  m_seen.clear ();
+  return std::exchange (m_program, program ());
+}
+
+void
+pump_stream (std::istream &in, module_stream &stream, uint64_t chunk_size)
+{
+  std::vector<char> buffer (std::max<uint64_t> (chunk_size, 1));
+
+  while (in)
+    {
+      in.read (buffer.data (), static_cast<std::streamsize> (buffer.size ()));
+      auto count = static_cast<uint64_t> (in.gcount ());
+
+      if (count > 0)
+        stream.feed (std::span<const uint8_t> (
+            reinterpret_cast<const uint8_t *> (buffer.data ()), count));
+    }
+
+  if (in.bad ())
+    throw std::runtime_error ("Could not read module.");
+
+  stream.finish ();
+}
+
+void
+pump_stream (int fd, module_stream &stream, uint64_t chunk_size)
+{
+  std::vector<uint8_t> buffer (std::max<uint64_t> (chunk_size, 1));
+
+  for (;;)
+    {
+      auto count = ::read (fd, buffer.data (), buffer.size ());
+
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count < 0)
+        throw std::runtime_error ("Could not read module.");
+      if (count == 0)
+        break;
+
+      stream.feed (std::span<const uint8_t> (buffer.data (),
+                                             static_cast<uint64_t> (count)));
+    }
+
+  stream.finish ();
+}
+
+program
+stream_program (std::istream &in)
+{
+  program_builder builder;
+  module_stream stream (builder);
+  pump_stream (in, stream);
+
+  return builder.take ();
+}
+
+program
+stream_program (int fd)
+{
+  program_builder builder;
+  module_stream stream (builder);
+  pump_stream (fd, stream);
+
+  return builder.take ();
+}
+
+} // evm
@@ -0,0 +1,28 @@
+#include <evm/tagged.h>
+
+namespace evm
+{
+
+value_slot
+to_slot (const primitive_value &value)
+{
+  if (const auto *ref = std::get_if<heap_ref> (&value))
+    return ref->address;
+
+  return visit_type (primitive_get_type (value), [&value] (auto type) {
+    return to_slot<type ()> (std::get<type ()> (value));
+  });
+}
+
+primitive_value
+from_slot (value_slot slot, primitive_type type)
+{
+  if (type == REF_TYPE)
+    return make_primitive<REF_TYPE> (heap_ref{ slot });
+
+  return visit_type (type, [slot] (auto type) {
+    return make_primitive<type ()> (from_slot<type ()> (slot));
+  });
+}
+
+} // evm
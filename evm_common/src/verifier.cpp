@@ -0,0 +1,385 @@
+#include <evm/tagged.h>
+#include <evm/verifier.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace evm
+{
+
+/// the types on the operand stack, bottom first.
+using stack_state = std::vector<primitive_type>;
+
+[[noreturn]] static void
+fail (uint64_t ip, const char *message)
+{
+  throw std::runtime_error ("Instruction " + std::to_string (ip) + ": "
+                            + message);
+}
+
+[[noreturn]] static void
+fail_function (uint64_t function, const char *message)
+{
+  throw std::runtime_error ("Function " + std::to_string (function) + ": "
+                            + message);
+}
+
+static void
+require (const stack_state &stack, uint64_t count, uint64_t ip)
+{
+  if (stack.size () < count)
+    fail (ip, "Operand stack underflow.");
+}
+
+/**
+ * Pops the two operands of a binary instruction, and returns their type.
+ */
+static primitive_type
+pop_operands (stack_state &stack, uint64_t ip)
+{
+  require (stack, 2, ip);
+  auto type = stack.back ();
+
+  if (stack[stack.size () - 2] != type)
+    fail (ip, "Operands have different types.");
+
+  stack.resize (stack.size () - 2);
+  return type;
+}
+
+/**
+ * Checks the type of the operands of arithmetic or a comparison.
+ */
+static primitive_type
+require_numbers (primitive_type type, uint64_t ip)
+{
+  if (!is_number_type (type))
+    fail (ip, "Operands are not numbers.");
+
+  return type;
+}
+
+/**
+ * Pops the arguments of a call, the last argument is on top.
+ */
+static void
+pop_arguments (stack_state &stack, std::span<const primitive_type> args,
+               uint64_t ip)
+{
+  require (stack, args.size (), ip);
+  auto first = stack.size () - args.size ();
+
+  for (uint64_t i = 0; i < args.size (); i++)
+    if (stack[first + i] != args[i])
+      fail (ip, "Argument does not match its type.");
+
+  stack.resize (first);
+}
+
+static bool
+valid_type (primitive_type type)
+{
+  return type <= REF_TYPE;
+}
+
+static void
+check_function (const function_info &info, uint64_t function,
+                uint64_t code_size)
+{
+  if (info.entry >= code_size)
+    fail_function (function, "Entry is not an instruction.");
+  if (info.arg_count > info.locals.size ())
+    fail_function (function, "More arguments than local variables.");
+  if (!std::all_of (info.locals.begin (), info.locals.end (), valid_type)
+      || (info.result && !valid_type (*info.result)))
+    fail_function (function, "Invalid Type Specifier.");
+}
+
+bool
+verification::reachable (uint64_t ip) const
+{
+  return depths[ip] != unreachable;
+}
+
+std::span<const primitive_type>
+verification::stack_types (uint64_t ip) const
+{
+  if (!reachable (ip))
+    return {};
+
+  return std::span<const primitive_type> (types).subspan (type_offsets[ip],
+                                                          depths[ip]);
+}
+
+verification
+verify_program (const program &prog, std::span<const host_signature> hosts)
+{
+  const auto &code = prog.code;
+  auto size = code.size ();
+
+  verification result;
+  result.owners.assign (size, verification::unreachable);
+  result.hosts.assign (hosts.begin (), hosts.end ());
+
+  for (uint64_t i = 0; i < prog.functions.size (); i++)
+    check_function (prog.functions[i], i, size);
+
+  // the stack before each reachable instruction.
+  std::vector<stack_state> states (size);
+  std::vector<uint64_t> work;
+
+  for (uint32_t function = 0; function < prog.functions.size (); function++)
+    {
+      const auto &info = prog.functions[function];
+      uint64_t max_depth = 0;
+
+      // every path to an instruction must agree on its stack,
+      // so each instruction is only analysed once.
+      auto reach = [&] (uint64_t from, uint64_t target,
+                        const stack_state &stack) {
+        if (target >= size)
+          fail (from, "Code runs off the end.");
+
+        auto &owner = result.owners[target];
+
+        if (owner == verification::unreachable)
+          {
+            owner = function;
+            states[target] = stack;
+            work.push_back (target);
+          }
+        else if (owner != function)
+          fail (target, "Instruction is reachable from two functions.");
+        else if (states[target] != stack)
+          fail (target, "Operand stack does not match at a join.");
+      };
+
+      reach (info.entry, info.entry, {});
+
+      while (!work.empty ())
+        {
+          auto ip = work.back ();
+          work.pop_back ();
+
+          auto stack = states[ip];
+          auto operand = code.operands[ip];
+          bool falls_through = true;
+
+          max_depth = std::max<uint64_t> (max_depth, stack.size ());
+
+          switch (code.opcodes[ip])
+            {
+            case opcode::nop:
+              break;
+
+            case opcode::load_const:
+              if (operand >= prog.constants.size ())
+                fail (ip, "Constant does not exist.");
+              stack.push_back (primitive_get_type (prog.constants[operand]));
+              break;
+
+            case opcode::pop:
+              require (stack, 1, ip);
+              stack.pop_back ();
+              break;
+
+            case opcode::dup:
+              require (stack, 1, ip);
+              stack.push_back (stack.back ());
+              break;
+
+            case opcode::swap:
+              require (stack, 2, ip);
+              std::swap (stack[stack.size () - 1], stack[stack.size () - 2]);
+              break;
+
+            case opcode::load_local:
+              if (operand >= info.locals.size ())
+                fail (ip, "Local variable does not exist.");
+              stack.push_back (info.locals[operand]);
+              break;
+
+            case opcode::store_local:
+              if (operand >= info.locals.size ())
+                fail (ip, "Local variable does not exist.");
+              require (stack, 1, ip);
+              if (stack.back () != info.locals[operand])
+                fail (ip, "Value does not match the local's type.");
+              stack.pop_back ();
+              break;
+
+            case opcode::add:
+            case opcode::sub:
+            case opcode::mul:
+            case opcode::div:
+            case opcode::rem:
+              stack.push_back (
+                  require_numbers (pop_operands (stack, ip), ip));
+              break;
+
+            case opcode::neg:
+              require (stack, 1, ip);
+              require_numbers (stack.back (), ip);
+              break;
+
+            case opcode::add_const:
+            case opcode::sub_const:
+              if (operand >= prog.constants.size ())
+                fail (ip, "Constant does not exist.");
+              require (stack, 1, ip);
+              if (stack.back () != primitive_get_type (prog.constants[operand]))
+                fail (ip, "Operands have different types.");
+              break;
+
+            case opcode::branch_local:
+            case opcode::branch_const:
+              {
+                auto branch = branch_operand::unpack (operand);
+                primitive_type type;
+
+                if (code.opcodes[ip] == opcode::branch_local)
+                  {
+                    if (branch.value >= info.locals.size ())
+                      fail (ip, "Local variable does not exist.");
+                    type = info.locals[branch.value];
+                  }
+                else
+                  {
+                    if (branch.value >= prog.constants.size ())
+                      fail (ip, "Constant does not exist.");
+                    type = primitive_get_type (prog.constants[branch.value]);
+                  }
+
+                if (!is_comparison (branch.compare)
+                    || !is_conditional_jump (branch.jump))
+                  fail (ip, "Invalid fused branch.");
+
+                require (stack, 1, ip);
+                if (stack.back () != type)
+                  fail (ip, "Operands have different types.");
+                require_numbers (type, ip);
+
+                stack.pop_back ();
+                reach (ip, branch.target, stack);
+                break;
+              }
+
+            case opcode::eq:
+            case opcode::ne:
+            case opcode::lt:
+            case opcode::le:
+            case opcode::gt:
+            case opcode::ge:
+              require_numbers (pop_operands (stack, ip), ip);
+              stack.push_back (U8_TYPE);
+              break;
+
+            case opcode::conv:
+              if (operand > F64_TYPE)
+                fail (ip, "Invalid Type Specifier.");
+              require (stack, 1, ip);
+              require_numbers (stack.back (), ip);
+              stack.back () = static_cast<primitive_type> (operand);
+              break;
+
+            case opcode::jump:
+              reach (ip, operand, stack);
+              falls_through = false;
+              break;
+
+            case opcode::jump_if:
+            case opcode::jump_unless:
+              require (stack, 1, ip);
+              stack.pop_back ();
+              reach (ip, operand, stack);
+              break;
+
+            case opcode::call:
+              {
+                if (operand >= prog.functions.size ())
+                  fail (ip, "Function does not exist.");
+
+                const auto &callee = prog.functions[operand];
+                pop_arguments (stack,
+                               std::span (callee.locals)
+                                   .first (callee.arg_count),
+                               ip);
+                if (callee.result)
+                  stack.push_back (*callee.result);
+                break;
+              }
+
+            case opcode::ret:
+              if (info.result)
+                {
+                  require (stack, 1, ip);
+                  if (stack.back () != *info.result)
+                    fail (ip, "Returned value does not match its type.");
+                }
+              falls_through = false;
+              break;
+
+            case opcode::host_call:
+              {
+                if (operand >= hosts.size ())
+                  fail (ip, "Host function does not exist.");
+
+                const auto &host = hosts[operand];
+                pop_arguments (stack, host.args, ip);
+                if (host.result)
+                  stack.push_back (*host.result);
+                break;
+              }
+
+            case opcode::load_string:
+              if (operand >= prog.strings.size ())
+                fail (ip, "String does not exist.");
+              stack.push_back (REF_TYPE);
+              break;
+
+            case opcode::concat:
+              if (pop_operands (stack, ip) != REF_TYPE)
+                fail (ip, "Operands are not references.");
+              stack.push_back (REF_TYPE);
+              break;
+
+            default:
+              fail (ip, "Invalid opcode.");
+            }
+
+          max_depth = std::max<uint64_t> (max_depth, stack.size ());
+
+          if (falls_through)
+            reach (ip, ip + 1, stack);
+        }
+
+      if (info.locals.size () + max_depth > UINT32_MAX)
+        fail_function (function, "Frame is too large.");
+
+      result.max_depths.push_back (static_cast<uint32_t> (max_depth));
+      result.frame_sizes.push_back (
+          static_cast<uint32_t> (info.locals.size () + max_depth));
+    }
+
+  result.depths.reserve (size);
+  result.type_offsets.reserve (size);
+
+  for (uint64_t ip = 0; ip < size; ip++)
+    {
+      bool reachable = result.owners[ip] != verification::unreachable;
+
+      result.depths.push_back (reachable
+                                   ? static_cast<uint32_t> (states[ip].size ())
+                                   : verification::unreachable);
+      result.type_offsets.push_back (
+          static_cast<uint32_t> (result.types.size ()));
+      result.types.insert (result.types.end (), states[ip].begin (),
+                           states[ip].end ());
+    }
+
+  return result;
+}
+
+} // evm
@@ -0,0 +1,183 @@
+/** @file
+ *
+ * @brief This header contains the executor (@c evm::executor),
+ * which runs many scripts over a fixed pool of threads.
+ */
+
+#ifndef EVM_INTERP_EXECUTOR_H_
+#define EVM_INTERP_EXECUTOR_H_
+
+#include "interpreter.h"
+
+#include <evm/primitive.h>
+#include <evm/program.h>
+#include <evm/verifier.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief How busy a worker of an @c executor has been.
+ */
+struct worker_stats
+{
+  /**
+   * @brief The number of scripts the worker ran.
+   */
+  uint64_t jobs;
+  /**
+   * @brief How many of those it stole from other workers.
+   */
+  uint64_t steals;
+  /**
+   * @brief The time spent running scripts.
+   */
+  std::chrono::nanoseconds busy;
+  /**
+   * @brief The number of interpreters the worker keeps for the programs it
+   * has run.
+   */
+  uint64_t interpreters;
+  /**
+   * @brief The share of the executor's lifetime spent running scripts,
+   * from @c 0 to @c 1.
+   */
+  double utilization;
+};
+
+/**
+ * @brief Runs scripts on a fixed pool of worker threads.
+ *
+ * Each worker has its own deque of scripts. It runs the newest script it
+ * queued first, and when it runs out it steals the oldest script of
+ * another worker. Scripts submitted from outside the pool are spread
+ * over the workers in turn.
+ *
+ * Programs are shared and never written to, so one loaded program can serve
+ * every worker. Each worker keeps its own interpreter for each program it
+ * has run recently, so no interpreter state is shared between threads.
+ * Past a fixed number, the one used least recently is dropped.
+ *
+ * Host functions are shared by every worker, so they must be thread safe.
+ */
+class executor
+{
+public:
+  /**
+   * @brief Starts the workers.
+   * @param workers The number of threads, at least one.
+   */
+  explicit executor (unsigned workers = std::thread::hardware_concurrency ());
+  /**
+   * @brief Runs the scripts already submitted, then stops the workers.
+   */
+  ~executor ();
+
+  executor (const executor &) = delete;
+  executor &operator= (const executor &) = delete;
+
+  /**
+   * @brief Binds a host function for every script,
+   * see @c interpreter::bind_host.
+   * This must be done before anything is submitted.
+   */
+  void bind_host (uint32_t index, host_function function);
+
+  /**
+   * @brief Runs a function of a program on one of the workers.
+   * @return The value the function returns, or the exception it threw.
+   */
+  std::future<std::optional<primitive_value>>
+  submit (std::shared_ptr<const program> prog, uint32_t function,
+          std::vector<primitive_value> args);
+  /**
+   * @brief Runs a function of a verified program on one of the workers,
+   * without the checks the verifier has made.
+   */
+  std::future<std::optional<primitive_value>>
+  submit (std::shared_ptr<const program> prog,
+          std::shared_ptr<const verification> verified, uint32_t function,
+          std::vector<primitive_value> args);
+
+  /**
+   * @brief The number of workers.
+   */
+  unsigned size () const;
+  /**
+   * @brief How busy each worker has been.
+   */
+  std::vector<worker_stats> stats () const;
+
+private:
+  struct job
+  {
+    std::shared_ptr<const program> prog;
+    std::shared_ptr<const verification> verified;
+    uint32_t function;
+    std::vector<primitive_value> args;
+    std::promise<std::optional<primitive_value>> result;
+  };
+
+  using interpreter_key = std::pair<const program *, const verification *>;
+
+  /// an interpreter, with what it needs kept alive.
+  struct cached_interpreter
+  {
+    interpreter_key key;
+    std::shared_ptr<const program> prog;
+    std::shared_ptr<const verification> verified;
+    std::unique_ptr<interpreter> interp;
+  };
+
+  struct worker
+  {
+    std::mutex mutex;
+    std::deque<job> jobs;
+    std::thread thread;
+
+    std::atomic<uint64_t> job_count{ 0 };
+    std::atomic<uint64_t> steals{ 0 };
+    std::atomic<uint64_t> busy_ns{ 0 };
+    std::atomic<uint64_t> cached{ 0 };
+
+    /// only used by the worker's thread, the most recently used first.
+    std::list<cached_interpreter> interpreters;
+    std::map<interpreter_key, std::list<cached_interpreter>::iterator>
+        interpreter_index;
+  };
+
+  void work (unsigned index);
+  bool take (unsigned index, job &out);
+  void run (worker &self, job &current);
+  interpreter &interpreter_for (worker &self, const job &current);
+
+  std::vector<std::unique_ptr<worker>> m_workers;
+  std::vector<host_function> m_hosts;
+  std::chrono::steady_clock::time_point m_start;
+
+  /// where the next script from outside the pool goes.
+  std::atomic<unsigned> m_next{ 0 };
+  std::atomic<uint64_t> m_pending{ 0 };
+  std::mutex m_sleep_mutex;
+  std::condition_variable m_wake;
+  bool m_stopping = false;
+};
+
+} // evm
+
+#endif // EVM_INTERP_EXECUTOR_H_
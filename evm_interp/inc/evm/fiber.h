@@ -0,0 +1,132 @@
+/** @file
+ *
+ * @brief This header contains fibers (@c evm::fiber), runs of a function
+ * that can suspend at host calls, and the scheduler that takes turns
+ * running them (@c evm::scheduler).
+ */
+
+#ifndef EVM_INTERP_FIBER_H_
+#define EVM_INTERP_FIBER_H_
+
+#include "heap.h"
+#include "host_task.h"
+#include "interpreter.h"
+
+#include <evm/primitive.h>
+#include <evm/tagged.h>
+
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief A run of a function, which suspends whenever a host task it calls
+ * does (see @c interpreter::resume).
+ *
+ * A fiber holds its own stacks, which start empty and grow as its frames
+ * need, so that a suspended fiber takes little more than its live values.
+ */
+class fiber
+{
+public:
+  /**
+   * @brief A fiber that runs @c function with @c args when first resumed.
+   */
+  fiber (uint32_t function, std::vector<primitive_value> args);
+  /**
+   * @brief Stops the fiber if it has not finished.
+   */
+  ~fiber ();
+
+  fiber (const fiber &) = delete;
+  fiber &operator= (const fiber &) = delete;
+
+  /**
+   * @brief Whether the function returned or threw.
+   */
+  bool finished () const;
+
+  /**
+   * @brief The value the function returned, if any.
+   * @throws The exception the run threw, if it did,
+   * or std::runtime_error if it has not finished.
+   */
+  std::optional<primitive_value> result () const;
+
+private:
+  friend class interpreter;
+
+  uint32_t m_function;
+  std::vector<primitive_value> m_args;
+  bool m_started = false;
+  bool m_finished = false;
+
+  /// swapped with the interpreter's while the fiber runs.
+  tagged_stack m_stack;
+  std::vector<interpreter::frame> m_frames;
+  std::vector<primitive_value> m_host_args;
+  host_task m_task;
+
+  /// the host call it is suspended in.
+  uint64_t m_ip = 0;
+  uint32_t m_host = 0;
+  /// the heap its stack is a root of, from its first run until it finishes.
+  heap *m_heap = nullptr;
+
+  std::optional<primitive_value> m_result;
+  std::exception_ptr m_error;
+};
+
+/**
+ * @brief Runs many fibers on one interpreter, taking turns.
+ *
+ * Scheduling is cooperative: a fiber runs until it finishes or a host task
+ * suspends, then the next fiber runs. A suspended fiber is resumed on its
+ * next turn. Fibers on many threads need a scheduler, and so an interpreter,
+ * on each.
+ */
+class scheduler
+{
+public:
+  /**
+   * @brief Runs fibers on @c interp, which must outlive the scheduler.
+   */
+  explicit scheduler (interpreter &interp);
+
+  /**
+   * @brief Adds a fiber running @c function with @c args,
+   * which first runs on the next turn.
+   * @return The fiber, whose result can be read once it has finished.
+   */
+  std::shared_ptr<fiber> spawn (uint32_t function,
+                                std::vector<primitive_value> args);
+
+  /**
+   * @brief Gives every fiber a turn.
+   * @return Whether any fiber has not finished.
+   */
+  bool step ();
+  /**
+   * @brief Takes turns until every fiber has finished.
+   */
+  void run ();
+
+  /**
+   * @brief The number of fibers that have not finished.
+   */
+  uint64_t size () const;
+
+private:
+  interpreter &m_interp;
+  std::deque<std::shared_ptr<fiber>> m_fibers;
+};
+
+} // evm
+
+#endif // EVM_INTERP_FIBER_H_
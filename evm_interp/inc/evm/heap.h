@@ -0,0 +1,233 @@
+/** @file
+ *
+ * @brief This header contains the heap of an interpreter (@c evm::heap),
+ * which holds the strings and arrays that values of @c REF_TYPE refer to.
+ *
+ * The heap is generational. Objects are allocated by bumping a pointer
+ * through the nursery, which is collected on its own when it fills:
+ * the objects still referred to are copied into the tenured space,
+ * and the whole nursery is free again. Most objects die young,
+ * so they are never copied or freed one by one.
+ * The tenured space is a list of chunks, also allocated into by bumping a
+ * pointer, which is only collected once it has grown by
+ * @c heap_options::growth since the last time.
+ *
+ * Both collections copy, so objects move. References are found precisely:
+ * the roots are the slots of type @c REF_TYPE of the stacks added with
+ * @c heap::add_roots, which are updated as their objects move.
+ * References held anywhere else are only valid until the next allocation.
+ */
+
+#ifndef EVM_INTERP_HEAP_H_
+#define EVM_INTERP_HEAP_H_
+
+#include <evm/primitive.h>
+#include <evm/tagged.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief The kinds of objects on the heap.
+ */
+enum class object_kind : uint8_t
+{
+  /**
+   * @brief Characters, which hold no references.
+   */
+  string,
+  /**
+   * @brief Values of any type, including references to other objects.
+   */
+  array,
+};
+
+/**
+ * @brief How the heap is sized, and how long it pauses for.
+ */
+struct heap_options
+{
+  /**
+   * @brief The size of the nursery in bytes. Each nursery collection
+   * copies what survives of it, so a smaller nursery pauses for less,
+   * but more often.
+   */
+  uint64_t nursery_size = 512 * 1024;
+  /**
+   * @brief The size in bytes of each chunk of the tenured space.
+   * Objects larger than a quarter of the nursery are allocated there
+   * directly, in a chunk of their own if need be.
+   */
+  uint64_t chunk_size = 1024 * 1024;
+  /**
+   * @brief How many times larger the tenured space gets than what
+   * survived the last full collection, before it is collected again.
+   */
+  double growth = 2.0;
+  /**
+   * @brief The longest a nursery collection should pause for,
+   * or zero to always use the whole nursery.
+   *
+   * After each nursery collection the part of the nursery in use is halved
+   * if the pause was longer than this, and doubled up to @c nursery_size
+   * if it was shorter than half of it.
+   */
+  std::chrono::nanoseconds pause_target{ 0 };
+};
+
+/**
+ * @brief What the heap has done so far.
+ */
+struct heap_stats
+{
+  uint64_t minor_collections = 0;
+  uint64_t major_collections = 0;
+  /**
+   * @brief The bytes allocated, including the headers of objects.
+   */
+  uint64_t allocated = 0;
+  /**
+   * @brief The bytes copied out of the nursery into the tenured space.
+   */
+  uint64_t promoted = 0;
+  /**
+   * @brief The bytes in the tenured space now.
+   */
+  uint64_t tenured = 0;
+  /**
+   * @brief The bytes of the nursery in use before it is collected,
+   * see @c heap_options::pause_target.
+   */
+  uint64_t nursery_limit = 0;
+  std::chrono::nanoseconds longest_pause{ 0 };
+  std::chrono::nanoseconds total_pause{ 0 };
+};
+
+/**
+ * @brief A garbage collected heap of strings and arrays.
+ *
+ * References are the address of an object as a @c value_slot,
+ * zero being null. They are passed to and from the host as
+ * @c heap_ref values.
+ *
+ * A heap is not thread safe, and can not be copied or moved because the
+ * stacks of its roots refer to it.
+ */
+class heap
+{
+public:
+  explicit heap (heap_options options = {});
+  ~heap ();
+
+  heap (const heap &) = delete;
+  heap &operator= (const heap &) = delete;
+
+  /**
+   * @brief Allocates a string with a copy of @c chars,
+   * which must not be on this heap (see @c concat).
+   * This, and every allocation, may collect garbage first.
+   * @throws std::runtime_error if the string is longer than 4 GiB.
+   */
+  value_slot make_string (std::string_view chars);
+  /**
+   * @brief Allocates a string joining two strings.
+   * @throws std::runtime_error if either is null or not a string.
+   */
+  value_slot concat (value_slot lhs, value_slot rhs);
+  /**
+   * @brief Allocates an array of @c length null references.
+   */
+  value_slot make_array (uint32_t length);
+
+  /**
+   * @brief The kind of the object.
+   * @throws std::runtime_error if @c ref is null, as do the other accessors.
+   */
+  object_kind kind (value_slot ref) const;
+  /**
+   * @brief The characters of a string, valid until the next allocation.
+   * @throws std::runtime_error if the object is not a string.
+   */
+  std::string_view string (value_slot ref) const;
+  /**
+   * @brief The number of characters of a string, or values of an array.
+   */
+  uint32_t length (value_slot ref) const;
+
+  /**
+   * @brief The value at @c index of an array.
+   * @throws std::runtime_error if the object is not an array,
+   * or @c index is out of range.
+   */
+  primitive_value get (value_slot ref, uint32_t index) const;
+  /**
+   * @brief Sets the value at @c index of an array.
+   * @throws std::runtime_error if the object is not an array,
+   * or @c index is out of range.
+   */
+  void set (value_slot ref, uint32_t index, value_slot slot,
+            primitive_type type);
+  void set (value_slot ref, uint32_t index, const primitive_value &value);
+
+  /**
+   * @brief Adds a stack whose references are roots,
+   * it must be removed before it is destroyed.
+   */
+  void add_roots (tagged_stack &stack);
+  void remove_roots (tagged_stack &stack);
+
+  /**
+   * @brief Collects the nursery, and the tenured space as well if @c full.
+   */
+  void collect (bool full = false);
+
+  const heap_stats &stats () const;
+  const heap_options &options () const;
+
+private:
+  /// a block of memory that objects are allocated into by bumping.
+  struct arena
+  {
+    std::unique_ptr<std::byte[]> memory;
+    uint64_t size = 0;
+    uint64_t used = 0;
+  };
+
+  struct object_header;
+
+  std::byte *allocate (uint64_t size);
+  std::byte *allocate_tenured (uint64_t size);
+  object_header *object_of (value_slot ref, object_kind kind) const;
+  bool in_nursery (value_slot ref) const;
+  value_slot evacuate (value_slot ref, bool full);
+  void copy_live (bool full);
+  void collect_garbage (bool full);
+  void scan (std::byte *object, bool full);
+
+  heap_options m_options;
+  arena m_nursery;
+  std::vector<arena> m_tenured;
+  /// the tenured arrays that may refer into the nursery.
+  std::vector<std::byte *> m_remembered;
+  /// the objects copied but not yet scanned by a collection.
+  std::vector<std::byte *> m_work;
+  /// a set, since a stack is added for each fiber and removed when it ends.
+  std::unordered_set<tagged_stack *> m_roots;
+  /// the references an allocation of the heap itself must keep up to date.
+  tagged_stack m_pinned;
+  /// the size the tenured space collects at.
+  uint64_t m_major_threshold;
+  heap_stats m_stats;
+};
+
+} // evm
+
+#endif // EVM_INTERP_HEAP_H_
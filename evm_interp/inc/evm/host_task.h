@@ -0,0 +1,144 @@
+/** @file
+ *
+ * @brief This header contains the coroutine type of host functions that
+ * can suspend (@c evm::host_task), such as while they wait for I/O.
+ */
+
+#ifndef EVM_INTERP_HOST_TASK_H_
+#define EVM_INTERP_HOST_TASK_H_
+
+#include <evm/primitive.h>
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace evm
+{
+
+/**
+ * @brief A host function that can suspend, written as a C++20 coroutine
+ * returning the value to push, if any, with @c co_return.
+ *
+ * The task does not start until it is first resumed. It suspends with
+ * <tt>co_await std::suspend_always {}</tt> to let other fibers run,
+ * for instance while the I/O it waits for is not ready,
+ * and is resumed each time its fiber runs until it finishes
+ * (see @c evm::scheduler). Outside a fiber it is resumed until it finishes.
+ */
+class host_task
+{
+public:
+  struct promise_type
+  {
+    std::optional<primitive_value> value;
+    std::exception_ptr error;
+
+    host_task
+    get_return_object ()
+    {
+      return host_task (
+          std::coroutine_handle<promise_type>::from_promise (*this));
+    }
+
+    std::suspend_always
+    initial_suspend () noexcept
+    {
+      return {};
+    }
+
+    std::suspend_always
+    final_suspend () noexcept
+    {
+      return {};
+    }
+
+    void
+    return_value (std::optional<primitive_value> result)
+    {
+      value = std::move (result);
+    }
+
+    void
+    unhandled_exception ()
+    {
+      error = std::current_exception ();
+    }
+  };
+
+  host_task () = default;
+
+  host_task (host_task &&other) noexcept
+      : m_handle (std::exchange (other.m_handle, {}))
+  {
+  }
+
+  host_task &
+  operator= (host_task &&other) noexcept
+  {
+    if (this != &other)
+      {
+        if (m_handle)
+          m_handle.destroy ();
+        m_handle = std::exchange (other.m_handle, {});
+      }
+    return *this;
+  }
+
+  ~host_task ()
+  {
+    if (m_handle)
+      m_handle.destroy ();
+  }
+
+  /**
+   * @brief Whether there is a task, finished or not.
+   */
+  explicit
+  operator bool () const
+  {
+    return static_cast<bool> (m_handle);
+  }
+
+  bool
+  done () const
+  {
+    return m_handle.done ();
+  }
+
+  /**
+   * @brief Runs the task until it suspends or finishes.
+   */
+  void
+  resume ()
+  {
+    m_handle.resume ();
+  }
+
+  /**
+   * @brief The value the finished task returned.
+   * @throws The exception it threw, if it did.
+   */
+  std::optional<primitive_value>
+  result () const
+  {
+    auto &promise = m_handle.promise ();
+    if (promise.error)
+      std::rethrow_exception (promise.error);
+
+    return promise.value;
+  }
+
+private:
+  explicit host_task (std::coroutine_handle<promise_type> handle)
+      : m_handle (handle)
+  {
+  }
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+} // evm
+
+#endif // EVM_INTERP_HOST_TASK_H_
@@ -0,0 +1,279 @@
+/** @file
+ *
+ * @brief This header contains the interpreter (@c evm::interpreter),
+ * which runs @c evm::program.
+ */
+
+#ifndef EVM_INTERP_INTERPRETER_H_
+#define EVM_INTERP_INTERPRETER_H_
+
+#include "heap.h"
+#include "host_task.h"
+#include "profiler.h"
+
+#include <evm/primitive.h>
+#include <evm/program.h>
+#include <evm/tagged.h>
+#include <evm/verifier.h>
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief A function implemented by the host, called by @c opcode::host_call.
+ */
+struct host_function
+{
+  /**
+   * @brief The number of values popped and passed to @c call.
+   */
+  uint16_t arg_count;
+  /**
+   * @brief The function, if it returns a value it is pushed.
+   * References among the arguments are only valid until it allocates
+   * on the heap of the interpreter.
+   */
+  std::function<std::optional<primitive_value> (
+      std::span<const primitive_value>)>
+      call;
+  /**
+   * @brief Or a function that can suspend, which is called instead if set.
+   * The arguments stay valid until the task finishes, but references among
+   * them only until it first suspends or allocates.
+   */
+  std::function<host_task (std::span<const primitive_value>)> task = {};
+};
+
+class fiber;
+
+/**
+ * @brief Native code for a function.
+ *
+ * It is passed its frame: the local variables, with the arguments set and
+ * the rest zero, followed by room for its deepest operand stack.
+ * It leaves the value it returns, if any, in the first slot of the frame.
+ *
+ * @return @c false if the function divided by zero.
+ */
+using native_function = bool (*) (value_slot *frame);
+
+/**
+ * @brief Compiles hot functions to native code, for an interpreter of
+ * verified code (see @c interpreter::set_tier_up).
+ */
+class tier_up
+{
+public:
+  virtual ~tier_up () = default;
+
+  /**
+   * @brief Compiles a function,
+   * or returns @c nullptr if the function cannot be compiled.
+   */
+  virtual native_function compile (uint32_t function) = 0;
+};
+
+/**
+ * @brief Runs the functions of a program.
+ *
+ * The dispatch loop is direct threaded using labels as values on compilers
+ * that support them (GCC and Clang), and a @c switch otherwise.
+ * The strategy can be forced with the @c EVM_DISPATCH CMake option.
+ *
+ * The operand stack and local variables are kept in a @c tagged_stack,
+ * whose references are the roots of the interpreter's @c heap.
+ *
+ * Code checked by @c verify_program runs without per instruction checks:
+ * each frame is allocated at its verified size when it is entered,
+ * and stack underflow and operand types are not checked again.
+ * Verified code can also tier up to native code, see @c set_tier_up.
+ *
+ * The interpreter runs its own copy of the code, which it quickens:
+ * arithmetic and comparisons of @c I64_TYPE or @c F64_TYPE values are
+ * rewritten into variants for that type (see @c quickened_opcode),
+ * which skip the type dispatch. Unverified code is rewritten once an
+ * instruction has run, and the variant guards the types of its operands,
+ * rewriting it back if they differ. An instruction rewritten back a few
+ * times is left generic. Verified code is rewritten before it runs,
+ * without guards, since the verifier already knows the types.
+ *
+ * Runs can also be fibers (see @c resume), which suspend at the host
+ * functions that are tasks until those finish, so that many scripts
+ * waiting on the host share one interpreter and thread.
+ *
+ * When built with the @c EVM_PROFILE CMake option, instructions can be
+ * sampled by a @c profiler, see @c set_profiler. Otherwise the hooks are
+ * not compiled in at all.
+ *
+ * An interpreter is not thread safe, but many interpreters can share a
+ * program.
+ */
+class interpreter
+{
+public:
+  /**
+   * @brief Makes an interpreter for @c prog, which must outlive it.
+   * @param options How its heap is sized, see @c heap_options.
+   */
+  explicit interpreter (const program &prog, heap_options options = {});
+  /**
+   * @brief Makes an interpreter for verified code,
+   * @c prog and @c verified must outlive it.
+   * @throws std::runtime_error if @c verified is not of @c prog.
+   */
+  interpreter (const program &prog, const verification &verified,
+               heap_options options = {});
+
+  /**
+   * @brief Binds the host function called by @c opcode::host_call with the
+   * given index.
+   * @throws std::runtime_error if the program was verified and the function
+   * does not match the host signature it was verified against.
+   */
+  void bind_host (uint32_t index, host_function function);
+
+  /**
+   * @brief Compiles functions with @c compiler once they get hot.
+   *
+   * A function is compiled when it is called, after it was called
+   * @c call_threshold times or its loops jumped back @c back_edge_threshold
+   * times. Functions are never swapped while they run,
+   * so a running loop finishes in the interpreter.
+   *
+   * @param compiler The compiler, which must outlive the interpreter,
+   * or @c nullptr to stop compiling.
+   * @throws std::runtime_error if the interpreter is not for verified code.
+   */
+  void set_tier_up (tier_up *compiler, uint32_t call_threshold = 1000,
+                    uint32_t back_edge_threshold = 10000);
+
+  /**
+   * @brief Whether the function has been compiled to native code.
+   */
+  bool compiled (uint32_t function) const;
+
+  /**
+   * @brief Samples the instructions run with @c prof, which must outlive
+   * the interpreter, or stops sampling with @c nullptr.
+   * Native code is not sampled, apart from the calls to it.
+   * @throws std::runtime_error if profiling was not compiled in,
+   * see @c profiling_enabled.
+   */
+  void set_profiler (profiler *prof);
+
+  /**
+   * @brief The heap of the strings and arrays the program refers to,
+   * through which host functions read and make them.
+   */
+  evm::heap &heap ();
+
+  /**
+   * @brief The opcodes as this interpreter runs them, with the
+   * instructions it quickened. Empty until it first runs.
+   */
+  std::span<const opcode> quickened_code () const;
+
+  /**
+   * @brief Runs a function until it returns.
+   * @param function Index of the function to run.
+   * @param args The arguments, which must match the function's signature.
+   * @return The value returned, if any.
+   * @throws std::runtime_error if the code does something invalid,
+   * such as popping from an empty stack.
+   */
+  std::optional<primitive_value> run (uint32_t function,
+                                      std::span<const primitive_value> args);
+
+  /**
+   * @brief Runs a fiber until it finishes, or a host task it called
+   * suspends. Next time, that task is resumed, and if it has finished
+   * the fiber carries on after the call.
+   *
+   * The fiber's stack is a root of this interpreter's heap from its first
+   * run until it finishes, and the interpreter must outlive it until then.
+   *
+   * @return Whether the fiber has finished, see @c fiber::result.
+   * @throws std::runtime_error if the fiber was run by another interpreter.
+   */
+  bool resume (fiber &f);
+
+  /**
+   * @brief The name of the dispatch strategy compiled in,
+   * either @c "threaded" or @c "switch".
+   */
+  static std::string_view dispatch_name ();
+  /**
+   * @brief Whether profiling was compiled in, see @c set_profiler.
+   */
+  static bool profiling_enabled ();
+
+private:
+  friend class fiber;
+
+  struct frame
+  {
+    uint32_t function;
+    /// index of the instruction to return to.
+    uint64_t return_ip;
+    /// index of the first local variable in the stack.
+    uint64_t base;
+  };
+
+  /// how hot a function is, and its native code once compiled.
+  struct tier_state
+  {
+    uint32_t calls = 0;
+    uint32_t back_edges = 0;
+    native_function native = nullptr;
+    /// whether it has been handed to the compiler.
+    bool tried = false;
+  };
+
+  template <bool checked> void enter (uint32_t function, uint64_t return_ip);
+  std::optional<primitive_value> start (uint32_t function);
+  template <bool checked>
+  void finish_host_call (uint32_t index,
+                         std::optional<primitive_value> result);
+  native_function native_for (uint32_t function);
+  void call_native (uint32_t function, native_function native);
+  template <bool checked>
+  std::optional<primitive_value> execute (uint64_t ip);
+
+  const program &m_program;
+  /// the verification of the program, if it was verified.
+  const verification *m_verified = nullptr;
+  std::vector<host_function> m_hosts;
+  std::vector<value_slot> m_constant_slots;
+  std::vector<primitive_type> m_constant_types;
+  tagged_stack m_stack;
+  evm::heap m_heap;
+  /// reused for the arguments of host functions.
+  std::vector<primitive_value> m_host_args;
+  std::vector<frame> m_frames;
+  /// the fiber being run, if any.
+  fiber *m_fiber = nullptr;
+  /// the host task the fiber is suspended in, if it is.
+  host_task m_task;
+  tier_up *m_tier_up = nullptr;
+  uint32_t m_call_threshold = 0;
+  uint32_t m_back_edge_threshold = 0;
+  std::vector<tier_state> m_tiers;
+  profiler *m_profiler = nullptr;
+  /// the opcodes being run, quickened as they run.
+  std::vector<opcode> m_opcodes;
+  /// how many times each instruction was rewritten back from quickened.
+  std::vector<uint8_t> m_deopts;
+  /// the handler address of each instruction, when direct threaded.
+  std::vector<const void *> m_threaded;
+};
+
+} // evm
+
+#endif // EVM_INTERP_INTERPRETER_H_
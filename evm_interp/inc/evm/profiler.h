@@ -0,0 +1,181 @@
+/** @file
+ *
+ * @brief This header contains the profiler (@c evm::profiler),
+ * which samples where an interpreter spends its time.
+ */
+
+#ifndef EVM_INTERP_PROFILER_H_
+#define EVM_INTERP_PROFILER_H_
+
+#include <evm/instruction.h>
+#include <evm/optimizer.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief What was sampled of an opcode or function.
+ */
+struct profile_entry
+{
+  /**
+   * @brief The number of instructions sampled.
+   */
+  uint64_t samples = 0;
+  /**
+   * @brief The ticks spent in the instructions sampled,
+   * see @c profiler::tick_unit.
+   */
+  uint64_t ticks = 0;
+};
+
+/**
+ * @brief What was sampled of a function.
+ */
+struct function_profile : profile_entry
+{
+  /**
+   * @brief The number of times the function was entered, which is exact.
+   */
+  uint64_t calls = 0;
+};
+
+/**
+ * @brief Samples the instructions an interpreter runs,
+ * see @c interpreter::set_profiler.
+ *
+ * About one in every @c sample_period instructions is sampled,
+ * at random so that loops cannot hide from it. A sampled instruction is
+ * timed until the next instruction starts, and counted against its opcode,
+ * its function, its call stack and the opcode that runs after it.
+ * Counts are of samples, multiply them by @c sample_period to estimate
+ * executions.
+ *
+ * Time is measured in cycles with @c rdtsc on x86-64,
+ * and in nanoseconds with @c clock_gettime elsewhere.
+ */
+class profiler
+{
+public:
+  /**
+   * @brief Makes a profiler that samples one in about every
+   * @c sample_period instructions, @c 1 samples all of them.
+   */
+  explicit profiler (uint32_t sample_period = 1);
+
+  /**
+   * @brief Called by the interpreter before each instruction runs.
+   * @param op The instruction's opcode.
+   * @param call_stack Appends the functions on the call stack,
+   * outermost first, to a vector; only called when sampling.
+   */
+  template <typename F>
+  void
+  step (opcode op, F &&call_stack)
+  {
+    if (m_sampling)
+      finish (op, true);
+
+    if (--m_countdown == 0)
+      {
+        m_stack.clear ();
+        call_stack (m_stack);
+        start (op);
+      }
+  }
+
+  /**
+   * @brief Called by the interpreter when a function is entered.
+   */
+  void enter (uint32_t function);
+
+  /**
+   * @brief Ends the sample in progress, if any,
+   * once the interpreter stops running.
+   */
+  void flush ();
+
+  /**
+   * @brief Forgets everything sampled.
+   */
+  void reset ();
+
+  /**
+   * @brief The period sampling was made with.
+   */
+  uint32_t sample_period () const;
+
+  /**
+   * @brief What was sampled of each opcode.
+   */
+  const std::array<profile_entry, opcode_count> &opcodes () const;
+  /**
+   * @brief What was sampled of each function, by index.
+   */
+  const std::vector<function_profile> &functions () const;
+  /**
+   * @brief How often each opcode was sampled followed by each other opcode.
+   */
+  const opcode_pair_counts &pairs () const;
+
+  /**
+   * @brief The superinstructions worth fusing for what was sampled,
+   * see @c fusion_table::from_profile.
+   */
+  fusion_table fusion_candidates (double min_share = 0.01) const;
+
+  /**
+   * @brief The profile as a JSON object, with the members
+   * @c "sample_period", @c "tick_unit", @c "opcodes", @c "functions"
+   * and @c "pairs". Opcodes, functions and pairs never sampled are left out.
+   */
+  std::string to_json () const;
+  /**
+   * @brief The profile as folded stacks, for flame graph tools:
+   * one line per call stack, such as @c "fn0;fn3;add 1234",
+   * with functions by index, the sampled opcode last and the ticks spent.
+   */
+  std::string to_folded () const;
+
+  /**
+   * @brief What ticks are counted in, either @c "cycles" or @c "ns".
+   */
+  static const char *tick_unit ();
+  /**
+   * @brief The current time in ticks.
+   */
+  static uint64_t now ();
+
+private:
+  void start (opcode op);
+  void finish (opcode next, bool has_next);
+  function_profile &function (uint32_t index);
+  uint32_t next_countdown ();
+
+  uint32_t m_period;
+  uint32_t m_countdown;
+  /// state of the generator that spreads samples out.
+  uint64_t m_random;
+
+  /// the sample in progress.
+  bool m_sampling = false;
+  opcode m_op = opcode::nop;
+  uint64_t m_start = 0;
+  std::vector<uint32_t> m_stack;
+
+  std::array<profile_entry, opcode_count> m_opcodes{};
+  std::vector<function_profile> m_functions;
+  opcode_pair_counts m_pairs;
+  /// ticks by call stack, functions then the opcode.
+  std::map<std::vector<uint32_t>, uint64_t> m_folded;
+};
+
+} // evm
+
+#endif // EVM_INTERP_PROFILER_H_
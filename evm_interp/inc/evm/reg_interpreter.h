@@ -0,0 +1,115 @@
+/** @file
+ *
+ * @brief This header contains the register interpreter
+ * (@c evm::reg_interpreter), which runs the register code of a verified
+ * program (see @c evm::lower_program), side by side with
+ * @c evm::interpreter.
+ */
+
+#ifndef EVM_INTERP_REG_INTERPRETER_H_
+#define EVM_INTERP_REG_INTERPRETER_H_
+
+#include "heap.h"
+#include "interpreter.h"
+
+#include <evm/lowering.h>
+#include <evm/primitive.h>
+#include <evm/program.h>
+#include <evm/tagged.h>
+#include <evm/verifier.h>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief Runs the functions of a program from its register code.
+ *
+ * It behaves as an @c interpreter of verified code, without tiering up or
+ * profiling, but runs fewer instructions: most loads and stores of the
+ * stack code are gone, so what is left is the arithmetic, comparisons and
+ * jumps. Dispatch is a @c switch.
+ *
+ * The registers of every frame are kept in a @c tagged_stack, whose
+ * references are the roots of the interpreter's @c heap.
+ * The frame of a callee starts at the arguments its caller passes it,
+ * so calls copy nothing.
+ *
+ * A register interpreter is not thread safe,
+ * but many can share a program and its register code.
+ */
+class reg_interpreter
+{
+public:
+  /**
+   * @brief Makes an interpreter for the register code of @c prog,
+   * @c prog, @c verified and @c code must outlive it.
+   * @param code What @c lower_program returns for @c prog and @c verified.
+   * @param options How its heap is sized, see @c heap_options.
+   * @throws std::runtime_error if @c verified or @c code are not of
+   * @c prog.
+   */
+  reg_interpreter (const program &prog, const verification &verified,
+                   const reg_program &code, heap_options options = {});
+
+  /**
+   * @brief Binds the host function called by @c reg_op::host_call with the
+   * given index. A @c host_function::task is run until it finishes.
+   * @throws std::runtime_error if the function does not match the host
+   * signature the program was verified against.
+   */
+  void bind_host (uint32_t index, host_function function);
+
+  /**
+   * @brief The heap of the strings and arrays the program refers to,
+   * through which host functions read and make them.
+   */
+  evm::heap &heap ();
+
+  /**
+   * @brief Runs a function until it returns.
+   * @param function Index of the function to run.
+   * @param args The arguments, which must match the function's signature.
+   * @return The value returned, if any.
+   * @throws std::runtime_error if the code divides by zero,
+   * a host function is not bound, or the call stack overflows.
+   */
+  std::optional<primitive_value> run (uint32_t function,
+                                      std::span<const primitive_value> args);
+
+private:
+  struct frame
+  {
+    uint32_t function;
+    /// index of the instruction to return to.
+    uint32_t return_ip;
+    /// index of the first register in the stack.
+    uint64_t base;
+    /// the register of the caller the result goes to, from the bottom of
+    /// the stack.
+    uint64_t result;
+  };
+
+  void enter (uint32_t function, uint64_t base);
+  std::optional<primitive_value> execute (uint32_t ip);
+
+  const program &m_program;
+  const verification &m_verified;
+  const reg_program &m_code;
+  std::vector<host_function> m_hosts;
+  std::vector<value_slot> m_constant_slots;
+  std::vector<primitive_type> m_constant_types;
+  tagged_stack m_registers;
+  evm::heap m_heap;
+  /// reused for the arguments of host functions.
+  std::vector<primitive_value> m_host_args;
+  std::vector<frame> m_frames;
+};
+
+} // evm
+
+#endif // EVM_INTERP_REG_INTERPRETER_H_
@@ -0,0 +1,255 @@
+#include <evm/executor.h>
+
+#include <algorithm>
+#include <exception>
+
+namespace evm
+{
+
+/// past this many, the interpreters used least recently are dropped.
+static constexpr uint64_t max_cached_interpreters = 64;
+
+/// the executor and worker the current thread belongs to, if any.
+static thread_local const executor *t_executor = nullptr;
+static thread_local unsigned t_worker = 0;
+
+executor::executor (unsigned workers)
+    : m_start (std::chrono::steady_clock::now ())
+{
+  workers = std::max (workers, 1u);
+
+  // every worker exists before any of them can steal.
+  for (unsigned i = 0; i < workers; i++)
+    m_workers.push_back (std::make_unique<worker> ());
+
+  for (unsigned i = 0; i < workers; i++)
+    m_workers[i]->thread = std::thread (&executor::work, this, i);
+}
+
+executor::~executor ()
+{
+  {
+    std::lock_guard lock (m_sleep_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all ();
+
+  for (auto &self : m_workers)
+    self->thread.join ();
+}
+
+void
+executor::bind_host (uint32_t index, host_function function)
+{
+  if (m_hosts.size () <= index)
+    m_hosts.resize (index + 1);
+
+  m_hosts[index] = std::move (function);
+}
+
+std::future<std::optional<primitive_value>>
+executor::submit (std::shared_ptr<const program> prog, uint32_t function,
+                  std::vector<primitive_value> args)
+{
+  return submit (std::move (prog), nullptr, function, std::move (args));
+}
+
+std::future<std::optional<primitive_value>>
+executor::submit (std::shared_ptr<const program> prog,
+                  std::shared_ptr<const verification> verified,
+                  uint32_t function, std::vector<primitive_value> args)
+{
+  job next{
+    .prog = std::move (prog),
+    .verified = std::move (verified),
+    .function = function,
+    .args = std::move (args),
+    .result = {},
+  };
+  auto future = next.result.get_future ();
+
+  // scripts submitted by a script stay on its worker, until stolen.
+  auto index = t_executor == this ? t_worker : m_next++ % size ();
+
+  {
+    std::lock_guard lock (m_sleep_mutex);
+    m_pending++;
+  }
+  {
+    auto &target = *m_workers[index];
+    std::lock_guard lock (target.mutex);
+    target.jobs.push_back (std::move (next));
+  }
+  m_wake.notify_one ();
+
+  return future;
+}
+
+unsigned
+executor::size () const
+{
+  return static_cast<unsigned> (m_workers.size ());
+}
+
+std::vector<worker_stats>
+executor::stats () const
+{
+  auto elapsed = std::chrono::steady_clock::now () - m_start;
+  std::vector<worker_stats> stats;
+
+  for (const auto &self : m_workers)
+    {
+      auto busy = std::chrono::nanoseconds (self->busy_ns.load ());
+
+      stats.push_back (worker_stats{
+          .jobs = self->job_count.load (),
+          .steals = self->steals.load (),
+          .busy = busy,
+          .interpreters = self->cached.load (),
+          .utilization = std::min (
+              1.0, std::chrono::duration<double> (busy).count ()
+                       / std::chrono::duration<double> (elapsed).count ()),
+      });
+    }
+
+  return stats;
+}
+
+void
+executor::work (unsigned index)
+{
+  t_executor = this;
+  t_worker = index;
+
+  auto &self = *m_workers[index];
+  job current;
+
+  for (;;)
+    {
+      if (take (index, current))
+        {
+          m_pending--;
+          run (self, current);
+          continue;
+        }
+
+      std::unique_lock lock (m_sleep_mutex);
+      m_wake.wait (lock, [this] { return m_stopping || m_pending > 0; });
+
+      if (m_stopping && m_pending == 0)
+        return;
+    }
+}
+
+bool
+executor::take (unsigned index, job &out)
+{
+  auto &self = *m_workers[index];
+
+  {
+    std::lock_guard lock (self.mutex);
+    if (!self.jobs.empty ())
+      {
+        out = std::move (self.jobs.back ());
+        self.jobs.pop_back ();
+        return true;
+      }
+  }
+
+  for (unsigned i = 1; i < size (); i++)
+    {
+      auto &victim = *m_workers[(index + i) % size ()];
+      std::lock_guard lock (victim.mutex);
+
+      if (!victim.jobs.empty ())
+        {
+          out = std::move (victim.jobs.front ());
+          victim.jobs.pop_front ();
+          self.steals++;
+          return true;
+        }
+    }
+
+  return false;
+}
+
+void
+executor::run (worker &self, job &current)
+{
+  auto start = std::chrono::steady_clock::now ();
+  std::optional<primitive_value> value;
+  std::exception_ptr error;
+
+  try
+    {
+      auto &interp = interpreter_for (self, current);
+      value = interp.run (current.function, current.args);
+    }
+  catch (...)
+    {
+      error = std::current_exception ();
+    }
+
+  // counted before the result is ready, so stats include every awaited job.
+  auto busy = std::chrono::steady_clock::now () - start;
+  self.busy_ns += static_cast<uint64_t> (
+      std::chrono::duration_cast<std::chrono::nanoseconds> (busy).count ());
+  self.job_count++;
+
+  if (error)
+    current.result.set_exception (error);
+  else
+    current.result.set_value (value);
+
+  // let go of the program.
+  current = job ();
+}
+
+interpreter &
+executor::interpreter_for (worker &self, const job &current)
+{
+  auto key = interpreter_key (current.prog.get (), current.verified.get ());
+  auto found = self.interpreter_index.find (key);
+
+  if (found != self.interpreter_index.end ())
+    {
+      self.interpreters.splice (self.interpreters.begin (),
+                                self.interpreters, found->second);
+      return *found->second->interp;
+    }
+
+  // other workers may hold the same programs, so they are dropped by how
+  // recently this one used them.
+  if (self.interpreters.size () >= max_cached_interpreters)
+    {
+      self.interpreter_index.erase (self.interpreters.back ().key);
+      self.interpreters.pop_back ();
+    }
+
+  cached_interpreter cached{
+    .key = key,
+    .prog = current.prog,
+    .verified = current.verified,
+    .interp = current.verified ? std::make_unique<interpreter> (
+                  *current.prog, *current.verified)
+                               : std::make_unique<interpreter> (*current.prog),
+  };
+
+  for (uint32_t i = 0; i < m_hosts.size (); i++)
+    {
+      // verified code can only call the hosts it was verified against.
+      if ((!m_hosts[i].call && !m_hosts[i].task)
+          || (current.verified && i >= current.verified->hosts.size ()))
+        continue;
+
+      cached.interp->bind_host (i, m_hosts[i]);
+    }
+
+  self.interpreters.push_front (std::move (cached));
+  self.interpreter_index.emplace (key, self.interpreters.begin ());
+  self.cached = self.interpreters.size ();
+
+  return *self.interpreters.front ().interp;
+}
+
+} // evm
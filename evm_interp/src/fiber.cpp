@@ -0,0 +1,76 @@
+#include <evm/fiber.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace evm
+{
+
+fiber::fiber (uint32_t function, std::vector<primitive_value> args)
+    : m_function (function), m_args (std::move (args))
+{
+}
+
+fiber::~fiber ()
+{
+  if (m_heap)
+    m_heap->remove_roots (m_stack);
+}
+
+bool
+fiber::finished () const
+{
+  return m_finished;
+}
+
+std::optional<primitive_value>
+fiber::result () const
+{
+  if (!m_finished)
+    throw std::runtime_error ("Fiber has not finished.");
+  if (m_error)
+    std::rethrow_exception (m_error);
+
+  return m_result;
+}
+
+scheduler::scheduler (interpreter &interp) : m_interp (interp) {}
+
+std::shared_ptr<fiber>
+scheduler::spawn (uint32_t function, std::vector<primitive_value> args)
+{
+  auto spawned = std::make_shared<fiber> (function, std::move (args));
+  m_fibers.push_back (spawned);
+  return spawned;
+}
+
+bool
+scheduler::step ()
+{
+  // the fibers spawned during the turn wait for the next one.
+  for (auto count = m_fibers.size (); count > 0; count--)
+    {
+      auto next = std::move (m_fibers.front ());
+      m_fibers.pop_front ();
+
+      if (!m_interp.resume (*next))
+        m_fibers.push_back (std::move (next));
+    }
+
+  return !m_fibers.empty ();
+}
+
+void
+scheduler::run ()
+{
+  while (step ())
+    ;
+}
+
+uint64_t
+scheduler::size () const
+{
+  return m_fibers.size ();
+}
+
+} // evm
@@ -0,0 +1,453 @@
+#include <evm/heap.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace evm
+{
+
+/// the smallest the nursery in use shrinks to, see heap_options::pause_target.
+static constexpr uint64_t min_nursery_limit = 4096;
+
+/**
+ * The start of every object, followed by its contents:
+ * the characters of a string,
+ * or the slots then the types of the values of an array.
+ */
+struct heap::object_header
+{
+  uint32_t length;
+  object_kind kind;
+  /// set once copied by a collection, the new address then replaces the
+  /// contents.
+  bool forwarded;
+  /// whether it is in m_remembered.
+  bool remembered;
+  uint8_t reserved;
+};
+
+static_assert (sizeof (value_slot) == 8);
+
+/**
+ * The size of an object, rounded up so the next one is aligned,
+ * and with room for a forwarding address.
+ */
+static uint64_t
+object_size (object_kind kind, uint64_t length)
+{
+  auto contents = kind == object_kind::string
+                      ? length
+                      : length * (sizeof (value_slot) + 1);
+  auto size = (8 + contents + 7) & ~uint64_t (7);
+
+  return std::max<uint64_t> (size, 16);
+}
+
+static char *
+chars_of (void *object)
+{
+  return static_cast<char *> (object) + 8;
+}
+
+static value_slot *
+slots_of (void *object)
+{
+  return reinterpret_cast<value_slot *> (static_cast<std::byte *> (object)
+                                         + 8);
+}
+
+static primitive_type *
+types_of (void *object, uint32_t length)
+{
+  return reinterpret_cast<primitive_type *> (slots_of (object) + length);
+}
+
+heap::heap (heap_options options) : m_options (options)
+{
+  m_nursery.size = std::max (m_options.nursery_size, min_nursery_limit);
+  m_nursery.memory.reset (new std::byte[m_nursery.size]);
+  m_stats.nursery_limit = m_nursery.size;
+  m_major_threshold = m_options.chunk_size;
+
+  add_roots (m_pinned);
+}
+
+heap::~heap () = default;
+
+std::byte *
+heap::allocate (uint64_t size)
+{
+  m_stats.allocated += size;
+
+  // large objects would fill the nursery, and be copied out anyway.
+  if (size > m_stats.nursery_limit / 4)
+    {
+      if (m_stats.tenured + size > m_major_threshold)
+        collect_garbage (true);
+      return allocate_tenured (size);
+    }
+
+  if (m_nursery.used + size > m_stats.nursery_limit)
+    collect_garbage (false);
+
+  auto *object = m_nursery.memory.get () + m_nursery.used;
+  m_nursery.used += size;
+  return object;
+}
+
+std::byte *
+heap::allocate_tenured (uint64_t size)
+{
+  if (m_tenured.empty ()
+      || m_tenured.back ().size - m_tenured.back ().used < size)
+    {
+      arena chunk;
+      chunk.size = std::max (m_options.chunk_size, size);
+      chunk.memory.reset (new std::byte[chunk.size]);
+      m_tenured.push_back (std::move (chunk));
+    }
+
+  auto &chunk = m_tenured.back ();
+  auto *object = chunk.memory.get () + chunk.used;
+  chunk.used += size;
+  m_stats.tenured += size;
+
+  return object;
+}
+
+heap::object_header *
+heap::object_of (value_slot ref, object_kind kind) const
+{
+  if (ref == 0)
+    throw std::runtime_error ("Null reference.");
+
+  auto *header = reinterpret_cast<object_header *> (ref);
+  if (header->kind != kind)
+    throw std::runtime_error (kind == object_kind::string
+                                  ? "Object is not a string."
+                                  : "Object is not an array.");
+
+  return header;
+}
+
+bool
+heap::in_nursery (value_slot ref) const
+{
+  auto base = reinterpret_cast<value_slot> (m_nursery.memory.get ());
+  return ref - base < m_nursery.size;
+}
+
+value_slot
+heap::make_string (std::string_view chars)
+{
+  if (chars.size () > UINT32_MAX)
+    throw std::runtime_error ("String is too long.");
+
+  auto length = static_cast<uint32_t> (chars.size ());
+  auto *object = allocate (object_size (object_kind::string, length));
+
+  new (object) object_header{ .length = length,
+                              .kind = object_kind::string,
+                              .forwarded = false,
+                              .remembered = false,
+                              .reserved = 0 };
+  std::memcpy (chars_of (object), chars.data (), length);
+
+  return reinterpret_cast<value_slot> (object);
+}
+
+value_slot
+heap::concat (value_slot lhs, value_slot rhs)
+{
+  uint64_t lhs_length = object_of (lhs, object_kind::string)->length;
+  uint64_t rhs_length = object_of (rhs, object_kind::string)->length;
+
+  if (lhs_length + rhs_length > UINT32_MAX)
+    throw std::runtime_error ("String is too long.");
+
+  auto length = static_cast<uint32_t> (lhs_length + rhs_length);
+
+  // allocating may move them, so they are roots until it is done.
+  auto pinned = m_pinned.size ();
+  m_pinned.push (lhs, REF_TYPE);
+  m_pinned.push (rhs, REF_TYPE);
+
+  std::byte *object;
+  try
+    {
+      object = allocate (object_size (object_kind::string, length));
+    }
+  catch (...)
+    {
+      m_pinned.pop (2);
+      throw;
+    }
+
+  lhs = m_pinned.slot (pinned);
+  rhs = m_pinned.slot (pinned + 1);
+  m_pinned.pop (2);
+
+  new (object) object_header{ .length = length,
+                              .kind = object_kind::string,
+                              .forwarded = false,
+                              .remembered = false,
+                              .reserved = 0 };
+  std::memcpy (chars_of (object),
+               chars_of (reinterpret_cast<void *> (lhs)), lhs_length);
+  std::memcpy (chars_of (object) + lhs_length,
+               chars_of (reinterpret_cast<void *> (rhs)), rhs_length);
+
+  return reinterpret_cast<value_slot> (object);
+}
+
+value_slot
+heap::make_array (uint32_t length)
+{
+  auto *object = allocate (object_size (object_kind::array, length));
+
+  new (object) object_header{ .length = length,
+                              .kind = object_kind::array,
+                              .forwarded = false,
+                              .remembered = false,
+                              .reserved = 0 };
+  std::fill_n (slots_of (object), length, 0);
+  std::fill_n (types_of (object, length), length, REF_TYPE);
+
+  return reinterpret_cast<value_slot> (object);
+}
+
+object_kind
+heap::kind (value_slot ref) const
+{
+  if (ref == 0)
+    throw std::runtime_error ("Null reference.");
+
+  return reinterpret_cast<object_header *> (ref)->kind;
+}
+
+std::string_view
+heap::string (value_slot ref) const
+{
+  auto *header = object_of (ref, object_kind::string);
+  return std::string_view (chars_of (header), header->length);
+}
+
+uint32_t
+heap::length (value_slot ref) const
+{
+  if (ref == 0)
+    throw std::runtime_error ("Null reference.");
+
+  return reinterpret_cast<object_header *> (ref)->length;
+}
+
+primitive_value
+heap::get (value_slot ref, uint32_t index) const
+{
+  auto *header = object_of (ref, object_kind::array);
+  if (index >= header->length)
+    throw std::runtime_error ("Index out of range.");
+
+  return from_slot (slots_of (header)[index],
+                    types_of (header, header->length)[index]);
+}
+
+void
+heap::set (value_slot ref, uint32_t index, value_slot slot,
+           primitive_type type)
+{
+  auto *header = object_of (ref, object_kind::array);
+  if (index >= header->length)
+    throw std::runtime_error ("Index out of range.");
+  if (type > REF_TYPE)
+    throw std::runtime_error ("Invalid Type Specifier.");
+
+  slots_of (header)[index] = slot;
+  types_of (header, header->length)[index] = type;
+
+  // the write barrier: a tenured array that refers into the nursery is
+  // a root of the next nursery collection.
+  if (type == REF_TYPE && slot != 0 && in_nursery (slot) && !in_nursery (ref)
+      && !header->remembered)
+    {
+      header->remembered = true;
+      m_remembered.push_back (reinterpret_cast<std::byte *> (header));
+    }
+}
+
+void
+heap::set (value_slot ref, uint32_t index, const primitive_value &value)
+{
+  set (ref, index, to_slot (value), primitive_get_type (value));
+}
+
+void
+heap::add_roots (tagged_stack &stack)
+{
+  m_roots.insert (&stack);
+}
+
+void
+heap::remove_roots (tagged_stack &stack)
+{
+  m_roots.erase (&stack);
+}
+
+void
+heap::collect (bool full)
+{
+  collect_garbage (full);
+}
+
+const heap_stats &
+heap::stats () const
+{
+  return m_stats;
+}
+
+const heap_options &
+heap::options () const
+{
+  return m_options;
+}
+
+/**
+ * Copies an object out of the space being collected, once,
+ * and returns where it is now.
+ */
+value_slot
+heap::evacuate (value_slot ref, bool full)
+{
+  if (ref == 0 || (!full && !in_nursery (ref)))
+    return ref;
+
+  auto *header = reinterpret_cast<object_header *> (ref);
+  value_slot moved;
+
+  if (header->forwarded)
+    {
+      std::memcpy (&moved, chars_of (header), sizeof (moved));
+      return moved;
+    }
+
+  auto size = object_size (header->kind, header->length);
+  auto *copy = allocate_tenured (size);
+  std::memcpy (copy, header, size);
+  reinterpret_cast<object_header *> (copy)->remembered = false;
+
+  if (in_nursery (ref))
+    m_stats.promoted += size;
+
+  moved = reinterpret_cast<value_slot> (copy);
+  header->forwarded = true;
+  std::memcpy (chars_of (header), &moved, sizeof (moved));
+
+  if (header->kind == object_kind::array)
+    m_work.push_back (copy);
+
+  return moved;
+}
+
+/**
+ * Copies what the values of an array refer to.
+ */
+void
+heap::scan (std::byte *object, bool full)
+{
+  auto *header = reinterpret_cast<object_header *> (object);
+  auto *slots = slots_of (object);
+  auto *types = types_of (object, header->length);
+
+  for (uint32_t i = 0; i < header->length; i++)
+    if (types[i] == REF_TYPE)
+      slots[i] = evacuate (slots[i], full);
+}
+
+/**
+ * Copies what is live out of the nursery, or out of the whole heap if
+ * @c full, and frees the rest.
+ */
+void
+heap::copy_live (bool full)
+{
+  // a full collection copies the tenured space too, into new chunks.
+  std::vector<arena> old;
+  if (full)
+    {
+      old = std::move (m_tenured);
+      m_tenured.clear ();
+      m_stats.tenured = 0;
+    }
+
+  for (auto *stack : m_roots)
+    for (uint64_t i = 0; i < stack->size (); i++)
+      if (stack->type (i) == REF_TYPE)
+        stack->slot (i) = evacuate (stack->slot (i), full);
+
+  // the tenured space is not scanned by a nursery collection,
+  // but for the arrays the write barrier saw refer into the nursery.
+  for (auto *object : m_remembered)
+    {
+      reinterpret_cast<object_header *> (object)->remembered = false;
+      if (!full)
+        scan (object, full);
+    }
+  m_remembered.clear ();
+
+  while (!m_work.empty ())
+    {
+      auto *object = m_work.back ();
+      m_work.pop_back ();
+      scan (object, full);
+    }
+
+  m_nursery.used = 0;
+
+  if (full)
+    m_stats.major_collections++;
+  else
+    m_stats.minor_collections++;
+}
+
+void
+heap::collect_garbage (bool full)
+{
+  auto start = std::chrono::steady_clock::now ();
+  copy_live (full);
+
+  // collects the tenured space as well, once what was promoted grew it.
+  bool minor = !full;
+  if (minor && m_stats.tenured > m_major_threshold)
+    {
+      copy_live (true);
+      full = true;
+    }
+
+  if (full)
+    m_major_threshold = std::max (
+        m_options.chunk_size,
+        static_cast<uint64_t> (static_cast<double> (m_stats.tenured)
+                               * m_options.growth));
+
+  auto pause = std::chrono::duration_cast<std::chrono::nanoseconds> (
+      std::chrono::steady_clock::now () - start);
+  m_stats.longest_pause = std::max (m_stats.longest_pause, pause);
+  m_stats.total_pause += pause;
+
+  // only the nursery is sized to the pause target,
+  // full collections take as long as the tenured space needs.
+  auto target = m_options.pause_target;
+  auto &limit = m_stats.nursery_limit;
+
+  if (target.count () > 0 && minor && !full)
+    {
+      if (pause > target)
+        limit = std::max (limit / 2, min_nursery_limit);
+      else if (pause < target / 2)
+        limit = std::min (limit * 2, m_nursery.size);
+    }
+}
+
+} // evm
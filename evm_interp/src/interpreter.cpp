@@ -0,0 +1,1180 @@
+#include <evm/arith.h>
+#include <evm/fiber.h>
+#include <evm/interpreter.h>
+
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Pick a dispatch strategy if the build did not.
+#if !defined(EVM_DISPATCH_THREADED) && !defined(EVM_DISPATCH_SWITCH)
+#if defined(__GNUC__)
+#define EVM_DISPATCH_THREADED
+#else
+#define EVM_DISPATCH_SWITCH
+#endif
+#endif
+
+#if defined(EVM_DISPATCH_THREADED) && !defined(__GNUC__)
+#error "Threaded dispatch needs labels as values (GCC or Clang)."
+#endif
+
+namespace evm
+{
+
+/// the deepest the call stack can get.
+static constexpr uint64_t max_call_depth = 1 << 16;
+/// how many times a quickened instruction may fail its guard,
+/// before it is left generic.
+static constexpr uint8_t megamorphic_deopts = 4;
+
+/// an arithmetic operation or comparison, as a type.
+template <arith_op OP> using arith_t = std::integral_constant<arith_op, OP>;
+template <compare_op OP>
+using compare_t = std::integral_constant<compare_op, OP>;
+
+/**
+ * Compares two slots of the given type, with a comparison opcode.
+ */
+static bool
+compare_with (opcode op, primitive_type type, value_slot lhs, value_slot rhs)
+{
+  auto index = kernel_index (type, type);
+
+  switch (op)
+    {
+    case opcode::eq:
+      return compare_table<compare_op::eq>[index](lhs, rhs);
+    case opcode::ne:
+      return compare_table<compare_op::ne>[index](lhs, rhs);
+    case opcode::lt:
+      return compare_table<compare_op::lt>[index](lhs, rhs);
+    case opcode::le:
+      return compare_table<compare_op::le>[index](lhs, rhs);
+    case opcode::gt:
+      return compare_table<compare_op::gt>[index](lhs, rhs);
+    case opcode::ge:
+      return compare_table<compare_op::ge>[index](lhs, rhs);
+    default:
+      throw std::runtime_error ("Invalid opcode.");
+    }
+}
+
+static bool
+truthy (primitive_type type, value_slot slot)
+{
+  // a reference is true unless it is null.
+  if (type == REF_TYPE)
+    return slot != 0;
+
+  return visit_type (type, [slot] (auto tag) {
+    return from_slot<decltype (tag)::value> (slot) != 0;
+  });
+}
+
+interpreter::interpreter (const program &prog, heap_options options)
+    : m_program (prog), m_heap (options)
+{
+  m_heap.add_roots (m_stack);
+
+  m_constant_slots.reserve (prog.constants.size ());
+  m_constant_types.reserve (prog.constants.size ());
+
+  for (const auto &constant : prog.constants)
+    {
+      m_constant_slots.push_back (to_slot (constant));
+      m_constant_types.push_back (primitive_get_type (constant));
+    }
+}
+
+interpreter::interpreter (const program &prog, const verification &verified,
+                          heap_options options)
+    : interpreter (prog, options)
+{
+  if (verified.depths.size () != prog.code.size ()
+      || verified.frame_sizes.size () != prog.functions.size ())
+    throw std::runtime_error ("Verification is not of this program.");
+
+  m_verified = &verified;
+}
+
+void
+interpreter::bind_host (uint32_t index, host_function function)
+{
+  if (m_verified
+      && (index >= m_verified->hosts.size ()
+          || function.arg_count != m_verified->hosts[index].args.size ()))
+    throw std::runtime_error ("Host function does not match its signature.");
+
+  if (m_hosts.size () <= index)
+    m_hosts.resize (index + 1);
+
+  m_hosts[index] = std::move (function);
+}
+
+void
+interpreter::set_tier_up (tier_up *compiler, uint32_t call_threshold,
+                          uint32_t back_edge_threshold)
+{
+  if (!m_verified)
+    throw std::runtime_error ("Only verified code can be compiled.");
+
+  m_tier_up = compiler;
+  m_call_threshold = call_threshold;
+  m_back_edge_threshold = back_edge_threshold;
+  m_tiers.assign (m_program.functions.size (), tier_state ());
+}
+
+void
+interpreter::set_profiler (profiler *prof)
+{
+  if (!profiling_enabled ())
+    throw std::runtime_error ("Profiling was not compiled in.");
+
+  m_profiler = prof;
+}
+
+heap &
+interpreter::heap ()
+{
+  return m_heap;
+}
+
+std::span<const opcode>
+interpreter::quickened_code () const
+{
+  return m_opcodes;
+}
+
+bool
+interpreter::compiled (uint32_t function) const
+{
+  return function < m_tiers.size () && m_tiers[function].native;
+}
+
+native_function
+interpreter::native_for (uint32_t function)
+{
+  auto &tier = m_tiers[function];
+  tier.calls++;
+
+  if (!tier.native && !tier.tried
+      && (tier.calls >= m_call_threshold
+          || tier.back_edges >= m_back_edge_threshold))
+    {
+      tier.tried = true;
+      tier.native = m_tier_up->compile (function);
+    }
+
+  return tier.native;
+}
+
+void
+interpreter::call_native (uint32_t function, native_function native)
+{
+  const auto &info = m_program.functions[function];
+  auto base = m_stack.size () - info.arg_count;
+
+  m_stack.reserve (base + m_verified->frame_sizes[function]);
+  // zeroes the other locals.
+  m_stack.resize (base + info.locals.size ());
+
+  if (!native (&m_stack.slot (base)))
+    throw std::runtime_error ("Division by zero.");
+
+  auto result = m_stack.slot (base);
+  m_stack.pop (m_stack.size () - base);
+
+  if (info.result)
+    m_stack.push (result, *info.result);
+}
+
+std::optional<primitive_value>
+interpreter::run (uint32_t function, std::span<const primitive_value> args)
+{
+  if (function >= m_program.functions.size ())
+    throw std::runtime_error ("Function does not exist.");
+
+  const auto &info = m_program.functions[function];
+  if (args.size () != info.arg_count)
+    throw std::runtime_error ("Wrong number of arguments.");
+
+  m_stack.clear ();
+  m_frames.clear ();
+
+#ifdef EVM_INTERP_PROFILE
+  // times the last instruction, however the run ends.
+  struct flush_guard
+  {
+    profiler *prof;
+    ~flush_guard ()
+    {
+      if (prof)
+        prof->flush ();
+    }
+  } guard{ m_profiler };
+#endif
+
+  for (const auto &arg : args)
+    m_stack.push (arg);
+
+  return start (function);
+}
+
+bool
+interpreter::resume (fiber &f)
+{
+  if (f.m_finished)
+    return true;
+
+  if (!f.m_heap)
+    {
+      m_heap.add_roots (f.m_stack);
+      f.m_heap = &m_heap;
+    }
+  else if (f.m_heap != &m_heap)
+    throw std::runtime_error ("Fiber was run by another interpreter.");
+
+  auto swap_state = [&] () {
+    std::swap (m_stack, f.m_stack);
+    std::swap (m_frames, f.m_frames);
+    std::swap (m_host_args, f.m_host_args);
+    std::swap (m_task, f.m_task);
+  };
+
+#ifdef EVM_INTERP_PROFILE
+  struct flush_guard
+  {
+    profiler *prof;
+    ~flush_guard ()
+    {
+      if (prof)
+        prof->flush ();
+    }
+  } guard{ m_profiler };
+#endif
+
+  swap_state ();
+  m_fiber = &f;
+
+  // errors end the fiber rather than the turn, so the state is always
+  // swapped back.
+  try
+    {
+      std::optional<primitive_value> result;
+
+      if (!f.m_started)
+        {
+          f.m_started = true;
+
+          if (f.m_function >= m_program.functions.size ())
+            throw std::runtime_error ("Function does not exist.");
+          if (f.m_args.size ()
+              != m_program.functions[f.m_function].arg_count)
+            throw std::runtime_error ("Wrong number of arguments.");
+
+          for (const auto &arg : f.m_args)
+            m_stack.push (arg);
+          f.m_args = {};
+
+          result = start (f.m_function);
+        }
+      else
+        {
+          m_task.resume ();
+
+          if (m_task.done ())
+            {
+              auto task = std::move (m_task);
+
+              if (m_verified)
+                {
+                  finish_host_call<false> (f.m_host, task.result ());
+                  result = execute<false> (f.m_ip + 1);
+                }
+              else
+                {
+                  finish_host_call<true> (f.m_host, task.result ());
+                  result = execute<true> (f.m_ip + 1);
+                }
+            }
+        }
+
+      if (!m_task)
+        {
+          f.m_result = std::move (result);
+          f.m_finished = true;
+        }
+    }
+  catch (...)
+    {
+      m_task = {};
+      f.m_error = std::current_exception ();
+      f.m_finished = true;
+    }
+
+  m_fiber = nullptr;
+  swap_state ();
+
+  if (!f.m_finished)
+    return false;
+
+  // only the result is kept.
+  m_heap.remove_roots (f.m_stack);
+  f.m_heap = nullptr;
+  f.m_stack = {};
+  f.m_frames = {};
+  f.m_host_args = {};
+  return true;
+}
+
+std::optional<primitive_value>
+interpreter::start (uint32_t function)
+{
+  const auto &info = m_program.functions[function];
+
+  if (!m_verified)
+    {
+      enter<true> (function, 0);
+      return execute<true> (info.entry);
+    }
+
+  // the arguments come from the host, so they are checked anyway.
+  for (uint64_t i = 0; i < info.arg_count; i++)
+    if (m_stack.type (i) != info.locals[i])
+      throw std::runtime_error ("Argument does not match its type.");
+
+  if (m_tier_up)
+    if (auto native = native_for (function))
+      {
+#ifdef EVM_INTERP_PROFILE
+        if (m_profiler)
+          m_profiler->enter (function);
+#endif
+        call_native (function, native);
+
+        if (!info.result)
+          return std::nullopt;
+        return m_stack.get (0);
+      }
+
+  enter<false> (function, 0);
+  return execute<false> (info.entry);
+}
+
+std::string_view
+interpreter::dispatch_name ()
+{
+#ifdef EVM_DISPATCH_THREADED
+  return "threaded";
+#else
+  return "switch";
+#endif
+}
+
+bool
+interpreter::profiling_enabled ()
+{
+#ifdef EVM_INTERP_PROFILE
+  return true;
+#else
+  return false;
+#endif
+}
+
+template <bool checked>
+void
+interpreter::enter (uint32_t function, uint64_t return_ip)
+{
+  const auto &info = m_program.functions[function];
+
+  if (m_frames.size () >= max_call_depth)
+    throw std::runtime_error ("Call stack overflow.");
+
+  if constexpr (checked)
+    {
+      if (m_stack.size () < info.arg_count)
+        throw std::runtime_error ("Operand stack underflow.");
+
+      for (uint64_t i = 0; i < info.arg_count; i++)
+        if (m_stack.type (m_stack.size () - info.arg_count + i)
+            != info.locals[i])
+          throw std::runtime_error ("Argument does not match its type.");
+    }
+
+  auto base = m_stack.size () - info.arg_count;
+
+  // the whole frame fits from here on, verified code never grows the stack.
+  if constexpr (!checked)
+    m_stack.reserve (base + m_verified->frame_sizes[function]);
+
+  // a zero slot is zero for every type.
+  for (uint64_t i = info.arg_count; i < info.locals.size (); i++)
+    {
+      if constexpr (checked)
+        m_stack.push (0, info.locals[i]);
+      else
+        m_stack.push_unchecked (0, info.locals[i]);
+    }
+
+  m_frames.push_back (
+      frame{ .function = function, .return_ip = return_ip, .base = base });
+
+#ifdef EVM_INTERP_PROFILE
+  if (m_profiler)
+    m_profiler->enter (function);
+#endif
+}
+
+template <bool checked>
+void
+interpreter::finish_host_call (uint32_t index,
+                               std::optional<primitive_value> result)
+{
+  // the verifier trusted the signature, so hold the host to it.
+  if constexpr (!checked)
+    {
+      std::optional<primitive_type> type;
+      if (result)
+        type = primitive_get_type (*result);
+
+      if (type != m_verified->hosts[index].result)
+        throw std::runtime_error (
+            "Host function does not match its signature.");
+    }
+
+  m_stack.pop (m_hosts[index].arg_count);
+  if (result)
+    m_stack.push (*result);
+}
+
+template <bool checked>
+std::optional<primitive_value>
+interpreter::execute (uint64_t ip)
+{
+  const auto &code = m_program.code;
+  const auto *operands = code.operands.data ();
+
+#ifdef EVM_DISPATCH_THREADED
+  // in the same order as opcode, quickened opcodes included.
+  static const void *const labels[] = {
+    &&op_nop,       &&op_load_const, &&op_pop,       &&op_dup,
+    &&op_swap,      &&op_load_local, &&op_store_local, &&op_add,
+    &&op_sub,       &&op_mul,        &&op_div,       &&op_rem,
+    &&op_neg,       &&op_eq,         &&op_ne,        &&op_lt,
+    &&op_le,        &&op_gt,         &&op_ge,        &&op_conv,
+    &&op_jump,      &&op_jump_if,    &&op_jump_unless, &&op_call,
+    &&op_ret,       &&op_host_call,  &&op_add_const, &&op_sub_const,
+    &&op_branch_local, &&op_branch_const, &&op_load_string, &&op_concat,
+    &&op_add_i64,   &&op_sub_i64,    &&op_mul_i64,   &&op_eq_i64,
+    &&op_ne_i64,    &&op_lt_i64,     &&op_le_i64,    &&op_gt_i64,
+    &&op_ge_i64,    &&op_add_const_i64, &&op_sub_const_i64, &&op_add_f64,
+    &&op_sub_f64,   &&op_mul_f64,    &&op_eq_f64,    &&op_ne_f64,
+    &&op_lt_f64,    &&op_le_f64,     &&op_gt_f64,    &&op_ge_f64,
+    &&op_add_const_f64, &&op_sub_const_f64,
+  };
+  static_assert (sizeof (labels) / sizeof (labels[0])
+                 == quickened_opcode_count);
+#endif
+
+  // this interpreter's own copy of the code, which it quickens as it runs.
+  if (m_opcodes.size () != code.size ())
+    {
+      m_opcodes = code.opcodes;
+      m_deopts.assign (code.size (), 0);
+
+      // verified types never change, so those instructions are quickened
+      // at once and need no guard.
+      if constexpr (!checked)
+        for (uint64_t i = 0; i < code.size (); i++)
+          if (m_verified->reachable (i) && m_verified->depths[i] > 0)
+            m_opcodes[i] = quickened_opcode (
+                m_opcodes[i], m_verified->stack_types (i).back ());
+
+#ifdef EVM_DISPATCH_THREADED
+      // thread the code, with a sentinel for running off the end.
+      m_threaded.clear ();
+      m_threaded.reserve (code.size () + 1);
+
+      for (auto op : m_opcodes)
+        m_threaded.push_back (labels[static_cast<uint8_t> (op)]);
+      m_threaded.push_back (&&op_end);
+#endif
+    }
+
+  const function_info *info;
+  // index of the first local, and of the first operand of the frame.
+  uint64_t base, floor;
+  // the counters of the function, when tiering up.
+  tier_state *tier = nullptr;
+
+  auto load_frame = [&] () {
+    const auto &top = m_frames.back ();
+    info = &m_program.functions[top.function];
+    base = top.base;
+    floor = base + info->locals.size ();
+
+    if constexpr (!checked)
+      tier = m_tier_up ? &m_tiers[top.function] : nullptr;
+  };
+  load_frame ();
+
+  auto require = [&] (uint64_t count) {
+    if constexpr (checked)
+      if (m_stack.size () - floor < count)
+        throw std::runtime_error ("Operand stack underflow.");
+  };
+
+  auto same_types = [&] (uint64_t top) {
+    if constexpr (checked)
+      if (m_stack.type (top) != m_stack.type (top - 1))
+        throw std::runtime_error ("Operands have different types.");
+  };
+
+  // references can not be added or compared, checked by the verifier
+  // otherwise.
+  auto numbers = [&] (primitive_type type) {
+    if constexpr (checked)
+      if (!is_number_type (type))
+        throw std::runtime_error ("Operands are not numbers.");
+  };
+
+  auto push = [&] (value_slot slot, primitive_type type) {
+    if constexpr (checked)
+      m_stack.push (slot, type);
+    else
+      m_stack.push_unchecked (slot, type);
+  };
+
+  // applies op to two slots of the same type, inline for i64.
+  auto apply = [] (auto op, primitive_type type, value_slot lhs,
+                   value_slot rhs) {
+    constexpr auto OP = decltype (op)::value;
+
+    if (type == I64_TYPE)
+      return arith<OP, I64_TYPE> (lhs, rhs);
+    return arith_table<OP>[kernel_index (type, type)](lhs, rhs);
+  };
+
+  auto binary = [&] (auto op) {
+    require (2);
+    auto top = m_stack.size () - 1;
+    auto type = m_stack.type (top);
+    same_types (top);
+    numbers (type);
+
+    m_stack.slot (top - 1)
+        = apply (op, type, m_stack.slot (top - 1), m_stack.slot (top));
+    m_stack.pop ();
+    return type;
+  };
+
+  auto comparison = [&] (auto op) {
+    constexpr auto OP = decltype (op)::value;
+    require (2);
+    auto top = m_stack.size () - 1;
+    auto type = m_stack.type (top);
+    same_types (top);
+    numbers (type);
+
+    auto lhs = m_stack.slot (top - 1);
+    auto rhs = m_stack.slot (top);
+
+    m_stack.slot (top - 1)
+        = type == I64_TYPE
+              ? compare<OP, I64_TYPE> (lhs, rhs)
+              : compare_table<OP>[kernel_index (type, type)](lhs, rhs);
+    m_stack.type (top - 1) = U8_TYPE;
+    m_stack.pop ();
+    return type;
+  };
+
+  // counts jumps back, which make the function compile on its next call.
+  auto jump_to = [&] (uint64_t target) {
+    if constexpr (!checked)
+      if (tier && target <= ip)
+        tier->back_edges++;
+    return target;
+  };
+
+  // applies op to the top value and a constant, in place.
+  auto binary_const = [&] (uint64_t index, auto op) {
+    if constexpr (checked)
+      if (index >= m_constant_slots.size ())
+        throw std::runtime_error ("Constant does not exist.");
+
+    require (1);
+    auto top = m_stack.size () - 1;
+    auto type = m_stack.type (top);
+
+    if constexpr (checked)
+      if (type != m_constant_types[index])
+        throw std::runtime_error ("Operands have different types.");
+
+    m_stack.slot (top)
+        = apply (op, type, m_stack.slot (top), m_constant_slots[index]);
+    return type;
+  };
+
+  // rewrites the instruction being run.
+  auto rewrite = [&] (opcode op) {
+    m_opcodes[ip] = op;
+#ifdef EVM_DISPATCH_THREADED
+    m_threaded[ip] = labels[static_cast<uint8_t> (op)];
+#endif
+  };
+
+  // quickens the generic instruction just run for the type of its operands,
+  // unless it has seen too many types.
+  auto quicken = [&] (primitive_type type) {
+    if constexpr (checked)
+      if (m_deopts[ip] < megamorphic_deopts)
+        rewrite (quickened_opcode (m_opcodes[ip], type));
+  };
+
+  // whether the top values are of the type a quickened instruction is for,
+  // which verified code proves.
+  auto guard = [&] (uint64_t count, primitive_type type) {
+    if constexpr (checked)
+      {
+        if (m_stack.size () - floor < count)
+          return false;
+        for (uint64_t i = 1; i <= count; i++)
+          if (m_stack.type (m_stack.size () - i) != type)
+            return false;
+      }
+    return true;
+  };
+
+  // rewrites a quickened instruction back to its generic form,
+  // which then runs instead.
+  auto deopt = [&] () {
+    m_deopts[ip]++;
+    rewrite (generic_opcode (m_opcodes[ip]));
+  };
+
+  // pops the top value and compares it with another for a fused branch,
+  // then returns where to continue.
+  auto branch = [&] (branch_operand fused, value_slot rhs,
+                     primitive_type rhs_type) -> uint64_t {
+    require (1);
+    auto top = m_stack.size () - 1;
+    auto type = m_stack.type (top);
+
+    if constexpr (checked)
+      if (type != rhs_type)
+        throw std::runtime_error ("Operands have different types.");
+    numbers (type);
+
+    bool holds = compare_with (fused.compare, type, m_stack.slot (top), rhs);
+    m_stack.pop ();
+
+    return holds == (fused.jump == opcode::jump_if) ? jump_to (fused.target)
+                                                    : ip + 1;
+  };
+
+  // pops the top value, and returns whether it is true.
+  auto condition = [&] () {
+    require (1);
+    auto top = m_stack.size () - 1;
+    bool result = truthy (m_stack.type (top), m_stack.slot (top));
+
+    m_stack.pop ();
+    return result;
+  };
+
+  auto local = [&] (uint64_t index) {
+    if constexpr (checked)
+      if (index >= info->locals.size ())
+        throw std::runtime_error ("Local variable does not exist.");
+    return base + index;
+  };
+
+#ifdef EVM_INTERP_PROFILE
+  // appends the functions being run, for the profiler's samples.
+  auto call_stack = [this] (std::vector<uint32_t> &stack) {
+    for (const auto &active : m_frames)
+      stack.push_back (active.function);
+  };
+
+#define PROFILE()                                                             \
+  if (m_profiler && ip < code.size ())                                        \
+  m_profiler->step (code.opcodes[ip], call_stack)
+#else
+#define PROFILE()
+#endif
+
+#ifdef EVM_DISPATCH_THREADED
+  const void *const *threaded = m_threaded.data ();
+
+#define TARGET(op) op_##op:
+#define DISPATCH()                                                            \
+  do                                                                          \
+    {                                                                         \
+      PROFILE ();                                                             \
+      goto *threaded[ip];                                                     \
+    }                                                                         \
+  while (0)
+
+  DISPATCH ();
+#else
+  const auto *opcodes = m_opcodes.data ();
+
+#define TARGET(op) case opcode::op:
+#define DISPATCH() continue
+
+  for (;;)
+    {
+      if (ip >= code.size ())
+        goto op_end;
+
+      PROFILE ();
+      switch (opcodes[ip])
+        {
+#endif
+
+#define NEXT()                                                                \
+  ip++;                                                                       \
+  DISPATCH ()
+
+  TARGET (nop) { NEXT (); }
+
+  TARGET (load_const)
+  {
+    auto index = operands[ip];
+    if constexpr (checked)
+      if (index >= m_constant_slots.size ())
+        throw std::runtime_error ("Constant does not exist.");
+
+    push (m_constant_slots[index], m_constant_types[index]);
+    NEXT ();
+  }
+
+  TARGET (pop)
+  {
+    require (1);
+    m_stack.pop ();
+    NEXT ();
+  }
+
+  TARGET (dup)
+  {
+    require (1);
+    auto top = m_stack.size () - 1;
+    push (m_stack.slot (top), m_stack.type (top));
+    NEXT ();
+  }
+
+  TARGET (swap)
+  {
+    require (2);
+    auto top = m_stack.size () - 1;
+    std::swap (m_stack.slot (top), m_stack.slot (top - 1));
+    std::swap (m_stack.type (top), m_stack.type (top - 1));
+    NEXT ();
+  }
+
+  TARGET (load_local)
+  {
+    auto index = local (operands[ip]);
+    push (m_stack.slot (index), m_stack.type (index));
+    NEXT ();
+  }
+
+  TARGET (store_local)
+  {
+    auto index = local (operands[ip]);
+    require (1);
+
+    auto top = m_stack.size () - 1;
+    if constexpr (checked)
+      if (m_stack.type (top) != m_stack.type (index))
+        throw std::runtime_error ("Value does not match the local's type.");
+
+    m_stack.slot (index) = m_stack.slot (top);
+    m_stack.pop ();
+    NEXT ();
+  }
+
+  TARGET (add)
+  {
+    quicken (binary (arith_t<arith_op::add> ()));
+    NEXT ();
+  }
+
+  TARGET (sub)
+  {
+    quicken (binary (arith_t<arith_op::sub> ()));
+    NEXT ();
+  }
+
+  TARGET (mul)
+  {
+    quicken (binary (arith_t<arith_op::mul> ()));
+    NEXT ();
+  }
+
+  TARGET (div)
+  {
+    binary (arith_t<arith_op::div> ());
+    NEXT ();
+  }
+
+  TARGET (rem)
+  {
+    binary (arith_t<arith_op::rem> ());
+    NEXT ();
+  }
+
+  TARGET (neg)
+  {
+    require (1);
+    auto top = m_stack.size () - 1;
+    auto &slot = m_stack.slot (top);
+    numbers (m_stack.type (top));
+
+    slot = neg_table[m_stack.type (top)](slot);
+    NEXT ();
+  }
+
+  TARGET (eq)
+  {
+    quicken (comparison (compare_t<compare_op::eq> ()));
+    NEXT ();
+  }
+
+  TARGET (ne)
+  {
+    quicken (comparison (compare_t<compare_op::ne> ()));
+    NEXT ();
+  }
+
+  TARGET (lt)
+  {
+    quicken (comparison (compare_t<compare_op::lt> ()));
+    NEXT ();
+  }
+
+  TARGET (le)
+  {
+    quicken (comparison (compare_t<compare_op::le> ()));
+    NEXT ();
+  }
+
+  TARGET (gt)
+  {
+    quicken (comparison (compare_t<compare_op::gt> ()));
+    NEXT ();
+  }
+
+  TARGET (ge)
+  {
+    quicken (comparison (compare_t<compare_op::ge> ()));
+    NEXT ();
+  }
+
+  TARGET (conv)
+  {
+    require (1);
+    if constexpr (checked)
+      if (operands[ip] > F64_TYPE)
+        throw std::runtime_error ("Invalid Type Specifier.");
+
+    auto top = m_stack.size () - 1;
+    auto to = static_cast<primitive_type> (operands[ip]);
+    numbers (m_stack.type (top));
+
+    m_stack.slot (top)
+        = convert_table[kernel_index (m_stack.type (top), to)](
+            m_stack.slot (top));
+    m_stack.type (top) = to;
+    NEXT ();
+  }
+
+  TARGET (jump)
+  {
+    ip = jump_to (operands[ip]);
+    DISPATCH ();
+  }
+
+  TARGET (jump_if)
+  {
+    ip = condition () ? jump_to (operands[ip]) : ip + 1;
+    DISPATCH ();
+  }
+
+  TARGET (jump_unless)
+  {
+    ip = condition () ? ip + 1 : jump_to (operands[ip]);
+    DISPATCH ();
+  }
+
+  TARGET (call)
+  {
+    auto function = operands[ip];
+    if constexpr (checked)
+      if (function >= m_program.functions.size ())
+        throw std::runtime_error ("Function does not exist.");
+
+    require (m_program.functions[function].arg_count);
+
+    if constexpr (!checked)
+      if (m_tier_up)
+        if (auto native = native_for (static_cast<uint32_t> (function)))
+          {
+#ifdef EVM_INTERP_PROFILE
+            if (m_profiler)
+              m_profiler->enter (static_cast<uint32_t> (function));
+#endif
+            call_native (static_cast<uint32_t> (function), native);
+            NEXT ();
+          }
+
+    enter<checked> (static_cast<uint32_t> (function), ip + 1);
+    load_frame ();
+
+    ip = info->entry;
+    DISPATCH ();
+  }
+
+  TARGET (ret)
+  {
+    auto result_type = info->result;
+    value_slot result = 0;
+
+    if (result_type)
+      {
+        require (1);
+        auto top = m_stack.size () - 1;
+
+        if constexpr (checked)
+          if (m_stack.type (top) != *result_type)
+            throw std::runtime_error (
+                "Returned value does not match its type.");
+
+        result = m_stack.slot (top);
+      }
+
+    auto return_ip = m_frames.back ().return_ip;
+    m_stack.pop (m_stack.size () - base);
+    m_frames.pop_back ();
+
+    if (m_frames.empty ())
+      {
+        if (!result_type)
+          return std::nullopt;
+        return from_slot (result, *result_type);
+      }
+
+    if (result_type)
+      push (result, *result_type);
+
+    load_frame ();
+    ip = return_ip;
+    DISPATCH ();
+  }
+
+  TARGET (host_call)
+  {
+    auto index = static_cast<uint32_t> (operands[ip]);
+    if (index >= m_hosts.size ()
+        || (!m_hosts[index].call && !m_hosts[index].task))
+      throw std::runtime_error ("Host function is not bound.");
+
+    const auto &host = m_hosts[index];
+    require (host.arg_count);
+
+    auto args_begin = m_stack.size () - host.arg_count;
+    m_host_args.clear ();
+    for (auto i = args_begin; i < m_stack.size (); i++)
+      m_host_args.push_back (m_stack.get (i));
+
+    if (!host.task)
+      {
+        finish_host_call<checked> (index, host.call (m_host_args));
+        NEXT ();
+      }
+
+    m_task = host.task (m_host_args);
+    m_task.resume ();
+
+    if (!m_task.done ())
+      {
+        // a fiber waits for the task, and the next one runs.
+        if (m_fiber)
+          {
+            m_fiber->m_ip = ip;
+            m_fiber->m_host = index;
+            return std::nullopt;
+          }
+
+        // otherwise there is nothing else to run.
+        while (!m_task.done ())
+          m_task.resume ();
+      }
+
+    // nothing with a destructor may live across a threaded dispatch.
+    auto result = m_task.result ();
+    m_task = {};
+    finish_host_call<checked> (index, result);
+    NEXT ();
+  }
+
+  TARGET (add_const)
+  {
+    quicken (binary_const (operands[ip], arith_t<arith_op::add> ()));
+    NEXT ();
+  }
+
+  TARGET (sub_const)
+  {
+    quicken (binary_const (operands[ip], arith_t<arith_op::sub> ()));
+    NEXT ();
+  }
+
+  TARGET (branch_local)
+  {
+    auto fused = branch_operand::unpack (operands[ip]);
+    auto index = local (fused.value);
+
+    ip = branch (fused, m_stack.slot (index), m_stack.type (index));
+    DISPATCH ();
+  }
+
+  TARGET (branch_const)
+  {
+    auto fused = branch_operand::unpack (operands[ip]);
+    if constexpr (checked)
+      if (fused.value >= m_constant_slots.size ())
+        throw std::runtime_error ("Constant does not exist.");
+
+    ip = branch (fused, m_constant_slots[fused.value],
+                 m_constant_types[fused.value]);
+    DISPATCH ();
+  }
+
+  TARGET (load_string)
+  {
+    auto index = operands[ip];
+    if constexpr (checked)
+      if (index >= m_program.strings.size ())
+        throw std::runtime_error ("String does not exist.");
+
+    // straight from the program into the nursery.
+    push (m_heap.make_string (m_program.strings[index]), REF_TYPE);
+    NEXT ();
+  }
+
+  TARGET (concat)
+  {
+    require (2);
+    auto top = m_stack.size () - 1;
+
+    if constexpr (checked)
+      if (m_stack.type (top) != REF_TYPE || m_stack.type (top - 1) != REF_TYPE)
+        throw std::runtime_error ("Operands are not references.");
+
+    // the operands stay on the stack while allocating, so they are roots.
+    auto joined = m_heap.concat (m_stack.slot (top - 1), m_stack.slot (top));
+    m_stack.slot (top - 1) = joined;
+    m_stack.pop ();
+    NEXT ();
+  }
+
+  // quickened instructions, whose guard only checks what the generic
+  // instruction would have in checked code.
+
+#define QUICK_BINARY(name, OP, TYPE)                                          \
+  TARGET (name)                                                               \
+  {                                                                           \
+    if (!guard (2, TYPE))                                                     \
+      {                                                                       \
+        deopt ();                                                             \
+        DISPATCH ();                                                          \
+      }                                                                       \
+                                                                              \
+    auto top = m_stack.size () - 1;                                           \
+    m_stack.slot (top - 1)                                                    \
+        = arith<arith_op::OP, TYPE> (m_stack.slot (top - 1),                  \
+                                     m_stack.slot (top));                     \
+    m_stack.pop ();                                                           \
+    NEXT ();                                                                  \
+  }
+
+#define QUICK_COMPARE(name, OP, TYPE)                                         \
+  TARGET (name)                                                               \
+  {                                                                           \
+    if (!guard (2, TYPE))                                                     \
+      {                                                                       \
+        deopt ();                                                             \
+        DISPATCH ();                                                          \
+      }                                                                       \
+                                                                              \
+    auto top = m_stack.size () - 1;                                           \
+    m_stack.slot (top - 1) = compare<compare_op::OP, TYPE> (                  \
+        m_stack.slot (top - 1), m_stack.slot (top));                          \
+    m_stack.type (top - 1) = U8_TYPE;                                         \
+    m_stack.pop ();                                                           \
+    NEXT ();                                                                  \
+  }
+
+  // the constant was checked when the generic instruction ran.
+#define QUICK_CONST(name, OP, TYPE)                                           \
+  TARGET (name)                                                               \
+  {                                                                           \
+    if (!guard (1, TYPE))                                                     \
+      {                                                                       \
+        deopt ();                                                             \
+        DISPATCH ();                                                          \
+      }                                                                       \
+                                                                              \
+    auto top = m_stack.size () - 1;                                           \
+    m_stack.slot (top) = arith<arith_op::OP, TYPE> (                          \
+        m_stack.slot (top), m_constant_slots[operands[ip]]);                  \
+    NEXT ();                                                                  \
+  }
+
+  QUICK_BINARY (add_i64, add, I64_TYPE)
+  QUICK_BINARY (sub_i64, sub, I64_TYPE)
+  QUICK_BINARY (mul_i64, mul, I64_TYPE)
+  QUICK_COMPARE (eq_i64, eq, I64_TYPE)
+  QUICK_COMPARE (ne_i64, ne, I64_TYPE)
+  QUICK_COMPARE (lt_i64, lt, I64_TYPE)
+  QUICK_COMPARE (le_i64, le, I64_TYPE)
+  QUICK_COMPARE (gt_i64, gt, I64_TYPE)
+  QUICK_COMPARE (ge_i64, ge, I64_TYPE)
+  QUICK_CONST (add_const_i64, add, I64_TYPE)
+  QUICK_CONST (sub_const_i64, sub, I64_TYPE)
+  QUICK_BINARY (add_f64, add, F64_TYPE)
+  QUICK_BINARY (sub_f64, sub, F64_TYPE)
+  QUICK_BINARY (mul_f64, mul, F64_TYPE)
+  QUICK_COMPARE (eq_f64, eq, F64_TYPE)
+  QUICK_COMPARE (ne_f64, ne, F64_TYPE)
+  QUICK_COMPARE (lt_f64, lt, F64_TYPE)
+  QUICK_COMPARE (le_f64, le, F64_TYPE)
+  QUICK_COMPARE (gt_f64, gt, F64_TYPE)
+  QUICK_COMPARE (ge_f64, ge, F64_TYPE)
+  QUICK_CONST (add_const_f64, add, F64_TYPE)
+  QUICK_CONST (sub_const_f64, sub, F64_TYPE)
+
+#undef QUICK_CONST
+#undef QUICK_COMPARE
+#undef QUICK_BINARY
+
+#ifndef EVM_DISPATCH_THREADED
+        default:
+          throw std::runtime_error ("Invalid opcode.");
+        }
+    }
+#endif
+
+op_end:
+  throw std::runtime_error ("Ran off the end of the code.");
+
+#undef NEXT
+#undef PROFILE
+#undef DISPATCH
+#undef TARGET
+}
+
+} // evm
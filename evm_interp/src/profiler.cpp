@@ -0,0 +1,229 @@
+#include <evm/profiler.h>
+
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <x86intrin.h>
+#endif
+
+namespace evm
+{
+
+profiler::profiler (uint32_t sample_period)
+    : m_period (std::max (sample_period, 1u)), m_countdown (1),
+      m_random (0x9e3779b97f4a7c15)
+{
+}
+
+void
+profiler::enter (uint32_t index)
+{
+  function (index).calls++;
+}
+
+void
+profiler::flush ()
+{
+  if (m_sampling)
+    finish (opcode::nop, false);
+}
+
+void
+profiler::reset ()
+{
+  m_sampling = false;
+  m_countdown = 1;
+  m_opcodes = {};
+  m_functions.clear ();
+  m_pairs = {};
+  m_folded.clear ();
+}
+
+uint32_t
+profiler::sample_period () const
+{
+  return m_period;
+}
+
+const std::array<profile_entry, opcode_count> &
+profiler::opcodes () const
+{
+  return m_opcodes;
+}
+
+const std::vector<function_profile> &
+profiler::functions () const
+{
+  return m_functions;
+}
+
+const opcode_pair_counts &
+profiler::pairs () const
+{
+  return m_pairs;
+}
+
+fusion_table
+profiler::fusion_candidates (double min_share) const
+{
+  return fusion_table::from_profile (m_pairs, min_share);
+}
+
+std::string
+profiler::to_json () const
+{
+  std::ostringstream out;
+
+  out << "{\"sample_period\":" << m_period << ",\"tick_unit\":\""
+      << tick_unit () << "\",\"opcodes\":[";
+
+  bool first = true;
+  for (uint8_t i = 0; i < opcode_count; i++)
+    {
+      const auto &entry = m_opcodes[i];
+      if (entry.samples == 0)
+        continue;
+
+      out << (first ? "" : ",") << "{\"opcode\":\""
+          << opcode_name (static_cast<opcode> (i))
+          << "\",\"samples\":" << entry.samples
+          << ",\"ticks\":" << entry.ticks << "}";
+      first = false;
+    }
+
+  out << "],\"functions\":[";
+
+  first = true;
+  for (uint64_t i = 0; i < m_functions.size (); i++)
+    {
+      const auto &entry = m_functions[i];
+      if (entry.calls == 0 && entry.samples == 0)
+        continue;
+
+      out << (first ? "" : ",") << "{\"function\":" << i
+          << ",\"calls\":" << entry.calls << ",\"samples\":" << entry.samples
+          << ",\"ticks\":" << entry.ticks << "}";
+      first = false;
+    }
+
+  out << "],\"pairs\":[";
+
+  first = true;
+  for (uint8_t a = 0; a < opcode_count; a++)
+    for (uint8_t b = 0; b < opcode_count; b++)
+      {
+        auto count = m_pairs (static_cast<opcode> (a), static_cast<opcode> (b));
+        if (count == 0)
+          continue;
+
+        out << (first ? "" : ",") << "{\"first\":\""
+            << opcode_name (static_cast<opcode> (a)) << "\",\"second\":\""
+            << opcode_name (static_cast<opcode> (b))
+            << "\",\"count\":" << count << "}";
+        first = false;
+      }
+
+  out << "]}";
+  return out.str ();
+}
+
+std::string
+profiler::to_folded () const
+{
+  std::ostringstream out;
+
+  for (const auto &[stack, ticks] : m_folded)
+    {
+      for (uint64_t i = 0; i + 1 < stack.size (); i++)
+        out << "fn" << stack[i] << ";";
+
+      out << opcode_name (static_cast<opcode> (stack.back ())) << " " << ticks
+          << "\n";
+    }
+
+  return out.str ();
+}
+
+const char *
+profiler::tick_unit ()
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+  return "cycles";
+#else
+  return "ns";
+#endif
+}
+
+uint64_t
+profiler::now ()
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+  return __rdtsc ();
+#else
+  timespec time;
+  clock_gettime (CLOCK_MONOTONIC, &time);
+  return static_cast<uint64_t> (time.tv_sec) * 1000000000
+         + static_cast<uint64_t> (time.tv_nsec);
+#endif
+}
+
+void
+profiler::start (opcode op)
+{
+  m_sampling = true;
+  m_op = op;
+  m_countdown = next_countdown ();
+  // last, so the bookkeeping above is not timed.
+  m_start = now ();
+}
+
+void
+profiler::finish (opcode next, bool has_next)
+{
+  auto ticks = now () - m_start;
+  m_sampling = false;
+
+  auto &entry = m_opcodes[static_cast<uint8_t> (m_op)];
+  entry.samples++;
+  entry.ticks += ticks;
+
+  if (has_next)
+    m_pairs (m_op, next)++;
+
+  if (m_stack.empty ())
+    return;
+
+  auto &current = function (m_stack.back ());
+  current.samples++;
+  current.ticks += ticks;
+
+  m_stack.push_back (static_cast<uint8_t> (m_op));
+  m_folded[m_stack] += ticks;
+}
+
+function_profile &
+profiler::function (uint32_t index)
+{
+  if (m_functions.size () <= index)
+    m_functions.resize (index + 1);
+
+  return m_functions[index];
+}
+
+uint32_t
+profiler::next_countdown ()
+{
+  if (m_period == 1)
+    return 1;
+
+  // xorshift, for a countdown spread evenly around the period.
+  m_random ^= m_random << 13;
+  m_random ^= m_random >> 7;
+  m_random ^= m_random << 17;
+
+  return 1 + static_cast<uint32_t> (m_random % (2 * uint64_t (m_period) - 1));
+}
+
+} // evm
@@ -0,0 +1,437 @@
+#include <evm/arith.h>
+#include <evm/reg_interpreter.h>
+
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace evm
+{
+
+/// the deepest the call stack can get, as for the stack interpreter.
+static constexpr uint64_t max_call_depth = 1 << 16;
+
+/// an arithmetic operation, as a type.
+template <arith_op OP> using arith_t = std::integral_constant<arith_op, OP>;
+
+/**
+ * Compares two slots of the given type, with a comparison opcode.
+ */
+static bool
+compare_with (opcode op, primitive_type type, value_slot lhs, value_slot rhs)
+{
+  auto index = kernel_index (type, type);
+
+  switch (op)
+    {
+    case opcode::eq:
+      return compare_table<compare_op::eq>[index](lhs, rhs);
+    case opcode::ne:
+      return compare_table<compare_op::ne>[index](lhs, rhs);
+    case opcode::lt:
+      return compare_table<compare_op::lt>[index](lhs, rhs);
+    case opcode::le:
+      return compare_table<compare_op::le>[index](lhs, rhs);
+    case opcode::gt:
+      return compare_table<compare_op::gt>[index](lhs, rhs);
+    case opcode::ge:
+      return compare_table<compare_op::ge>[index](lhs, rhs);
+    default:
+      throw std::runtime_error ("Invalid opcode.");
+    }
+}
+
+static bool
+truthy (primitive_type type, value_slot slot)
+{
+  // a reference is true unless it is null.
+  if (type == REF_TYPE)
+    return slot != 0;
+
+  return visit_type (type, [slot] (auto tag) {
+    return from_slot<decltype (tag)::value> (slot) != 0;
+  });
+}
+
+reg_interpreter::reg_interpreter (const program &prog,
+                                  const verification &verified,
+                                  const reg_program &code,
+                                  heap_options options)
+    : m_program (prog), m_verified (verified), m_code (code),
+      m_heap (options)
+{
+  if (verified.depths.size () != prog.code.size ()
+      || verified.frame_sizes.size () != prog.functions.size ())
+    throw std::runtime_error ("Verification is not of this program.");
+  if (code.entries.size () != prog.functions.size ())
+    throw std::runtime_error ("Register code is not of this program.");
+
+  m_heap.add_roots (m_registers);
+  // so that the registers always have an address, even when empty.
+  m_registers.reserve (1);
+
+  m_constant_slots.reserve (prog.constants.size ());
+  m_constant_types.reserve (prog.constants.size ());
+
+  for (const auto &constant : prog.constants)
+    {
+      m_constant_slots.push_back (to_slot (constant));
+      m_constant_types.push_back (primitive_get_type (constant));
+    }
+}
+
+void
+reg_interpreter::bind_host (uint32_t index, host_function function)
+{
+  if (index >= m_verified.hosts.size ()
+      || function.arg_count != m_verified.hosts[index].args.size ())
+    throw std::runtime_error ("Host function does not match its signature.");
+
+  if (m_hosts.size () <= index)
+    m_hosts.resize (index + 1);
+
+  m_hosts[index] = std::move (function);
+}
+
+heap &
+reg_interpreter::heap ()
+{
+  return m_heap;
+}
+
+std::optional<primitive_value>
+reg_interpreter::run (uint32_t function,
+                      std::span<const primitive_value> args)
+{
+  if (function >= m_program.functions.size ())
+    throw std::runtime_error ("Function does not exist.");
+
+  const auto &info = m_program.functions[function];
+  if (args.size () != info.arg_count)
+    throw std::runtime_error ("Wrong number of arguments.");
+
+  m_registers.clear ();
+  m_frames.clear ();
+
+  for (const auto &arg : args)
+    m_registers.push (arg);
+
+  for (uint64_t i = 0; i < args.size (); i++)
+    if (m_registers.type (i) != info.locals[i])
+      throw std::runtime_error ("Argument does not match its type.");
+
+  m_frames.push_back (
+      frame{ .function = function, .return_ip = 0, .base = 0, .result = 0 });
+  enter (function, 0);
+
+  return execute (m_code.entries[function]);
+}
+
+void
+reg_interpreter::enter (uint32_t function, uint64_t base)
+{
+  const auto &info = m_program.functions[function];
+
+  // the registers above the arguments may hold what the caller left there,
+  // which is of the right type at least.
+  m_registers.resize (base + m_verified.frame_sizes[function]);
+
+  for (uint64_t i = info.arg_count; i < info.locals.size (); i++)
+    {
+      m_registers.slot (base + i) = 0;
+      m_registers.type (base + i) = info.locals[i];
+    }
+}
+
+std::optional<primitive_value>
+reg_interpreter::execute (uint32_t ip)
+{
+  const auto *code = m_code.code.data ();
+
+  // the registers of the current frame.
+  value_slot *regs;
+  primitive_type *types;
+
+  auto load_frame = [&] () {
+    auto base = m_frames.back ().base;
+    regs = &m_registers.slot (0) + base;
+    types = &m_registers.type (0) + base;
+  };
+  load_frame ();
+
+  // applies op into dst, inline for i64.
+  auto binary = [&] (auto op, const reg_instr &instr, value_slot rhs) {
+    constexpr auto OP = decltype (op)::value;
+    auto lhs = regs[instr.a];
+
+    regs[instr.dst]
+        = instr.type == I64_TYPE
+              ? arith<OP, I64_TYPE> (lhs, rhs)
+              : arith_table<OP>[kernel_index (instr.type, instr.type)](lhs,
+                                                                       rhs);
+    types[instr.dst] = instr.result;
+  };
+
+  auto compare = [&] (const reg_instr &instr, value_slot rhs) {
+    return compare_with (instr.compare, instr.type, regs[instr.a], rhs);
+  };
+
+  // pops the frame, and returns it unless it was the last.
+  auto leave = [&] () -> std::optional<frame> {
+    auto done = m_frames.back ();
+    m_frames.pop_back ();
+
+    if (m_frames.empty ())
+      return std::nullopt;
+
+    const auto &caller = m_frames.back ();
+    m_registers.resize (caller.base
+                        + m_verified.frame_sizes[caller.function]);
+    load_frame ();
+
+    return done;
+  };
+
+  for (;;)
+    {
+      const auto &instr = code[ip];
+
+      switch (instr.op)
+        {
+        case reg_op::mov:
+          regs[instr.dst] = regs[instr.a];
+          types[instr.dst] = instr.result;
+          break;
+
+        case reg_op::load_const:
+          regs[instr.dst] = m_constant_slots[instr.a];
+          types[instr.dst] = instr.result;
+          break;
+
+        case reg_op::add:
+          binary (arith_t<arith_op::add> (), instr, regs[instr.b]);
+          break;
+        case reg_op::sub:
+          binary (arith_t<arith_op::sub> (), instr, regs[instr.b]);
+          break;
+        case reg_op::mul:
+          binary (arith_t<arith_op::mul> (), instr, regs[instr.b]);
+          break;
+        case reg_op::div:
+          binary (arith_t<arith_op::div> (), instr, regs[instr.b]);
+          break;
+        case reg_op::rem:
+          binary (arith_t<arith_op::rem> (), instr, regs[instr.b]);
+          break;
+
+        case reg_op::add_k:
+          binary (arith_t<arith_op::add> (), instr,
+                  m_constant_slots[instr.b]);
+          break;
+        case reg_op::sub_k:
+          binary (arith_t<arith_op::sub> (), instr,
+                  m_constant_slots[instr.b]);
+          break;
+        case reg_op::mul_k:
+          binary (arith_t<arith_op::mul> (), instr,
+                  m_constant_slots[instr.b]);
+          break;
+        case reg_op::div_k:
+          binary (arith_t<arith_op::div> (), instr,
+                  m_constant_slots[instr.b]);
+          break;
+        case reg_op::rem_k:
+          binary (arith_t<arith_op::rem> (), instr,
+                  m_constant_slots[instr.b]);
+          break;
+
+        case reg_op::neg:
+          regs[instr.dst] = neg_table[instr.type](regs[instr.a]);
+          types[instr.dst] = instr.result;
+          break;
+
+        case reg_op::conv:
+          regs[instr.dst] = convert_table[kernel_index (
+              instr.type, instr.result)](regs[instr.a]);
+          types[instr.dst] = instr.result;
+          break;
+
+        case reg_op::compare:
+          regs[instr.dst] = compare (instr, regs[instr.b]);
+          types[instr.dst] = U8_TYPE;
+          break;
+
+        case reg_op::compare_k:
+          regs[instr.dst] = compare (instr, m_constant_slots[instr.b]);
+          types[instr.dst] = U8_TYPE;
+          break;
+
+        case reg_op::jump:
+          ip = instr.dst;
+          continue;
+
+        case reg_op::jump_if:
+          if (truthy (instr.type, regs[instr.a]))
+            {
+              ip = instr.dst;
+              continue;
+            }
+          break;
+
+        case reg_op::jump_unless:
+          if (!truthy (instr.type, regs[instr.a]))
+            {
+              ip = instr.dst;
+              continue;
+            }
+          break;
+
+        case reg_op::branch_if:
+          if (compare (instr, regs[instr.b]))
+            {
+              ip = instr.dst;
+              continue;
+            }
+          break;
+
+        case reg_op::branch_if_k:
+          if (compare (instr, m_constant_slots[instr.b]))
+            {
+              ip = instr.dst;
+              continue;
+            }
+          break;
+
+        case reg_op::branch_unless:
+          if (!compare (instr, regs[instr.b]))
+            {
+              ip = instr.dst;
+              continue;
+            }
+          break;
+
+        case reg_op::branch_unless_k:
+          if (!compare (instr, m_constant_slots[instr.b]))
+            {
+              ip = instr.dst;
+              continue;
+            }
+          break;
+
+        case reg_op::call:
+          {
+            if (m_frames.size () >= max_call_depth)
+              throw std::runtime_error ("Call stack overflow.");
+
+            auto base = m_frames.back ().base;
+            m_frames.push_back (frame{ .function = instr.b,
+                                       .return_ip = ip + 1,
+                                       .base = base + instr.a,
+                                       .result = base + instr.dst });
+            enter (instr.b, base + instr.a);
+            load_frame ();
+
+            ip = m_code.entries[instr.b];
+            continue;
+          }
+
+        case reg_op::host_call:
+          {
+            if (instr.b >= m_hosts.size ()
+                || (!m_hosts[instr.b].call && !m_hosts[instr.b].task))
+              throw std::runtime_error ("Host function is not bound.");
+
+            const auto &host = m_hosts[instr.b];
+            m_host_args.clear ();
+            for (uint32_t i = 0; i < host.arg_count; i++)
+              m_host_args.push_back (
+                  from_slot (regs[instr.a + i], types[instr.a + i]));
+
+            std::optional<primitive_value> result;
+            if (host.task)
+              {
+                // there are no fibers here, so the task is run until it
+                // finishes.
+                auto task = host.task (m_host_args);
+                while (!task.done ())
+                  task.resume ();
+                result = task.result ();
+              }
+            else
+              result = host.call (m_host_args);
+
+            // the verifier trusted the signature, so hold the host to it.
+            std::optional<primitive_type> type;
+            if (result)
+              type = primitive_get_type (*result);
+
+            if (type != m_verified.hosts[instr.b].result)
+              throw std::runtime_error (
+                  "Host function does not match its signature.");
+
+            if (result)
+              {
+                regs[instr.dst] = to_slot (*result);
+                types[instr.dst] = *type;
+              }
+            break;
+          }
+
+        case reg_op::ret:
+          {
+            auto result = regs[instr.a];
+            auto done = leave ();
+
+            if (!done)
+              return from_slot (result, instr.result);
+
+            m_registers.slot (done->result) = result;
+            m_registers.type (done->result) = instr.result;
+            ip = done->return_ip;
+            continue;
+          }
+
+        case reg_op::ret_void:
+          {
+            auto done = leave ();
+
+            if (!done)
+              return std::nullopt;
+
+            ip = done->return_ip;
+            continue;
+          }
+
+        case reg_op::swap:
+          std::swap (regs[instr.a], regs[instr.b]);
+          std::swap (types[instr.a], types[instr.b]);
+          break;
+
+        case reg_op::load_string:
+          {
+            // straight from the program into the nursery.
+            auto string = m_heap.make_string (m_program.strings[instr.a]);
+            regs[instr.dst] = string;
+            types[instr.dst] = REF_TYPE;
+            break;
+          }
+
+        case reg_op::concat:
+          {
+            // the operands are in registers while allocating,
+            // so they are roots.
+            auto joined = m_heap.concat (regs[instr.a], regs[instr.b]);
+            regs[instr.dst] = joined;
+            types[instr.dst] = REF_TYPE;
+            break;
+          }
+
+        default:
+          throw std::runtime_error ("Invalid opcode.");
+        }
+
+      ip++;
+    }
+}
+
+} // evm
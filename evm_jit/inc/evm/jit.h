@@ -0,0 +1,85 @@
+/** @file
+ *
+ * @brief This header contains the baseline x86-64 compiler
+ * (@c evm::jit_compiler), which turns hot functions into native code for
+ * the interpreter to tier up to.
+ */
+
+#ifndef EVM_JIT_JIT_H_
+#define EVM_JIT_JIT_H_
+
+#include <evm/interpreter.h>
+#include <evm/program.h>
+#include <evm/verifier.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace evm
+{
+
+/**
+ * @brief A template compiler from verified code to x86-64.
+ *
+ * Each instruction is compiled to a fixed sequence of machine code.
+ * Values stay in the frame, the operand stack at a fixed offset for each
+ * instruction, which is known from the depths the verifier found.
+ *
+ * Only functions on 64-bit signed integers are supported:
+ * every local variable, constant and operand must be @c I64_TYPE,
+ * apart from the results of comparisons which are only jumped on,
+ * and the function cannot make calls or convert values.
+ * Anything else stays in the interpreter.
+ *
+ * Code is written into anonymous mappings, which are made executable
+ * and read only once written, and unmapped with the compiler.
+ */
+class jit_compiler : public tier_up
+{
+public:
+  /**
+   * @brief Makes a compiler for @c prog, which must outlive it,
+   * as must @c verified.
+   */
+  jit_compiler (const program &prog, const verification &verified);
+  ~jit_compiler () override;
+
+  jit_compiler (const jit_compiler &) = delete;
+  jit_compiler &operator= (const jit_compiler &) = delete;
+
+  /**
+   * @brief Whether the function only uses what the compiler supports.
+   */
+  bool supported (uint32_t function) const;
+
+  /**
+   * @brief Compiles a function once, later calls return the same code.
+   * @return The native code, or @c nullptr if the function is not
+   * supported.
+   * @throws std::runtime_error if executable memory cannot be mapped.
+   */
+  native_function compile (uint32_t function) override;
+
+  /**
+   * @brief The machine code a function compiles to, for inspection.
+   * @throws std::runtime_error if the function is not supported.
+   */
+  std::vector<uint8_t> emit (uint32_t function) const;
+
+private:
+  struct mapping
+  {
+    void *address;
+    uint64_t size;
+  };
+
+  const program &m_program;
+  const verification &m_verified;
+  /// the native code of each function, once compiled.
+  std::vector<native_function> m_compiled;
+  std::vector<mapping> m_mappings;
+};
+
+} // evm
+
+#endif // EVM_JIT_JIT_H_
@@ -0,0 +1,549 @@
+#include <evm/jit.h>
+
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace evm
+{
+
+/// the registers used, by their encoding.
+enum x86_register : uint8_t
+{
+  RAX = 0,
+  RCX = 1,
+  RDX = 2,
+};
+
+/// the condition codes of comparisons, by their encoding.
+enum x86_condition : uint8_t
+{
+  CC_E = 0x4,
+  CC_NE = 0x5,
+  CC_L = 0xc,
+  CC_GE = 0xd,
+  CC_LE = 0xe,
+  CC_G = 0xf,
+};
+
+/**
+ * Writes x86-64 machine code.
+ * Memory operands are relative to rdi, which holds the frame.
+ */
+class x86_emitter
+{
+public:
+  uint64_t
+  size () const
+  {
+    return m_code.size ();
+  }
+
+  void
+  bytes (std::initializer_list<uint8_t> values)
+  {
+    m_code.insert (m_code.end (), values);
+  }
+
+  void
+  u32 (uint32_t value)
+  {
+    for (int i = 0; i < 4; i++)
+      m_code.push_back (static_cast<uint8_t> (value >> (i * 8)));
+  }
+
+  void
+  u64 (uint64_t value)
+  {
+    u32 (static_cast<uint32_t> (value));
+    u32 (static_cast<uint32_t> (value >> 32));
+  }
+
+  /// a 64-bit instruction on a register and [rdi + disp].
+  void
+  mem (std::initializer_list<uint8_t> op, uint8_t r, int32_t disp)
+  {
+    bytes ({ 0x48 });
+    bytes (op);
+    bytes ({ static_cast<uint8_t> (0x80 | r << 3 | 7) });
+    u32 (static_cast<uint32_t> (disp));
+  }
+
+  /// a 64-bit instruction on two registers.
+  void
+  reg (std::initializer_list<uint8_t> op, uint8_t r, uint8_t rm)
+  {
+    bytes ({ 0x48 });
+    bytes (op);
+    bytes ({ static_cast<uint8_t> (0xc0 | r << 3 | rm) });
+  }
+
+  void
+  load (x86_register dst, int32_t disp)
+  {
+    mem ({ 0x8b }, dst, disp);
+  }
+
+  void
+  store (int32_t disp, x86_register src)
+  {
+    mem ({ 0x89 }, src, disp);
+  }
+
+  void
+  load_imm (x86_register dst, uint64_t value)
+  {
+    bytes ({ 0x48, static_cast<uint8_t> (0xb8 + dst) });
+    u64 (value);
+  }
+
+  /// jumps to a 32-bit displacement, returns where to patch it.
+  uint64_t
+  jump (std::optional<x86_condition> cond)
+  {
+    if (cond)
+      bytes ({ 0x0f, static_cast<uint8_t> (0x80 | *cond) });
+    else
+      bytes ({ 0xe9 });
+
+    auto at = size ();
+    u32 (0);
+    return at;
+  }
+
+  /// jumps to an 8-bit displacement, returns where to patch it.
+  uint64_t
+  jump_short (std::optional<x86_condition> cond)
+  {
+    if (cond)
+      bytes ({ static_cast<uint8_t> (0x70 | *cond) });
+    else
+      bytes ({ 0xeb });
+
+    auto at = size ();
+    bytes ({ 0 });
+    return at;
+  }
+
+  void
+  patch (uint64_t at, uint64_t target)
+  {
+    auto rel = static_cast<int64_t> (target) - static_cast<int64_t> (at + 4);
+    auto value = static_cast<uint32_t> (static_cast<int32_t> (rel));
+
+    for (int i = 0; i < 4; i++)
+      m_code[at + i] = static_cast<uint8_t> (value >> (i * 8));
+  }
+
+  void
+  patch_short (uint64_t at, uint64_t target)
+  {
+    m_code[at] = static_cast<uint8_t> (target - (at + 1));
+  }
+
+  std::vector<uint8_t>
+  take ()
+  {
+    return std::move (m_code);
+  }
+
+private:
+  std::vector<uint8_t> m_code;
+};
+
+static x86_condition
+condition_of (opcode compare)
+{
+  switch (compare)
+    {
+    case opcode::eq:
+      return CC_E;
+    case opcode::ne:
+      return CC_NE;
+    case opcode::lt:
+      return CC_L;
+    case opcode::le:
+      return CC_LE;
+    case opcode::gt:
+      return CC_G;
+    default:
+      return CC_GE;
+    }
+}
+
+/// the opposite condition, which has the low bit flipped.
+static x86_condition
+negate (x86_condition cond)
+{
+  return static_cast<x86_condition> (cond ^ 1);
+}
+
+/// keeps displacements well inside 32 bits.
+static constexpr uint32_t max_frame_size = 1 << 24;
+
+jit_compiler::jit_compiler (const program &prog, const verification &verified)
+    : m_program (prog), m_verified (verified),
+      m_compiled (prog.functions.size (), nullptr)
+{
+}
+
+jit_compiler::~jit_compiler ()
+{
+  for (const auto &mapped : m_mappings)
+    ::munmap (mapped.address, mapped.size);
+}
+
+bool
+jit_compiler::supported (uint32_t function) const
+{
+  if (function >= m_program.functions.size ())
+    return false;
+
+  const auto &info = m_program.functions[function];
+  const auto &code = m_program.code;
+
+  auto is_i64 = [] (primitive_type type) { return type == I64_TYPE; };
+  auto constant_i64 = [&] (uint64_t index) {
+    return primitive_get_type (m_program.constants[index]) == I64_TYPE;
+  };
+
+  for (auto type : info.locals)
+    if (!is_i64 (type))
+      return false;
+  if (info.result && !is_i64 (*info.result))
+    return false;
+  if (m_verified.frame_sizes[function] > max_frame_size)
+    return false;
+
+  for (uint64_t ip = 0; ip < code.size (); ip++)
+    {
+      if (m_verified.owners[ip] != function)
+        continue;
+
+      auto types = m_verified.stack_types (ip);
+      // whether the top count operands are i64.
+      auto operands_i64 = [&] (uint64_t count) {
+        for (uint64_t i = types.size () - count; i < types.size (); i++)
+          if (!is_i64 (types[i]))
+            return false;
+        return true;
+      };
+
+      switch (code.opcodes[ip])
+        {
+        case opcode::nop:
+        case opcode::pop:
+        case opcode::dup:
+        case opcode::swap:
+        case opcode::load_local:
+        case opcode::store_local:
+        case opcode::jump:
+        case opcode::jump_if:
+        case opcode::jump_unless:
+        case opcode::branch_local:
+        case opcode::ret:
+          break;
+
+        case opcode::load_const:
+        case opcode::add_const:
+        case opcode::sub_const:
+          if (!constant_i64 (code.operands[ip]))
+            return false;
+          break;
+
+        case opcode::branch_const:
+          if (!constant_i64 (branch_operand::unpack (code.operands[ip]).value))
+            return false;
+          break;
+
+        case opcode::add:
+        case opcode::sub:
+        case opcode::mul:
+        case opcode::div:
+        case opcode::rem:
+        case opcode::eq:
+        case opcode::ne:
+        case opcode::lt:
+        case opcode::le:
+        case opcode::gt:
+        case opcode::ge:
+          if (!operands_i64 (2))
+            return false;
+          break;
+
+        case opcode::neg:
+          if (!operands_i64 (1))
+            return false;
+          break;
+
+        default:
+          return false;
+        }
+    }
+
+  return true;
+}
+
+std::vector<uint8_t>
+jit_compiler::emit (uint32_t function) const
+{
+  if (!supported (function))
+    throw std::runtime_error ("Function cannot be compiled.");
+
+  const auto &code = m_program.code;
+  auto local_count = m_program.functions[function].locals.size ();
+
+  x86_emitter out;
+  // where each instruction starts, and the jumps to patch with them.
+  std::vector<uint64_t> labels (code.size ());
+  std::vector<std::pair<uint64_t, uint64_t>> jumps;
+  std::vector<uint64_t> errors;
+
+  auto local = [] (uint64_t index) {
+    return static_cast<int32_t> (index * sizeof (value_slot));
+  };
+
+  // the instructions are emitted in order, which may not start at the
+  // entry.
+  auto entry = m_program.functions[function].entry;
+  for (uint64_t ip = 0; ip < entry; ip++)
+    if (m_verified.owners[ip] == function)
+      {
+        jumps.emplace_back (out.jump (std::nullopt), entry);
+        break;
+      }
+
+  for (uint64_t ip = 0; ip < code.size (); ip++)
+    {
+      if (m_verified.owners[ip] != function)
+        continue;
+
+      labels[ip] = out.size ();
+
+      auto operand = code.operands[ip];
+      uint64_t depth = m_verified.depths[ip];
+      // the operand stack slot, counting down from the top.
+      auto stack = [&] (uint64_t from_top) {
+        return local (local_count + depth - 1 - from_top);
+      };
+      auto push_slot = local (local_count + depth);
+
+      switch (code.opcodes[ip])
+        {
+        case opcode::nop:
+        case opcode::pop:
+          break;
+
+        case opcode::load_const:
+          out.load_imm (RAX, to_slot (m_program.constants[operand]));
+          out.store (push_slot, RAX);
+          break;
+
+        case opcode::dup:
+          out.load (RAX, stack (0));
+          out.store (push_slot, RAX);
+          break;
+
+        case opcode::swap:
+          out.load (RAX, stack (0));
+          out.load (RCX, stack (1));
+          out.store (stack (1), RAX);
+          out.store (stack (0), RCX);
+          break;
+
+        case opcode::load_local:
+          out.load (RAX, local (operand));
+          out.store (push_slot, RAX);
+          break;
+
+        case opcode::store_local:
+          out.load (RAX, stack (0));
+          out.store (local (operand), RAX);
+          break;
+
+        case opcode::add:
+          out.load (RAX, stack (1));
+          out.mem ({ 0x03 }, RAX, stack (0));
+          out.store (stack (1), RAX);
+          break;
+
+        case opcode::sub:
+          out.load (RAX, stack (1));
+          out.mem ({ 0x2b }, RAX, stack (0));
+          out.store (stack (1), RAX);
+          break;
+
+        case opcode::mul:
+          out.load (RAX, stack (1));
+          out.mem ({ 0x0f, 0xaf }, RAX, stack (0));
+          out.store (stack (1), RAX);
+          break;
+
+        case opcode::div:
+        case opcode::rem:
+          {
+            bool remainder = code.opcodes[ip] == opcode::rem;
+
+            out.load (RAX, stack (1));
+            out.load (RCX, stack (0));
+            // test rcx, rcx
+            out.reg ({ 0x85 }, RCX, RCX);
+            errors.push_back (out.jump (CC_E));
+
+            // dividing by -1 is negating, which wraps instead of trapping.
+            // cmp rcx, -1
+            out.reg ({ 0x83 }, 7, RCX);
+            out.bytes ({ 0xff });
+            auto divide = out.jump_short (CC_NE);
+
+            if (remainder)
+              out.bytes ({ 0x31, 0xc0 }); // xor eax, eax
+            else
+              out.reg ({ 0xf7 }, 3, RAX); // neg rax
+            auto done = out.jump_short (std::nullopt);
+
+            out.patch_short (divide, out.size ());
+            out.bytes ({ 0x48, 0x99 }); // cqo
+            out.reg ({ 0xf7 }, 7, RCX); // idiv rcx
+            if (remainder)
+              out.reg ({ 0x89 }, RDX, RAX); // mov rax, rdx
+
+            out.patch_short (done, out.size ());
+            out.store (stack (1), RAX);
+            break;
+          }
+
+        case opcode::neg:
+          out.mem ({ 0xf7 }, 3, stack (0));
+          break;
+
+        case opcode::eq:
+        case opcode::ne:
+        case opcode::lt:
+        case opcode::le:
+        case opcode::gt:
+        case opcode::ge:
+          out.load (RAX, stack (1));
+          out.mem ({ 0x3b }, RAX, stack (0));
+          // setcc al, movzx eax, al
+          out.bytes ({ 0x0f,
+                       static_cast<uint8_t> (
+                           0x90 | condition_of (code.opcodes[ip])),
+                       0xc0, 0x0f, 0xb6, 0xc0 });
+          out.store (stack (1), RAX);
+          break;
+
+        case opcode::add_const:
+        case opcode::sub_const:
+          out.load (RAX, stack (0));
+          out.load_imm (RCX, to_slot (m_program.constants[operand]));
+          // add or sub rax, rcx
+          out.reg ({ code.opcodes[ip] == opcode::add_const ? uint8_t (0x01)
+                                                          : uint8_t (0x29) },
+                   RCX, RAX);
+          out.store (stack (0), RAX);
+          break;
+
+        case opcode::jump:
+          jumps.emplace_back (out.jump (std::nullopt), operand);
+          break;
+
+        case opcode::jump_if:
+        case opcode::jump_unless:
+          out.load (RAX, stack (0));
+          out.reg ({ 0x85 }, RAX, RAX);
+          jumps.emplace_back (
+              out.jump (code.opcodes[ip] == opcode::jump_if ? CC_NE : CC_E),
+              operand);
+          break;
+
+        case opcode::branch_local:
+        case opcode::branch_const:
+          {
+            auto branch = branch_operand::unpack (operand);
+            out.load (RAX, stack (0));
+
+            if (code.opcodes[ip] == opcode::branch_local)
+              out.mem ({ 0x3b }, RAX, local (branch.value));
+            else
+              {
+                out.load_imm (
+                    RCX, to_slot (m_program.constants[branch.value]));
+                out.reg ({ 0x39 }, RCX, RAX); // cmp rax, rcx
+              }
+
+            auto cond = condition_of (branch.compare);
+            if (branch.jump == opcode::jump_unless)
+              cond = negate (cond);
+
+            jumps.emplace_back (out.jump (cond), branch.target);
+            break;
+          }
+
+        case opcode::ret:
+          if (m_program.functions[function].result)
+            {
+              out.load (RAX, stack (0));
+              out.store (0, RAX);
+            }
+          // mov eax, 1; ret
+          out.bytes ({ 0xb8, 1, 0, 0, 0, 0xc3 });
+          break;
+
+        default:
+          throw std::runtime_error ("Function cannot be compiled.");
+        }
+    }
+
+  // failing returns false.
+  auto error = out.size ();
+  out.bytes ({ 0x31, 0xc0, 0xc3 });
+
+  for (auto [at, target] : jumps)
+    out.patch (at, labels[target]);
+  for (auto at : errors)
+    out.patch (at, error);
+
+  return out.take ();
+}
+
+native_function
+jit_compiler::compile (uint32_t function)
+{
+  if (function >= m_compiled.size ())
+    return nullptr;
+  if (m_compiled[function])
+    return m_compiled[function];
+  if (!supported (function))
+    return nullptr;
+
+  auto bytes = emit (function);
+
+  auto page = static_cast<uint64_t> (::sysconf (_SC_PAGESIZE));
+  auto size = (bytes.size () + page - 1) / page * page;
+
+  // written first, then made executable, so it is never both.
+  void *address = ::mmap (nullptr, size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (address == MAP_FAILED)
+    throw std::runtime_error ("Could not map memory for native code.");
+
+  std::memcpy (address, bytes.data (), bytes.size ());
+
+  if (::mprotect (address, size, PROT_READ | PROT_EXEC) != 0)
+    {
+      ::munmap (address, size);
+      throw std::runtime_error ("Could not make native code executable.");
+    }
+
+  m_mappings.push_back (mapping{ .address = address, .size = size });
+  m_compiled[function] = reinterpret_cast<native_function> (address);
+
+  return m_compiled[function];
+}
+
+} // evm
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <evm/arith.h>
+#include <limits>
+#include <stdexcept>
+
+using evm::arith_op;
+using evm::compare_op;
+
+template <evm::primitive_type TYPE>
+static evm::primitive_value
+make (evm::primitive_value_t<TYPE> value)
+{
+  return evm::make_primitive<TYPE> (value);
+}
+
+TEST (arith_tests, promote_test)
+{
+  using namespace evm;
+
+  static_assert (promote (I32_TYPE, I32_TYPE) == I32_TYPE);
+  static_assert (promote (I8_TYPE, I64_TYPE) == I64_TYPE);
+  static_assert (promote (U16_TYPE, U8_TYPE) == U16_TYPE);
+  static_assert (promote (I8_TYPE, F32_TYPE) == F32_TYPE);
+  static_assert (promote (F32_TYPE, F64_TYPE) == F64_TYPE);
+  static_assert (promote (U64_TYPE, F32_TYPE) == F32_TYPE);
+
+  // mixed signedness, signed and wide enough for both.
+  static_assert (promote (I8_TYPE, U8_TYPE) == I16_TYPE);
+  static_assert (promote (U16_TYPE, I8_TYPE) == I32_TYPE);
+  static_assert (promote (I32_TYPE, U8_TYPE) == I32_TYPE);
+  static_assert (promote (I32_TYPE, U32_TYPE) == I64_TYPE);
+  static_assert (promote (U64_TYPE, I8_TYPE) == I64_TYPE);
+
+  // promotion is symmetric.
+  for (uint8_t a = 0; a < primitive_type_count; a++)
+    for (uint8_t b = 0; b < primitive_type_count; b++)
+      EXPECT_EQ (promote (primitive_type (a), primitive_type (b)),
+                 promote (primitive_type (b), primitive_type (a)));
+}
+
+TEST (arith_tests, typed_test)
+{
+  using namespace evm;
+
+  static_assert (from_slot<I64_TYPE> (add<I64_TYPE> (to_slot<I64_TYPE> (40),
+                                                     to_slot<I64_TYPE> (2)))
+                 == 42);
+  static_assert (from_slot<U8_TYPE> (add<U8_TYPE> (to_slot<U8_TYPE> (255),
+                                                   to_slot<U8_TYPE> (1)))
+                 == 0);
+  static_assert (from_slot<I8_TYPE> (neg<I8_TYPE> (to_slot<I8_TYPE> (-128)))
+                 == -128);
+  static_assert (compare<compare_op::lt, I32_TYPE> (to_slot<I32_TYPE> (-1),
+                                                    to_slot<I32_TYPE> (0)));
+
+  // no promotion to int, which would overflow.
+  EXPECT_EQ (from_slot<U16_TYPE> (
+                 mul<U16_TYPE> (to_slot<U16_TYPE> (65535),
+                                to_slot<U16_TYPE> (65535))),
+             1);
+
+  auto min = to_slot<I64_TYPE> (std::numeric_limits<int64_t>::min ());
+  EXPECT_EQ (div<I64_TYPE> (min, to_slot<I64_TYPE> (-1)), min);
+  EXPECT_EQ (rem<I64_TYPE> (min, to_slot<I64_TYPE> (-1)), 0);
+  EXPECT_THROW (div<I32_TYPE> (1, 0), std::runtime_error);
+  EXPECT_THROW (rem<U8_TYPE> (1, 0), std::runtime_error);
+
+  EXPECT_EQ (from_slot<F64_TYPE> (rem<F64_TYPE> (to_slot<F64_TYPE> (7.5),
+                                                 to_slot<F64_TYPE> (2))),
+             1.5);
+}
+
+TEST (arith_tests, value_test)
+{
+  using namespace evm;
+
+  EXPECT_EQ (arith (arith_op::add, make<I32_TYPE> (2), make<I32_TYPE> (3)),
+             make<I32_TYPE> (5));
+  EXPECT_EQ (arith (arith_op::sub, make<U8_TYPE> (1), make<I8_TYPE> (2)),
+             make<I16_TYPE> (-1));
+  EXPECT_EQ (arith (arith_op::mul, make<I64_TYPE> (3), make<F32_TYPE> (0.5f)),
+             make<F32_TYPE> (1.5f));
+  EXPECT_EQ (arith (arith_op::div, make<U32_TYPE> (7), make<U64_TYPE> (2)),
+             make<U64_TYPE> (3));
+  EXPECT_EQ (arith (arith_op::rem, make<I16_TYPE> (-7), make<I16_TYPE> (2)),
+             make<I16_TYPE> (-1));
+  EXPECT_THROW (arith (arith_op::div, make<I64_TYPE> (1), make<U8_TYPE> (0)),
+                std::runtime_error);
+
+  EXPECT_EQ (neg (make<F64_TYPE> (2)), make<F64_TYPE> (-2));
+  EXPECT_EQ (neg (make<U32_TYPE> (1)), make<U32_TYPE> (UINT32_MAX));
+  EXPECT_THROW (neg (primitive_value (heap_ref{ 8 })), std::runtime_error);
+}
+
+TEST (arith_tests, compare_test)
+{
+  using namespace evm;
+
+  EXPECT_TRUE (compare (compare_op::eq, make<I8_TYPE> (3), make<U64_TYPE> (3)));
+  EXPECT_TRUE (compare (compare_op::lt, make<F32_TYPE> (1), make<F64_TYPE> (2)));
+  EXPECT_TRUE (
+      compare (compare_op::ge, make<I32_TYPE> (5), make<F64_TYPE> (4.5)));
+
+  // exactly, where converting to either type would be wrong.
+  EXPECT_TRUE (compare (compare_op::lt, make<I64_TYPE> (-1),
+                        make<U64_TYPE> (UINT64_MAX)));
+  EXPECT_TRUE (compare (compare_op::ne, make<I8_TYPE> (-1),
+                        make<U8_TYPE> (255)));
+  EXPECT_TRUE (compare (compare_op::gt, make<U64_TYPE> (UINT64_MAX),
+                        make<I8_TYPE> (0)));
+
+  auto nan = make<F64_TYPE> (std::nan (""));
+  EXPECT_FALSE (compare (compare_op::eq, nan, nan));
+  EXPECT_TRUE (compare (compare_op::ne, nan, nan));
+}
+
+TEST (arith_tests, convert_test)
+{
+  using namespace evm;
+
+  EXPECT_EQ (convert (make<I32_TYPE> (-1), U8_TYPE), make<U8_TYPE> (255));
+  EXPECT_EQ (convert (make<U8_TYPE> (200), I64_TYPE), make<I64_TYPE> (200));
+  EXPECT_EQ (convert (make<I64_TYPE> (3), F64_TYPE), make<F64_TYPE> (3));
+  EXPECT_EQ (convert (make<F64_TYPE> (-2.9), I32_TYPE), make<I32_TYPE> (-2));
+
+  // floats saturate, and NaN is zero.
+  EXPECT_EQ (convert (make<F64_TYPE> (1e300), I64_TYPE),
+             make<I64_TYPE> (INT64_MAX));
+  EXPECT_EQ (convert (make<F32_TYPE> (-1e30f), I64_TYPE),
+             make<I64_TYPE> (INT64_MIN));
+  EXPECT_EQ (convert (make<F64_TYPE> (-1), U32_TYPE), make<U32_TYPE> (0));
+  EXPECT_EQ (convert (make<F64_TYPE> (300), U8_TYPE), make<U8_TYPE> (255));
+  EXPECT_EQ (convert (make<F64_TYPE> (std::nan ("")), I16_TYPE),
+             make<I16_TYPE> (0));
+  EXPECT_EQ (convert (make<F32_TYPE> (INFINITY), U64_TYPE),
+             make<U64_TYPE> (UINT64_MAX));
+
+  EXPECT_THROW (convert (make<I8_TYPE> (0), primitive_type (10)),
+                std::runtime_error);
+}
+
+TEST (arith_tests, table_test)
+{
+  using namespace evm;
+
+  // the tables are built at compile time.
+  static_assert (arith_table<arith_op::add>[kernel_index (I64_TYPE, I64_TYPE)]
+                 == &promoted_arith<arith_op::add, I64_TYPE, I64_TYPE>);
+  static_assert (convert_table.size ()
+                 == primitive_type_count * primitive_type_count);
+
+  auto kernel = find_arith (arith_op::sub, U8_TYPE, F64_TYPE);
+  EXPECT_EQ (from_slot<F64_TYPE> (
+                 kernel (to_slot<U8_TYPE> (1), to_slot<F64_TYPE> (0.25))),
+             0.75);
+
+  EXPECT_THROW (find_arith (arith_op::add, I8_TYPE, primitive_type (12)),
+                std::runtime_error);
+  EXPECT_THROW (find_compare (compare_op::eq, primitive_type (10), I8_TYPE),
+                std::runtime_error);
+}
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/cache.h>
+#include <evm/optimizer.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using evm::opcode;
+
+/**
+ * A cache in a directory of its own, removed afterwards.
+ */
+class cache_tests : public testing::Test
+{
+protected:
+  void
+  SetUp () override
+  {
+    m_directory = testing::TempDir () + "evm_cache_"
+                  + testing::UnitTest::GetInstance ()
+                        ->current_test_info ()
+                        ->name ();
+    std::filesystem::remove_all (m_directory);
+  }
+
+  void
+  TearDown () override
+  {
+    std::filesystem::remove_all (m_directory);
+  }
+
+  std::string m_directory;
+};
+
+/**
+ * Calls a host function with the sum of its arguments, from a second
+ * function.
+ */
+static std::vector<uint8_t>
+sample_module ()
+{
+  return make_module (
+      {
+          { opcode::load_local, 0 },
+          { opcode::load_local, 1 },
+          { opcode::nop },
+          { opcode::add },
+          { opcode::load_const, 0 },
+          { opcode::add },
+          { opcode::ret },
+          { opcode::load_const, 1 },
+          { opcode::load_const, 2 },
+          { opcode::call, 0 },
+          { opcode::host_call, 0 },
+          { opcode::ret },
+      },
+      { evm::make_primitive<evm::I64_TYPE> (1),
+        evm::make_primitive<evm::I64_TYPE> (-5),
+        evm::make_primitive<evm::I64_TYPE> (7) },
+      { { .entry = 0,
+          .arg_count = 2,
+          .locals = { evm::I64_TYPE, evm::I64_TYPE },
+          .result = evm::I64_TYPE },
+        { .entry = 7, .arg_count = 0, .locals = {}, .result = {} } });
+}
+
+static const std::vector<evm::host_signature> hosts = {
+  { .args = { evm::I64_TYPE }, .result = {} },
+};
+
+static void
+expect_same (const evm::verified_program &a, const evm::verified_program &b)
+{
+  EXPECT_EQ (a.prog.code.opcodes, b.prog.code.opcodes);
+  EXPECT_EQ (a.prog.code.operands, b.prog.code.operands);
+  EXPECT_EQ (a.prog.code.offsets, b.prog.code.offsets);
+  EXPECT_EQ (a.prog.constants, b.prog.constants);
+  EXPECT_EQ (a.prog.strings, b.prog.strings);
+
+  ASSERT_EQ (a.prog.functions.size (), b.prog.functions.size ());
+  for (uint64_t i = 0; i < a.prog.functions.size (); i++)
+    {
+      EXPECT_EQ (a.prog.functions[i].entry, b.prog.functions[i].entry);
+      EXPECT_EQ (a.prog.functions[i].arg_count, b.prog.functions[i].arg_count);
+      EXPECT_EQ (a.prog.functions[i].locals, b.prog.functions[i].locals);
+      EXPECT_EQ (a.prog.functions[i].result, b.prog.functions[i].result);
+    }
+
+  EXPECT_EQ (a.verified.depths, b.verified.depths);
+  EXPECT_EQ (a.verified.type_offsets, b.verified.type_offsets);
+  EXPECT_EQ (a.verified.types, b.verified.types);
+  EXPECT_EQ (a.verified.owners, b.verified.owners);
+  EXPECT_EQ (a.verified.max_depths, b.verified.max_depths);
+  EXPECT_EQ (a.verified.frame_sizes, b.verified.frame_sizes);
+  ASSERT_EQ (a.verified.hosts.size (), b.verified.hosts.size ());
+
+  EXPECT_EQ (a.lowered.code, b.lowered.code);
+  EXPECT_EQ (a.lowered.entries, b.lowered.entries);
+}
+
+TEST_F (cache_tests, hit_test)
+{
+  auto module = sample_module ();
+  evm::program_cache cache (m_directory);
+  auto key = evm::cache_key::of (module, hosts, true);
+
+  EXPECT_FALSE (cache.find (key, hosts).has_value ());
+  auto loaded = cache.load (module, hosts);
+  EXPECT_TRUE (std::filesystem::exists (cache.path_of (key)));
+
+  // as it would be without the cache.
+  evm::verified_program expected;
+  expected.prog = evm::load_program (evm::module_view (module));
+  evm::optimize_program (expected.prog);
+  expected.verified = evm::verify_program (expected.prog, hosts);
+  expected.lowered = evm::lower_program (expected.prog, expected.verified);
+  ASSERT_FALSE (expected.lowered.code.empty ());
+  expect_same (loaded, expected);
+
+  auto found = cache.find (key, hosts);
+  ASSERT_TRUE (found.has_value ());
+  expect_same (*found, expected);
+  expect_same (cache.load (module, hosts), expected);
+
+  // another cache on the same directory, as another process would be.
+  evm::program_cache other (m_directory);
+  expect_same (*other.find (key, hosts), expected);
+}
+
+TEST_F (cache_tests, key_test)
+{
+  auto module = sample_module ();
+  auto key = evm::cache_key::of (module, hosts, true);
+
+  EXPECT_EQ (key, evm::cache_key::of (module, hosts, true));
+  EXPECT_EQ (key.to_string ().size (), 32);
+
+  // everything the cached program depends on is in the key.
+  EXPECT_NE (key, evm::cache_key::of (module, hosts, false));
+  EXPECT_NE (key, evm::cache_key::of (module, {}, true));
+
+  auto other_hosts = hosts;
+  other_hosts[0].result = evm::I64_TYPE;
+  EXPECT_NE (key, evm::cache_key::of (module, other_hosts, true));
+
+  for (uint64_t i = 0; i < module.size (); i += 7)
+    {
+      auto changed = module;
+      changed[i] ^= 1;
+      EXPECT_NE (key, evm::cache_key::of (changed, hosts, true));
+    }
+}
+
+TEST_F (cache_tests, invalidation_test)
+{
+  auto module = sample_module ();
+  evm::program_cache cache (m_directory);
+  auto key = evm::cache_key::of (module, hosts, true);
+  cache.load (module, hosts);
+
+  auto path = cache.path_of (key);
+  auto rewrite = [&] (uint64_t offset, uint8_t value) {
+    std::fstream file (path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp (static_cast<std::streamoff> (offset));
+    file.put (static_cast<char> (value));
+  };
+
+  // an entry of another cache version is never found.
+  rewrite (4, evm::cache_version + 1);
+  EXPECT_FALSE (cache.find (key, hosts).has_value ());
+  EXPECT_EQ (cache.prune (), 1);
+  EXPECT_FALSE (std::filesystem::exists (path));
+
+  // loading saves it again.
+  auto loaded = cache.load (module, hosts);
+  ASSERT_TRUE (cache.find (key, hosts).has_value ());
+  EXPECT_EQ (cache.prune (), 0);
+
+  // nor is a damaged one.
+  rewrite (std::filesystem::file_size (path) - 1, 0xee);
+  EXPECT_FALSE (cache.find (key, hosts).has_value ());
+  expect_same (cache.load (module, hosts), loaded);
+
+  std::filesystem::resize_file (path, 40);
+  EXPECT_FALSE (cache.find (key, hosts).has_value ());
+
+  // left behind by a writer that stopped.
+  std::ofstream (path + ".1.0.tmp") << "partial";
+  std::ofstream (m_directory + "/unrelated") << "kept";
+  EXPECT_EQ (cache.prune (), 2);
+  EXPECT_TRUE (std::filesystem::exists (m_directory + "/unrelated"));
+}
+
+TEST_F (cache_tests, malformed_test)
+{
+  evm::program_cache cache (m_directory);
+
+  // errors are not cached.
+  auto bad = sample_module ();
+  bad[0] ^= 1;
+  EXPECT_THROW (cache.load (bad, hosts), std::runtime_error);
+
+  auto module = sample_module ();
+  EXPECT_THROW (cache.load (module, {}), std::runtime_error);
+  EXPECT_TRUE (std::filesystem::is_empty (m_directory));
+
+  EXPECT_THROW (evm::program_cache ("/proc/evm_cache"), std::runtime_error);
+}
@@ -0,0 +1,288 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/compact.h>
+#include <evm/stream.h>
+#include <limits>
+#include <stdexcept>
+
+using evm::opcode;
+
+static std::vector<uint8_t>
+uleb (uint64_t value)
+{
+  evm::byte_writer writer;
+  writer.write_uleb128 (value);
+  return writer.take ();
+}
+
+static std::vector<uint8_t>
+sleb (int64_t value)
+{
+  evm::byte_writer writer;
+  writer.write_sleb128 (value);
+  return writer.take ();
+}
+
+TEST (compact_tests, leb128_test)
+{
+  EXPECT_EQ (uleb (0), std::vector<uint8_t> ({ 0x00 }));
+  EXPECT_EQ (uleb (127), std::vector<uint8_t> ({ 0x7f }));
+  EXPECT_EQ (uleb (128), std::vector<uint8_t> ({ 0x80, 0x01 }));
+  EXPECT_EQ (uleb (624485), std::vector<uint8_t> ({ 0xe5, 0x8e, 0x26 }));
+  EXPECT_EQ (sleb (-1), std::vector<uint8_t> ({ 0x7f }));
+  EXPECT_EQ (sleb (63), std::vector<uint8_t> ({ 0x3f }));
+  EXPECT_EQ (sleb (64), std::vector<uint8_t> ({ 0xc0, 0x00 }));
+  EXPECT_EQ (sleb (-123456), std::vector<uint8_t> ({ 0xc0, 0xbb, 0x78 }));
+
+  static_assert (evm::uleb128_size (UINT64_MAX) == evm::max_leb128_size);
+  static_assert (evm::sleb128_size (INT64_MIN) == evm::max_leb128_size);
+  static_assert (evm::sleb128_size (-64) == 1);
+}
+
+TEST (compact_tests, round_trip_test)
+{
+  std::vector<uint64_t> unsigned_values = { 0, 1, 127, 128, 16383, 16384 };
+  std::vector<int64_t> signed_values = { 0, 1, -1, 63, -64, 64, -65 };
+
+  // every width, at its edges.
+  for (int bits = 7; bits < 64; bits += 7)
+    {
+      unsigned_values.push_back ((uint64_t (1) << bits) - 1);
+      unsigned_values.push_back (uint64_t (1) << bits);
+      signed_values.push_back ((int64_t (1) << (bits - 1)) - 1);
+      signed_values.push_back (-(int64_t (1) << (bits - 1)));
+    }
+  unsigned_values.push_back (UINT64_MAX);
+  signed_values.push_back (INT64_MAX);
+  signed_values.push_back (INT64_MIN);
+
+  for (auto value : unsigned_values)
+    {
+      auto bytes = uleb (value);
+      EXPECT_EQ (bytes.size (), evm::uleb128_size (value));
+
+      // both with the word at a time path, and without.
+      for (uint64_t padding : { 0, 16 })
+        {
+          auto padded = bytes;
+          padded.resize (bytes.size () + padding, 0xff);
+
+          uint64_t loaded = ~value;
+          EXPECT_EQ (evm::load_uleb128 (padded.data (), padded.size (), loaded),
+                     bytes.size ());
+          EXPECT_EQ (loaded, value);
+        }
+    }
+
+  for (auto value : signed_values)
+    {
+      auto bytes = sleb (value);
+      EXPECT_EQ (bytes.size (), evm::sleb128_size (value));
+
+      for (uint64_t padding : { 0, 16 })
+        {
+          auto padded = bytes;
+          padded.resize (bytes.size () + padding, 0xff);
+
+          int64_t loaded = ~value;
+          EXPECT_EQ (evm::load_sleb128 (padded.data (), padded.size (), loaded),
+                     bytes.size ());
+          EXPECT_EQ (loaded, value);
+        }
+    }
+}
+
+TEST (compact_tests, malformed_test)
+{
+  uint64_t value;
+
+  // no last byte.
+  std::vector<uint8_t> truncated = { 0x80, 0x80 };
+  EXPECT_EQ (evm::load_uleb128 (truncated.data (), truncated.size (), value),
+             0);
+
+  // more than 64 bits.
+  std::vector<uint8_t> too_large (9, 0xff);
+  too_large.push_back (0x02);
+  EXPECT_EQ (evm::load_uleb128 (too_large.data (), too_large.size (), value),
+             0);
+
+  std::vector<uint8_t> too_long (11, 0x80);
+  too_long.push_back (0);
+  EXPECT_EQ (evm::load_uleb128 (too_long.data (), too_long.size (), value), 0);
+
+  evm::byte_reader reader (truncated);
+  EXPECT_THROW (reader.read_uleb128 (), std::runtime_error);
+
+  // an i8 constant that needs more than 8 bits.
+  evm::byte_writer writer;
+  writer.write (evm::I8_TYPE);
+  writer.write_sleb128 (200);
+  evm::byte_reader constant (writer.bytes ());
+  EXPECT_THROW (constant.read_compact_primitive (), std::runtime_error);
+
+  // a truncated constant, before and after compacting.
+  evm::byte_writer fat;
+  fat.write_primitive (evm::make_primitive<evm::I64_TYPE> (5), true);
+  evm::byte_writer compact;
+  compact.write_compact_primitive (evm::make_primitive<evm::F64_TYPE> (0.5));
+
+  for (bool compacted : { false, true })
+    {
+      auto constants = compacted ? compact.bytes () : fat.bytes ();
+      evm::module_writer module;
+      module.add_section (evm::section_kind::code, std::vector<uint8_t> ());
+      module.add_section (evm::section_kind::constants,
+                          constants.first (constants.size () - 3));
+      if (compacted)
+        module.set_flags (evm::module_flag_compact);
+      auto bytes = module.write ();
+
+      if (!compacted)
+        {
+          EXPECT_THROW (evm::compact_module (evm::module_view (bytes)),
+                        std::runtime_error);
+        }
+      EXPECT_THROW (evm::load_program (evm::module_view (bytes)),
+                    std::runtime_error);
+    }
+}
+
+TEST (compact_tests, primitive_test)
+{
+  std::vector<evm::primitive_value> values = {
+    evm::make_primitive<evm::I8_TYPE> (-128),
+    evm::make_primitive<evm::U16_TYPE> (65535),
+    evm::make_primitive<evm::I32_TYPE> (-1),
+    evm::make_primitive<evm::U64_TYPE> (UINT64_MAX),
+    evm::make_primitive<evm::I64_TYPE> (INT64_MIN),
+    evm::make_primitive<evm::F32_TYPE> (0.25f),
+    evm::make_primitive<evm::F64_TYPE> (-1e300),
+  };
+
+  evm::byte_writer writer;
+  for (const auto &value : values)
+    writer.write_compact_primitive (value);
+  writer.write_compact_string ("hello");
+
+  evm::byte_reader reader (writer.bytes ());
+  for (const auto &value : values)
+    EXPECT_EQ (reader.read_compact_primitive (), value);
+  EXPECT_EQ (reader.read_compact_string (), "hello");
+  EXPECT_TRUE (reader.at_end ());
+}
+
+/**
+ * A loop whose fused branch jumps far enough that its target takes
+ * two bytes, which moves everything after it.
+ */
+static std::vector<uint8_t>
+loop_module ()
+{
+  std::vector<test_instr> code = {
+    { opcode::load_const, 0 },
+    { opcode::store_local, 1 },
+  };
+
+  auto exit = evm::branch_operand{
+    .target = 0, .value = 0, .compare = opcode::ge, .jump = opcode::jump_if
+  };
+  auto branch = code.size ();
+  code.push_back ({ opcode::branch_local });
+
+  for (int i = 0; i < 40; i++)
+    {
+      code.push_back ({ opcode::load_local, 1 });
+      code.push_back ({ opcode::add_const, 1 });
+      code.push_back ({ opcode::store_local, 1 });
+    }
+  code.push_back ({ opcode::jump, branch });
+
+  exit.target = static_cast<uint32_t> (code.size ());
+  code[branch].operand = exit.pack ();
+  code.push_back ({ opcode::load_local, 1 });
+  code.push_back ({ opcode::ret });
+
+  return make_module (code,
+                      { evm::make_primitive<evm::I64_TYPE> (0),
+                        evm::make_primitive<evm::I64_TYPE> (1) },
+                      { { .entry = 0,
+                          .arg_count = 1,
+                          .locals = { evm::I64_TYPE, evm::I64_TYPE },
+                          .result = evm::I64_TYPE } });
+}
+
+static void
+expect_same (const evm::program &a, const evm::program &b)
+{
+  EXPECT_EQ (a.code.opcodes, b.code.opcodes);
+  EXPECT_EQ (a.code.operands, b.code.operands);
+  EXPECT_EQ (a.constants, b.constants);
+
+  ASSERT_EQ (a.functions.size (), b.functions.size ());
+  for (uint64_t i = 0; i < a.functions.size (); i++)
+    {
+      EXPECT_EQ (a.functions[i].entry, b.functions[i].entry);
+      EXPECT_EQ (a.functions[i].locals, b.functions[i].locals);
+    }
+}
+
+TEST (compact_tests, module_test)
+{
+  auto module = loop_module ();
+  auto compact = evm::compact_module (evm::module_view (module));
+  evm::module_view view (compact);
+
+  EXPECT_TRUE (view.header ().flags & evm::module_flag_compact);
+
+  // the operands are small, so the code is under two thirds the size.
+  auto old_code = evm::module_view (module).section (evm::section_kind::code);
+  auto new_code = view.section (evm::section_kind::code);
+  EXPECT_LT (new_code->size () * 3, old_code->size () * 2);
+  EXPECT_LT (compact.size (), module.size ());
+
+  auto loaded = evm::load_program (evm::module_view (module));
+  auto compact_loaded = evm::load_program (view);
+  expect_same (compact_loaded, loaded);
+
+  // compacting twice changes nothing.
+  EXPECT_EQ (evm::compact_module (view), compact);
+}
+
+TEST (compact_tests, stream_test)
+{
+  auto module = loop_module ();
+  auto compact = evm::compact_module (evm::module_view (module));
+  auto loaded = evm::load_program (evm::module_view (compact));
+
+  for (uint64_t chunk : { 1, 3, 7, 64 })
+    {
+      evm::program_builder builder;
+      evm::module_stream stream (builder);
+
+      for (uint64_t offset = 0; offset < compact.size (); offset += chunk)
+        stream.feed (std::span (compact).subspan (
+            offset, std::min (chunk, compact.size () - offset)));
+
+      stream.finish ();
+      expect_same (builder.take (), loaded);
+    }
+
+  // truncated in the middle of the code.
+  auto code = evm::module_view (compact).sections ()[0];
+  auto truncated = compact;
+  truncated.resize (code.offset + code.size - 1);
+  evm::program_builder builder;
+  evm::module_stream stream (builder);
+  stream.feed (truncated);
+  EXPECT_THROW (stream.finish (), std::runtime_error);
+}
+
+TEST (compact_tests, flags_test)
+{
+  auto module = loop_module ();
+  // an unknown flag.
+  module[6] |= 0x80;
+  EXPECT_THROW (evm::module_view view (module), std::runtime_error);
+}
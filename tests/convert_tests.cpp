@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <evm/convert.h>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using evm::primitive_type;
+using evm::primitive_value_t;
+using evm::simd_level;
+
+/**
+ * Values of every kind for a type: the limits, and for floats those just
+ * past the limits of the integers, then random ones.
+ */
+template <primitive_type TYPE>
+static std::vector<primitive_value_t<TYPE>>
+sample_values (uint64_t count)
+{
+  using T = primitive_value_t<TYPE>;
+  using limits = std::numeric_limits<T>;
+
+  std::vector<T> values = { T (0), T (1), limits::min (), limits::max (),
+                            limits::lowest () };
+  std::mt19937_64 random (TYPE);
+
+  if constexpr (std::is_floating_point_v<T>)
+    {
+      for (double value :
+           { -0.0, 0.5, -0.5, -1.0, 127.5, 128.0, -128.5, 255.9, 256.0,
+             65535.5, 2147483647.0, 2147483648.0, -2147483649.0, 4294967296.0,
+             9.3e18, -9.3e18, 1.8e19, 1.9e19 })
+        values.push_back (static_cast<T> (value));
+
+      values.push_back (limits::infinity ());
+      values.push_back (-limits::infinity ());
+      values.push_back (limits::quiet_NaN ());
+      values.push_back (limits::denorm_min ());
+
+      // any bits, then any magnitude.
+      std::uniform_real_distribution<double> unit (-1, 1);
+      while (values.size () < count / 2)
+        {
+          auto bits = random ();
+          T value;
+          std::memcpy (&value, &bits, sizeof (value));
+          values.push_back (value);
+        }
+      while (values.size () < count)
+        values.push_back (static_cast<T> (
+            std::ldexp (unit (random), int (random () % 140) - 70)));
+    }
+  else
+    while (values.size () < count)
+      values.push_back (static_cast<T> (random ()));
+
+  return values;
+}
+
+/**
+ * Whether two values are the same, taking NaN to be the same as NaN.
+ */
+template <typename T>
+static bool
+same (T lhs, T rhs)
+{
+  if constexpr (std::is_floating_point_v<T>)
+    if (std::isnan (lhs) && std::isnan (rhs))
+      return true;
+
+  return std::memcmp (&lhs, &rhs, sizeof (T)) == 0;
+}
+
+TEST (convert_tests, pairs_test)
+{
+  auto support = evm::simd_support ();
+
+  for (uint8_t from = 0; from < evm::primitive_type_count; from++)
+    for (uint8_t to = 0; to < evm::primitive_type_count; to++)
+      evm::visit_type (primitive_type (from), [&] (auto from_tag) {
+        evm::visit_type (primitive_type (to), [&] (auto to_tag) {
+          constexpr auto FROM = decltype (from_tag)::value;
+          constexpr auto TO = decltype (to_tag)::value;
+          using T = primitive_value_t<TO>;
+
+          // not a whole number of blocks, so the rest is converted too.
+          auto in = sample_values<FROM> (131);
+
+          for (uint8_t level = 0; level <= uint8_t (support); level++)
+            {
+              std::vector<T> out (in.size ());
+              evm::find_array_convert (FROM, TO, simd_level (level)) (
+                  in.data (), out.data (), in.size ());
+
+              for (uint64_t i = 0; i < in.size (); i++)
+                ASSERT_TRUE (
+                    same (out[i], evm::convert_value<FROM, TO> (in[i])))
+                    << int (from) << " to " << int (to) << " with "
+                    << evm::simd_level_name (simd_level (level))
+                    << " at " << i;
+            }
+        });
+      });
+}
+
+TEST (convert_tests, value_test)
+{
+  using namespace evm;
+  constexpr auto nan = std::numeric_limits<double>::quiet_NaN ();
+
+  EXPECT_EQ ((convert_value<F64_TYPE, I32_TYPE> (nan)), 0);
+  EXPECT_EQ ((convert_value<F64_TYPE, I32_TYPE> (1e10)), INT32_MAX);
+  EXPECT_EQ ((convert_value<F64_TYPE, I32_TYPE> (-1e10)), INT32_MIN);
+  EXPECT_EQ ((convert_value<F64_TYPE, I32_TYPE> (-2.9)), -2);
+  EXPECT_EQ ((convert_value<F64_TYPE, U8_TYPE> (-3.7)), 0);
+  EXPECT_EQ ((convert_value<F64_TYPE, U8_TYPE> (255.9)), 255);
+  EXPECT_EQ ((convert_value<F32_TYPE, I64_TYPE> (1e19f)), INT64_MAX);
+  EXPECT_EQ ((convert_value<F64_TYPE, F32_TYPE> (1e300)),
+             std::numeric_limits<float>::infinity ());
+
+  // the typed arrays.
+  std::vector<int32_t> ints = { -1, 0, 7, INT32_MAX, INT32_MIN };
+  std::vector<double> doubles (ints.size ());
+  convert_array<I32_TYPE, F64_TYPE> (ints, doubles);
+  EXPECT_EQ (doubles,
+             (std::vector<double>{ -1.0, 0.0, 7.0, 2147483647.0,
+                                   -2147483648.0 }));
+
+  std::vector<uint8_t> bytes = { 0, 1, 200, 255 };
+  std::vector<int64_t> longs (bytes.size ());
+  convert_array<U8_TYPE, I64_TYPE> (bytes, longs);
+  EXPECT_EQ (longs, (std::vector<int64_t>{ 0, 1, 200, 255 }));
+
+  std::vector<float> floats (3);
+  EXPECT_THROW ((convert_array<U8_TYPE, F32_TYPE> (bytes, floats)),
+                std::runtime_error);
+}
+
+TEST (convert_tests, level_test)
+{
+  EXPECT_EQ (evm::simd_level_name (simd_level::scalar), "scalar");
+  EXPECT_EQ (evm::simd_level_name (simd_level::sse4_2), "sse4.2");
+  EXPECT_EQ (evm::simd_level_name (simd_level::avx2), "avx2");
+
+  // the scalar kernels are always there.
+  EXPECT_NE (evm::find_array_convert (evm::I8_TYPE, evm::F64_TYPE,
+                                      simd_level::scalar),
+             nullptr);
+  EXPECT_THROW (evm::find_array_convert (evm::REF_TYPE, evm::F64_TYPE),
+                std::runtime_error);
+
+  if (evm::simd_support () < simd_level::avx2)
+    {
+      EXPECT_THROW (evm::find_array_convert (evm::I8_TYPE, evm::F64_TYPE,
+                                             simd_level::avx2),
+                    std::runtime_error);
+    }
+}
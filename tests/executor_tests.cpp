@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/executor.h>
+#include <atomic>
+#include <stdexcept>
+
+using evm::opcode;
+
+TEST (executor_tests, submit_test)
+{
+  auto prog = std::make_shared<const evm::program> (sum_program ());
+  evm::executor pool (4);
+  EXPECT_EQ (pool.size (), 4);
+
+  std::vector<std::future<std::optional<evm::primitive_value>>> results;
+  for (int64_t i = 0; i < 1000; i++)
+    results.push_back (pool.submit (prog, 0, { i64 (i) }));
+
+  for (int64_t i = 0; i < 1000; i++)
+    EXPECT_EQ (results[i].get (), i64 (i * (i + 1) / 2));
+
+  uint64_t jobs = 0;
+  for (const auto &stats : pool.stats ())
+    {
+      jobs += stats.jobs;
+      EXPECT_GE (stats.utilization, 0.0);
+      EXPECT_LE (stats.utilization, 1.0);
+    }
+  EXPECT_EQ (jobs, 1000);
+}
+
+TEST (executor_tests, verified_test)
+{
+  auto prog = std::make_shared<const evm::program> (fib_program ());
+  auto verified
+      = std::make_shared<const evm::verification> (evm::verify_program (*prog));
+  evm::executor pool (2);
+
+  auto checked = pool.submit (prog, 0, { i64 (15) });
+  auto fast = pool.submit (prog, verified, 0, { i64 (15) });
+
+  EXPECT_EQ (checked.get (), i64 (610));
+  EXPECT_EQ (fast.get (), i64 (610));
+}
+
+TEST (executor_tests, error_test)
+{
+  auto prog = std::make_shared<const evm::program> (sum_program ());
+  evm::executor pool (2);
+
+  // the wrong number of arguments.
+  auto result = pool.submit (prog, 0, {});
+  EXPECT_THROW (result.get (), std::runtime_error);
+
+  // the worker carries on.
+  EXPECT_EQ (pool.submit (prog, 0, { i64 (3) }).get (), i64 (6));
+}
+
+TEST (executor_tests, host_test)
+{
+  auto prog = std::make_shared<const evm::program> (make_program (
+      { { opcode::load_local, 0 }, { opcode::host_call, 0 }, { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } }));
+
+  std::atomic<int> calls = 0;
+  evm::executor pool (3);
+  pool.bind_host (0, { .arg_count = 1, .call = [&] (auto args) {
+                         calls++;
+                         return std::optional (args[0]);
+                       } });
+
+  std::vector<std::future<std::optional<evm::primitive_value>>> results;
+  for (int64_t i = 0; i < 100; i++)
+    results.push_back (pool.submit (prog, 0, { i64 (i) }));
+
+  for (int64_t i = 0; i < 100; i++)
+    EXPECT_EQ (results[i].get (), i64 (i));
+  EXPECT_EQ (calls, 100);
+}
+
+TEST (executor_tests, task_test)
+{
+  auto prog = std::make_shared<const evm::program> (make_program (
+      { { opcode::load_local, 0 }, { opcode::host_call, 0 }, { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } }));
+
+  // a host that suspends is run until it finishes.
+  evm::executor pool (2);
+  pool.bind_host (0, { .arg_count = 1,
+                       .call = {},
+                       .task = [] (auto args) -> evm::host_task {
+                         auto value = *evm::get_primitive<evm::I64_TYPE> (
+                             args[0]);
+                         co_await std::suspend_always{};
+                         co_return i64 (value * 4);
+                       } });
+
+  EXPECT_EQ (pool.submit (prog, 0, { i64 (10) }).get (), i64 (40));
+}
+
+TEST (executor_tests, drain_test)
+{
+  auto prog = std::make_shared<const evm::program> (sum_program ());
+  std::vector<std::future<std::optional<evm::primitive_value>>> results;
+
+  {
+    evm::executor pool (2);
+    for (int64_t i = 0; i < 200; i++)
+      results.push_back (pool.submit (prog, 0, { i64 (1000) }));
+  }
+
+  // everything submitted ran before the pool stopped.
+  for (auto &result : results)
+    EXPECT_EQ (result.get (), i64 (500500));
+}
+
+TEST (executor_tests, steal_test)
+{
+  auto sum = std::make_shared<const evm::program> (sum_program ());
+  auto spawner = std::make_shared<const evm::program> (make_program (
+      { { opcode::load_local, 0 }, { opcode::host_call, 0 }, { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } }));
+
+  evm::executor pool (2);
+
+  // queues scripts on its own worker, then waits for them, so the other
+  // worker has to steal every one.
+  auto spawn = [&] (std::span<const evm::primitive_value> args) {
+    auto count = *evm::get_primitive<evm::I64_TYPE> (args[0]);
+
+    std::vector<std::future<std::optional<evm::primitive_value>>> results;
+    for (int64_t i = 0; i < count; i++)
+      results.push_back (pool.submit (sum, 0, { i64 (i) }));
+
+    int64_t total = 0;
+    for (auto &result : results)
+      total += *evm::get_primitive<evm::I64_TYPE> (*result.get ());
+    return std::optional (i64 (total));
+  };
+  pool.bind_host (0, { .arg_count = 1, .call = spawn });
+
+  EXPECT_EQ (pool.submit (spawner, 0, { i64 (20) }).get (), i64 (1330));
+
+  uint64_t steals = 0;
+  for (const auto &stats : pool.stats ())
+    {
+      EXPECT_LE (stats.steals, stats.jobs);
+      steals += stats.steals;
+    }
+  EXPECT_GE (steals, 20);
+}
+
+TEST (executor_tests, cache_test)
+{
+  // more programs than a worker keeps interpreters for, all still held.
+  std::vector<std::shared_ptr<const evm::program>> progs;
+  for (int i = 0; i < 200; i++)
+    progs.push_back (std::make_shared<const evm::program> (sum_program ()));
+
+  evm::executor pool (2);
+  for (int round = 0; round < 2; round++)
+    {
+      std::vector<std::future<std::optional<evm::primitive_value>>> results;
+      for (const auto &prog : progs)
+        results.push_back (pool.submit (prog, 0, { i64 (10) }));
+      for (auto &result : results)
+        EXPECT_EQ (result.get (), i64 (55));
+    }
+
+  for (const auto &stats : pool.stats ())
+    EXPECT_LE (stats.interpreters, 64);
+}
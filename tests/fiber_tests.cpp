@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/fiber.h>
+#include <evm/interpreter.h>
+#include <evm/verifier.h>
+#include <algorithm>
+#include <stdexcept>
+
+using evm::opcode;
+
+/**
+ * Returns get (key) + get (key + 1), with get as host function 0.
+ */
+static evm::program
+lookup_program ()
+{
+  return make_program ({ { opcode::load_local, 0 },
+                         { opcode::host_call, 0 },
+                         { opcode::load_local, 0 },
+                         { opcode::load_const, 0 },
+                         { opcode::add },
+                         { opcode::host_call, 0 },
+                         { opcode::add },
+                         { opcode::ret } },
+                       { i64 (1) },
+                       { { .entry = 0,
+                           .arg_count = 1,
+                           .locals = { evm::I64_TYPE },
+                           .result = evm::I64_TYPE } });
+}
+
+static const evm::host_signature lookup_hosts[]
+    = { { .args = { evm::I64_TYPE }, .result = evm::I64_TYPE } };
+
+/**
+ * A key/value store standing in for I/O, whose lookups take a few turns.
+ */
+struct slow_store
+{
+  uint64_t in_flight = 0;
+  uint64_t max_in_flight = 0;
+
+  evm::host_function
+  get ()
+  {
+    return { .arg_count = 1,
+             .call = {},
+             .task = [this] (auto args) -> evm::host_task {
+               auto key = *evm::get_primitive<evm::I64_TYPE> (args[0]);
+
+               in_flight++;
+               max_in_flight = std::max (max_in_flight, in_flight);
+               for (int64_t i = 0; i <= key % 3; i++)
+                 co_await std::suspend_always{};
+               in_flight--;
+
+               co_return i64 (key * 10);
+             } };
+  }
+};
+
+TEST (fiber_tests, lookup_test)
+{
+  auto prog = lookup_program ();
+  auto verified = evm::verify_program (prog, lookup_hosts);
+
+  for (bool verify : { false, true })
+    {
+      auto interp = verify ? evm::interpreter (prog, verified)
+                           : evm::interpreter (prog);
+      slow_store store;
+      interp.bind_host (0, store.get ());
+
+      evm::scheduler fibers (interp);
+      std::vector<std::shared_ptr<evm::fiber>> spawned;
+      for (int64_t key = 0; key < 10000; key++)
+        spawned.push_back (fibers.spawn (0, { i64 (key) }));
+
+      EXPECT_EQ (fibers.size (), 10000);
+      fibers.run ();
+      EXPECT_EQ (fibers.size (), 0);
+
+      // every fiber waited on the store at once.
+      EXPECT_EQ (store.max_in_flight, 10000);
+      EXPECT_EQ (store.in_flight, 0);
+
+      for (int64_t key = 0; key < 10000; key++)
+        {
+          ASSERT_TRUE (spawned[key]->finished ());
+          EXPECT_EQ (spawned[key]->result (), i64 (key * 20 + 10));
+        }
+    }
+}
+
+TEST (fiber_tests, run_test)
+{
+  // outside a fiber, the task is run until it finishes.
+  auto prog = lookup_program ();
+  evm::interpreter interp (prog);
+  slow_store store;
+  interp.bind_host (0, store.get ());
+
+  evm::primitive_value args[] = { i64 (5) };
+  EXPECT_EQ (interp.run (0, args), i64 (110));
+}
+
+TEST (fiber_tests, string_test)
+{
+  // holds a string across a suspended host call, then doubles it.
+  auto prog = make_program (
+      {
+          { opcode::load_string, 0 },
+          { opcode::store_local, 1 },
+          { opcode::load_local, 0 },
+          { opcode::host_call, 0 },
+          { opcode::pop },
+          { opcode::load_local, 1 },
+          { opcode::load_local, 1 },
+          { opcode::concat },
+          { opcode::ret },
+      },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE, evm::REF_TYPE },
+          .result = evm::REF_TYPE } },
+      { "ab" });
+
+  evm::interpreter interp (prog);
+  slow_store store;
+  interp.bind_host (0, store.get ());
+
+  evm::scheduler fibers (interp);
+  auto doubled = fibers.spawn (0, { i64 (0) });
+  EXPECT_TRUE (fibers.step ());
+
+  // the string moves out of the nursery while the fiber is suspended.
+  auto collections = interp.heap ().stats ().minor_collections;
+  interp.heap ().collect ();
+  EXPECT_GT (interp.heap ().stats ().minor_collections, collections);
+
+  EXPECT_FALSE (fibers.step ());
+  auto result = doubled->result ();
+  ASSERT_TRUE (result.has_value ());
+  EXPECT_EQ (interp.heap ().string (to_slot (*result)), "abab");
+}
+
+TEST (fiber_tests, error_test)
+{
+  auto prog = lookup_program ();
+  auto verified = evm::verify_program (prog, lookup_hosts);
+  evm::interpreter interp (prog, verified);
+
+  // fails for 3 after suspending, and returns the wrong type for 4.
+  interp.bind_host (
+      0, { .arg_count = 1,
+           .call = {},
+           .task = [] (auto args) -> evm::host_task {
+             auto key = *evm::get_primitive<evm::I64_TYPE> (args[0]);
+             co_await std::suspend_always{};
+
+             if (key == 3)
+               throw std::runtime_error ("Lookup failed.");
+             if (key == 4)
+               co_return evm::primitive_value (1.0);
+             co_return i64 (key);
+           } });
+
+  evm::scheduler fibers (interp);
+  auto failed = fibers.spawn (0, { i64 (2) });
+  auto wrong = fibers.spawn (0, { i64 (4) });
+  auto missing = fibers.spawn (1, {});
+  auto fine = evm::fiber (0, { i64 (0) });
+
+  EXPECT_THROW (failed->result (), std::runtime_error);
+  fibers.run ();
+
+  // the errors end their own fibers only.
+  EXPECT_THROW (failed->result (), std::runtime_error);
+  EXPECT_THROW (wrong->result (), std::runtime_error);
+  EXPECT_THROW (missing->result (), std::runtime_error);
+
+  while (!interp.resume (fine))
+    ;
+  EXPECT_EQ (fine.result (), i64 (1));
+
+  // a fiber stays with its interpreter.
+  evm::interpreter other (prog, verified);
+  evm::fiber started (0, { i64 (0) });
+  EXPECT_FALSE (interp.resume (started));
+  EXPECT_THROW (other.resume (started), std::runtime_error);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <evm/heap.h>
+#include <stdexcept>
+#include <string>
+
+TEST (heap_tests, object_test)
+{
+  evm::heap heap;
+
+  auto hello = heap.make_string ("hello");
+  auto world = heap.make_string (", world");
+  EXPECT_EQ (heap.kind (hello), evm::object_kind::string);
+  EXPECT_EQ (heap.string (hello), "hello");
+  EXPECT_EQ (heap.string (heap.concat (hello, world)), "hello, world");
+  EXPECT_EQ (heap.string (heap.make_string ("")), "");
+
+  auto array = heap.make_array (3);
+  EXPECT_EQ (heap.kind (array), evm::object_kind::array);
+  EXPECT_EQ (heap.length (array), 3);
+  EXPECT_EQ (heap.get (array, 0), evm::primitive_value (evm::heap_ref{ 0 }));
+
+  heap.set (array, 1, evm::make_primitive<evm::I32_TYPE> (-4));
+  heap.set (array, 2, evm::primitive_value (evm::heap_ref{ hello }));
+  EXPECT_EQ (heap.get (array, 1), evm::make_primitive<evm::I32_TYPE> (-4));
+  EXPECT_EQ (heap.get (array, 2), evm::primitive_value (evm::heap_ref{ hello }));
+
+  EXPECT_THROW (heap.get (array, 3), std::runtime_error);
+  EXPECT_THROW (heap.string (array), std::runtime_error);
+  EXPECT_THROW (heap.get (hello, 0), std::runtime_error);
+  EXPECT_THROW (heap.concat (hello, 0), std::runtime_error);
+  EXPECT_THROW (heap.kind (0), std::runtime_error);
+}
+
+TEST (heap_tests, minor_test)
+{
+  evm::heap heap ({ .nursery_size = 8192 });
+  evm::tagged_stack roots;
+  heap.add_roots (roots);
+
+  roots.push (heap.make_string ("kept"), evm::REF_TYPE);
+  roots.push (7, evm::I64_TYPE);
+  auto before = roots.slot (0);
+
+  // garbage, which is never copied.
+  for (int i = 0; i < 1000; i++)
+    heap.make_string ("garbage " + std::to_string (i));
+
+  const auto &stats = heap.stats ();
+  EXPECT_GT (stats.minor_collections, 0);
+  EXPECT_EQ (stats.major_collections, 0);
+
+  // the root moved to the tenured space, only it was copied.
+  EXPECT_NE (roots.slot (0), before);
+  EXPECT_EQ (heap.string (roots.slot (0)), "kept");
+  EXPECT_EQ (stats.promoted, 16);
+  EXPECT_EQ (roots.slot (1), 7);
+
+  heap.remove_roots (roots);
+}
+
+TEST (heap_tests, barrier_test)
+{
+  evm::heap heap ({ .nursery_size = 8192 });
+  evm::tagged_stack roots;
+  heap.add_roots (roots);
+
+  roots.push (heap.make_array (2), evm::REF_TYPE);
+  heap.collect ();
+
+  // a tenured array refers into the nursery, through the barrier.
+  auto young = heap.make_string ("young");
+  heap.set (roots.slot (0), 0, young, evm::REF_TYPE);
+  heap.set (roots.slot (0), 1, heap.make_array (1), evm::REF_TYPE);
+  heap.collect ();
+
+  auto array = roots.slot (0);
+  auto element = heap.get (array, 0);
+  EXPECT_NE (std::get<evm::heap_ref> (element).address, young);
+  EXPECT_EQ (heap.string (std::get<evm::heap_ref> (element).address),
+             "young");
+  EXPECT_EQ (heap.length (std::get<evm::heap_ref> (heap.get (array, 1))
+                              .address),
+             1);
+
+  heap.remove_roots (roots);
+}
+
+TEST (heap_tests, major_test)
+{
+  evm::heap heap ({ .nursery_size = 8192, .chunk_size = 16384 });
+  evm::tagged_stack roots;
+  heap.add_roots (roots);
+
+  // a list of arrays, each referring to the one before.
+  roots.push (0, evm::REF_TYPE);
+  for (int i = 0; i < 100; i++)
+    {
+      auto node = heap.make_array (2);
+      heap.set (node, 0, evm::make_primitive<evm::I64_TYPE> (i));
+      heap.set (node, 1, roots.slot (0), evm::REF_TYPE);
+      roots.slot (0) = node;
+    }
+
+  // promoted, then dropped, so only full collections free them.
+  for (int i = 0; i < 2000; i++)
+    {
+      roots.push (heap.make_string (std::string (100, 'x')), evm::REF_TYPE);
+      heap.collect ();
+      roots.pop ();
+    }
+
+  const auto &stats = heap.stats ();
+  EXPECT_GT (stats.major_collections, 0);
+  EXPECT_LT (stats.tenured, 2000 * 100 / 2);
+
+  int64_t expected = 99;
+  for (auto node = roots.slot (0); node != 0;
+       node = std::get<evm::heap_ref> (heap.get (node, 1)).address)
+    EXPECT_EQ (heap.get (node, 0), evm::make_primitive<evm::I64_TYPE> (
+                                       expected--));
+  EXPECT_EQ (expected, -1);
+
+  // nothing is left once the roots are gone.
+  roots.clear ();
+  heap.collect (true);
+  EXPECT_EQ (stats.tenured, 0);
+
+  heap.remove_roots (roots);
+}
+
+TEST (heap_tests, large_test)
+{
+  evm::heap heap ({ .nursery_size = 8192 });
+  evm::tagged_stack roots;
+  heap.add_roots (roots);
+
+  // too large for the nursery, so tenured at once.
+  std::string large (100000, 'l');
+  roots.push (heap.make_string (large), evm::REF_TYPE);
+  EXPECT_GE (heap.stats ().tenured, large.size ());
+  EXPECT_EQ (heap.string (roots.slot (0)), large);
+
+  roots.push (heap.concat (roots.slot (0), roots.slot (0)), evm::REF_TYPE);
+  EXPECT_EQ (heap.string (roots.slot (1)), large + large);
+
+  heap.remove_roots (roots);
+}
+
+TEST (heap_tests, pause_target_test)
+{
+  using namespace std::chrono_literals;
+
+  // every pause is longer than a nanosecond, so the nursery shrinks.
+  evm::heap heap ({ .nursery_size = 65536, .pause_target = 1ns });
+  EXPECT_EQ (heap.stats ().nursery_limit, 65536);
+
+  heap.collect ();
+  EXPECT_EQ (heap.stats ().nursery_limit, 32768);
+  for (int i = 0; i < 10; i++)
+    heap.collect ();
+  EXPECT_EQ (heap.stats ().nursery_limit, 4096);
+  EXPECT_GT (heap.stats ().longest_pause.count (), 0);
+
+  // and grows back when pauses are short enough.
+  evm::heap relaxed ({ .nursery_size = 65536, .pause_target = 1h });
+  relaxed.collect ();
+  EXPECT_EQ (relaxed.stats ().nursery_limit, 65536);
+}
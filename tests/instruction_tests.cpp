@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <evm/decode.h>
+#include <evm/instruction.h>
+#include <stdexcept>
+#include <vector>
+
+static std::vector<uint8_t>
+encode (const std::vector<evm::instruction> &instrs)
+{
+  auto info = evm::instruction::get_ls_info ();
+  std::vector<uint8_t> code;
+
+  for (const auto &instr : instrs)
+    {
+      auto offset = code.size ();
+      code.resize (offset + info.save_size (instr));
+      info.save (instr, code.data () + offset);
+    }
+
+  return code;
+}
+
+TEST (instruction_tests, load_save_test)
+{
+  auto instr = evm::instruction{ .code = evm::opcode::load_local,
+                                 .args = { .local = { 513 } } };
+  auto info = evm::instruction::get_ls_info ();
+
+  uint8_t buffer[8];
+  info.save (instr, buffer);
+
+  EXPECT_EQ (info.load_size (buffer), 3);
+
+  auto loaded = info.load (buffer);
+  EXPECT_EQ (loaded.code, evm::opcode::load_local);
+  EXPECT_EQ (loaded.args.local.value, 513);
+}
+
+TEST (instruction_tests, decode_test)
+{
+  // offsets: 0, 3, 8, 9, 14, 16.
+  auto code = encode ({
+      { .code = evm::opcode::load_local, .args = { .local = { 0 } } },
+      { .code = evm::opcode::jump_if, .args = { .jump = { 16 } } },
+      { .code = evm::opcode::nop, .args = { .lonely = {} } },
+      { .code = evm::opcode::jump, .args = { .jump = { 0 } } },
+      { .code = evm::opcode::conv, .args = { .type = { evm::F64_TYPE } } },
+      { .code = evm::opcode::ret, .args = { .lonely = {} } },
+  });
+
+  auto decoded = evm::decode_code (code);
+
+  ASSERT_EQ (decoded.size (), 6);
+  EXPECT_EQ (decoded.opcodes[1], evm::opcode::jump_if);
+  // jump targets become instruction indices.
+  EXPECT_EQ (decoded.operands[1], 5);
+  EXPECT_EQ (decoded.operands[3], 0);
+  EXPECT_EQ (decoded.operands[4], evm::F64_TYPE);
+  EXPECT_EQ (decoded.offsets[5], 16);
+
+  EXPECT_EQ (decoded.index_of (9), 3);
+  EXPECT_FALSE (decoded.index_of (10).has_value ());
+}
+
+TEST (instruction_tests, decode_malformed_test)
+{
+  auto bad_jump = encode ({
+      { .code = evm::opcode::jump, .args = { .jump = { 2 } } },
+  });
+  EXPECT_THROW (evm::decode_code (bad_jump), std::runtime_error);
+
+  auto truncated = encode ({
+      { .code = evm::opcode::load_const, .args = { .index = { 1 } } },
+  });
+  truncated.pop_back ();
+  EXPECT_THROW (evm::decode_code (truncated), std::runtime_error);
+
+  const std::vector<uint8_t> bad_opcode = { 0xff };
+  EXPECT_THROW (evm::decode_code (bad_opcode), std::runtime_error);
+}
+
+TEST (instruction_tests, branch_test)
+{
+  auto code = encode ({
+      { .code = evm::opcode::branch_local,
+        .args = { .branch = { .value = 3,
+                              .compare = evm::opcode::lt,
+                              .jump = evm::opcode::jump_unless,
+                              .target = 9 } } },
+      { .code = evm::opcode::ret, .args = { .lonely = {} } },
+  });
+
+  // opcode, value, comparison, jump and target.
+  ASSERT_EQ (code.size (), 10);
+
+  auto decoded = evm::decode_code (code);
+  auto branch = evm::branch_operand::unpack (decoded.operands[0]);
+  EXPECT_EQ (branch.value, 3);
+  EXPECT_EQ (branch.compare, evm::opcode::lt);
+  EXPECT_EQ (branch.jump, evm::opcode::jump_unless);
+  EXPECT_EQ (branch.target, 1);
+
+  // the comparison must be a comparison.
+  code[3] = static_cast<uint8_t> (evm::opcode::add);
+  EXPECT_THROW (evm::decode_code (code), std::runtime_error);
+}
+
+TEST (instruction_tests, quickened_test)
+{
+  EXPECT_EQ (evm::quickened_opcode (evm::opcode::add, evm::I64_TYPE),
+             evm::opcode::add_i64);
+  EXPECT_EQ (evm::quickened_opcode (evm::opcode::lt, evm::F64_TYPE),
+             evm::opcode::lt_f64);
+  EXPECT_EQ (evm::generic_opcode (evm::opcode::sub_const_f64),
+             evm::opcode::sub_const);
+  EXPECT_EQ (evm::opcode_kind (evm::opcode::sub_const_f64),
+             evm::opcode_kind (evm::opcode::sub_const));
+  EXPECT_THROW (evm::opcode_kind (static_cast<evm::opcode> (0xff)),
+                std::runtime_error);
+  EXPECT_EQ (evm::opcode_name (evm::opcode::ge_i64), "ge_i64");
+
+  // others are left as they are.
+  EXPECT_EQ (evm::quickened_opcode (evm::opcode::add, evm::I32_TYPE),
+             evm::opcode::add);
+  EXPECT_EQ (evm::quickened_opcode (evm::opcode::div, evm::I64_TYPE),
+             evm::opcode::div);
+  EXPECT_EQ (evm::generic_opcode (evm::opcode::ret), evm::opcode::ret);
+
+  // they are never encoded.
+  EXPECT_FALSE (evm::opcode_valid (static_cast<uint8_t> (evm::opcode::add_i64)));
+  const std::vector<uint8_t> quick = { static_cast<uint8_t> (
+      evm::opcode::add_i64) };
+  EXPECT_THROW (evm::decode_code (quick), std::runtime_error);
+}
@@ -0,0 +1,298 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/interpreter.h>
+#include <evm/optimizer.h>
+#include <stdexcept>
+
+using evm::opcode;
+
+TEST (interpreter_tests, loop_test)
+{
+  auto prog = sum_program ();
+  evm::interpreter interp (prog);
+
+  evm::primitive_value args[] = { i64 (100) };
+  EXPECT_EQ (interp.run (0, args), i64 (5050));
+
+  // interpreters can be reused.
+  args[0] = i64 (0);
+  EXPECT_EQ (interp.run (0, args), i64 (0));
+}
+
+TEST (interpreter_tests, call_test)
+{
+  auto prog = fib_program ();
+  evm::interpreter interp (prog);
+
+  evm::primitive_value args[] = { i64 (20) };
+  EXPECT_EQ (interp.run (0, args), i64 (6765));
+}
+
+TEST (interpreter_tests, host_call_test)
+{
+  auto prog = make_program (
+      { { opcode::load_local, 0 },
+        { opcode::conv, evm::F64_TYPE },
+        { opcode::host_call, 0 },
+        { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I32_TYPE },
+          .result = evm::F64_TYPE } });
+
+  evm::interpreter interp (prog);
+  interp.bind_host (0, { .arg_count = 1,
+                         .call = [] (auto args) {
+                           auto value = evm::get_primitive<evm::F64_TYPE> (
+                               args[0]);
+                           return evm::primitive_value (*value / 4);
+                         } });
+
+  evm::primitive_value args[] = { evm::make_primitive<evm::I32_TYPE> (3) };
+  EXPECT_EQ (interp.run (0, args), evm::make_primitive<evm::F64_TYPE> (0.75));
+}
+
+TEST (interpreter_tests, error_test)
+{
+  auto prog = make_program (
+      { { opcode::load_local, 0 },
+        { opcode::load_const, 0 },
+        { opcode::add },
+        { opcode::ret } },
+      { evm::make_primitive<evm::I8_TYPE> (1) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE },
+        { .entry = 2, .arg_count = 0, .locals = {}, .result = {} } });
+
+  evm::interpreter interp (prog);
+
+  // i64 + i8.
+  evm::primitive_value args[] = { i64 (1) };
+  EXPECT_THROW (interp.run (0, args), std::runtime_error);
+  // add with an empty stack.
+  EXPECT_THROW (interp.run (1, {}), std::runtime_error);
+  // wrong argument count.
+  EXPECT_THROW (interp.run (0, {}), std::runtime_error);
+}
+
+TEST (interpreter_tests, dispatch_test)
+{
+  auto name = evm::interpreter::dispatch_name ();
+  EXPECT_TRUE (name == "threaded" || name == "switch");
+}
+
+TEST (interpreter_tests, verified_test)
+{
+  auto sum = sum_program ();
+  auto sum_verified = evm::verify_program (sum);
+  evm::interpreter sum_interp (sum, sum_verified);
+
+  evm::primitive_value args[] = { i64 (100) };
+  EXPECT_EQ (sum_interp.run (0, args), i64 (5050));
+
+  auto fib = fib_program ();
+  auto fib_verified = evm::verify_program (fib);
+  evm::interpreter fib_interp (fib, fib_verified);
+
+  args[0] = i64 (20);
+  EXPECT_EQ (fib_interp.run (0, args), i64 (6765));
+
+  // arguments still get checked.
+  evm::primitive_value bad[] = { evm::make_primitive<evm::I8_TYPE> (1) };
+  EXPECT_THROW (fib_interp.run (0, bad), std::runtime_error);
+  // as does the verification.
+  EXPECT_THROW (evm::interpreter (sum, fib_verified), std::runtime_error);
+}
+
+TEST (interpreter_tests, verified_host_test)
+{
+  auto prog = make_program (
+      { { opcode::load_local, 0 }, { opcode::host_call, 0 }, { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  evm::host_signature hosts[]
+      = { { .args = { evm::I64_TYPE }, .result = evm::I64_TYPE } };
+  auto verified = evm::verify_program (prog, hosts);
+  evm::interpreter interp (prog, verified);
+
+  EXPECT_THROW (interp.bind_host (0, { .arg_count = 2, .call = {} }),
+                std::runtime_error);
+
+  bool wrong = false;
+  interp.bind_host (0, { .arg_count = 1, .call = [&] (auto args) {
+                          if (wrong)
+                            return evm::primitive_value (1.0);
+                          return evm::primitive_value (
+                              *evm::get_primitive<evm::I64_TYPE> (args[0])
+                              * 2);
+                        } });
+
+  evm::primitive_value args[] = { i64 (21) };
+  EXPECT_EQ (interp.run (0, args), i64 (42));
+
+  // the host is held to its signature.
+  wrong = true;
+  EXPECT_THROW (interp.run (0, args), std::runtime_error);
+}
+
+TEST (interpreter_tests, optimized_test)
+{
+  auto sum = sum_program ();
+  evm::optimize_program (sum);
+  auto sum_verified = evm::verify_program (sum);
+
+  evm::primitive_value args[] = { i64 (100) };
+  EXPECT_EQ (evm::interpreter (sum).run (0, args), i64 (5050));
+  EXPECT_EQ (evm::interpreter (sum, sum_verified).run (0, args), i64 (5050));
+
+  auto fib = fib_program ();
+  evm::optimize_program (fib);
+  auto fib_verified = evm::verify_program (fib);
+
+  args[0] = i64 (20);
+  EXPECT_EQ (evm::interpreter (fib).run (0, args), i64 (6765));
+  EXPECT_EQ (evm::interpreter (fib, fib_verified).run (0, args), i64 (6765));
+}
+
+TEST (interpreter_tests, string_test)
+{
+  // joins "ab" to a string as many times as its i64 argument,
+  // then passes it through a host function.
+  auto prog = make_program (
+      {
+          { opcode::load_string, 0 }, { opcode::store_local, 1 },
+          { opcode::load_local, 0 },  { opcode::load_const, 0 },
+          { opcode::gt },             { opcode::jump_unless, 15 },
+          { opcode::load_local, 1 },  { opcode::load_string, 1 },
+          { opcode::concat },         { opcode::store_local, 1 },
+          { opcode::load_local, 0 },  { opcode::load_const, 1 },
+          { opcode::sub },            { opcode::store_local, 0 },
+          { opcode::jump, 2 },        { opcode::load_local, 1 },
+          { opcode::host_call, 0 },   { opcode::ret },
+          // joins a null reference.
+          { opcode::load_local, 0 },  { opcode::load_string, 0 },
+          { opcode::concat },         { opcode::ret },
+      },
+      { i64 (0), i64 (1) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE, evm::REF_TYPE },
+          .result = evm::REF_TYPE },
+        { .entry = 18,
+          .arg_count = 0,
+          .locals = { evm::REF_TYPE },
+          .result = evm::REF_TYPE } },
+      { "", "ab" });
+
+  evm::host_signature hosts[]
+      = { { .args = { evm::REF_TYPE }, .result = evm::REF_TYPE } };
+  auto verified = evm::verify_program (prog, hosts);
+
+  std::string expected;
+  for (int i = 0; i < 500; i++)
+    expected += "ab";
+
+  evm::heap_options options{ .nursery_size = 16 * 1024 };
+  evm::interpreter checked (prog, options);
+  evm::interpreter unchecked (prog, verified, options);
+
+  for (auto *interp : { &checked, &unchecked })
+    {
+      // the host sees the string, and makes another on the heap.
+      interp->bind_host (
+          0, { .arg_count = 1, .call = [interp, &expected] (auto args) {
+                auto ref = std::get<evm::heap_ref> (args[0]);
+                EXPECT_EQ (interp->heap ().string (ref.address), expected);
+                auto copy = interp->heap ().make_string ("copy");
+                return evm::primitive_value (evm::heap_ref{ copy });
+              } });
+
+      evm::primitive_value args[] = { i64 (500) };
+      auto result = interp->run (0, args);
+      ASSERT_TRUE (result.has_value ());
+      EXPECT_EQ (evm::primitive_get_type (*result), evm::REF_TYPE);
+      EXPECT_EQ (interp->heap ().string (to_slot (*result)), "copy");
+
+      // the strings did not fit in the nursery at once.
+      EXPECT_GT (interp->heap ().stats ().minor_collections, 0);
+      EXPECT_THROW (interp->run (1, {}), std::runtime_error);
+    }
+}
+
+TEST (interpreter_tests, quicken_test)
+{
+  auto prog = sum_program ();
+  evm::interpreter interp (prog);
+  EXPECT_TRUE (interp.quickened_code ().empty ());
+
+  // the loop is never entered, so only the comparison is quickened.
+  evm::primitive_value args[] = { i64 (0) };
+  EXPECT_EQ (interp.run (0, args), i64 (0));
+
+  auto code = interp.quickened_code ();
+  ASSERT_EQ (code.size (), prog.code.size ());
+  EXPECT_EQ (code[2], opcode::gt_i64);
+  EXPECT_EQ (code[6], opcode::add);
+
+  args[0] = i64 (100);
+  EXPECT_EQ (interp.run (0, args), i64 (5050));
+  EXPECT_EQ (code[6], opcode::add_i64);
+  EXPECT_EQ (code[10], opcode::sub_i64);
+
+  // verified code is quickened before it runs.
+  auto verified = evm::verify_program (prog);
+  evm::interpreter verified_interp (prog, verified);
+  EXPECT_EQ (verified_interp.run (0, args), i64 (5050));
+
+  auto verified_code = verified_interp.quickened_code ();
+  EXPECT_EQ (verified_code[2], opcode::gt_i64);
+  EXPECT_EQ (verified_code[6], opcode::add_i64);
+  EXPECT_EQ (verified_code[10], opcode::sub_i64);
+}
+
+TEST (interpreter_tests, deopt_test)
+{
+  // both functions run the same add, of i64 and of f64 values.
+  auto prog = make_program (
+      { { opcode::load_local, 0 },
+        { opcode::load_local, 0 },
+        { opcode::add },
+        { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE },
+        { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::F64_TYPE },
+          .result = evm::F64_TYPE } });
+
+  evm::interpreter interp (prog);
+  evm::primitive_value ints[] = { i64 (2) };
+  evm::primitive_value floats[] = { evm::make_primitive<evm::F64_TYPE> (1.5) };
+
+  EXPECT_EQ (interp.run (0, ints), i64 (4));
+  EXPECT_EQ (interp.quickened_code ()[2], opcode::add_i64);
+
+  // the guard fails, and the add is quickened again for f64.
+  EXPECT_EQ (interp.run (1, floats), evm::make_primitive<evm::F64_TYPE> (3.0));
+  EXPECT_EQ (interp.quickened_code ()[2], opcode::add_f64);
+
+  // until it has failed too often, and stays generic.
+  for (int i = 0; i < 4; i++)
+    {
+      EXPECT_EQ (interp.run (0, ints), i64 (4));
+      EXPECT_EQ (interp.run (1, floats),
+                 evm::make_primitive<evm::F64_TYPE> (3.0));
+    }
+  EXPECT_EQ (interp.quickened_code ()[2], opcode::add);
+}
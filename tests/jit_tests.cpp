@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/jit.h>
+#include <evm/optimizer.h>
+#include <limits>
+#include <stdexcept>
+
+using evm::opcode;
+
+TEST (jit_tests, native_test)
+{
+  auto prog = sum_program ();
+  auto verified = evm::verify_program (prog);
+  evm::jit_compiler jit (prog, verified);
+
+  ASSERT_TRUE (jit.supported (0));
+  auto native = jit.compile (0);
+  ASSERT_NE (native, nullptr);
+  // compiled once.
+  EXPECT_EQ (jit.compile (0), native);
+
+  std::vector<evm::value_slot> frame (verified.frame_sizes[0]);
+  frame[0] = 100;
+  ASSERT_TRUE (native (frame.data ()));
+  EXPECT_EQ (frame[0], 5050);
+}
+
+TEST (jit_tests, unsupported_test)
+{
+  // fib makes calls.
+  auto prog = fib_program ();
+  auto verified = evm::verify_program (prog);
+  evm::jit_compiler jit (prog, verified);
+
+  EXPECT_FALSE (jit.supported (0));
+  EXPECT_EQ (jit.compile (0), nullptr);
+  EXPECT_THROW (jit.emit (0), std::runtime_error);
+
+  // the interpreter carries on without it.
+  evm::interpreter interp (prog, verified);
+  interp.set_tier_up (&jit, 1, 1);
+
+  evm::primitive_value args[] = { i64 (15) };
+  EXPECT_EQ (interp.run (0, args), i64 (610));
+  EXPECT_FALSE (interp.compiled (0));
+}
+
+TEST (jit_tests, tier_up_test)
+{
+  auto prog = sum_program ();
+  evm::optimize_program (prog);
+  auto verified = evm::verify_program (prog);
+  evm::jit_compiler jit (prog, verified);
+
+  evm::interpreter interp (prog, verified);
+  interp.set_tier_up (&jit, 3, 1000);
+
+  evm::primitive_value args[] = { i64 (100) };
+
+  for (int i = 0; i < 2; i++)
+    {
+      EXPECT_EQ (interp.run (0, args), i64 (5050));
+      EXPECT_FALSE (interp.compiled (0));
+    }
+
+  EXPECT_EQ (interp.run (0, args), i64 (5050));
+  EXPECT_TRUE (interp.compiled (0));
+
+  args[0] = i64 (1000);
+  EXPECT_EQ (interp.run (0, args), i64 (500500));
+
+  // only verified code tiers up.
+  evm::interpreter checked (prog);
+  EXPECT_THROW (checked.set_tier_up (&jit), std::runtime_error);
+}
+
+TEST (jit_tests, back_edge_test)
+{
+  auto prog = sum_program ();
+  auto verified = evm::verify_program (prog);
+  evm::jit_compiler jit (prog, verified);
+
+  evm::interpreter interp (prog, verified);
+  interp.set_tier_up (&jit, 1000, 50);
+
+  // the loop finishes in the interpreter, the next call is compiled.
+  evm::primitive_value args[] = { i64 (100) };
+  EXPECT_EQ (interp.run (0, args), i64 (5050));
+  EXPECT_FALSE (interp.compiled (0));
+
+  EXPECT_EQ (interp.run (0, args), i64 (5050));
+  EXPECT_TRUE (interp.compiled (0));
+}
+
+TEST (jit_tests, call_test)
+{
+  // the caller stays interpreted, and calls the compiled callee.
+  auto prog = make_program (
+      { { opcode::load_local, 0 },
+        { opcode::call, 1 },
+        { opcode::load_const, 0 },
+        { opcode::add },
+        { opcode::ret },
+        { opcode::load_local, 0 },
+        { opcode::load_local, 0 },
+        { opcode::mul },
+        { opcode::neg },
+        { opcode::ret } },
+      { i64 (1) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE },
+        { .entry = 5,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE, evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  auto verified = evm::verify_program (prog);
+  evm::jit_compiler jit (prog, verified);
+
+  evm::interpreter interp (prog, verified);
+  interp.set_tier_up (&jit, 1, 1);
+
+  evm::primitive_value args[] = { i64 (7) };
+  EXPECT_EQ (interp.run (0, args), i64 (-48));
+  EXPECT_FALSE (interp.compiled (0));
+  EXPECT_TRUE (interp.compiled (1));
+}
+
+TEST (jit_tests, division_test)
+{
+  // returns a / b - a % b.
+  auto prog = make_program (
+      { { opcode::load_local, 0 },
+        { opcode::load_local, 1 },
+        { opcode::div },
+        { opcode::load_local, 0 },
+        { opcode::load_local, 1 },
+        { opcode::rem },
+        { opcode::sub },
+        { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 2,
+          .locals = { evm::I64_TYPE, evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  auto verified = evm::verify_program (prog);
+  evm::jit_compiler jit (prog, verified);
+  evm::interpreter interp (prog, verified);
+  interp.set_tier_up (&jit, 1, 1);
+
+  evm::primitive_value args[] = { i64 (-7), i64 (2) };
+  EXPECT_EQ (interp.run (0, args), i64 (-2));
+  ASSERT_TRUE (interp.compiled (0));
+
+  // wraps around like the interpreter.
+  auto min = std::numeric_limits<int64_t>::min ();
+  args[0] = i64 (min);
+  args[1] = i64 (-1);
+  EXPECT_EQ (interp.run (0, args), i64 (min));
+
+  args[1] = i64 (0);
+  EXPECT_THROW (interp.run (0, args), std::runtime_error);
+}
+
+TEST (jit_tests, entry_test)
+{
+  // the loop body comes before the entry, and adds 5 once.
+  auto prog = make_program ({ { opcode::load_local, 0 },
+                              { opcode::ret },
+                              { opcode::load_local, 0 },
+                              { opcode::load_const, 0 },
+                              { opcode::add },
+                              { opcode::store_local, 0 },
+                              { opcode::jump, 0 } },
+                            { i64 (5) },
+                            { { .entry = 2,
+                                .arg_count = 1,
+                                .locals = { evm::I64_TYPE },
+                                .result = evm::I64_TYPE } });
+
+  auto verified = evm::verify_program (prog);
+  evm::jit_compiler jit (prog, verified);
+  evm::interpreter interp (prog, verified);
+  interp.set_tier_up (&jit, 2, 1000);
+
+  evm::primitive_value args[] = { i64 (10) };
+  EXPECT_EQ (interp.run (0, args), i64 (15));
+  EXPECT_FALSE (interp.compiled (0));
+
+  EXPECT_EQ (interp.run (0, args), i64 (15));
+  ASSERT_TRUE (interp.compiled (0));
+  EXPECT_EQ (interp.run (0, args), i64 (15));
+}
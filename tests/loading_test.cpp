@@ -1,6 +1,9 @@
 #include <evm/loading.h>
+#include <evm/serializer.h>
 #include <gtest/gtest.h>
 
+#include <vector>
+
 TEST (loading_tests, uint16_t_load)
 {
   constexpr uint8_t data[] = { 0x00, 0x01 }; // Should be 256
@@ -86,3 +89,122 @@ TEST (loading_tests, string_test)
 
   EXPECT_STREQ (str_loaded.data (), str.data ());
 }
+
+TEST (loading_tests, span_load_save_test)
+{
+  const std::vector<int32_t> values = { 1, -2, 300000, -400000, 5 };
+  std::vector<uint8_t> buffer (values.size () * sizeof (int32_t));
+
+  evm::save_span<int32_t> (values, buffer.data ());
+
+  // each element must be where value_ls_info would have put it.
+  auto i32_ls_info = evm::value_ls_info<int32_t> ();
+  for (uint64_t i = 0; i < values.size (); i++)
+    EXPECT_EQ (i32_ls_info.load (buffer.data () + i * 4), values[i]);
+
+  std::vector<int32_t> loaded (values.size ());
+  evm::load_span<int32_t> (loaded, buffer.data ());
+
+  EXPECT_EQ (loaded, values);
+}
+
+TEST (loading_tests, span_byte_order_test)
+{
+  constexpr std::endian foreign = std::endian::native == std::endian::little
+                                      ? std::endian::big
+                                      : std::endian::little;
+
+  const std::vector<double> values = { 1.5, -2.25e100, 0.0 };
+  std::vector<uint8_t> buffer (values.size () * sizeof (double));
+
+  evm::save_span<double> (values, buffer.data (), foreign);
+
+  std::vector<double> loaded (values.size ());
+  evm::load_span<double> (loaded, buffer.data (), foreign);
+  EXPECT_EQ (loaded, values);
+
+  constexpr uint8_t data[] = { 0x00, 0x01, 0x01, 0x00 };
+  uint16_t big[2];
+  evm::load_span<uint16_t> (big, data, std::endian::big);
+
+  EXPECT_EQ (big[0], 1);
+  EXPECT_EQ (big[1], 256);
+}
+
+TEST (loading_tests, string_view_borrow_test)
+{
+  const auto str_view_info = evm::value_ls_info<std::string_view> ();
+
+  std::string_view str = "borrowed identifier";
+  uint8_t buffer[128];
+
+  str_view_info.save (str, buffer);
+
+  auto view = str_view_info.load (buffer);
+
+  EXPECT_EQ (view, str);
+  EXPECT_EQ (str_view_info.load_size (buffer), str.size () + 8);
+  // the view points straight into the buffer.
+  EXPECT_EQ (reinterpret_cast<const uint8_t *> (view.data ()), buffer + 8);
+}
+
+/**
+ * A type with a compile time serializer.
+ */
+struct point_t
+{
+  int16_t x, y;
+};
+
+template <> struct evm::serializer<point_t>
+{
+  static constexpr uint64_t size = 4;
+
+  static point_t
+  load (const uint8_t *buffer)
+  {
+    return point_t{ .x = serializer<int16_t>::load (buffer),
+                    .y = serializer<int16_t>::load (buffer + 2) };
+  }
+
+  static void
+  save (const point_t &value, uint8_t *buffer)
+  {
+    serializer<int16_t>::save (value.x, buffer);
+    serializer<int16_t>::save (value.y, buffer + 2);
+  }
+
+  static constexpr uint64_t
+  load_size (const uint8_t *)
+  {
+    return size;
+  }
+
+  static constexpr uint64_t
+  save_size (const point_t &)
+  {
+    return size;
+  }
+};
+
+static_assert (evm::fixed_serializable<uint64_t>);
+static_assert (evm::fixed_serializable<point_t>);
+static_assert (evm::serializable<std::string>);
+static_assert (!evm::fixed_serializable<std::string_view>);
+static_assert (!evm::serializable<std::vector<int>>);
+
+TEST (loading_tests, serializer_test)
+{
+  uint8_t buffer[8];
+
+  evm::serializer<double>::save (0.125, buffer);
+  EXPECT_EQ (evm::value_ls_info<double> ().load (buffer), 0.125);
+
+  constexpr auto point_info = evm::make_ls_info<point_t> ();
+  point_info.save ({ .x = -4, .y = 9 }, buffer);
+
+  auto point = point_info.load (buffer);
+  EXPECT_EQ (point.x, -4);
+  EXPECT_EQ (point.y, 9);
+  EXPECT_EQ (point_info.load_size (buffer), 4);
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/lowering.h>
+#include <evm/optimizer.h>
+#include <evm/verifier.h>
+
+using evm::opcode;
+using evm::reg_op;
+
+static evm::reg_program
+lower (const evm::program &prog)
+{
+  return evm::lower_program (prog, evm::verify_program (prog));
+}
+
+TEST (lowering_tests, sum_test)
+{
+  auto prog = sum_program ();
+  auto lowered = lower (prog);
+
+  // the loads and stores are gone, the comparison is fused with its jump,
+  // and the results are computed into the locals.
+  ASSERT_EQ (lowered.code.size (), 5);
+  EXPECT_LT (lowered.code.size (), prog.code.size () / 2);
+  EXPECT_EQ (lowered.entries, std::vector<uint32_t>{ 0 });
+
+  const auto &branch = lowered.code[0];
+  EXPECT_EQ (branch.op, reg_op::branch_unless_k);
+  EXPECT_EQ (branch.compare, opcode::gt);
+  EXPECT_EQ (branch.a, 0);
+  EXPECT_EQ (branch.b, 0);
+  EXPECT_EQ (branch.dst, 4);
+
+  EXPECT_EQ (lowered.code[1], (evm::reg_instr{ .op = reg_op::add,
+                                               .type = evm::I64_TYPE,
+                                               .result = evm::I64_TYPE,
+                                               .compare = opcode::nop,
+                                               .dst = 1,
+                                               .a = 1,
+                                               .b = 0 }));
+  EXPECT_EQ (lowered.code[2].op, reg_op::sub_k);
+  EXPECT_EQ (lowered.code[2].dst, 0);
+  EXPECT_EQ (lowered.code[3].op, reg_op::jump);
+  EXPECT_EQ (lowered.code[3].dst, 0);
+  EXPECT_EQ (lowered.code[4].op, reg_op::ret);
+  EXPECT_EQ (lowered.code[4].a, 1);
+
+  // the fused stack code lowers the same.
+  auto optimized = sum_program ();
+  evm::optimize_program (optimized);
+  EXPECT_EQ (lower (optimized).code, lowered.code);
+}
+
+TEST (lowering_tests, call_test)
+{
+  auto prog = fib_program ();
+  auto lowered = lower (prog);
+  ASSERT_EQ (lowered.code.size (), 8);
+
+  // each argument is computed where the frame of the callee starts,
+  // just above the one local.
+  EXPECT_EQ (lowered.code[2].op, reg_op::sub_k);
+  EXPECT_EQ (lowered.code[2].dst, 1);
+  EXPECT_EQ (lowered.code[3].op, reg_op::call);
+  EXPECT_EQ (lowered.code[3].a, 1);
+  EXPECT_EQ (lowered.code[5].op, reg_op::call);
+  EXPECT_EQ (lowered.code[5].a, 2);
+  EXPECT_EQ (lowered.code[6].op, reg_op::add);
+}
+
+TEST (lowering_tests, block_test)
+{
+  // the constant is still pending when the loop starts, so it is loaded
+  // before it.
+  auto prog = make_program (
+      {
+          { opcode::load_const, 0 }, { opcode::load_local, 0 },
+          { opcode::load_const, 0 }, { opcode::gt },
+          { opcode::jump_unless, 12 }, { opcode::load_local, 0 },
+          { opcode::add },           { opcode::load_local, 0 },
+          { opcode::load_const, 1 }, { opcode::sub },
+          { opcode::store_local, 0 }, { opcode::jump, 1 },
+          { opcode::ret },
+      },
+      { evm::make_primitive<evm::I64_TYPE> (0),
+        evm::make_primitive<evm::I64_TYPE> (1) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  auto lowered = lower (prog);
+  ASSERT_GE (lowered.code.size (), 2);
+  EXPECT_EQ (lowered.code[0].op, reg_op::load_const);
+  EXPECT_EQ (lowered.code[0].dst, 1);
+  EXPECT_EQ (lowered.code[1].op, reg_op::branch_unless_k);
+  EXPECT_EQ (lowered.code.back ().op, reg_op::ret);
+  EXPECT_EQ (lowered.code.back ().a, 1);
+}
+
+TEST (lowering_tests, alias_test)
+{
+  // the old value of local 0 is still on the stack when it is stored to,
+  // so it is moved out first.
+  auto prog = make_program (
+      {
+          { opcode::load_local, 0 },
+          { opcode::load_local, 1 },
+          { opcode::store_local, 0 },
+          { opcode::ret },
+      },
+      {},
+      { { .entry = 0,
+          .arg_count = 2,
+          .locals = { evm::I64_TYPE, evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  auto lowered = lower (prog);
+  ASSERT_EQ (lowered.code.size (), 3);
+  EXPECT_EQ (lowered.code[0].op, reg_op::mov);
+  EXPECT_EQ (lowered.code[0].dst, 2);
+  EXPECT_EQ (lowered.code[0].a, 0);
+  EXPECT_EQ (lowered.code[1].op, reg_op::mov);
+  EXPECT_EQ (lowered.code[1].dst, 0);
+  EXPECT_EQ (lowered.code[1].a, 1);
+  EXPECT_EQ (lowered.code[2].a, 2);
+}
+
+TEST (lowering_tests, name_test)
+{
+  EXPECT_EQ (evm::reg_op_name (reg_op::mov), "mov");
+  EXPECT_EQ (evm::reg_op_name (reg_op::branch_unless_k), "branch_unless_k");
+  EXPECT_EQ (evm::reg_op_name (reg_op::concat), "concat");
+  EXPECT_EQ (evm::reg_op_name (static_cast<reg_op> (evm::reg_op_count)),
+             "invalid");
+}
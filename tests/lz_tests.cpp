@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <evm/lz.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t>
+round_trip (const std::vector<uint8_t> &input)
+{
+  auto block = evm::lz_compress (input);
+  EXPECT_LE (block.size (), evm::lz_bound (input.size ()));
+
+  std::vector<uint8_t> output (input.size ());
+  evm::lz_decompress (block, output);
+
+  return output;
+}
+
+TEST (lz_tests, round_trip_test)
+{
+  EXPECT_EQ (round_trip ({}), std::vector<uint8_t> ());
+  EXPECT_EQ (round_trip ({ 1, 2, 3 }), std::vector<uint8_t> ({ 1, 2, 3 }));
+
+  // runs, which overlap themselves when copied.
+  std::vector<uint8_t> run (10000, 7);
+  EXPECT_EQ (round_trip (run), run);
+  EXPECT_LT (evm::lz_compress (run).size (), 100);
+
+  std::string text;
+  for (int i = 0; i < 500; i++)
+    text += "load_local " + std::to_string (i % 13) + "; add; ret\n";
+  std::vector<uint8_t> repeated (text.begin (), text.end ());
+  EXPECT_EQ (round_trip (repeated), repeated);
+  EXPECT_LT (evm::lz_compress (repeated).size () * 4, repeated.size ());
+
+  // random bytes do not compress, and have more than 15 literals in a row.
+  std::mt19937 random (42);
+  std::vector<uint8_t> noise (70000);
+  for (auto &byte : noise)
+    byte = static_cast<uint8_t> (random ());
+  EXPECT_EQ (round_trip (noise), noise);
+
+  // matches further back than an offset reaches.
+  auto far = noise;
+  far.insert (far.end (), noise.begin (), noise.begin () + 1000);
+  EXPECT_EQ (round_trip (far), far);
+}
+
+TEST (lz_tests, malformed_test)
+{
+  std::vector<uint8_t> input (1000, 'a');
+  auto block = evm::lz_compress (input);
+
+  std::vector<uint8_t> output (input.size ());
+
+  // the wrong size, either way.
+  std::vector<uint8_t> small (input.size () - 1);
+  EXPECT_THROW (evm::lz_decompress (block, small), std::runtime_error);
+  std::vector<uint8_t> large (input.size () + 1);
+  EXPECT_THROW (evm::lz_decompress (block, large), std::runtime_error);
+
+  // every truncation.
+  for (uint64_t size = 0; size < block.size (); size++)
+    EXPECT_THROW (
+        evm::lz_decompress (std::span (block).first (size), output),
+        std::runtime_error);
+
+  // a match before the start of the output.
+  std::vector<uint8_t> bad_offset = { 0x10, 'a', 0x10, 0x00, 0x00 };
+  std::vector<uint8_t> five (5);
+  EXPECT_THROW (evm::lz_decompress (bad_offset, five), std::runtime_error);
+
+  std::vector<uint8_t> zero_offset = { 0x10, 'a', 0x00, 0x00, 0x00 };
+  EXPECT_THROW (evm::lz_decompress (zero_offset, five), std::runtime_error);
+}
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <evm/module.h>
+#include <evm/primitive.h>
+#include <evm/program.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::vector<uint8_t>
+constants_section ()
+{
+  evm::primitive_value vals[] = { evm::make_primitive<evm::I64_TYPE> (-7),
+                                  evm::make_primitive<evm::F32_TYPE> (2.5f) };
+
+  std::vector<uint8_t> data;
+  for (const auto &val : vals)
+    {
+      auto offset = data.size ();
+      data.resize (offset + evm::primitive_save_size (val, true));
+      evm::save_primitive (val, data.data () + offset, true);
+    }
+
+  return data;
+}
+
+TEST (module_tests, write_view_test)
+{
+  const std::vector<uint8_t> code = { 0, 0, 0 };
+  const auto constants = constants_section ();
+
+  evm::module_writer writer;
+  writer.add_section (evm::section_kind::code, code);
+  writer.add_section (evm::section_kind::constants, constants);
+
+  auto bytes = writer.write ();
+  EXPECT_EQ (bytes.size (), writer.size ());
+
+  evm::module_view view (bytes);
+  EXPECT_EQ (view.header ().section_count, 2);
+  EXPECT_FALSE (view.section (evm::section_kind::strings).has_value ());
+
+  auto code_section = view.section (evm::section_kind::code);
+  ASSERT_TRUE (code_section.has_value ());
+  EXPECT_EQ (std::vector<uint8_t> (code_section->begin (),
+                                   code_section->end ()),
+             code);
+
+  auto constants_in_place = view.section (evm::section_kind::constants);
+  ASSERT_TRUE (constants_in_place.has_value ());
+  EXPECT_EQ ((constants_in_place->data () - bytes.data ())
+                 % evm::module_section_alignment,
+             0);
+  EXPECT_EQ (evm::load_primitive (constants_in_place->data ()),
+             evm::make_primitive<evm::I64_TYPE> (-7));
+}
+
+TEST (module_tests, mapped_module_test)
+{
+  const std::vector<uint8_t> strings = { 'a', 'b', 'c' };
+  const std::string path = testing::TempDir () + "evm_mapped_module_test";
+
+  evm::module_writer writer;
+  writer.add_section (evm::section_kind::strings, strings);
+  writer.write_file (path);
+
+  {
+    evm::mapped_module module (path);
+    auto section = module.view ().section (evm::section_kind::strings);
+
+    ASSERT_TRUE (section.has_value ());
+    EXPECT_EQ (std::vector<uint8_t> (section->begin (), section->end ()),
+               strings);
+  }
+
+  std::remove (path.c_str ());
+}
+
+TEST (module_tests, compressed_test)
+{
+  std::vector<uint8_t> strings;
+  for (int i = 0; i < 4096; i++)
+    strings.push_back (static_cast<uint8_t> ('a' + i % 7));
+  const std::vector<uint8_t> code = { 1, 2, 3 };
+
+  evm::module_writer writer;
+  writer.add_section (evm::section_kind::strings, strings, true);
+  writer.add_section (evm::section_kind::constants, strings, true);
+  // too small to shrink, so it is saved as it is.
+  writer.add_section (evm::section_kind::code, code, true);
+  auto bytes = writer.write ();
+  EXPECT_LT (bytes.size (), strings.size ());
+
+  evm::module_view view (bytes);
+  const auto &sections = view.sections ();
+  EXPECT_EQ (sections[0].flags, evm::section_flag_compressed);
+  EXPECT_EQ (sections[0].raw_size, strings.size ());
+  EXPECT_EQ (sections[2].flags, 0);
+
+  // read from many threads at once, each section is decompressed once.
+  std::vector<std::thread> readers;
+  std::vector<const uint8_t *> seen (8);
+  for (uint64_t i = 0; i < seen.size (); i++)
+    readers.emplace_back ([&, i] {
+      seen[i] = view.section (evm::section_kind::strings)->data ();
+    });
+  for (auto &reader : readers)
+    reader.join ();
+  for (auto *data : seen)
+    EXPECT_EQ (data, seen[0]);
+
+  view.prefetch (2);
+  auto section = view.section (evm::section_kind::constants);
+  EXPECT_EQ (std::vector<uint8_t> (section->begin (), section->end ()),
+             strings);
+
+  // uncompressed sections are still read in place.
+  auto code_section = view.section (evm::section_kind::code);
+  EXPECT_EQ (code_section->data (), bytes.data () + sections[2].offset);
+
+  // copies share what is decompressed.
+  auto copy = view;
+  EXPECT_EQ (copy.section (evm::section_kind::strings)->data (), seen[0]);
+}
+
+TEST (module_tests, compressed_malformed_test)
+{
+  std::vector<uint8_t> strings (4096, 'x');
+
+  evm::module_writer writer;
+  writer.add_section (evm::section_kind::strings, strings, true);
+  auto bytes = writer.write ();
+  auto offset = evm::module_view (bytes).sections ()[0].offset;
+
+  // the first match reaches back before the start of the section.
+  auto bad_block = bytes;
+  bad_block[offset + 3] = 0xff;
+  evm::module_view view (bad_block);
+  EXPECT_THROW (view.section (evm::section_kind::strings), std::runtime_error);
+  EXPECT_THROW (view.prefetch (), std::runtime_error);
+
+  // a raw size that no block could expand to.
+  auto bad_size = bytes;
+  auto *raw_size = bad_size.data () + evm::module_header::saved_size + 24;
+  raw_size[7] = 0x10;
+  EXPECT_THROW (evm::module_view{ bad_size }, std::runtime_error);
+
+  auto bad_flags = bytes;
+  bad_flags[evm::module_header::saved_size + 4] |= 0x80;
+  EXPECT_THROW (evm::module_view{ bad_flags }, std::runtime_error);
+}
+
+TEST (module_tests, malformed_test)
+{
+  evm::module_writer writer;
+  writer.add_section (evm::section_kind::code, std::vector<uint8_t> (4));
+  auto bytes = writer.write ();
+
+  auto bad_magic = bytes;
+  bad_magic[0] ^= 0xff;
+  EXPECT_THROW (evm::module_view{ bad_magic }, std::runtime_error);
+
+  auto truncated = std::span<const uint8_t> (bytes).first (bytes.size () - 1);
+  EXPECT_THROW (evm::module_view{ truncated }, std::runtime_error);
+
+  EXPECT_THROW (evm::mapped_module ("/nonexistent/evm_module"),
+                std::runtime_error);
+}
+
+TEST (module_tests, truncated_constants_test)
+{
+  // an i64 constant cut to its type and two bytes.
+  auto constants = constants_section ();
+  constants.resize (3);
+
+  evm::module_writer writer;
+  writer.add_section (evm::section_kind::code, std::vector<uint8_t> ());
+  writer.add_section (evm::section_kind::constants, constants);
+  auto bytes = writer.write ();
+
+  EXPECT_THROW (evm::load_program (evm::module_view (bytes)),
+                std::runtime_error);
+}
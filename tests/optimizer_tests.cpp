@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/optimizer.h>
+#include <evm/verifier.h>
+
+using evm::opcode;
+
+TEST (optimizer_tests, fuse_test)
+{
+  auto prog = sum_program ();
+  evm::optimize_program (prog);
+
+  // load_local, load_const, gt, jump_unless and load_const, sub are fused.
+  ASSERT_EQ (prog.code.size (), 12);
+  EXPECT_EQ (prog.code.opcodes[1], opcode::branch_const);
+  EXPECT_EQ (prog.code.opcodes[7], opcode::sub_const);
+
+  auto branch = evm::branch_operand::unpack (prog.code.operands[1]);
+  EXPECT_EQ (branch.value, 0);
+  EXPECT_EQ (branch.compare, opcode::gt);
+  EXPECT_EQ (branch.jump, opcode::jump_unless);
+  // the load_local 1 after the loop.
+  EXPECT_EQ (branch.target, 10);
+  EXPECT_EQ (prog.code.opcodes[branch.target], opcode::load_local);
+
+  // the loop jumps back to the start.
+  EXPECT_EQ (prog.code.opcodes[9], opcode::jump);
+  EXPECT_EQ (prog.code.operands[9], 0);
+
+  EXPECT_NO_THROW (evm::verify_program (prog));
+}
+
+TEST (optimizer_tests, nop_test)
+{
+  auto prog = make_program (
+      { { opcode::nop },
+        { opcode::load_local, 0 },
+        { opcode::jump_if, 4 },
+        { opcode::nop },
+        { opcode::nop },
+        { opcode::load_local, 0 },
+        { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  evm::optimize_program (prog, evm::fusion_table::none ());
+
+  ASSERT_EQ (prog.code.size (), 4);
+  // the jump to a nop goes to the instruction after it.
+  EXPECT_EQ (prog.code.operands[1], 2);
+  EXPECT_EQ (prog.functions[0].entry, 0);
+
+  for (auto op : prog.code.opcodes)
+    EXPECT_NE (op, opcode::nop);
+}
+
+TEST (optimizer_tests, target_test)
+{
+  auto prog = make_program (
+      { { opcode::load_local, 0 },
+        { opcode::load_const, 0 },
+        { opcode::jump, 3 },
+        { opcode::add },
+        { opcode::ret } },
+      { evm::make_primitive<evm::I64_TYPE> (1) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  // load_const, add is not fused, as the add is a jump target.
+  evm::optimize_program (prog);
+  EXPECT_EQ (prog.code.size (), 5);
+
+  prog = make_program (
+      { { opcode::load_local, 0 }, { opcode::ret }, { opcode::load_const, 0 },
+        { opcode::add }, { opcode::ret } },
+      { evm::make_primitive<evm::I64_TYPE> (1) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE },
+        { .entry = 3,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  // nor is it fused into a function entry.
+  evm::optimize_program (prog);
+  EXPECT_EQ (prog.code.size (), 5);
+}
+
+TEST (optimizer_tests, profile_test)
+{
+  evm::opcode_pair_counts pairs;
+  pairs (opcode::load_const, opcode::add) = 100;
+  pairs (opcode::load_local, opcode::lt) = 50;
+  pairs (opcode::lt, opcode::jump_if) = 50;
+  pairs (opcode::load_local, opcode::load_local) = 10000;
+  pairs (opcode::load_const, opcode::sub) = 1;
+
+  EXPECT_EQ (pairs.total (), 10201);
+
+  auto table = evm::fusion_table::from_profile (pairs, 0.001);
+  EXPECT_TRUE (table.uses (opcode::add_const));
+  EXPECT_TRUE (table.uses (opcode::branch_local));
+  EXPECT_FALSE (table.uses (opcode::sub_const));
+  EXPECT_FALSE (table.uses (opcode::branch_const));
+  ASSERT_EQ (table.rules ().size (), 2);
+  // longest first.
+  EXPECT_EQ (table.rules ()[0].fused, opcode::branch_local);
+
+  EXPECT_FALSE (evm::fusion_table::from_profile ({}).uses (opcode::add_const));
+
+  auto prog = sum_program ();
+  evm::optimize_program (prog, table);
+  // nothing in the sum loop is hot in this profile.
+  EXPECT_EQ (prog.code.size (), 15);
+}
@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 
 #include <cmath>
+#include <evm/columns.h>
+#include <evm/cursor.h>
 #include <evm/primitive.h>
+#include <evm/tagged.h>
 
 TEST (primitive_tests, get_set_test)
 {
@@ -78,3 +81,120 @@ TEST (primitive_tests, fat_load_save_test)
       EXPECT_EQ (primitive, expected);
     }
 }
+
+TEST (primitive_tests, slot_round_trip_test)
+{
+  evm::primitive_value vals[] = {
+    evm::make_primitive<evm::I8_TYPE> (-128),
+    evm::make_primitive<evm::I64_TYPE> (INT64_MIN),
+    evm::make_primitive<evm::U32_TYPE> (UINT32_MAX),
+    evm::make_primitive<evm::U64_TYPE> (UINT64_MAX),
+    evm::make_primitive<evm::F32_TYPE> (-0.0f),
+    evm::make_primitive<evm::F64_TYPE> (NAN),
+  };
+
+  for (const auto &val : vals)
+    {
+      auto type = evm::primitive_get_type (val);
+      auto back = evm::from_slot (evm::to_slot (val), type);
+
+      // compare the bits, so that NaN compares equal.
+      EXPECT_EQ (evm::to_slot (back), evm::to_slot (val));
+      EXPECT_EQ (evm::primitive_get_type (back), type);
+    }
+
+  EXPECT_EQ (evm::to_slot<evm::I16_TYPE> (-1), UINT64_MAX);
+  EXPECT_EQ (evm::from_slot<evm::I16_TYPE> (UINT64_MAX), -1);
+}
+
+TEST (primitive_tests, type_checks_test)
+{
+  EXPECT_TRUE (evm::is_integer_type (evm::U8_TYPE));
+  EXPECT_FALSE (evm::is_integer_type (evm::F32_TYPE));
+  EXPECT_TRUE (evm::is_signed_type (evm::I32_TYPE));
+  EXPECT_FALSE (evm::is_signed_type (evm::U32_TYPE));
+  EXPECT_TRUE (evm::is_float_type (evm::F64_TYPE));
+  EXPECT_FALSE (evm::is_float_type (evm::I64_TYPE));
+}
+
+TEST (primitive_tests, tagged_stack_test)
+{
+  evm::tagged_stack stack;
+
+  stack.push (evm::make_primitive<evm::F64_TYPE> (2.5));
+  stack.push (evm::to_slot<evm::I32_TYPE> (-3), evm::I32_TYPE);
+
+  EXPECT_EQ (stack.size (), 2);
+  EXPECT_EQ (stack.type (1), evm::I32_TYPE);
+  EXPECT_EQ (stack.get (0), evm::make_primitive<evm::F64_TYPE> (2.5));
+  EXPECT_EQ (stack.get (1), evm::make_primitive<evm::I32_TYPE> (-3));
+
+  stack.pop ();
+  EXPECT_EQ (stack.size (), 1);
+}
+
+TEST (primitive_tests, cursor_test)
+{
+  evm::primitive_value vals[] = { evm::make_primitive<evm::F64_TYPE> (10.0),
+                                  evm::make_primitive<evm::I8_TYPE> (54),
+                                  evm::make_primitive<evm::U16_TYPE> (45000) };
+
+  // a tiny batch, so that the writer has to grow.
+  evm::byte_writer writer (2);
+  for (const auto &val : vals)
+    writer.write_primitive (val, true);
+  writer.write<std::string_view> ("end");
+
+  EXPECT_EQ (writer.size (), 9 + 2 + 3 + 8 + 3);
+
+  auto bytes = writer.take ();
+  evm::byte_reader reader (bytes);
+
+  for (const auto &val : vals)
+    EXPECT_EQ (reader.read_primitive (), val);
+
+  EXPECT_EQ (reader.read<std::string_view> (), "end");
+  EXPECT_TRUE (reader.at_end ());
+  EXPECT_THROW (reader.read<uint8_t> (), std::out_of_range);
+
+  evm::byte_reader truncated (std::span<const uint8_t> (bytes).first (5));
+  EXPECT_THROW (truncated.read_primitive (), std::out_of_range);
+
+  // a length that wraps around when its own size is added.
+  evm::byte_writer huge;
+  huge.write<uint64_t> (UINT64_MAX - 3);
+  huge.write<uint64_t> (0);
+  auto huge_bytes = huge.take ();
+  evm::byte_reader wrapping (huge_bytes);
+  EXPECT_THROW (wrapping.read<std::string_view> (), std::out_of_range);
+  EXPECT_THROW (wrapping.read<std::string> (), std::out_of_range);
+}
+
+TEST (primitive_tests, columns_test)
+{
+  std::vector<evm::primitive_value> vals;
+  for (int i = 0; i < 100; i++)
+    vals.push_back (evm::make_primitive<evm::I32_TYPE> (i * 3));
+  vals.push_back (evm::make_primitive<evm::F64_TYPE> (0.5));
+  vals.push_back (evm::make_primitive<evm::I32_TYPE> (-1));
+  vals.push_back (evm::make_primitive<evm::U8_TYPE> (200));
+
+  evm::byte_writer writer;
+  for (const auto &val : vals)
+    writer.write_primitive (val, true);
+
+  auto columns = evm::decode_columns (writer.bytes ());
+
+  ASSERT_EQ (columns.size (), vals.size ());
+  EXPECT_EQ (columns.column<evm::I32_TYPE> ().size (), 101);
+  EXPECT_EQ (columns.column<evm::I32_TYPE> ()[100], -1);
+  EXPECT_EQ (columns.column<evm::F64_TYPE> ().size (), 1);
+  EXPECT_TRUE (columns.column<evm::I64_TYPE> ().empty ());
+
+  for (uint64_t i = 0; i < vals.size (); i++)
+    EXPECT_EQ (columns.get (i), vals[i]);
+
+  auto bytes = writer.take ();
+  bytes.pop_back ();
+  EXPECT_THROW (evm::decode_columns (bytes), std::runtime_error);
+}
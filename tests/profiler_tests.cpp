@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/interpreter.h>
+#include <evm/profiler.h>
+#include <stdexcept>
+
+using evm::opcode;
+
+static void
+run_steps (evm::profiler &prof, const std::vector<opcode> &ops,
+           std::vector<uint32_t> stack = { 0 })
+{
+  for (auto op : ops)
+    prof.step (op, [&] (std::vector<uint32_t> &out) {
+      out.insert (out.end (), stack.begin (), stack.end ());
+    });
+}
+
+static uint64_t
+samples (const evm::profiler &prof, opcode op)
+{
+  return prof.opcodes ()[static_cast<uint8_t> (op)].samples;
+}
+
+TEST (profiler_tests, step_test)
+{
+  evm::profiler prof;
+  prof.enter (1);
+  run_steps (prof, { opcode::load_const, opcode::add, opcode::load_const,
+                     opcode::add, opcode::ret },
+             { 0, 1 });
+  prof.flush ();
+
+  EXPECT_EQ (samples (prof, opcode::load_const), 2);
+  EXPECT_EQ (samples (prof, opcode::add), 2);
+  EXPECT_EQ (samples (prof, opcode::ret), 1);
+  EXPECT_EQ (samples (prof, opcode::sub), 0);
+
+  EXPECT_EQ (prof.pairs () (opcode::load_const, opcode::add), 2);
+  EXPECT_EQ (prof.pairs () (opcode::add, opcode::load_const), 1);
+  EXPECT_EQ (prof.pairs () (opcode::add, opcode::ret), 1);
+  EXPECT_EQ (prof.pairs ().total (), 4);
+
+  ASSERT_EQ (prof.functions ().size (), 2);
+  EXPECT_EQ (prof.functions ()[0].samples, 0);
+  EXPECT_EQ (prof.functions ()[1].samples, 5);
+  EXPECT_EQ (prof.functions ()[1].calls, 1);
+
+  EXPECT_TRUE (prof.fusion_candidates ().uses (opcode::add_const));
+  EXPECT_FALSE (prof.fusion_candidates ().uses (opcode::sub_const));
+
+  prof.reset ();
+  EXPECT_EQ (prof.pairs ().total (), 0);
+  EXPECT_TRUE (prof.functions ().empty ());
+}
+
+TEST (profiler_tests, sampling_test)
+{
+  evm::profiler prof (100);
+  EXPECT_EQ (prof.sample_period (), 100);
+
+  // a loop as long as the period is still sampled throughout.
+  std::vector<opcode> loop (100, opcode::nop);
+  loop[0] = opcode::load_local;
+  std::vector<opcode> ops;
+  for (int i = 0; i < 1000; i++)
+    ops.insert (ops.end (), loop.begin (), loop.end ());
+
+  run_steps (prof, ops);
+  prof.flush ();
+
+  auto total = prof.functions ()[0].samples;
+  EXPECT_GT (total, 500);
+  EXPECT_LT (total, 2000);
+  EXPECT_GT (samples (prof, opcode::nop), 0);
+  EXPECT_LT (samples (prof, opcode::load_local), total / 10);
+}
+
+TEST (profiler_tests, export_test)
+{
+  evm::profiler prof;
+  run_steps (prof, { opcode::load_local, opcode::ret }, { 0, 2 });
+  prof.flush ();
+
+  auto json = prof.to_json ();
+  EXPECT_EQ (json.front (), '{');
+  EXPECT_EQ (json.back (), '}');
+  EXPECT_NE (json.find ("\"sample_period\":1"), std::string::npos);
+  EXPECT_NE (json.find ("{\"opcode\":\"load_local\",\"samples\":1,"),
+             std::string::npos);
+  EXPECT_NE (json.find ("{\"function\":2,\"calls\":0,\"samples\":2,"),
+             std::string::npos);
+  EXPECT_NE (
+      json.find (
+          "{\"first\":\"load_local\",\"second\":\"ret\",\"count\":1}"),
+      std::string::npos);
+  EXPECT_EQ (json.find ("\"opcode\":\"add\""), std::string::npos);
+
+  auto folded = prof.to_folded ();
+  EXPECT_EQ (folded.find ("fn0;fn2;load_local "), 0);
+  EXPECT_NE (folded.find ("\nfn0;fn2;ret "), std::string::npos);
+  EXPECT_EQ (folded.back (), '\n');
+}
+
+TEST (profiler_tests, interpreter_test)
+{
+  auto prog = sum_program ();
+  evm::interpreter interp (prog);
+  evm::profiler prof;
+
+  if (!evm::interpreter::profiling_enabled ())
+    {
+      EXPECT_THROW (interp.set_profiler (&prof), std::runtime_error);
+      GTEST_SKIP () << "Built without EVM_PROFILE.";
+    }
+
+  interp.set_profiler (&prof);
+  std::vector<evm::primitive_value> args{ i64 (10) };
+  EXPECT_EQ (interp.run (0, args), i64 (55));
+
+  // ten times round the loop, then out of it.
+  EXPECT_EQ (samples (prof, opcode::load_local), 42);
+  EXPECT_EQ (samples (prof, opcode::load_const), 21);
+  EXPECT_EQ (samples (prof, opcode::add), 10);
+  EXPECT_EQ (samples (prof, opcode::ret), 1);
+  EXPECT_EQ (prof.pairs () (opcode::load_const, opcode::sub), 10);
+  EXPECT_EQ (prof.pairs () (opcode::gt, opcode::jump_unless), 11);
+  EXPECT_EQ (prof.pairs ().total (), 135);
+  EXPECT_EQ (prof.functions ()[0].calls, 1);
+  EXPECT_EQ (prof.functions ()[0].samples, 136);
+
+  auto table = prof.fusion_candidates ();
+  EXPECT_TRUE (table.uses (opcode::sub_const));
+  EXPECT_TRUE (table.uses (opcode::branch_const));
+  EXPECT_FALSE (table.uses (opcode::add_const));
+}
+
+TEST (profiler_tests, call_stack_test)
+{
+  auto prog = fib_program ();
+  auto verified = evm::verify_program (prog);
+  evm::interpreter interp (prog, verified);
+  evm::profiler prof;
+
+  if (!evm::interpreter::profiling_enabled ())
+    GTEST_SKIP () << "Built without EVM_PROFILE.";
+
+  interp.set_profiler (&prof);
+  std::vector<evm::primitive_value> args{ i64 (5) };
+  EXPECT_EQ (interp.run (0, args), i64 (5));
+
+  // fib (5) makes 15 calls, the deepest 4 levels down.
+  EXPECT_EQ (prof.functions ()[0].calls, 15);
+  EXPECT_NE (prof.to_folded ().find ("fn0;fn0;fn0;fn0;fn0;ret "),
+             std::string::npos);
+  EXPECT_EQ (prof.to_folded ().find ("fn0;fn0;fn0;fn0;fn0;fn0;"),
+             std::string::npos);
+
+  // stopping leaves the counts alone.
+  interp.set_profiler (nullptr);
+  interp.run (0, args);
+  EXPECT_EQ (prof.functions ()[0].calls, 15);
+}
@@ -0,0 +1,261 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/arith.h>
+#include <evm/interpreter.h>
+#include <evm/optimizer.h>
+#include <evm/reg_interpreter.h>
+#include <stdexcept>
+#include <string>
+
+using evm::opcode;
+
+/**
+ * A program with its verification and register code,
+ * which the interpreters refer to.
+ */
+struct lowered_program
+{
+  evm::program prog;
+  evm::verification verified;
+  evm::reg_program code;
+
+  explicit lowered_program (evm::program program,
+                            std::span<const evm::host_signature> hosts = {})
+      : prog (std::move (program)),
+        verified (evm::verify_program (prog, hosts)),
+        code (evm::lower_program (prog, verified))
+  {
+  }
+};
+
+/**
+ * Runs a function with both interpreters, which must agree.
+ */
+static std::optional<evm::primitive_value>
+run_both (const lowered_program &lowered, uint32_t function,
+          std::span<const evm::primitive_value> args)
+{
+  evm::interpreter stack (lowered.prog, lowered.verified);
+  evm::reg_interpreter registers (lowered.prog, lowered.verified,
+                                  lowered.code);
+
+  auto expected = stack.run (function, args);
+  auto result = registers.run (function, args);
+  EXPECT_EQ (result, expected);
+
+  return result;
+}
+
+TEST (reg_interpreter_tests, loop_test)
+{
+  lowered_program sum (sum_program ());
+  evm::reg_interpreter interp (sum.prog, sum.verified, sum.code);
+
+  evm::primitive_value args[] = { i64 (100) };
+  EXPECT_EQ (interp.run (0, args), i64 (5050));
+
+  // interpreters can be reused.
+  for (int64_t n : { 0, 1, 7, 1000 })
+    {
+      args[0] = i64 (n);
+      EXPECT_EQ (run_both (sum, 0, args), i64 (n * (n + 1) / 2));
+    }
+}
+
+TEST (reg_interpreter_tests, call_test)
+{
+  lowered_program fib (fib_program ());
+
+  evm::primitive_value args[] = { i64 (20) };
+  EXPECT_EQ (run_both (fib, 0, args), i64 (6765));
+}
+
+TEST (reg_interpreter_tests, optimized_test)
+{
+  auto sum_prog = sum_program ();
+  evm::optimize_program (sum_prog);
+  lowered_program sum (std::move (sum_prog));
+
+  evm::primitive_value args[] = { i64 (100) };
+  EXPECT_EQ (run_both (sum, 0, args), i64 (5050));
+
+  auto fib_prog = fib_program ();
+  evm::optimize_program (fib_prog);
+  lowered_program fib (std::move (fib_prog));
+
+  args[0] = i64 (20);
+  EXPECT_EQ (run_both (fib, 0, args), i64 (6765));
+}
+
+TEST (reg_interpreter_tests, stack_test)
+{
+  // returns (b - a) * a + 10 after setting a to b,
+  // moving values around the stack while their locals change.
+  lowered_program prog (make_program (
+      {
+          { opcode::load_local, 0 },  { opcode::load_local, 1 },
+          { opcode::store_local, 0 }, { opcode::dup },
+          { opcode::load_local, 0 },  { opcode::swap },
+          { opcode::sub },            { opcode::mul },
+          { opcode::load_const, 0 },  { opcode::add },
+          { opcode::store_local, 1 }, { opcode::load_local, 1 },
+          { opcode::neg },            { opcode::conv, evm::F64_TYPE },
+          { opcode::ret },
+      },
+      { i64 (10) },
+      { { .entry = 0,
+          .arg_count = 2,
+          .locals = { evm::I64_TYPE, evm::I64_TYPE },
+          .result = evm::F64_TYPE } }));
+
+  evm::primitive_value args[] = { i64 (3), i64 (5) };
+  EXPECT_EQ (run_both (prog, 0, args),
+             evm::make_primitive<evm::F64_TYPE> (-16.0));
+
+  args[0] = i64 (-4);
+  args[1] = i64 (9);
+  EXPECT_EQ (run_both (prog, 0, args),
+             evm::make_primitive<evm::F64_TYPE> (42.0));
+}
+
+TEST (reg_interpreter_tests, host_call_test)
+{
+  evm::host_signature hosts[]
+      = { { .args = { evm::I64_TYPE, evm::I64_TYPE },
+            .result = evm::I64_TYPE } };
+  lowered_program prog (
+      make_program ({ { opcode::load_local, 0 },
+                      { opcode::load_const, 0 },
+                      { opcode::host_call, 0 },
+                      { opcode::ret } },
+                    { i64 (5) },
+                    { { .entry = 0,
+                        .arg_count = 1,
+                        .locals = { evm::I64_TYPE },
+                        .result = evm::I64_TYPE } }),
+      hosts);
+
+  evm::reg_interpreter interp (prog.prog, prog.verified, prog.code);
+  EXPECT_THROW (interp.bind_host (0, { .arg_count = 1, .call = {} }),
+                std::runtime_error);
+
+  evm::primitive_value args[] = { i64 (3) };
+  EXPECT_THROW (interp.run (0, args), std::runtime_error);
+
+  bool wrong = false;
+  interp.bind_host (0, { .arg_count = 2, .call = [&] (auto args) {
+                          if (wrong)
+                            return evm::primitive_value (1.0);
+                          return evm::primitive_value (
+                              *evm::get_primitive<evm::I64_TYPE> (args[0])
+                              - *evm::get_primitive<evm::I64_TYPE> (args[1]));
+                        } });
+  EXPECT_EQ (interp.run (0, args), i64 (-2));
+
+  // the host is held to its signature.
+  wrong = true;
+  EXPECT_THROW (interp.run (0, args), std::runtime_error);
+
+  // a task is run until it finishes, and held to the signature too.
+  interp.bind_host (0, { .arg_count = 2,
+                         .call = {},
+                         .task = [&] (auto args) -> evm::host_task {
+                           auto lhs = args[0];
+                           auto rhs = args[1];
+                           co_await std::suspend_always{};
+                           co_await std::suspend_always{};
+
+                           if (wrong)
+                             co_return evm::primitive_value (1.0);
+                           co_return evm::arith (evm::arith_op::mul, lhs,
+                                                 rhs);
+                         } });
+  EXPECT_THROW (interp.run (0, args), std::runtime_error);
+  wrong = false;
+  EXPECT_EQ (interp.run (0, args), i64 (15));
+}
+
+TEST (reg_interpreter_tests, string_test)
+{
+  // joins "ab" to a string as many times as its i64 argument,
+  // then passes it through a host function.
+  lowered_program prog (
+      make_program (
+          {
+              { opcode::load_string, 0 }, { opcode::store_local, 1 },
+              { opcode::load_local, 0 },  { opcode::load_const, 0 },
+              { opcode::gt },             { opcode::jump_unless, 15 },
+              { opcode::load_local, 1 },  { opcode::load_string, 1 },
+              { opcode::concat },         { opcode::store_local, 1 },
+              { opcode::load_local, 0 },  { opcode::load_const, 1 },
+              { opcode::sub },            { opcode::store_local, 0 },
+              { opcode::jump, 2 },        { opcode::load_local, 1 },
+              { opcode::host_call, 0 },   { opcode::ret },
+          },
+          { i64 (0), i64 (1) },
+          { { .entry = 0,
+              .arg_count = 1,
+              .locals = { evm::I64_TYPE, evm::REF_TYPE },
+              .result = evm::REF_TYPE } },
+          { "", "ab" }),
+      std::vector<evm::host_signature>{
+          { .args = { evm::REF_TYPE }, .result = evm::REF_TYPE } });
+
+  std::string expected;
+  for (int i = 0; i < 500; i++)
+    expected += "ab";
+
+  evm::reg_interpreter interp (prog.prog, prog.verified, prog.code,
+                               { .nursery_size = 16 * 1024 });
+
+  // the host sees the string, and makes another on the heap.
+  interp.bind_host (0, { .arg_count = 1, .call = [&] (auto args) {
+                          auto ref = std::get<evm::heap_ref> (args[0]);
+                          EXPECT_EQ (interp.heap ().string (ref.address),
+                                     expected);
+                          auto copy = interp.heap ().make_string ("copy");
+                          return evm::primitive_value (evm::heap_ref{ copy });
+                        } });
+
+  evm::primitive_value args[] = { i64 (500) };
+  auto result = interp.run (0, args);
+  ASSERT_TRUE (result.has_value ());
+  EXPECT_EQ (interp.heap ().string (to_slot (*result)), "copy");
+
+  // the strings did not fit in the nursery at once.
+  EXPECT_GT (interp.heap ().stats ().minor_collections, 0);
+}
+
+TEST (reg_interpreter_tests, error_test)
+{
+  lowered_program prog (make_program (
+      { { opcode::load_local, 0 },
+        { opcode::load_const, 0 },
+        { opcode::div },
+        { opcode::ret } },
+      { i64 (0) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } }));
+
+  evm::reg_interpreter interp (prog.prog, prog.verified, prog.code);
+
+  evm::primitive_value args[] = { i64 (1) };
+  EXPECT_THROW (interp.run (0, args), std::runtime_error);
+
+  // arguments are checked.
+  evm::primitive_value bad[] = { evm::make_primitive<evm::I8_TYPE> (1) };
+  EXPECT_THROW (interp.run (0, bad), std::runtime_error);
+  EXPECT_THROW (interp.run (0, {}), std::runtime_error);
+  EXPECT_THROW (interp.run (1, {}), std::runtime_error);
+
+  // as are the verification and register code.
+  lowered_program fib (fib_program ());
+  EXPECT_THROW (evm::reg_interpreter (prog.prog, fib.verified, prog.code),
+                std::runtime_error);
+  EXPECT_THROW (evm::reg_interpreter (prog.prog, prog.verified,
+                                      evm::reg_program ()),
+                std::runtime_error);
+}
@@ -0,0 +1,304 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/stream.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+using evm::opcode;
+
+/**
+ * A module with every kind of section, with the strings before the
+ * constants.
+ */
+static std::vector<uint8_t>
+sample_module ()
+{
+  auto code = assemble ({
+      { opcode::load_local, 0 },
+      { opcode::load_const, 0 },
+      { opcode::add },
+      { opcode::jump, 4 },
+      { opcode::ret },
+  });
+
+  evm::byte_writer constants;
+  constants.write_primitive (evm::make_primitive<evm::I64_TYPE> (40), true);
+  constants.write_primitive (evm::make_primitive<evm::F64_TYPE> (0.5), true);
+
+  evm::byte_writer strings;
+  strings.write (std::string ("hello"));
+  strings.write (std::string ());
+
+  auto info = evm::function_info::get_ls_info ();
+  evm::function_info function{ .entry = 0,
+                               .arg_count = 1,
+                               .locals = { evm::I64_TYPE },
+                               .result = evm::I64_TYPE };
+  evm::byte_writer functions;
+  info.save (function, functions.reserve (info.save_size (function)));
+
+  evm::module_writer writer;
+  writer.add_section (evm::section_kind::code, code);
+  writer.add_section (evm::section_kind::strings, strings.bytes ());
+  writer.add_section (evm::section_kind::constants, constants.bytes ());
+  writer.add_section (evm::section_kind::functions, functions.bytes ());
+
+  return writer.write ();
+}
+
+static void
+expect_same (const evm::program &a, const evm::program &b)
+{
+  EXPECT_EQ (a.code.opcodes, b.code.opcodes);
+  EXPECT_EQ (a.code.operands, b.code.operands);
+  EXPECT_EQ (a.code.offsets, b.code.offsets);
+  EXPECT_EQ (a.constants, b.constants);
+  EXPECT_EQ (a.strings, b.strings);
+
+  ASSERT_EQ (a.functions.size (), b.functions.size ());
+  for (uint64_t i = 0; i < a.functions.size (); i++)
+    {
+      EXPECT_EQ (a.functions[i].entry, b.functions[i].entry);
+      EXPECT_EQ (a.functions[i].locals, b.functions[i].locals);
+      EXPECT_EQ (a.functions[i].result, b.functions[i].result);
+    }
+}
+
+/**
+ * Records what is decoded, in order.
+ */
+struct recording_sink : evm::stream_sink
+{
+  std::vector<std::string> events;
+
+  void
+  on_header (const evm::module_header &header,
+             std::span<const evm::section_entry>) override
+  {
+    events.push_back ("header " + std::to_string (header.section_count));
+  }
+  bool
+  on_section (const evm::section_entry &entry) override
+  {
+    events.push_back ("section " + std::to_string (uint32_t (entry.kind)));
+    return true;
+  }
+  void
+  on_instruction (uint32_t offset, const evm::instruction &) override
+  {
+    events.push_back ("instruction " + std::to_string (offset));
+  }
+  void
+  on_constant (const evm::primitive_value &) override
+  {
+    events.push_back ("constant");
+  }
+  void
+  on_string (std::string_view value) override
+  {
+    events.push_back ("string " + std::string (value));
+  }
+  void
+  on_function (const evm::function_info &) override
+  {
+    events.push_back ("function");
+  }
+  void
+  on_section_end (const evm::section_entry &) override
+  {
+    events.push_back ("end");
+  }
+};
+
+TEST (stream_tests, events_test)
+{
+  auto module = sample_module ();
+  recording_sink sink;
+  evm::module_stream stream (sink);
+
+  stream.feed (module);
+  EXPECT_TRUE (stream.done ());
+  EXPECT_EQ (stream.offset (), module.size ());
+  stream.finish ();
+
+  std::vector<std::string> expected = {
+    "header 4",      "section 0",   "instruction 0", "instruction 3",
+    "instruction 8", "instruction 9", "instruction 14", "end",
+    "section 2",     "string hello", "string ",      "end",
+    "section 1",     "constant",    "constant",      "end",
+    "section 3",     "function",    "end",
+  };
+  EXPECT_EQ (sink.events, expected);
+}
+
+TEST (stream_tests, chunk_test)
+{
+  auto module = sample_module ();
+  auto loaded = evm::load_program (evm::module_view (module));
+
+  // every split of the module decodes the same.
+  for (uint64_t chunk = 1; chunk <= module.size (); chunk++)
+    {
+      evm::program_builder builder;
+      evm::module_stream stream (builder);
+
+      for (uint64_t offset = 0; offset < module.size (); offset += chunk)
+        {
+          EXPECT_FALSE (stream.done ());
+          stream.feed (std::span (module).subspan (
+              offset, std::min (chunk, module.size () - offset)));
+        }
+
+      stream.finish ();
+      expect_same (builder.take (), loaded);
+    }
+}
+
+TEST (stream_tests, istream_test)
+{
+  auto module = make_module (
+      {
+          { opcode::load_local, 0 },  { opcode::load_const, 0 },
+          { opcode::gt },             { opcode::jump_unless, 5 },
+          { opcode::load_const, 1 },  { opcode::ret },
+      },
+      { evm::make_primitive<evm::I64_TYPE> (0),
+        evm::make_primitive<evm::I64_TYPE> (1) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+
+  std::istringstream in (std::string (module.begin (), module.end ()));
+  expect_same (evm::stream_program (in),
+               evm::load_program (evm::module_view (module)));
+}
+
+TEST (stream_tests, fd_test)
+{
+  auto module = sample_module ();
+  int fds[2];
+  ASSERT_EQ (pipe (fds), 0);
+
+  // a byte at a time, as if from a slow socket.
+  std::thread writer ([&] {
+    for (auto byte : module)
+      EXPECT_EQ (write (fds[1], &byte, 1), 1);
+    close (fds[1]);
+  });
+
+  auto prog = evm::stream_program (fds[0]);
+  writer.join ();
+  close (fds[0]);
+
+  expect_same (prog, evm::load_program (evm::module_view (module)));
+}
+
+TEST (stream_tests, compressed_test)
+{
+  // the sections of the sample module, compressed where that helps.
+  auto plain = sample_module ();
+  evm::module_view view (plain);
+  evm::module_writer writer;
+  for (uint64_t i = 0; i < view.sections ().size (); i++)
+    writer.add_section (view.sections ()[i].kind, view.section_data (i),
+                        true);
+
+  // and one that is sure to be compressed.
+  evm::byte_writer strings;
+  strings.write (std::string (256, 'a'));
+  writer.add_section (evm::section_kind::strings, strings.bytes (), true);
+  auto module = writer.write ();
+
+  recording_sink expected;
+  evm::module_stream plain_stream (expected);
+  plain_stream.feed (plain);
+
+  for (uint64_t chunk : { 1, 5, 64 })
+    {
+      recording_sink sink;
+      evm::module_stream stream (sink);
+
+      for (uint64_t offset = 0; offset < module.size (); offset += chunk)
+        stream.feed (std::span (module).subspan (
+            offset, std::min (chunk, module.size () - offset)));
+      stream.finish ();
+
+      // the same, except for the strings section added at the end.
+      ASSERT_EQ (sink.events.size (), expected.events.size () + 3);
+      EXPECT_EQ (sink.events[sink.events.size () - 2],
+                 "string " + std::string (256, 'a'));
+      EXPECT_TRUE (std::equal (expected.events.begin () + 1,
+                               expected.events.end (),
+                               sink.events.begin () + 1));
+    }
+}
+
+TEST (stream_tests, skip_test)
+{
+  struct code_only : recording_sink
+  {
+    bool
+    on_section (const evm::section_entry &entry) override
+    {
+      return entry.kind == evm::section_kind::code;
+    }
+  } sink;
+
+  auto module = sample_module ();
+  evm::module_stream stream (sink);
+  stream.feed (module);
+  stream.finish ();
+
+  EXPECT_EQ (sink.events.size (), 7);
+  EXPECT_EQ (sink.events.back (), "end");
+}
+
+TEST (stream_tests, malformed_test)
+{
+  auto module = sample_module ();
+
+  auto stream_bytes = [] (std::span<const uint8_t> bytes) {
+    evm::program_builder builder;
+    evm::module_stream stream (builder);
+    stream.feed (bytes);
+    stream.finish ();
+    return builder.take ();
+  };
+
+  // any truncation is caught, once the stream is finished.
+  for (uint64_t size = 0; size < module.size (); size++)
+    EXPECT_THROW (stream_bytes (std::span (module).first (size)),
+                  std::runtime_error);
+
+  auto bad_magic = module;
+  bad_magic[0] ^= 1;
+  EXPECT_THROW (stream_bytes (bad_magic), std::runtime_error);
+
+  // an invalid opcode, in the first instruction.
+  auto bad_code = module;
+  auto code = evm::module_view (bad_code).sections ()[0];
+  bad_code[code.offset] = 0xff;
+  EXPECT_THROW (stream_bytes (bad_code), std::runtime_error);
+
+  // the jump now lands inside an instruction.
+  auto bad_jump = module;
+  bad_jump[code.offset + 10] = 13;
+  EXPECT_THROW (stream_bytes (bad_jump), std::runtime_error);
+
+  // a string longer than its section.
+  auto bad_string = module;
+  auto strings = evm::module_view (bad_string).sections ()[1];
+  bad_string[strings.offset] = 0xff;
+  EXPECT_THROW (stream_bytes (bad_string), std::runtime_error);
+
+  recording_sink sink;
+  evm::module_stream stream (sink);
+  EXPECT_THROW (stream.feed (bad_string), std::runtime_error);
+}
@@ -0,0 +1,206 @@
+/** @file
+ *
+ * @brief Helpers for writing programs in tests.
+ */
+
+#ifndef EVM_TESTS_TEST_PROGRAM_H_
+#define EVM_TESTS_TEST_PROGRAM_H_
+
+#include <evm/cursor.h>
+#include <evm/decode.h>
+#include <evm/instruction.h>
+#include <evm/module.h>
+#include <evm/program.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * An @c I64_TYPE value.
+ */
+inline evm::primitive_value
+i64 (int64_t value)
+{
+  return evm::make_primitive<evm::I64_TYPE> (value);
+}
+
+/**
+ * An instruction, where the operand of jumps is an instruction index,
+ * and the operand of fused branches is a packed @c evm::branch_operand.
+ */
+struct test_instr
+{
+  evm::opcode code;
+  uint64_t operand = 0;
+};
+
+/**
+ * Encodes the instructions, turning jump targets into offsets.
+ */
+inline std::vector<uint8_t>
+assemble (const std::vector<test_instr> &instrs,
+          std::vector<uint32_t> *offsets_out = nullptr)
+{
+  std::vector<uint32_t> offsets;
+  uint32_t offset = 0;
+
+  for (const auto &instr : instrs)
+    {
+      offsets.push_back (offset);
+      offset += 1 + evm::instruction_args::size (evm::opcode_kind (instr.code));
+    }
+
+  std::vector<uint8_t> code (offset);
+
+  for (uint64_t i = 0; i < instrs.size (); i++)
+    {
+      auto kind = evm::opcode_kind (instrs[i].code);
+      auto operand = instrs[i].operand;
+      evm::instruction_args args;
+
+      switch (kind)
+        {
+        case evm::instruction_kind::lonely:
+          args.lonely = {};
+          break;
+        case evm::instruction_kind::index:
+          args.index.value = static_cast<uint32_t> (operand);
+          break;
+        case evm::instruction_kind::local:
+          args.local.value = static_cast<uint16_t> (operand);
+          break;
+        case evm::instruction_kind::jump:
+          args.jump.target = offsets[operand];
+          break;
+        case evm::instruction_kind::type:
+          args.type.value = static_cast<evm::primitive_type> (operand);
+          break;
+        case evm::instruction_kind::branch:
+          {
+            auto branch = evm::branch_operand::unpack (operand);
+            args.branch.value = branch.value;
+            args.branch.compare = branch.compare;
+            args.branch.jump = branch.jump;
+            args.branch.target = offsets[branch.target];
+            break;
+          }
+        }
+
+      evm::instruction::save ({ .code = instrs[i].code, .args = args },
+                              code.data () + offsets[i]);
+    }
+
+  if (offsets_out)
+    *offsets_out = offsets;
+
+  return code;
+}
+
+/**
+ * Makes a module, where function entries are instruction indices.
+ */
+inline std::vector<uint8_t>
+make_module (const std::vector<test_instr> &instrs,
+             const std::vector<evm::primitive_value> &constants,
+             std::vector<evm::function_info> functions,
+             const std::vector<std::string> &strings = {})
+{
+  std::vector<uint32_t> offsets;
+  auto code = assemble (instrs, &offsets);
+
+  evm::byte_writer constant_data;
+  for (const auto &constant : constants)
+    constant_data.write_primitive (constant, true);
+
+  auto info = evm::function_info::get_ls_info ();
+  evm::byte_writer function_data;
+  for (auto &function : functions)
+    {
+      function.entry = offsets[function.entry];
+      info.save (function, function_data.reserve (info.save_size (function)));
+    }
+
+  evm::module_writer writer;
+  writer.add_section (evm::section_kind::code, code);
+  writer.add_section (evm::section_kind::constants, constant_data.bytes ());
+  writer.add_section (evm::section_kind::functions, function_data.bytes ());
+
+  if (!strings.empty ())
+    {
+      evm::byte_writer string_data;
+      for (const auto &string : strings)
+        string_data.write (string);
+      writer.add_section (evm::section_kind::strings, string_data.bytes ());
+    }
+
+  return writer.write ();
+}
+
+/**
+ * Makes a program, where function entries are instruction indices.
+ */
+inline evm::program
+make_program (const std::vector<test_instr> &instrs,
+              const std::vector<evm::primitive_value> &constants,
+              const std::vector<evm::function_info> &functions,
+              const std::vector<std::string> &strings = {})
+{
+  auto module = make_module (instrs, constants, functions, strings);
+  return evm::load_program (evm::module_view (module));
+}
+
+/**
+ * Sums the integers from 1 to its i64 argument with a loop.
+ */
+inline evm::program
+sum_program ()
+{
+  using evm::opcode;
+
+  return make_program (
+      {
+          { opcode::load_local, 0 },  { opcode::load_const, 0 },
+          { opcode::gt },             { opcode::jump_unless, 13 },
+          { opcode::load_local, 1 },  { opcode::load_local, 0 },
+          { opcode::add },            { opcode::store_local, 1 },
+          { opcode::load_local, 0 },  { opcode::load_const, 1 },
+          { opcode::sub },            { opcode::store_local, 0 },
+          { opcode::jump, 0 },        { opcode::load_local, 1 },
+          { opcode::ret },
+      },
+      { evm::make_primitive<evm::I64_TYPE> (0),
+        evm::make_primitive<evm::I64_TYPE> (1) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE, evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+}
+
+/**
+ * Computes the fibonacci number of its i64 argument recursively.
+ */
+inline evm::program
+fib_program ()
+{
+  using evm::opcode;
+
+  return make_program (
+      {
+          { opcode::load_local, 0 }, { opcode::load_const, 1 },
+          { opcode::lt },            { opcode::jump_unless, 6 },
+          { opcode::load_local, 0 }, { opcode::ret },
+          { opcode::load_local, 0 }, { opcode::load_const, 0 },
+          { opcode::sub },           { opcode::call, 0 },
+          { opcode::load_local, 0 }, { opcode::load_const, 1 },
+          { opcode::sub },           { opcode::call, 0 },
+          { opcode::add },           { opcode::ret },
+      },
+      { evm::make_primitive<evm::I64_TYPE> (1),
+        evm::make_primitive<evm::I64_TYPE> (2) },
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::I64_TYPE },
+          .result = evm::I64_TYPE } });
+}
+
+#endif // EVM_TESTS_TEST_PROGRAM_H_
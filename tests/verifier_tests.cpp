@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include "test_program.h"
+#include <evm/verifier.h>
+#include <stdexcept>
+
+using evm::opcode;
+
+TEST (verifier_tests, depth_test)
+{
+  auto prog = sum_program ();
+  auto verified = evm::verify_program (prog);
+
+  ASSERT_EQ (verified.max_depths.size (), 1);
+  EXPECT_EQ (verified.max_depths[0], 2);
+  // two locals, plus the deepest stack.
+  EXPECT_EQ (verified.frame_sizes[0], 4);
+
+  EXPECT_EQ (verified.depths[0], 0);
+  EXPECT_EQ (verified.depths[2], 2);
+  EXPECT_EQ (verified.depths[3], 1);
+  EXPECT_EQ (verified.depths[14], 1);
+
+  // the comparison leaves a u8 behind.
+  auto types = verified.stack_types (3);
+  ASSERT_EQ (types.size (), 1);
+  EXPECT_EQ (types[0], evm::U8_TYPE);
+
+  types = verified.stack_types (6);
+  ASSERT_EQ (types.size (), 2);
+  EXPECT_EQ (types[0], evm::I64_TYPE);
+  EXPECT_EQ (types[1], evm::I64_TYPE);
+}
+
+TEST (verifier_tests, call_test)
+{
+  auto prog = fib_program ();
+  auto verified = evm::verify_program (prog);
+
+  // the result of the first call is under the operands of the second sub.
+  EXPECT_EQ (verified.max_depths[0], 3);
+  EXPECT_EQ (verified.depths[13], 2);
+
+  for (uint64_t ip = 0; ip < prog.code.size (); ip++)
+    EXPECT_EQ (verified.owners[ip], 0);
+}
+
+TEST (verifier_tests, unreachable_test)
+{
+  auto prog = make_program (
+      { { opcode::ret }, { opcode::pop }, { opcode::ret } }, {},
+      { { .entry = 0, .arg_count = 0, .locals = {}, .result = {} } });
+
+  auto verified = evm::verify_program (prog);
+
+  EXPECT_TRUE (verified.reachable (0));
+  // the pop would underflow, but it can never run.
+  EXPECT_FALSE (verified.reachable (1));
+  EXPECT_TRUE (verified.stack_types (1).empty ());
+  EXPECT_EQ (verified.owners[2], evm::verification::unreachable);
+}
+
+TEST (verifier_tests, host_test)
+{
+  auto prog = make_program (
+      { { opcode::load_local, 0 }, { opcode::host_call, 0 }, { opcode::ret } },
+      {},
+      { { .entry = 0,
+          .arg_count = 1,
+          .locals = { evm::F64_TYPE },
+          .result = evm::I32_TYPE } });
+
+  evm::host_signature good[] = { { .args = { evm::F64_TYPE },
+                                   .result = evm::I32_TYPE } };
+  auto verified = evm::verify_program (prog, good);
+  EXPECT_EQ (verified.hosts.size (), 1);
+
+  evm::host_signature bad[] = { { .args = { evm::I32_TYPE },
+                                  .result = evm::I32_TYPE } };
+  EXPECT_THROW (evm::verify_program (prog, bad), std::runtime_error);
+  // the host function is missing.
+  EXPECT_THROW (evm::verify_program (prog), std::runtime_error);
+}
+
+static void
+expect_rejected (const std::vector<test_instr> &instrs,
+                 const std::vector<evm::primitive_value> &constants = {})
+{
+  auto prog = make_program (instrs, constants,
+                            { { .entry = 0,
+                                .arg_count = 1,
+                                .locals = { evm::I64_TYPE },
+                                .result = evm::I64_TYPE } });
+
+  EXPECT_THROW (evm::verify_program (prog), std::runtime_error);
+}
+
+TEST (verifier_tests, reject_test)
+{
+  auto i8 = evm::make_primitive<evm::I8_TYPE> (1);
+
+  // underflow.
+  expect_rejected ({ { opcode::add }, { opcode::ret } });
+  // different operand types.
+  expect_rejected (
+      { { opcode::load_local, 0 }, { opcode::load_const, 0 }, { opcode::add },
+        { opcode::ret } },
+      { i8 });
+  // wrong result type.
+  expect_rejected ({ { opcode::load_const, 0 }, { opcode::ret } }, { i8 });
+  // missing constant and local.
+  expect_rejected ({ { opcode::load_const, 0 }, { opcode::ret } });
+  expect_rejected ({ { opcode::load_local, 1 }, { opcode::ret } });
+  // running off the end.
+  expect_rejected ({ { opcode::load_local, 0 } });
+  // the loop grows the stack, so the join does not match.
+  expect_rejected ({ { opcode::load_local, 0 }, { opcode::jump, 0 } });
+  // calling a function that does not exist.
+  expect_rejected ({ { opcode::call, 3 }, { opcode::ret } });
+}
+
+TEST (verifier_tests, reference_test)
+{
+  auto verify = [] (const std::vector<test_instr> &instrs) {
+    auto prog = make_program (instrs, { evm::make_primitive<evm::I64_TYPE> (1) },
+                              { { .entry = 0,
+                                  .arg_count = 1,
+                                  .locals = { evm::REF_TYPE },
+                                  .result = evm::REF_TYPE } },
+                              { "a" });
+    return evm::verify_program (prog);
+  };
+
+  auto verified = verify ({ { opcode::load_string, 0 },
+                            { opcode::load_local, 0 },
+                            { opcode::concat },
+                            { opcode::ret } });
+  auto types = verified.stack_types (2);
+  ASSERT_EQ (types.size (), 2);
+  EXPECT_EQ (types[0], evm::REF_TYPE);
+  EXPECT_EQ (types[1], evm::REF_TYPE);
+
+  // references are not numbers.
+  EXPECT_THROW (verify ({ { opcode::load_local, 0 },
+                          { opcode::load_local, 0 },
+                          { opcode::add },
+                          { opcode::ret } }),
+                std::runtime_error);
+  EXPECT_THROW (verify ({ { opcode::load_local, 0 },
+                          { opcode::load_local, 0 },
+                          { opcode::eq },
+                          { opcode::pop },
+                          { opcode::load_local, 0 },
+                          { opcode::ret } }),
+                std::runtime_error);
+  EXPECT_THROW (verify ({ { opcode::load_local, 0 },
+                          { opcode::neg },
+                          { opcode::ret } }),
+                std::runtime_error);
+  EXPECT_THROW (verify ({ { opcode::load_local, 0 },
+                          { opcode::conv, evm::I64_TYPE },
+                          { opcode::pop },
+                          { opcode::load_local, 0 },
+                          { opcode::ret } }),
+                std::runtime_error);
+  // nor are numbers strings.
+  EXPECT_THROW (verify ({ { opcode::load_const, 0 },
+                          { opcode::load_const, 0 },
+                          { opcode::concat },
+                          { opcode::ret } }),
+                std::runtime_error);
+  // a string that does not exist.
+  EXPECT_THROW (verify ({ { opcode::load_string, 1 }, { opcode::ret } }),
+                std::runtime_error);
+}
+
+TEST (verifier_tests, shared_code_test)
+{
+  auto prog = make_program (
+      { { opcode::nop }, { opcode::ret } }, {},
+      { { .entry = 0, .arg_count = 0, .locals = {}, .result = {} },
+        { .entry = 1, .arg_count = 0, .locals = {}, .result = {} } });
+
+  // the first function falls through into the second.
+  EXPECT_THROW (evm::verify_program (prog), std::runtime_error);
+}